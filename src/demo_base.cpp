@@ -1,15 +1,73 @@
 
+#include <chrono>
 #include <vector>
 
 #include <imgui.h>
 
 #include "opengl_helpers.h"
 #include "color.h"
+#include "jobs.h"
 #include "maths.h"
 #include "mesh.h"
 
 #include "demo_base.h"
 
+static const GL::std140_member gFrameConstantsLayout[] =
+{
+    { "uProjection",   GL_FLOAT_MAT4, offsetof(demo_base::frame_constants, Projection) },
+    { "uClusterScale", GL_FLOAT_VEC4, offsetof(demo_base::frame_constants, ClusterScale) },
+    { "uClusterSize",  GL_INT_VEC4,   offsetof(demo_base::frame_constants, ClusterSize) },
+};
+
+static const GL::std140_member gDrawConstantsLayout[] =
+{
+    { "uModelView",    GL_FLOAT_MAT4, offsetof(demo_base::draw_constants, ModelView) },
+    { "uNormalMatrix", GL_FLOAT_MAT4, offsetof(demo_base::draw_constants, NormalMatrix) },
+};
+
+// Shared by both stages (ranges of the uniform ring)
+static const char* gFrameBlockStr = R"GLSL(
+layout(std140) uniform uFrameBlock
+{
+    mat4 uProjection;
+    vec4 uClusterScale; // Tiles per pixel (xy), depth slice = log(depth) * z + w
+    ivec4 uClusterSize;
+};
+)GLSL";
+
+// Lights of the fragment cluster (needs uFrameBlock and the injected light shading)
+static const char* gClusteredLightingStr = R"GLSL(
+uniform samplerBuffer uClusterLights;   // 5 texels per light (position, ambient, diffuse, specular, attenuation + radius)
+uniform usamplerBuffer uClusterRanges;  // Offset and count in uClusterIndices per cluster
+uniform usamplerBuffer uClusterIndices;
+
+vec3 cluster_shade(material material, vec3 viewPosition, vec3 viewNormal)
+{
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * uClusterScale.xy), int(log(-viewPosition.z) * uClusterScale.z + uClusterScale.w));
+    cluster = clamp(cluster, ivec3(0), uClusterSize.xyz - 1);
+    uvec2 range = texelFetch(uClusterRanges, (cluster.z * uClusterSize.y + cluster.y) * uClusterSize.x + cluster.x).xy;
+
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i)
+    {
+        int index = 5 * int(texelFetch(uClusterIndices, int(range.x + i)).x);
+        vec4 attenuation = texelFetch(uClusterLights, index + 4);
+        light clusterLight = light(true,
+            texelFetch(uClusterLights, index + 0),
+            texelFetch(uClusterLights, index + 1).rgb,
+            texelFetch(uClusterLights, index + 2).rgb,
+            texelFetch(uClusterLights, index + 3).rgb,
+            attenuation.xyz);
+
+        // Fade to 0 at the culling radius (no seams along the cluster bounds)
+        float ratio = length(clusterLight.viewPosition.xyz - viewPosition) / attenuation.w;
+        float window = clusterLight.viewPosition.w > 0.0 ? clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0) : 1.0;
+        color += window * window * light_shade(clusterLight, material, viewPosition, viewNormal);
+    }
+    return color;
+}
+)GLSL";
+
 static const char* gVertexShaderStr = R"GLSL(
 // Attributes
 layout(location = 0) in vec3 aPosition;
@@ -17,9 +75,11 @@ layout(location = 1) in vec2 aUV;
 layout(location = 2) in vec3 aNormal;
 
 // Uniforms
-uniform mat4 uProjection;
-uniform mat4 uModelView;
-uniform mat4 uNormalMatrix;
+layout(std140) uniform uDrawBlock
+{
+    mat4 uModelView;
+    mat4 uNormalMatrix;
+};
 
 // Varyings
 out vec2 vUV;
@@ -43,10 +103,12 @@ in vec3 vViewNormal;
 
 // Uniforms
 uniform sampler2D uColorTexture;
-uniform uLightBlock
+#ifndef CLUSTERED
+layout(std140) uniform uLightBlock
 {
 	light uLight[LIGHT_COUNT];
 };
+#endif
 
 // Shader outputs
 out vec4 oColor;
@@ -56,14 +118,83 @@ void main()
     oColor = texture(uColorTexture, vUV);
     
     // Compute phong shading
-    vec3 phongColor = gDefaultMaterial.emission;
+    vec3 phongColor = uMaterial.emission;
+#ifdef CLUSTERED
+    phongColor += cluster_shade(uMaterial, vViewPos, normalize(vViewNormal));
+#else
 	for (int i = 0; i < LIGHT_COUNT; ++i)
-        phongColor += light_shade(uLight[i], gDefaultMaterial, vViewPos, normalize(vViewNormal));
+        phongColor += light_shade(uLight[i], uMaterial, vViewPos, normalize(vViewNormal));
+#endif
     
     // Apply light color
     oColor.rgb *= phongColor;
 })GLSL";
 
+// Deferred path, geometry pass: surface attributes only (no lighting)
+static const char* gGBufferFragmentShaderStr = R"GLSL(
+// Varyings
+in vec2 vUV;
+in vec3 vViewPos;
+in vec3 vViewNormal;
+
+// Uniforms
+uniform sampler2D uColorTexture;
+uniform int uMaterialIndex;
+
+// Shader outputs (G-buffer)
+layout(location = 0) out vec4 oAlbedo; // Texture color, material index in alpha
+layout(location = 1) out vec4 oNormal; // View space
+
+void main()
+{
+    oAlbedo = vec4(texture(uColorTexture, vUV).rgb, float(uMaterialIndex) / 255.0);
+    oNormal = vec4(normalize(vViewNormal), 0.0);
+})GLSL";
+
+// Deferred path, shading pass: triangle covering the viewport
+static const char* gFullscreenVertexShaderStr = R"GLSL(
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+static const char* gShadingFragmentShaderStr = R"GLSL(
+// Uniforms
+uniform sampler2D uGBufferAlbedo;
+uniform sampler2D uGBufferNormal;
+uniform sampler2D uGBufferDepth;
+uniform vec2 uViewportOrigin;
+layout(std140) uniform uMaterialsBlock
+{
+    material uMaterials[MATERIAL_COUNT];
+};
+
+// Shader outputs
+out vec4 oColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy - uViewportOrigin);
+    float depth = texelFetch(uGBufferDepth, texel, 0).r;
+    if (depth == 1.0)
+        discard;
+    vec4 albedo = texelFetch(uGBufferAlbedo, texel, 0);
+    vec3 viewNormal = texelFetch(uGBufferNormal, texel, 0).xyz;
+
+    // View position from the depth (inverse of uProjection)
+    vec2 ndc = (vec2(texel) + 0.5) / vec2(textureSize(uGBufferDepth, 0)) * 2.0 - 1.0;
+    float viewZ = -uProjection[3][2] / (depth * 2.0 - 1.0 + uProjection[2][2]);
+    vec3 viewPos = vec3(-viewZ * (ndc.x + uProjection[2][0]) / uProjection[0][0], -viewZ * (ndc.y + uProjection[2][1]) / uProjection[1][1], viewZ);
+
+    material surfaceMaterial = uMaterials[int(albedo.a * 255.0 + 0.5)];
+    vec3 phongColor = surfaceMaterial.emission + cluster_shade(surfaceMaterial, viewPos, viewNormal);
+    oColor = vec4(albedo.rgb * phongColor, 1.0);
+
+    // Later passes (skybox, wireframe) test against the scene depth
+    gl_FragDepth = depth;
+})GLSL";
+
 static bool EditLight(GL::light* Light)
 {
     bool Result =
@@ -77,8 +208,19 @@ static bool EditLight(GL::light* Light)
     return Result;
 }
 
+static bool EditMaterial(GL::material* Material)
+{
+    bool Result =
+          ImGui::ColorEdit3("Ambient", Material->Ambient.e)
+        + ImGui::ColorEdit3("Diffuse", Material->Diffuse.e)
+        + ImGui::ColorEdit3("Specular", Material->Specular.e)
+        + ImGui::ColorEdit3("Emission", Material->Emission.e)
+        + ImGui::SliderFloat("Shininess", &Material->Shininess, 0.f, 256.f);
+    return Result;
+}
+
 demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
-    : GLDebug(GLDebug)
+    : GLCache(GLCache), GLDebug(GLDebug)
 {
     // Init camera pos
     this->Camera.Position = { 0.f, 0.f, 0.f };
@@ -91,7 +233,7 @@ demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
             { 0.0f, 0.0f, 0.0f, 1.0f }, // position
             { 0.2f, 0.2f, 0.2f }, -1.f, // ambient (+padding)
             { 1.0f, 1.0f, 1.0f }, -1.f, // diffuse (+padding)
-            { 1.0f, 1.0f, 1.0f },       // specular
+            { 1.0f, 1.0f, 1.0f }, -1.f, // specular (+padding)
             { 1.0f, 0.0f, 0.0f },       // attenuation(constant, linear, quadratic)
         };
 
@@ -115,56 +257,177 @@ demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
         LightsPosition[5] = {  3.030360f, 0.352532f,-1.644170f, 1.f }; // Candle 5
     }
 
-    // Assemble fragment shader strings (defines + code)
-    char FragmentShaderConfig[] = "#define LIGHT_COUNT %d  \n";
-    snprintf(FragmentShaderConfig, ARRAY_SIZE(FragmentShaderConfig), FragmentShaderConfig, LIGHT_COUNT);
-    const char* FragmentShaderStrs[2] = {
-        FragmentShaderConfig,
-        gFragmentShaderStr,
+    // Init materials (instances alternate between them)
+    {
+        GL::material DefaultMaterial =
+        {
+            { 0.2f, 0.2f, 0.2f }, -1.f, // ambient (+padding)
+            { 0.8f, 0.8f, 0.8f }, -1.f, // diffuse (+padding)
+            { 0.0f, 0.0f, 0.0f }, -1.f, // specular (+padding)
+            { 0.0f, 0.0f, 0.0f },       // emission
+            0.f,                        // shininess
+        };
+        Materials[0] = DefaultMaterial;
+
+        GL::material GlossyMaterial = DefaultMaterial;
+        GlossyMaterial.Specular = { 0.6f, 0.6f, 0.6f };
+        GlossyMaterial.Shininess = 64.f;
+        Materials[1] = GlossyMaterial;
+
+        MaterialBuffer = GL::CreateMaterialBuffer(Materials, MATERIAL_COUNT);
+    }
+
+    // Bind the uniform blocks and samplers once (blocks and samplers missing from a program are skipped)
+    auto SetupProgram = [this](GLuint Program)
+    {
+        GL::program_reflection Reflection = GL::ReflectProgram(Program);
+        const struct { const char* Name; GLuint Binding; } Blocks[] =
+        {
+            { "uLightBlock",     LIGHT_BLOCK_BINDING },
+            { "uFrameBlock",     FRAME_BLOCK_BINDING },
+            { "uDrawBlock",      DRAW_BLOCK_BINDING },
+            { "uMaterialsBlock", MATERIALS_BLOCK_BINDING },
+        };
+        for (const auto& Block : Blocks)
+        {
+            GLuint BlockIndex = GL::FindUniformBlock(Reflection, Block.Name);
+            if (BlockIndex != GL_INVALID_INDEX)
+                glUniformBlockBinding(Program, BlockIndex, Block.Binding);
+        }
+
+        glUseProgram(Program);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uClusterLights"), CLUSTER_LIGHTS_TEXTURE_UNIT);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uClusterRanges"), CLUSTER_RANGES_TEXTURE_UNIT);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uClusterIndices"), CLUSTER_INDICES_TEXTURE_UNIT);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uGBufferAlbedo"), GBUFFER_ALBEDO_TEXTURE_UNIT);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uGBufferNormal"), GBUFFER_NORMAL_TEXTURE_UNIT);
+        GL::Uniform(GL::GetUniform<int>(Reflection, "uGBufferDepth"), GBUFFER_DEPTH_TEXTURE_UNIT);
+
+        // Constants are copied as is to the ring and material buffer
+        GL::CheckUniformBlockLayout(Reflection, "uLightBlock", "uLight[0].", GL::LightLayout, LIGHT_COUNT * sizeof(GL::light));
+        GL::CheckUniformBlockLayout(Reflection, "uMaterialBlock", "uMaterial.", GL::MaterialLayout, sizeof(GL::material));
+        GL::CheckUniformBlockLayout(Reflection, "uMaterialsBlock", "uMaterials[0].", GL::MaterialLayout, MATERIAL_COUNT * sizeof(GL::material));
+        GL::CheckUniformBlockLayout(Reflection, "uFrameBlock", "", gFrameConstantsLayout, sizeof(frame_constants));
+        GL::CheckUniformBlockLayout(Reflection, "uDrawBlock", "", gDrawConstantsLayout, sizeof(draw_constants));
+        return Reflection;
     };
 
-    // Create main shader
-    this->Program = GL::CreateProgramEx(1, &gVertexShaderStr, 2, FragmentShaderStrs, true);
-    
-    // Create mesh
+    // Assemble shader strings (defines + code)
+    char ShaderConfig[64];
+    snprintf(ShaderConfig, ARRAY_SIZE(ShaderConfig), "#define LIGHT_COUNT %d\n#define MATERIAL_COUNT %d\n", LIGHT_COUNT, MATERIAL_COUNT);
+    const char* VertexShaderStrs[2] = {
+        gFrameBlockStr,
+        gVertexShaderStr,
+    };
+
+    // Create main shaders (one per lighting mode)
+    for (int Mode = 0; Mode < LIGHTING_MODE_COUNT; ++Mode)
+    {
+        const char* FragmentShaderStrs[5] = {
+            ShaderConfig,
+            (Mode == LIGHTING_CLUSTERED) ? "#define CLUSTERED\n" : "",
+            gFrameBlockStr,
+            (Mode == LIGHTING_CLUSTERED) ? gClusteredLightingStr : "",
+            gFragmentShaderStr,
+        };
+        Programs[Mode] = GL::CreateProgramEx(2, VertexShaderStrs, 5, FragmentShaderStrs, true);
+        SetupProgram(Programs[Mode]);
+    }
+
+    // Create deferred shaders (the shading pass always reads the cluster lists)
     {
-        // Use vbo from GLCache
-        MeshBuffer = GLCache.LoadObj("media/fantasy_game_inn.obj", 1.f, &this->MeshVertexCount);
+        GBufferProgram = GL::CreateProgramEx(2, VertexShaderStrs, 1, &gGBufferFragmentShaderStr);
+        GBufferMaterialIndexUniform = GL::GetUniform<int>(SetupProgram(GBufferProgram), "uMaterialIndex");
+
+        const char* FragmentShaderStrs[4] = {
+            ShaderConfig,
+            gFrameBlockStr,
+            gClusteredLightingStr,
+            gShadingFragmentShaderStr,
+        };
+        ShadingProgram = GL::CreateProgramEx(1, &gFullscreenVertexShaderStr, 4, FragmentShaderStrs, true);
+        ShadingViewportOriginUniform = GL::GetUniform<v2>(SetupProgram(ShadingProgram), "uViewportOrigin");
+
+        // Vertices are generated from gl_VertexID
+        glGenVertexArrays(1, &FullscreenVAO);
     }
 
-    // Gen light uniform block
+    // Light lists of the clustered lighting
     {
-        glGenBuffers(1, &LightsUniformBuffer);
-        glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
-        glBufferData(GL_UNIFORM_BUFFER, LIGHT_COUNT * sizeof(GL::light), &Lights[0], GL_DYNAMIC_DRAW);
+        ClusterLightsBuffer = GL::CreateTextureBuffer(GL_RGBA32F);
+        ClusterRangesBuffer = GL::CreateTextureBuffer(GL_RG32UI);
+        ClusterIndicesBuffer = GL::CreateTextureBuffer(GL_R32UI);
+        GLint MaxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &MaxTexels);
+        MaxClusteredLights = Math::Min(MaxTexels / 5, 65536);
     }
 
     // Gen texture
     {
-        Texture = GLCache.LoadTexture("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        TextureHandle = GLCache.LoadTextureAsync("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        Texture = TextureHandle.GetTexture();
     }
     
-    // Create a vertex array and bind it with the vertex buffer
+    // Create a vertex array and the mesh
+    glGenVertexArrays(1, &VAO);
+    LoadMesh();
+}
+
+void demo_base::LoadMesh()
+{
+    // Quantized: half positions, 10:10:10:2 normals and half uvs (16 bytes per vertex instead of 32)
+    vertex_descriptor Descriptor = QuantizedVertices
+        ? Mesh::PackedDescriptor(VERTEX_FORMAT_HALF, VERTEX_FORMAT_SNORM10, VERTEX_FORMAT_HALF)
+        : Mesh::PackedDescriptor(VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT);
+
+    // Use vbo/ibo from GLCache (empty until loaded, see Render), the other vertex format becomes evictable
+    MeshHandle = GLCache.LoadObjAsync("media/fantasy_game_inn.obj", 1.f, &Descriptor);
+    Mesh = MeshHandle.GetMesh();
+
+    // Picking structure (independent of the vertex format), built after the mesh by the background thread
+    // From the cached indexed mesh, so that triangle ids match the full detail triangles of the index buffer
+    if (!BvhRequested)
     {
-        glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, MeshBuffer);
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)OFFSETOF(vertex_full, Position));
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)OFFSETOF(vertex_full, UV));
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)OFFSETOF(vertex_full, Normal));
+        BvhRequested = true;
+        Jobs::RunInBackground([this]()
+        {
+            indexed_mesh IndexedMesh;
+            if (!Mesh::LoadObjIndexed(IndexedMesh, "media/fantasy_game_inn.obj", 1.f))
+                return;
+            auto StartTime = std::chrono::steady_clock::now();
+            Mesh::BuildBvh(Bvh, IndexedMesh.Vertices.data(), IndexedMesh.Indices.data(), (int)IndexedMesh.Lods[0].IndexCount);
+            BvhBuildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+            BvhReady = true;
+        });
     }
+
+    // Bind vertex array with the vertex buffer
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh.IndexBuffer);
+    //                                      Position  Normal  UV
+    GL::SetupVertexAttributes(Mesh.Descriptor, 0,       2,      1);
 }
 
 demo_base::~demo_base()
 {
+    // The bvh task writes into this demo
+    Jobs::WaitBackground();
+
     // Cleanup GL
-    //glDeleteTextures(1, &Texture);   // From cache
-    //glDeleteBuffers(1, &MeshBuffer); // From cache
+    // Texture and Mesh are released with their cache handles
     glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(Program);
+    GL::DeleteMaterialBuffer(MaterialBuffer);
+    GL::DeleteTextureBuffer(ClusterLightsBuffer);
+    GL::DeleteTextureBuffer(ClusterRangesBuffer);
+    GL::DeleteTextureBuffer(ClusterIndicesBuffer);
+    for (GLuint Program : Programs)
+        glDeleteProgram(Program);
+    glDeleteProgram(GBufferProgram);
+    glDeleteProgram(ShadingProgram);
+    glDeleteVertexArrays(1, &FullscreenVAO);
+    if (GBuffer.FBO)
+        GL::DeleteFramebuffer(GBuffer);
 }
 
 void demo_base::Update(const platform_io& IO)
@@ -176,10 +439,12 @@ void demo_base::Update(const platform_io& IO)
     glClearColor(0.0f, 0.0f, 0.0f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    mat4 ProjectionTransform = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
+    mat4 ProjectionTransform = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 1000.f);
     mat4 ViewTransform = CameraGetInverseMatrix(Camera);
     mat4 ModelTransform = Mat4::Translate({ 0.f, 0.f, 0.f });
 
+    if (Picking && BvhReady)
+        this->Pick(IO, ProjectionTransform, ViewTransform, ModelTransform);
     this->Render(ProjectionTransform, ViewTransform, ModelTransform);
     this->DisplayDebugUI();
 }
@@ -190,6 +455,113 @@ void demo_base::DisplayDebugUI()
     {
         // Debug display
         ImGui::Checkbox("Wireframe", &Wireframe);
+        if (ImGui::Checkbox("Quantized vertices", &QuantizedVertices))
+            LoadMesh();
+        if (ImGui::TreeNodeEx("Mesh"))
+        {
+            int IndexSize = (Mesh.IndexType == GL_UNSIGNED_SHORT) ? 2 : 4;
+            int FlatSize = Mesh.IndexCount * (int)sizeof(vertex_full);
+            int IndexedSize = Mesh.VertexCount * Mesh.Descriptor.Stride + Mesh.IndexCount * IndexSize;
+            ImGui::Text("Vertices: %d (%d bytes), Indices: %d (%d bits)", Mesh.VertexCount, Mesh.Descriptor.Stride, Mesh.IndexCount, IndexSize * 8);
+            ImGui::Text("VRAM: %.1f KB (non-indexed: %.1f KB)", IndexedSize / 1024.f, FlatSize / 1024.f);
+            ImGui::Text("Post-transform cache hit rate: %.1f%%", Mesh.CacheHitRate * 100.f);
+            ImGui::Text("ACMR: %.3f -> %.3f (optimized)", Mesh.SourceACMR, Mesh.ACMR);
+            ImGui::Text("ATVR: %.3f -> %.3f (optimized)", Mesh.SourceATVR, Mesh.ATVR);
+            if (Mesh.Pending)
+                ImGui::Text("Load time: loading...");
+            else
+                ImGui::Text("Load time: %.2f ms (%s cache)", Mesh.LoadTime, Mesh.WarmCache ? "warm" : "cold");
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNodeEx("Levels of detail", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Checkbox("Automatic", &AutomaticLod);
+            if (AutomaticLod)
+            {
+                ImGui::SliderFloat("Pixel error", &LodPixelError, 0.25f, 16.f, "%.2f px");
+                ImGui::SliderFloat("Hysteresis", &LodHysteresis, 0.f, 0.9f);
+            }
+            else
+            {
+                ImGui::SliderInt("Level", &ForcedLod, 0, Mesh.LodCount - 1);
+            }
+            ImGui::SliderInt("Instance grid", &InstanceGridSize, 1, 32);
+            ImGui::SliderFloat("Instance spacing", &InstanceSpacing, 10.f, 100.f);
+
+            int InstanceCount = InstanceGridSize * InstanceGridSize;
+            ImGui::Text("Triangles drawn: %d (%.1f%% of full detail)", DrawnTriangles, 100.f * DrawnTriangles / ((float)Mesh.IndexCount / 3 * InstanceCount));
+            for (int i = 0; i < Mesh.LodCount; ++i)
+            {
+                ImGui::Text("LOD %d: %6d triangles, error %.3f, %d instances", i,
+                    (int)Mesh.Lods[i].IndexCount / 3, Mesh.Lods[i].Error, LodInstanceCounts[i]);
+            }
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNodeEx("Culling", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Combo("Mode", &CullingMode, "None (single draw)\0Ranges (frustum)\0Meshlets (frustum + cone, multi-draw)\0");
+            int InstanceCount = InstanceGridSize * InstanceGridSize;
+            ImGui::Text("Instances: %d visible, %d culled", InstanceCount - CulledInstances, CulledInstances);
+            ImGui::Text("Clusters (full detail): %d visible, %d frustum culled, %d cone culled", VisibleClusters, FrustumCulledClusters, ConeCulledClusters);
+            ImGui::Text("Per mesh: %d ranges, %d meshlets", (int)Mesh.Ranges.size(), (int)Mesh.Meshlets.size());
+            ImGui::Text("Draw calls: %d, vertices submitted: %d", DrawCalls, DrawnTriangles * 3);
+            ImGui::Text("Render: %.3f ms cpu", CpuTime);
+            ImGui::Text("Uniform ring: %.1f/%.1f KB, %.3f ms fence wait", UniformRing.GetUsedSize() / 1024.f, UniformRing.GetFrameSize() / 1024.f, UniformRing.GetWaitTime());
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNodeEx("Render path", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::RadioButton("Forward", &RenderPath, RENDER_FORWARD);
+            ImGui::RadioButton("Deferred (G-buffer)", &RenderPath, RENDER_DEFERRED);
+
+            // Timers keep the result of the last frame drawn with their path
+            ImGui::Text("Forward: %.3f ms gpu", ForwardTimer.GetMilliseconds());
+            ImGui::Text("Deferred: %.3f ms gpu (geometry %.3f, shading %.3f)", GeometryTimer.GetMilliseconds() + ShadingTimer.GetMilliseconds(),
+                GeometryTimer.GetMilliseconds(), ShadingTimer.GetMilliseconds());
+            if (RenderPath == RENDER_DEFERRED && GBuffer.FBO && ImGui::TreeNode("G-buffer"))
+            {
+                v2 Size = { GBuffer.Width / 4.f, GBuffer.Height / 4.f };
+                ImGui::Image((ImTextureID)(size_t)GBuffer.ColorTextures[0], { Size.x, Size.y }, { 0.f, 1.f }, { 1.f, 0.f });
+                ImGui::SameLine();
+                ImGui::Image((ImTextureID)(size_t)GBuffer.ColorTextures[1], { Size.x, Size.y }, { 0.f, 1.f }, { 1.f, 0.f });
+                ImGui::TreePop();
+            }
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNodeEx("Lighting", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::RadioButton("Uniform block (all lights per fragment)", &LightingMode, LIGHTING_UNIFORM);
+            ImGui::RadioButton("Clustered", &LightingMode, LIGHTING_CLUSTERED);
+            if (LightingMode == LIGHTING_CLUSTERED || RenderPath == RENDER_DEFERRED)
+            {
+                ImGui::SliderInt("Stress lights", &StressLightCount, 0, 4096);
+                ImGui::SliderFloat("Light cutoff", &LightCutoff, 0.001f, 0.2f, "%.3f", 2.f);
+                int ClusterCount = Math::Max(1, (int)LightClusters.Ranges.size() / 2);
+                ImGui::Text("Grid: %d clusters, %d lights (max %d)", ClusterCount, (int)ClusterLights.size(), MaxClusteredLights);
+                ImGui::Text("Lights per cluster: %.1f average, %d max", (float)LightClusters.Indices.size() / ClusterCount, LightClusters.MaxLightsPerCluster);
+                ImGui::Text("Assignment: %.3f ms cpu (%d threads)", ClusterAssignTime, Jobs::GetThreadCount());
+            }
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNodeEx("Picking", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Checkbox("Enabled", &Picking);
+            if (BvhReady)
+                ImGui::Text("BVH: %d nodes (%.1f KB), built in %.2f ms", (int)Bvh.Nodes.size(), Bvh.Nodes.size() * sizeof(bvh_node) / 1024.f, BvhBuildTime);
+            else
+                ImGui::Text("BVH: loading...");
+            if (PickedInstance >= 0)
+            {
+                ImGui::Text("Hovered: instance %d, triangle %d", PickedInstance, (int)PickedHit.TriangleId);
+                ImGui::Text("Position: (%.2f, %.2f, %.2f)", PickedPosition.x, PickedPosition.y, PickedPosition.z);
+            }
+            else
+            {
+                ImGui::Text("Hovered: none");
+            }
+            ImGui::Text("Raycast: %.3f ms", PickTime);
+            ImGui::TreePop();
+        }
         if (ImGui::TreeNodeEx("Camera"))
         {
             ImGui::Text("Position: (%.2f, %.2f, %.2f)", Camera.Position.x, Camera.Position.y, Camera.Position.z);
@@ -200,7 +572,7 @@ void demo_base::DisplayDebugUI()
 
         if (ImGui::TreeNodeEx("Shader"))
         {
-            GLImGui::InspectProgram(Program);
+            GLImGui::InspectProgram(Programs[LightingMode]);
             ImGui::TreePop();
         }
 
@@ -212,11 +584,8 @@ void demo_base::DisplayDebugUI()
                 {
                     v4& LightPosition = LightsPosition[i];
                     GL::light& Light = Lights[i];
-                    if (ImGui::SliderFloat4("Position", LightPosition.e, -3.f, 3.f) + EditLight(&Light))
-                    {
-                        glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
-                        glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(GL::light), sizeof(GL::light), &Light);
-                    }
+                    ImGui::SliderFloat4("Position", LightPosition.e, -3.f, 3.f);
+                    EditLight(&Light);
 
                     // Calculate attenuation based on the light values
                     if (ImGui::TreeNode("Attenuation calculator"))
@@ -233,44 +602,426 @@ void demo_base::DisplayDebugUI()
             }
             ImGui::TreePop();
         }
+
+        if (ImGui::TreeNodeEx("Materials"))
+        {
+            for (int i = 0; i < MATERIAL_COUNT; ++i)
+            {
+                if (ImGui::TreeNode(&Materials[i], "Material[%d]", i))
+                {
+                    if (EditMaterial(&Materials[i]))
+                        GL::UpdateMaterial(MaterialBuffer, i, Materials[i]);
+                    ImGui::TreePop();
+                }
+            }
+            ImGui::TreePop();
+        }
         ImGui::TreePop();
     }
 }
 
+v3 demo_base::GetInstanceOffset(int InstanceIndex) const
+{
+    float Center = (InstanceGridSize - 1) * 0.5f;
+    float X = (InstanceIndex % InstanceGridSize - Center) * InstanceSpacing;
+    float Z = (InstanceIndex / InstanceGridSize - Center) * InstanceSpacing;
+    return { X, 0.f, Z };
+}
+
+mat4 demo_base::GetInstanceMatrix(int InstanceIndex, const mat4& ModelMatrix) const
+{
+    return Mat4::Translate(GetInstanceOffset(InstanceIndex)) * ModelMatrix;
+}
+
+// Pick the coarsest level whose error projects under LodPixelError (with hysteresis around the threshold)
+int demo_base::SelectLod(const mat4& ProjectionMatrix, const mat4& ModelView, int CurrentLod) const
+{
+    if (!AutomaticLod)
+        return Math::Clamp(ForcedLod, 0, Mesh.LodCount - 1);
+
+    // Projected bounding sphere radius (in pixels) gives the pixel size of a mesh unit
+    v4 Center = ModelView * Vec4::vec4(Mesh.BoundsCenter, 1.f);
+    float Scale = Math::Max(Vec3::Length(ModelView.c[0].xyz), Math::Max(Vec3::Length(ModelView.c[1].xyz), Vec3::Length(ModelView.c[2].xyz)));
+    float Radius = Mesh.BoundsRadius * Scale;
+    float Distance = -Center.z;
+    if (Distance <= Radius)
+        return 0;
+    float ScreenRadius = Radius * ProjectionMatrix.c[1].y * 0.5f * ViewportHeight / Distance;
+    float PixelsPerUnit = ScreenRadius / Mesh.BoundsRadius;
+
+    int Lod = Math::Clamp(CurrentLod, 0, Mesh.LodCount - 1);
+    if (Mesh.Lods[Lod].Error * PixelsPerUnit > LodPixelError * (1.f + LodHysteresis))
+    {
+        while (Lod > 0 && Mesh.Lods[Lod].Error * PixelsPerUnit > LodPixelError)
+            --Lod;
+    }
+    else
+    {
+        while (Lod + 1 < Mesh.LodCount && Mesh.Lods[Lod + 1].Error * PixelsPerUnit <= LodPixelError * (1.f - LodHysteresis))
+            ++Lod;
+    }
+    return Lod;
+}
+
 void demo_base::Render(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
 {
+    auto StartTime = std::chrono::steady_clock::now();
+    bool Deferred = (RenderPath == RENDER_DEFERRED);
+    (Deferred ? GeometryTimer : ForwardTimer).Begin();
+
+    // Get the mesh data once GLCache has uploaded it (same buffers)
+    if (Mesh.Pending)
+        Mesh = MeshHandle.GetMesh();
+
+    // Opaque surfaces (the debug wireframes leave blending enabled, G-buffer alpha is not a coverage)
     glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
 
-    // Use shader and configure its uniforms
-    glUseProgram(Program);
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+    ViewportHeight = (float)Viewport[3];
 
-    mat4 ModelView    = ViewMatrix * ModelMatrix;
-    mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelView));
+    // Missing mesh
+    int InstanceCount = (Mesh.LodCount > 0) ? InstanceGridSize * InstanceGridSize : 0;
+    if ((int)InstanceLods.size() != InstanceCount)
+        InstanceLods.assign(InstanceCount, 0);
 
-    // Matrices
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uProjection"), 1, GL_FALSE, ProjectionMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModelView"), 1, GL_FALSE, ModelView.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uNormalMatrix"), 1, GL_FALSE, ModelView.e);
+    DrawnTriangles = 0;
+    DrawCalls = 0;
+    CulledInstances = 0;
+    VisibleClusters = 0;
+    FrustumCulledClusters = 0;
+    ConeCulledClusters = 0;
+    for (int& Count : LodInstanceCounts)
+        Count = 0;
+    DrawRanges.clear();
+    InstanceDraws.clear();
 
-    // Update lights position inside the uniform buffer
-    for (int i = 0; i < LIGHT_COUNT; ++i)
+    // Deferred shading reads light lists, a single cluster holds all the lights without clustered lighting
+    bool LightLists = (LightingMode == LIGHTING_CLUSTERED || Deferred);
+    frame_constants FrameConstants = {};
+    FrameConstants.Projection = ProjectionMatrix;
+    if (LightLists)
     {
-        GL::light& Light = Lights[i];
-        Light.ViewPosition = ViewMatrix * ModelMatrix * LightsPosition[i];
-        glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
-        glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(GL::light) + OFFSETOF(GL::light, ViewPosition), sizeof(v4), &Light.ViewPosition);
+        cluster_grid Grid = (LightingMode == LIGHTING_CLUSTERED)
+            ? Clusters::MakeGrid(ProjectionMatrix, CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z)
+            : Clusters::MakeGrid(ProjectionMatrix, 1, 1, 1);
+        UpdateLightClusters(Grid, ViewMatrix, ModelMatrix, InstanceCount);
+        FrameConstants.ClusterScale.x = (float)Grid.SizeX / Viewport[2];
+        FrameConstants.ClusterScale.y = (float)Grid.SizeY / Viewport[3];
+        Clusters::GetSliceScaleBias(Grid, &FrameConstants.ClusterScale.z, &FrameConstants.ClusterScale.w);
+        FrameConstants.ClusterSize[0] = Grid.SizeX;
+        FrameConstants.ClusterSize[1] = Grid.SizeY;
+        FrameConstants.ClusterSize[2] = Grid.SizeZ;
     }
-    glBindBufferBase(GL_UNIFORM_BUFFER, glGetUniformBlockIndex(Program, "uLightBlock"), LightsUniformBuffer);
 
-    // Draw mesh
+    // Constants of the frame and of every draw are written before the first draw (one map per frame)
+    UniformRing.BeginFrame();
+    GLintptr FrameOffset = UniformRing.Push(FrameConstants);
+    GLintptr MaterialsOffset = Deferred ? UniformRing.Push(Materials, sizeof(Materials)) : 0;
+
+    // Instances only differ by a translation
+    mat4 ViewModel = ViewMatrix * ModelMatrix;
+    for (int InstanceIndex = 0; InstanceIndex < InstanceCount; ++InstanceIndex)
+    {
+        mat4 ModelView = ViewModel;
+        ModelView.c[3].xyz += (ViewMatrix * Vec4::vec4(GetInstanceOffset(InstanceIndex), 0.f)).xyz;
+
+        // Planes in model space, bounds are tested without transforming them
+        frustum ViewFrustum = Frustum::FromMatrix(ProjectionMatrix * ModelView);
+        if (CullingMode != CULLING_NONE && !Frustum::IsSphereVisible(ViewFrustum, Mesh.BoundsCenter, Mesh.BoundsRadius))
+        {
+            CulledInstances++;
+            continue;
+        }
+
+        // Matrices and lights in view space (the ring grows next frame if it is full)
+        draw_constants DrawConstants = { ModelView, ModelView };
+        instance_draw InstanceDraw;
+        InstanceDraw.InstanceIndex = InstanceIndex;
+        InstanceDraw.ConstantsOffset = UniformRing.Push(DrawConstants);
+        InstanceDraw.LightsOffset = 0;
+        if (!LightLists)
+        {
+            GL::light DrawLights[LIGHT_COUNT];
+            for (int i = 0; i < LIGHT_COUNT; ++i)
+            {
+                DrawLights[i] = Lights[i];
+                DrawLights[i].ViewPosition = ModelView * LightsPosition[i];
+            }
+            InstanceDraw.LightsOffset = UniformRing.Push(DrawLights, sizeof(DrawLights));
+        }
+        if (FrameOffset < 0 || MaterialsOffset < 0 || InstanceDraw.ConstantsOffset < 0 || InstanceDraw.LightsOffset < 0)
+            continue;
+
+        // Coarse levels are drawn whole, the full mesh only draws its visible clusters
+        int Lod = InstanceLods[InstanceIndex] = SelectLod(ProjectionMatrix, ModelView, InstanceLods[InstanceIndex]);
+        const mesh_lod& MeshLod = Mesh.Lods[Lod];
+        LodInstanceCounts[Lod]++;
+        int FirstDraw = (int)DrawRanges.size();
+        if (Lod == 0 && CullingMode == CULLING_RANGES && !Mesh.Ranges.empty())
+        {
+            for (const mesh_range& Range : Mesh.Ranges)
+            {
+                if (!Frustum::IsBoxVisible(ViewFrustum, Range.BoundsMin, Range.BoundsMax))
+                {
+                    FrustumCulledClusters++;
+                    continue;
+                }
+                VisibleClusters++;
+                AddDraw(FirstDraw, InstanceIndex, Range.IndexOffset, Range.IndexCount);
+            }
+        }
+        else if (Lod == 0 && CullingMode == CULLING_MESHLETS && !Mesh.Meshlets.empty())
+        {
+            // Camera position in model space for the normal cones
+            v3 Eye = Mat4::Inverse(ModelView).c[3].xyz;
+            for (const mesh_meshlet& Meshlet : Mesh.Meshlets)
+            {
+                if (!Frustum::IsSphereVisible(ViewFrustum, Meshlet.Center, Meshlet.Radius))
+                {
+                    FrustumCulledClusters++;
+                    continue;
+                }
+                v3 ToMeshlet = Meshlet.Center - Eye;
+                if (Vec3::Dot(ToMeshlet, Meshlet.ConeAxis) >= Meshlet.ConeCutoff * Vec3::Length(ToMeshlet) + Meshlet.Radius)
+                {
+                    ConeCulledClusters++;
+                    continue;
+                }
+                VisibleClusters++;
+                AddDraw(FirstDraw, InstanceIndex, Meshlet.IndexOffset, Meshlet.IndexCount);
+            }
+        }
+        else
+        {
+            DrawRanges.push_back({ InstanceIndex, MeshLod.IndexOffset, MeshLod.IndexCount });
+        }
+        InstanceDraw.FirstDraw = FirstDraw;
+        InstanceDraw.DrawCount = (int)DrawRanges.size() - FirstDraw;
+        InstanceDraws.push_back(InstanceDraw);
+    }
+    UniformRing.Unmap();
+
+    // Deferred: surfaces are written to the G-buffer (same size as the viewport), then shaded once per pixel
+    GLint PreviousFramebuffer = 0;
+    if (Deferred)
+    {
+        if (GBuffer.Width != Viewport[2] || GBuffer.Height != Viewport[3])
+        {
+            if (GBuffer.FBO)
+                GL::DeleteFramebuffer(GBuffer);
+            const GLenum GBufferFormats[2] = { GL_RGBA8, GL_RGBA16F }; // Albedo and material index, view normal
+            GBuffer = GL::CreateFramebuffer(Viewport[2], Viewport[3], 2, GBufferFormats, true);
+        }
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, GBuffer.FBO);
+        glViewport(0, 0, GBuffer.Width, GBuffer.Height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Use shader and bind the frame constants
+    glUseProgram(Deferred ? GBufferProgram : Programs[LightingMode]);
+    UniformRing.Bind(FRAME_BLOCK_BINDING, FrameOffset, sizeof(frame_constants));
+    if (LightLists)
+    {
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, ClusterLightsBuffer.Texture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_RANGES_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, ClusterRangesBuffer.Texture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_INDICES_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, ClusterIndicesBuffer.Texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
     glBindTexture(GL_TEXTURE_2D, Texture);
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, MeshVertexCount);
+
+    int IndexSize = (Mesh.IndexType == GL_UNSIGNED_SHORT) ? 2 : 4;
+    for (const instance_draw& InstanceDraw : InstanceDraws)
+    {
+        UniformRing.Bind(DRAW_BLOCK_BINDING, InstanceDraw.ConstantsOffset, sizeof(draw_constants));
+        if (!LightLists)
+            UniformRing.Bind(LIGHT_BLOCK_BINDING, InstanceDraw.LightsOffset, LIGHT_COUNT * sizeof(GL::light));
+        if (Deferred)
+            GL::Uniform(GBufferMaterialIndexUniform, InstanceDraw.InstanceIndex % MATERIAL_COUNT);
+        else
+            GL::BindMaterial(MaterialBuffer, InstanceDraw.InstanceIndex % MATERIAL_COUNT);
+
+        // Draw mesh
+        MultiDrawCounts.clear();
+        MultiDrawOffsets.clear();
+        for (int i = InstanceDraw.FirstDraw; i < InstanceDraw.FirstDraw + InstanceDraw.DrawCount; ++i)
+        {
+            const draw_range& Draw = DrawRanges[i];
+            MultiDrawCounts.push_back(Draw.IndexCount);
+            MultiDrawOffsets.push_back((const void*)((size_t)Draw.IndexOffset * IndexSize));
+            DrawnTriangles += Draw.IndexCount / 3;
+        }
+
+        if (CullingMode == CULLING_MESHLETS && MultiDrawCounts.size() > 1)
+        {
+            glMultiDrawElements(GL_TRIANGLES, MultiDrawCounts.data(), Mesh.IndexType, MultiDrawOffsets.data(), (GLsizei)MultiDrawCounts.size());
+            DrawCalls++;
+        }
+        else
+        {
+            for (int i = 0; i < (int)MultiDrawCounts.size(); ++i)
+                glDrawElements(GL_TRIANGLES, MultiDrawCounts[i], Mesh.IndexType, MultiDrawOffsets[i]);
+            DrawCalls += (int)MultiDrawCounts.size();
+        }
+    }
+
+    if (Deferred)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+        glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+        GeometryTimer.End();
+        ShadingTimer.Begin();
+
+        // Lights are accumulated per pixel, the G-buffer depth is copied for the next passes
+        glUseProgram(ShadingProgram);
+        GL::Uniform(ShadingViewportOriginUniform, v2{ (float)Viewport[0], (float)Viewport[1] });
+        if (MaterialsOffset >= 0)
+            UniformRing.Bind(MATERIALS_BLOCK_BINDING, MaterialsOffset, sizeof(Materials));
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_ALBEDO_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, GBuffer.ColorTextures[0]);
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, GBuffer.ColorTextures[1]);
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_DEPTH_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, GBuffer.DepthStencilTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glDepthFunc(GL_ALWAYS);
+        glBindVertexArray(FullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glDepthFunc(GL_LESS);
+    }
 
     if (Wireframe)
     {
-        //                           VBO        Vertex stride              Position offset,           Buffer size
-        GLDebug.WireframePrepare(MeshBuffer, sizeof(vertex_full), OFFSETOF(vertex_full, Position), MeshVertexCount);
-        GLDebug.WireframeDrawArray(0, MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+        GLDebug.WireframePrepare(Mesh.VertexBuffer, Mesh.Descriptor, Mesh.IndexBuffer);
+        for (const draw_range& Draw : DrawRanges)
+        {
+            mat4 MVP = ProjectionMatrix * ViewMatrix * GetInstanceMatrix(Draw.InstanceIndex, ModelMatrix);
+            GLDebug.WireframeDrawElements(Draw.IndexCount, Mesh.IndexType, MVP, Draw.IndexOffset);
+        }
     }
+
+    // Outline of the hovered triangle
+    if (Picking && PickedInstance >= 0 && PickedInstance < InstanceCount)
+    {
+        GLDebug.WireframePrepare(Mesh.VertexBuffer, Mesh.Descriptor, Mesh.IndexBuffer);
+        mat4 MVP = ProjectionMatrix * ViewMatrix * GetInstanceMatrix(PickedInstance, ModelMatrix);
+        GLDebug.WireframeDrawElements(3, Mesh.IndexType, MVP, PickedHit.TriangleId * 3);
+    }
+
+    UniformRing.EndFrame();
+    (Deferred ? ShadingTimer : ForwardTimer).End();
+    CpuTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+void demo_base::UpdateLightClusters(const cluster_grid& Grid, const mat4& ViewMatrix, const mat4& ModelMatrix, int InstanceCount)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    // Candles spread inside the mesh bounds (deterministic)
+    if ((int)StressLightsPosition.size() != StressLightCount && Mesh.LodCount > 0)
+    {
+        uint32_t Seed = 1234u;
+        auto Random = [&]() { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) / 16777216.f; };
+        float Extent = Mesh.BoundsRadius * 0.5f;
+        StressLightsPosition.resize(StressLightCount);
+        StressLights.resize(StressLightCount);
+        for (int i = 0; i < StressLightCount; ++i)
+        {
+            StressLightsPosition[i] = Vec4::vec4(Mesh.BoundsCenter + v3{ Random() - 0.5f, Random() - 0.5f, Random() - 0.5f } * (2.f * Extent), 1.f);
+            GL::light& Light = StressLights[i];
+            Light = Lights[1];
+            Light.Ambient = {};
+            Light.Diffuse = Color::RGB(0xFFB400) * (0.1f + 0.3f * Random());
+            Light.Specular = Light.Diffuse;
+            Light.Attenuation = { 1.f, 0.f, 8.f };
+        }
+    }
+
+    // Lights of every instance in view space (directional lights once)
+    ClusterLights.clear();
+    ClusterLightsData.clear();
+    auto AddLight = [&](const GL::light& Light, v4 ViewPosition)
+    {
+        float Radius = (ViewPosition.w > 0.f) ? Clusters::GetLightRadius(Light.Attenuation, LightCutoff) : FLT_MAX;
+        if (!Light.Enabled || Radius <= 0.f || (int)ClusterLights.size() >= MaxClusteredLights)
+            return;
+        ClusterLights.push_back({ ViewPosition.xyz, Radius });
+        ClusterLightsData.push_back(ViewPosition);
+        ClusterLightsData.push_back(Vec4::vec4(Light.Ambient, 0.f));
+        ClusterLightsData.push_back(Vec4::vec4(Light.Diffuse, 0.f));
+        ClusterLightsData.push_back(Vec4::vec4(Light.Specular, 0.f));
+        ClusterLightsData.push_back(Vec4::vec4(Light.Attenuation, Radius));
+    };
+    mat4 ViewModel = ViewMatrix * ModelMatrix;
+    for (int InstanceIndex = 0; InstanceIndex < InstanceCount; ++InstanceIndex)
+    {
+        mat4 ModelView = ViewModel;
+        ModelView.c[3].xyz += (ViewMatrix * Vec4::vec4(GetInstanceOffset(InstanceIndex), 0.f)).xyz;
+        for (int i = 0; i < LIGHT_COUNT; ++i)
+        {
+            if (LightsPosition[i].w != 0.f || InstanceIndex == 0)
+                AddLight(Lights[i], ModelView * LightsPosition[i]);
+        }
+        for (int i = 0; i < (int)StressLights.size(); ++i)
+            AddLight(StressLights[i], ModelView * StressLightsPosition[i]);
+    }
+
+    Clusters::AssignLights(LightClusters, Grid, ClusterLights.data(), (int)ClusterLights.size());
+    ClusterAssignTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+
+    GL::UploadTextureBuffer(ClusterLightsBuffer, ClusterLightsData.data(), ClusterLightsData.size() * sizeof(v4));
+    GL::UploadTextureBuffer(ClusterRangesBuffer, LightClusters.Ranges.data(), LightClusters.Ranges.size() * sizeof(uint32_t));
+    GL::UploadTextureBuffer(ClusterIndicesBuffer, LightClusters.Indices.data(), LightClusters.Indices.size() * sizeof(uint32_t));
+}
+
+void demo_base::Pick(const platform_io& IO, const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    // Segment between the near and far planes under the cursor
+    v2 Ndc = {};
+    if (!IO.MouseCaptured)
+        Ndc = { 2.f * IO.MouseX / IO.ScreenWidth - 1.f, 1.f - 2.f * IO.MouseY / IO.ScreenHeight };
+    mat4 InverseViewProjection = Mat4::Inverse(ProjectionMatrix * ViewMatrix);
+    v4 Near = InverseViewProjection * v4{ Ndc.x, Ndc.y, -1.f, 1.f };
+    v4 Far = InverseViewProjection * v4{ Ndc.x, Ndc.y, 1.f, 1.f };
+    v3 Origin = Near.xyz / Near.w;
+    v3 Direction = Far.xyz / Far.w - Origin;
+
+    // Distances are fractions of the segment, so they compare between instances
+    PickedInstance = -1;
+    ray_hit Hit;
+    float ClosestDistance = 1.f;
+    int InstanceCount = (Mesh.LodCount > 0) ? InstanceGridSize * InstanceGridSize : 0;
+    for (int InstanceIndex = 0; InstanceIndex < InstanceCount; ++InstanceIndex)
+    {
+        mat4 InverseModel = Mat4::Inverse(GetInstanceMatrix(InstanceIndex, ModelMatrix));
+        v3 ModelOrigin = (InverseModel * Vec4::vec4(Origin, 1.f)).xyz;
+        v3 ModelDirection = (InverseModel * Vec4::vec4(Direction, 0.f)).xyz;
+        if (Mesh::Raycast(Bvh, ModelOrigin, ModelDirection, ClosestDistance, &Hit))
+        {
+            ClosestDistance = Hit.Distance;
+            PickedInstance = InstanceIndex;
+            PickedHit = Hit;
+        }
+    }
+    PickedPosition = Origin + Direction * ClosestDistance;
+
+    PickTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+// Merge with the previous draw of the instance when contiguous
+void demo_base::AddDraw(int FirstDraw, int InstanceIndex, uint32_t IndexOffset, uint32_t IndexCount)
+{
+    draw_range* Previous = ((int)DrawRanges.size() > FirstDraw) ? &DrawRanges.back() : nullptr;
+    if (Previous && Previous->IndexOffset + Previous->IndexCount == IndexOffset)
+        Previous->IndexCount += IndexCount;
+    else
+        DrawRanges.push_back({ InstanceIndex, IndexOffset, IndexCount });
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <vector>
 
 #include "demo.h"
 
@@ -8,6 +10,8 @@
 #include "opengl_helpers.h"
 
 #include "camera.h"
+#include "light_clusters.h"
+#include "mesh_bvh.h"
 
 class demo_base : public demo
 {
@@ -19,24 +23,175 @@ public:
     void Render(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
     void DisplayDebugUI();
 
+    // Layout of 'uFrameBlock' (std140)
+    struct frame_constants
+    {
+        mat4 Projection;
+        v4 ClusterScale;    // Tiles per pixel (xy), depth slice scale and bias (zw)
+        int ClusterSize[4]; // Grid size (xyz)
+    };
+
+    // Layout of 'uDrawBlock' (std140)
+    struct draw_constants
+    {
+        mat4 ModelView;
+        mat4 NormalMatrix;
+    };
+
 private:
+    void LoadMesh();
+    // Instances are centered around the model
+    v3 GetInstanceOffset(int InstanceIndex) const;
+    mat4 GetInstanceMatrix(int InstanceIndex, const mat4& ModelMatrix) const;
+    int SelectLod(const mat4& ProjectionMatrix, const mat4& ModelView, int CurrentLod) const;
+    void AddDraw(int FirstDraw, int InstanceIndex, uint32_t IndexOffset, uint32_t IndexCount);
+    // Gather the view space lights and upload their cluster lists
+    void UpdateLightClusters(const cluster_grid& Grid, const mat4& ViewMatrix, const mat4& ModelMatrix, int InstanceCount);
+    // Cast a ray from the mouse cursor (screen center while the mouse is captured) against all instances
+    void Pick(const platform_io& IO, const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+
+    GL::cache& GLCache;
     GL::debug& GLDebug;
 
     // 3d camera
     camera Camera = {};
 
+    // Lights shaded by every fragment or looked up in the fragment cluster
+    enum lighting_mode
+    {
+        LIGHTING_UNIFORM,   // LIGHT_COUNT lights per instance in a uniform block
+        LIGHTING_CLUSTERED, // Lights of all the instances (and stress lights) in texture buffers
+        LIGHTING_MODE_COUNT,
+    };
+    int LightingMode = LIGHTING_CLUSTERED;
+
+    // Phong shading per fragment drawn, or once per pixel from a G-buffer
+    enum render_path
+    {
+        RENDER_FORWARD,
+        RENDER_DEFERRED, // Always reads light lists (a single cluster with uniform lighting)
+        RENDER_PATH_COUNT,
+    };
+    int RenderPath = RENDER_FORWARD;
+
     // GL objects needed by this demo
-    GLuint Program = 0;
-    GLuint MeshBuffer = 0;
+    GLuint Programs[LIGHTING_MODE_COUNT] = {};
+    static const GLuint LIGHT_BLOCK_BINDING = 1; // GL::MATERIAL_BLOCK_BINDING is 0
+    static const GLuint FRAME_BLOCK_BINDING = 2;
+    static const GLuint DRAW_BLOCK_BINDING = 3;
+    static const GLuint MATERIALS_BLOCK_BINDING = 4; // All the materials, read by the deferred shading pass
+    GL::cache_handle MeshHandle;
+    GL::mesh Mesh = {}; // Indexed mesh (from cache)
     GLuint VAO = 0;
-    GLuint LightsUniformBuffer = 0;
+    GL::cache_handle TextureHandle;
     GLuint Texture = 0;
-    int MeshVertexCount = 0; // Mesh Size
 
     bool Wireframe = false;
+    bool QuantizedVertices = true;
+
+    // Levels of detail
+    bool AutomaticLod = true;
+    int ForcedLod = 0;
+    float LodPixelError = 2.f;   // Maximum projected error
+    float LodHysteresis = 0.25f; // Relative margin around LodPixelError before switching level
+    float ViewportHeight = 1.f;  // Pixels
+
+    // Grid of instances around the model (to test distant meshes)
+    int InstanceGridSize = 1;
+    float InstanceSpacing = 30.f;
+    std::vector<int> InstanceLods; // Current level of each instance
+
+    // Instances are frustum culled with their bounding sphere, then the full detail level is split in clusters
+    enum culling_mode
+    {
+        CULLING_NONE,     // One draw per instance
+        CULLING_RANGES,   // Frustum culled ranges (bounding boxes), one draw per run of visible ranges
+        CULLING_MESHLETS, // Frustum and normal cone culled meshlets, one glMultiDrawElements per instance
+    };
+    int CullingMode = CULLING_MESHLETS;
+    struct draw_range
+    {
+        int InstanceIndex;
+        uint32_t IndexOffset;
+        uint32_t IndexCount;
+    };
+    std::vector<draw_range> DrawRanges; // Draws of the last Render() call (adjacent visible clusters are merged)
+    std::vector<GLsizei> MultiDrawCounts;
+    std::vector<const void*> MultiDrawOffsets;
+
+    // Per-frame and per-draw constants, written before the draws
+    GL::uniform_ring UniformRing{ 1024 * 1024 };
+    struct instance_draw
+    {
+        int InstanceIndex;
+        int FirstDraw; // In DrawRanges
+        int DrawCount;
+        GLintptr ConstantsOffset;
+        GLintptr LightsOffset;
+    };
+    std::vector<instance_draw> InstanceDraws;
+
+    // Stats of the last Render() call
+    int DrawnTriangles = 0;
+    int DrawCalls = 0;
+    int LodInstanceCounts[MESH_MAX_LODS] = {};
+    int CulledInstances = 0;
+    int VisibleClusters = 0; // Ranges or meshlets
+    int FrustumCulledClusters = 0;
+    int ConeCulledClusters = 0;
+    float CpuTime = 0.f; // Milliseconds
+    GL::gpu_timer ForwardTimer;  // Whole Render() of the last forward frame
+    GL::gpu_timer GeometryTimer; // Deferred frames (timer queries cannot nest): until the G-buffer is written
+    GL::gpu_timer ShadingTimer;  // Then the rest of Render()
+
+    // Mouse picking (the bvh triangles follow the full detail index order)
+    mesh_bvh Bvh;             // Written by the background thread until BvhReady
+    float BvhBuildTime = 0.f; // Milliseconds
+    bool BvhRequested = false;
+    std::atomic<bool> BvhReady{ false };
+    bool Picking = true;
+    int PickedInstance = -1;
+    ray_hit PickedHit = {};
+    v3 PickedPosition = {};
+    float PickTime = 0.f; // Milliseconds
 
     static const int LIGHT_COUNT = 8;
     GL::light Lights[LIGHT_COUNT] = {};
     // Positions relative to the mesh
     v4 LightsPosition[LIGHT_COUNT] = {};
+
+    static const int MATERIAL_COUNT = 2;
+    GL::material Materials[MATERIAL_COUNT] = {};
+    GL::material_buffer MaterialBuffer = {};
+
+    // Clustered lighting (view frustum split in froxels, lights assigned on the CPU)
+    static const int CLUSTER_GRID_X = 16;
+    static const int CLUSTER_GRID_Y = 9;
+    static const int CLUSTER_GRID_Z = 24;
+    static const int CLUSTER_LIGHTS_TEXTURE_UNIT = 1;
+    static const int CLUSTER_RANGES_TEXTURE_UNIT = 2;
+    static const int CLUSTER_INDICES_TEXTURE_UNIT = 3;
+    float LightCutoff = 0.01f;    // Attenuation where lights are culled (and faded out)
+    int StressLightCount = 0;     // Random candles added to every instance
+    std::vector<GL::light> StressLights;
+    std::vector<v4> StressLightsPosition;
+    std::vector<cluster_light> ClusterLights;
+    std::vector<v4> ClusterLightsData; // 5 texels per light
+    light_clusters LightClusters = {};
+    int MaxClusteredLights = 0;
+    float ClusterAssignTime = 0.f; // Milliseconds
+    GL::texture_buffer ClusterLightsBuffer = {};
+    GL::texture_buffer ClusterRangesBuffer = {};
+    GL::texture_buffer ClusterIndicesBuffer = {};
+
+    // Deferred shading
+    static const int GBUFFER_ALBEDO_TEXTURE_UNIT = 4;
+    static const int GBUFFER_NORMAL_TEXTURE_UNIT = 5;
+    static const int GBUFFER_DEPTH_TEXTURE_UNIT = 6;
+    GL::framebuffer GBuffer = {}; // Albedo (material index in alpha), view normal, depth (resized with the viewport)
+    GLuint GBufferProgram = 0;
+    GL::uniform<int> GBufferMaterialIndexUniform;
+    GLuint ShadingProgram = 0;
+    GL::uniform<v2> ShadingViewportOriginUniform;
+    GLuint FullscreenVAO = 0;
 };
@@ -0,0 +1,557 @@
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <imgui.h>
+#include <stb_image.h>
+
+#include "opengl_headers.h"
+
+#include "maths.h"
+#include "file.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "mesh_builders.h"
+#include "mesh_bvh.h"
+#include "opengl_helpers.h"
+#include "process_info.h"
+#include "simd.h"
+#include "texture.h"
+
+#include "demo_benchmark.h"
+
+// Same layout as demo_pg_skybox vertices
+struct vertex_position_uv
+{
+    v3 Position;
+    v2 UV;
+};
+
+template<>
+struct vertex_traits<vertex_position_uv>
+{
+    static constexpr auto Position = &vertex_position_uv::Position;
+    static constexpr auto Normal = nullptr;
+    static constexpr auto UV = &vertex_position_uv::UV;
+};
+
+static const char* gSyntheticObjFilename = "media/bench_synthetic.obj";
+
+// Write a wavy grid of quads with positions, uvs and normals
+static bool GenerateSyntheticObj(const char* Filename, int GridSize)
+{
+    FILE* File = fopen(Filename, "w");
+    if (File == nullptr)
+        return false;
+
+    fprintf(File, "# Synthetic benchmark mesh: %d triangles\n", GridSize * GridSize * 2);
+    fprintf(File, "o Synthetic\n");
+    int Side = GridSize + 1;
+    for (int y = 0; y < Side; ++y)
+    {
+        for (int x = 0; x < Side; ++x)
+        {
+            float U = x / (float)GridSize;
+            float V = y / (float)GridSize;
+            float Height = 0.1f * Math::Sin(U * 20.f) * Math::Cos(V * 20.f);
+            v3 Normal = Vec3::Normalize({ -2.f * Math::Cos(U * 20.f) * Math::Cos(V * 20.f), 1.f, 2.f * Math::Sin(U * 20.f) * Math::Sin(V * 20.f) });
+            fprintf(File, "v %.6f %.6f %.6f\n", U * 10.f - 5.f, Height, V * 10.f - 5.f);
+            fprintf(File, "vt %.6f %.6f\n", U, V);
+            fprintf(File, "vn %.6f %.6f %.6f\n", Normal.x, Normal.y, Normal.z);
+        }
+    }
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            int I0 = y * Side + x + 1;
+            int I1 = I0 + Side;
+            fprintf(File, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", I0, I0, I0, I1, I1, I1, I1 + 1, I1 + 1, I1 + 1);
+            fprintf(File, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", I0, I0, I0, I1 + 1, I1 + 1, I1 + 1, I0 + 1, I0 + 1, I0 + 1);
+        }
+    }
+
+    fclose(File);
+    return true;
+}
+
+template<typename function>
+static float MeasureTime(function Function)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+    Function();
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+demo_benchmark::demo_benchmark()
+{
+}
+
+demo_benchmark::~demo_benchmark()
+{
+}
+
+void demo_benchmark::RunObjBenchmark()
+{
+    file_info SyntheticInfo;
+    if (SyntheticGridSize != GeneratedGridSize || !File::GetInfo(gSyntheticObjFilename, &SyntheticInfo))
+    {
+        GenerateSyntheticObj(gSyntheticObjFilename, SyntheticGridSize);
+        GeneratedGridSize = SyntheticGridSize;
+    }
+
+    const char* Filenames[] = { "media/fantasy_game_inn.obj", gSyntheticObjFilename };
+    for (int i = 0; i < 2; ++i)
+    {
+        obj_result& Result = ObjResults[i];
+        Result = {};
+        Result.Filename = Filenames[i];
+
+        file_info Info;
+        if (File::GetInfo(Result.Filename, &Info))
+            Result.FileSize = Info.Size / (1024.f * 1024.f);
+
+        std::vector<vertex_full> Meshes[2];
+        Result.ParseTime[OBJ_PARSER_TINYOBJ] = MeasureTime([&]() { Mesh::ParseObj(Meshes[0], Result.Filename, OBJ_PARSER_TINYOBJ); });
+        Result.ParseTime[OBJ_PARSER_PARALLEL] = MeasureTime([&]() { Mesh::ParseObj(Meshes[1], Result.Filename, OBJ_PARSER_PARALLEL); });
+        Result.TriangleCount = (int)Meshes[1].size() / 3;
+        Result.Identical = Meshes[0].size() == Meshes[1].size()
+            && memcmp(Meshes[0].data(), Meshes[1].data(), Meshes[0].size() * sizeof(vertex_full)) == 0;
+    }
+    ObjBenchmarkDone = true;
+}
+
+static const int gTransformVertexCount = 10 * 1000 * 1000;
+
+void demo_benchmark::RunTransformBenchmark()
+{
+    mat4 Transform = Mat4::Translate({ 1.f, 2.f, 3.f }) * Mat4::RotateY(0.5f) * Mat4::Scale({ 1.f, 2.f, 1.f });
+
+    vertex_descriptor Descriptors[2];
+    Descriptors[0] = Mesh::PackedDescriptor(VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT);
+    Descriptors[1] = {};
+    Descriptors[1].Stride = sizeof(v3);
+
+    for (int LayoutId = 0; LayoutId < 2; ++LayoutId)
+    {
+        const vertex_descriptor& Descriptor = Descriptors[LayoutId];
+        transform_result& Result = TransformResults[LayoutId];
+        Result = {};
+
+        std::vector<uint8_t> Reference;
+        std::vector<uint8_t> Vertices((size_t)gTransformVertexCount * Descriptor.Stride);
+
+        for (int Level = SIMD_NONE; Level <= Simd::GetSupportedLevel(); ++Level)
+        {
+            // Same random unit cube positions and unit normals for each run
+            uint32_t Seed = 1;
+            vertex_full Source[1024];
+            for (int First = 0; First < gTransformVertexCount; First += ARRAY_SIZE(Source))
+            {
+                int Count = Math::Min((int)ARRAY_SIZE(Source), gTransformVertexCount - First);
+                for (int i = 0; i < Count; ++i)
+                {
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        Seed = Seed * 1664525u + 1013904223u;
+                        Source[i].Position.e[j] = (Seed >> 8) / 16777216.f - 0.5f;
+                    }
+                    Source[i].Normal = Vec3::Normalize(Source[i].Position);
+                }
+                Mesh::ConvertVertices(Vertices.data() + (size_t)First * Descriptor.Stride, Descriptor, Source, Count);
+            }
+
+            Result.Time[Level] = MeasureTime([&]() {
+                Mesh::Transform(Vertices.data(), Vertices.data() + Vertices.size(), Descriptor, Transform, (simd_level)Level);
+            });
+
+            // Keep the scalar result as reference
+            if (Level == SIMD_NONE)
+                Reference = Vertices;
+            else
+                Result.Identical[Level] = memcmp(Vertices.data(), Reference.data(), Reference.size()) == 0;
+        }
+        Result.Identical[SIMD_NONE] = true;
+    }
+    TransformBenchmarkDone = true;
+}
+
+// Build the same sphere with the runtime descriptor and with the vertex_traits builders
+template<typename vertex>
+static void MeasureBuildSphere(int Subdivisions, float Time[2], bool* Identical)
+{
+    vertex_descriptor Descriptor = Mesh::GetDescriptor<vertex>();
+    std::vector<vertex> Vertices[2];
+    for (std::vector<vertex>& Buffer : Vertices)
+        Buffer.resize((size_t)Subdivisions * Subdivisions * 6);
+
+    Time[0] = MeasureTime([&]() {
+        Mesh::BuildSphere(Vertices[0].data(), Vertices[0].data() + Vertices[0].size(), Descriptor, Subdivisions, Subdivisions);
+    });
+    Time[1] = MeasureTime([&]() {
+        Mesh::BuildSphere(Vertices[1].data(), Vertices[1].data() + Vertices[1].size(), Subdivisions, Subdivisions);
+    });
+    *Identical = memcmp(Vertices[0].data(), Vertices[1].data(), Vertices[0].size() * sizeof(vertex)) == 0;
+}
+
+void demo_benchmark::RunBuilderBenchmark()
+{
+    BuilderVertexCount = SphereSubdivisions * SphereSubdivisions * 6;
+    MeasureBuildSphere<vertex_full>(SphereSubdivisions, BuilderResults[0].Time, &BuilderResults[0].Identical);
+    MeasureBuildSphere<vertex_position_uv>(SphereSubdivisions, BuilderResults[1].Time, &BuilderResults[1].Identical);
+    BuilderBenchmarkDone = true;
+}
+
+// Reference closest hit (same triangle test than the bvh traversal)
+static bool RaycastBruteForce(const std::vector<vertex_full>& Triangles, v3 Origin, v3 Direction, float* Distance)
+{
+    bool Found = false;
+    for (int i = 0; i < (int)Triangles.size(); i += 3)
+    {
+        v3 P0 = Triangles[i].Position;
+        v3 Edge1 = Triangles[i + 1].Position - P0;
+        v3 Edge2 = Triangles[i + 2].Position - P0;
+        v3 PVec = Vec3::Cross(Direction, Edge2);
+        float Det = Vec3::Dot(Edge1, PVec);
+        if (Det == 0.f)
+            continue;
+
+        float InvDet = 1.f / Det;
+        v3 TVec = Origin - P0;
+        float U = Vec3::Dot(TVec, PVec) * InvDet;
+        v3 QVec = Vec3::Cross(TVec, Edge1);
+        float V = Vec3::Dot(Direction, QVec) * InvDet;
+        float T = Vec3::Dot(Edge2, QVec) * InvDet;
+        if (U >= 0.f && U <= 1.f && V >= 0.f && U + V <= 1.f && T >= 0.f && T < *Distance)
+        {
+            *Distance = T;
+            Found = true;
+        }
+    }
+    return Found;
+}
+
+void demo_benchmark::RunBvhBenchmark()
+{
+    std::vector<vertex_full> Triangles;
+    if (!Mesh::LoadObjNoConvertion(Triangles, "media/fantasy_game_inn.obj", 1.f))
+        return;
+
+    const int BuildCount = 10;
+    mesh_bvh Bvh;
+    BvhResult.BuildTime = MeasureTime([&]() {
+        for (int i = 0; i < BuildCount; ++i)
+            Mesh::BuildBvh(Bvh, Triangles.data(), (int)Triangles.size());
+    }) / BuildCount;
+    BvhResult.TriangleCount = (int)Triangles.size() / 3;
+    BvhResult.NodeCount = (int)Bvh.Nodes.size();
+
+    // Rays from a sphere around the mesh toward random points of its bounds
+    v3 Min = Bvh.Nodes[0].BoundsMin;
+    v3 Max = Bvh.Nodes[0].BoundsMax;
+    v3 Center = (Min + Max) * 0.5f;
+    float Radius = Vec3::Length(Max - Min);
+    const int RayCount = 1000000;
+    std::vector<v3> Origins(RayCount);
+    std::vector<v3> Directions(RayCount);
+    uint32_t Seed = 1;
+    auto Random = [&]() { Seed = Seed * 1664525u + 1013904223u; return (Seed >> 8) / 16777216.f; };
+    for (int i = 0; i < RayCount; ++i)
+    {
+        v3 Target = { Math::Lerp(Min.x, Max.x, Random()), Math::Lerp(Min.y, Max.y, Random()), Math::Lerp(Min.z, Max.z, Random()) };
+        v3 Offset = { Random() - 0.5f, Random() - 0.5f, Random() - 0.5f };
+        Origins[i] = Center + Vec3::Normalize(Offset) * Radius;
+        Directions[i] = Target - Origins[i];
+    }
+
+    std::vector<ray_hit> Hits(RayCount);
+    std::vector<bool> Found(RayCount);
+    float BvhTime = MeasureTime([&]() {
+        for (int i = 0; i < RayCount; ++i)
+            Found[i] = Mesh::Raycast(Bvh, Origins[i], Directions[i], FLT_MAX, &Hits[i]);
+    });
+    BvhResult.RaysPerSecond[0] = RayCount / (BvhTime * 1000.f);
+
+    // Brute force on a subset
+    const int BruteForceRayCount = 1000;
+    BvhResult.Identical = true;
+    float BruteForceTime = MeasureTime([&]() {
+        for (int i = 0; i < BruteForceRayCount; ++i)
+        {
+            float Distance = FLT_MAX;
+            bool BruteForceFound = RaycastBruteForce(Triangles, Origins[i], Directions[i], &Distance);
+            if (BruteForceFound != Found[i] || (BruteForceFound && Distance != Hits[i].Distance))
+                BvhResult.Identical = false;
+        }
+    });
+    BvhResult.RaysPerSecond[1] = BruteForceRayCount / (BruteForceTime * 1000.f);
+    BvhBenchmarkDone = true;
+}
+
+static std::vector<uint8_t> ReadVertexBuffer(GLuint Buffer, size_t Size)
+{
+    std::vector<uint8_t> Data(Size);
+    glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, Size, Data.data());
+    return Data;
+}
+
+static float ToMegabytes(size_t Bytes) { return Bytes / (1024.f * 1024.f); }
+
+void demo_benchmark::RunStreamBenchmark()
+{
+    file_info SyntheticInfo;
+    if (SyntheticGridSize != GeneratedGridSize || !File::GetInfo(gSyntheticObjFilename, &SyntheticInfo))
+    {
+        GenerateSyntheticObj(gSyntheticObjFilename, SyntheticGridSize);
+        GeneratedGridSize = SyntheticGridSize;
+    }
+
+    // Same vertex format as demo_base
+    vertex_descriptor Descriptor = Mesh::PackedDescriptor(VERTEX_FORMAT_HALF, VERTEX_FORMAT_SNORM10, VERTEX_FORMAT_HALF);
+
+    const char* Filenames[] = { "media/fantasy_game_inn.obj", gSyntheticObjFilename };
+    for (int i = 0; i < 2; ++i)
+    {
+        stream_result& Result = StreamResults[i];
+        Result = {};
+        Result.Filename = Filenames[i];
+
+        file_info Info;
+        if (File::GetInfo(Result.Filename, &Info))
+            Result.FileSize = ToMegabytes(Info.Size);
+
+        // Streamed first so that the in-memory load does not leave freed pages to reuse
+        obj_stream_stats Stats;
+        GL::mesh Streamed = GL::StreamObj(Result.Filename, 1.f, Descriptor, (size_t)StreamBudget * 1024 * 1024, &Stats);
+        glFinish();
+        Result.Time[0] = Streamed.LoadTime;
+        Result.PeakMemory[0] = ToMegabytes(Stats.PeakResident - Stats.StartResident);
+        Result.AttributeMemory = ToMegabytes(Stats.AttributeBytes);
+        Result.BlockCount = Stats.BlockCount;
+        Result.VertexCount = Stats.VertexCount;
+
+        // Whole file parsed then converted and uploaded at once
+        GLuint Buffer = 0;
+        size_t StartResident = ProcessInfo::GetResidentMemory();
+        size_t PeakResident = StartResident;
+        Result.Time[1] = MeasureTime([&]()
+        {
+            std::vector<vertex_full> Vertices;
+            Mesh::ParseObj(Vertices, Result.Filename);
+            PeakResident = Math::Max(PeakResident, ProcessInfo::GetResidentMemory());
+            std::vector<uint8_t> Converted((size_t)Vertices.size() * Descriptor.Stride);
+            Mesh::ConvertVertices(Converted.data(), Descriptor, Vertices.data(), (int)Vertices.size());
+            PeakResident = Math::Max(PeakResident, ProcessInfo::GetResidentMemory());
+
+            glGenBuffers(1, &Buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+            glBufferData(GL_ARRAY_BUFFER, Converted.size(), Converted.data(), GL_STATIC_DRAW);
+            glFinish();
+            PeakResident = Math::Max(PeakResident, ProcessInfo::GetResidentMemory());
+        });
+        Result.PeakMemory[1] = ToMegabytes(PeakResident - StartResident);
+
+        size_t Size = (size_t)Result.VertexCount * Descriptor.Stride;
+        Result.Identical = Streamed.VertexBuffer != 0 && ReadVertexBuffer(Streamed.VertexBuffer, Size) == ReadVertexBuffer(Buffer, Size);
+
+        glDeleteBuffers(1, &Streamed.VertexBuffer);
+        glDeleteBuffers(1, &Buffer);
+    }
+    StreamBenchmarkDone = true;
+}
+
+static const char* gMipmapImageFilename = "media/fantasy_game_inn_diffuse.png";
+
+void demo_benchmark::RunMipmapBenchmark()
+{
+    MipmapResult = {};
+    int Width, Height, Channels;
+    uint8_t* Pixels = stbi_load(gMipmapImageFilename, &Width, &Height, &Channels, 0);
+    if (Pixels == nullptr)
+        return;
+
+    MipmapResult.Width = Width;
+    MipmapResult.Height = Height;
+    MipmapResult.LevelCount = 1;
+    for (int Size = Math::Max(Width, Height); Size > 1; Size /= 2)
+        MipmapResult.LevelCount++;
+
+    // Levels 1+
+    size_t MipmapSize = 0;
+    for (int i = 1; i < MipmapResult.LevelCount; ++i)
+        MipmapSize += (size_t)Math::Max(Width >> i, 1) * Math::Max(Height >> i, 1) * Channels;
+
+    std::vector<uint8_t> Reference;
+    std::vector<uint8_t> Mipmaps(MipmapSize);
+    uint8_t* Levels[TEXTURE_MAX_LEVELS] = { Pixels };
+    size_t Offset = 0;
+    for (int i = 1; i < MipmapResult.LevelCount; ++i)
+    {
+        Levels[i] = Mipmaps.data() + Offset;
+        Offset += (size_t)Math::Max(Width >> i, 1) * Math::Max(Height >> i, 1) * Channels;
+    }
+
+    for (int Level = SIMD_NONE; Level <= Simd::GetSupportedLevel(); ++Level)
+    {
+        MipmapResult.Time[Level] = MeasureTime([&]() {
+            Texture::GenerateMipmaps(Levels, MipmapResult.LevelCount, Pixels, Width, Height, Channels, TEXTURE_BUILD_MIPMAPS, (simd_level)Level);
+        });
+
+        // Keep the scalar result as reference
+        if (Level == SIMD_NONE)
+            Reference = Mipmaps;
+        MipmapResult.Identical[Level] = Mipmaps == Reference;
+    }
+
+    // Driver
+    GLuint Texture;
+    GLint Format = (Channels == 3) ? GL_RGB : GL_RGBA;
+    glGenTextures(1, &Texture);
+    glBindTexture(GL_TEXTURE_2D, Texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, Format, Width, Height, 0, Format, GL_UNSIGNED_BYTE, Pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glFinish();
+    MipmapResult.DriverTime = MeasureTime([&]() {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+    });
+    glDeleteTextures(1, &Texture);
+
+    stbi_image_free(Pixels);
+    MipmapBenchmarkDone = true;
+}
+
+void demo_benchmark::Update(const platform_io& IO)
+{
+    glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    ImGui::Text("Worker threads: %d", Jobs::GetThreadCount());
+
+    if (ImGui::CollapsingHeader("OBJ parsing", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::SliderInt("Synthetic grid size", &SyntheticGridSize, 100, 2000);
+        ImGui::Text("Synthetic mesh: %d triangles", SyntheticGridSize * SyntheticGridSize * 2);
+        if (ImGui::Button("Run OBJ benchmark"))
+            RunObjBenchmark();
+
+        if (ObjBenchmarkDone)
+        {
+            for (const obj_result& Result : ObjResults)
+            {
+                ImGui::Separator();
+                ImGui::Text("%s (%.1f MB, %d triangles)", Result.Filename, Result.FileSize, Result.TriangleCount);
+                ImGui::Text("tinyobj:  %8.1f ms (%.1f MB/s)", Result.ParseTime[0], Result.FileSize / (Result.ParseTime[0] / 1000.f));
+                ImGui::Text("parallel: %8.1f ms (%.1f MB/s)", Result.ParseTime[1], Result.FileSize / (Result.ParseTime[1] / 1000.f));
+                ImGui::Text("Speedup: x%.2f, output %s", Result.ParseTime[0] / Result.ParseTime[1], Result.Identical ? "identical" : "DIFFERENT");
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Mesh::Transform", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::Text("CPU support: %s", Simd::GetLevelName(Simd::GetSupportedLevel()));
+        if (ImGui::Button("Run transform benchmark (10M vertices)"))
+            RunTransformBenchmark();
+
+        if (TransformBenchmarkDone)
+        {
+            const char* LayoutNames[2] = { "vertex_full", "positions only" };
+            for (int LayoutId = 0; LayoutId < 2; ++LayoutId)
+            {
+                const transform_result& Result = TransformResults[LayoutId];
+                ImGui::Separator();
+                ImGui::Text("%s", LayoutNames[LayoutId]);
+                for (int Level = SIMD_NONE; Level <= Simd::GetSupportedLevel(); ++Level)
+                {
+                    ImGui::Text("%-8s %8.1f ms %8.1f Mverts/s (x%.2f) %s", Simd::GetLevelName((simd_level)Level), Result.Time[Level],
+                        gTransformVertexCount / (Result.Time[Level] * 1000.f), Result.Time[SIMD_NONE] / Result.Time[Level],
+                        Result.Identical[Level] ? "" : "DIFFERENT");
+                }
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Mesh::BuildSphere", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::SliderInt("Lon/Lat", &SphereSubdivisions, 100, 2000);
+        ImGui::Text("Sphere: %d vertices", SphereSubdivisions * SphereSubdivisions * 6);
+        if (ImGui::Button("Run builder benchmark"))
+            RunBuilderBenchmark();
+
+        if (BuilderBenchmarkDone)
+        {
+            const char* LayoutNames[2] = { "vertex_full", "position + uv" };
+            for (int LayoutId = 0; LayoutId < 2; ++LayoutId)
+            {
+                const builder_result& Result = BuilderResults[LayoutId];
+                ImGui::Separator();
+                ImGui::Text("%s", LayoutNames[LayoutId]);
+                ImGui::Text("descriptor: %8.1f ms %8.1f Mverts/s", Result.Time[0], BuilderVertexCount / (Result.Time[0] * 1000.f));
+                ImGui::Text("traits:     %8.1f ms %8.1f Mverts/s", Result.Time[1], BuilderVertexCount / (Result.Time[1] * 1000.f));
+                ImGui::Text("Speedup: x%.2f, output %s", Result.Time[0] / Result.Time[1], Result.Identical ? "identical" : "DIFFERENT");
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Mesh::BuildBvh / Mesh::Raycast", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        if (ImGui::Button("Run BVH benchmark (fantasy_game_inn.obj, 1M rays)"))
+            RunBvhBenchmark();
+
+        if (BvhBenchmarkDone)
+        {
+            ImGui::Text("%d triangles, %d nodes (%.1f KB)", BvhResult.TriangleCount, BvhResult.NodeCount, BvhResult.NodeCount * sizeof(bvh_node) / 1024.f);
+            ImGui::Text("Build:       %8.2f ms", BvhResult.BuildTime);
+            ImGui::Text("BVH:         %8.3f Mrays/s", BvhResult.RaysPerSecond[0]);
+            ImGui::Text("Brute force: %8.3f Mrays/s", BvhResult.RaysPerSecond[1]);
+            ImGui::Text("Speedup: x%.1f, hits %s", BvhResult.RaysPerSecond[0] / BvhResult.RaysPerSecond[1], BvhResult.Identical ? "identical" : "DIFFERENT");
+        }
+    }
+
+    if (ImGui::CollapsingHeader("GL::StreamObj", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::SliderInt("Memory budget (MB)", &StreamBudget, 1, 64);
+        if (ImGui::Button("Run streaming benchmark"))
+            RunStreamBenchmark();
+
+        if (StreamBenchmarkDone)
+        {
+            for (const stream_result& Result : StreamResults)
+            {
+                ImGui::Separator();
+                ImGui::Text("%s (%.1f MB, %d vertices)", Result.Filename, Result.FileSize, Result.VertexCount);
+                ImGui::Text("streamed:  %8.1f ms, peak resident +%.1f MB (%.1f MB attributes, %d blocks)",
+                    Result.Time[0], Result.PeakMemory[0], Result.AttributeMemory, Result.BlockCount);
+                ImGui::Text("in memory: %8.1f ms, peak resident +%.1f MB", Result.Time[1], Result.PeakMemory[1]);
+                ImGui::Text("Vertex buffer %s", Result.Identical ? "identical" : "DIFFERENT");
+            }
+            ImGui::Text("Process peak resident memory: %.1f MB", ToMegabytes(ProcessInfo::GetPeakResidentMemory()));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Texture::GenerateMipmaps", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        if (ImGui::Button("Run mipmap benchmark (fantasy_game_inn_diffuse.png)"))
+            RunMipmapBenchmark();
+
+        if (MipmapBenchmarkDone)
+        {
+            // Throughput in source pixels
+            float MegaPixels = MipmapResult.Width * MipmapResult.Height / 1000000.f;
+            ImGui::Text("%dx%d, %d levels, Kaiser filter in linear space", MipmapResult.Width, MipmapResult.Height, MipmapResult.LevelCount);
+            for (int Level = SIMD_NONE; Level <= Simd::GetSupportedLevel(); ++Level)
+            {
+                ImGui::Text("%-8s %8.1f ms %8.1f MPixels/s (x%.2f) %s", Simd::GetLevelName((simd_level)Level), MipmapResult.Time[Level],
+                    MegaPixels / (MipmapResult.Time[Level] / 1000.f), MipmapResult.Time[SIMD_NONE] / MipmapResult.Time[Level],
+                    MipmapResult.Identical[Level] ? "identical" : "DIFFERENT");
+            }
+            ImGui::Text("glGenerateMipmap %8.1f ms %8.1f MPixels/s (box filter in gamma space)", MipmapResult.DriverTime, MegaPixels / (MipmapResult.DriverTime / 1000.f));
+        }
+    }
+}
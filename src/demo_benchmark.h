@@ -0,0 +1,92 @@
+#pragma once
+
+#include "demo.h"
+
+// CPU benchmarks of the engine systems (results are displayed with ImGui)
+class demo_benchmark : public demo
+{
+public:
+    demo_benchmark();
+    virtual ~demo_benchmark();
+    virtual void Update(const platform_io& IO);
+
+private:
+    struct obj_result
+    {
+        const char* Filename;
+        float FileSize;  // MB
+        int TriangleCount;
+        float ParseTime[2]; // ms (tinyobj, parallel)
+        bool Identical;
+    };
+
+    struct transform_result
+    {
+        float Time[3]; // ms per simd_level
+        bool Identical[3];
+    };
+
+    struct builder_result
+    {
+        float Time[2]; // ms (vertex_descriptor, vertex_traits)
+        bool Identical;
+    };
+
+    void RunObjBenchmark();
+    void RunTransformBenchmark();
+    void RunBuilderBenchmark();
+    void RunBvhBenchmark();
+    void RunStreamBenchmark();
+    void RunMipmapBenchmark();
+
+    int SyntheticGridSize = 1000; // Quads per side (2 triangles per quad)
+    int GeneratedGridSize = 0;
+    obj_result ObjResults[2] = {};
+    bool ObjBenchmarkDone = false;
+
+    transform_result TransformResults[2] = {}; // vertex_full, positions only
+    bool TransformBenchmarkDone = false;
+
+    int SphereSubdivisions = 1000; // Lon and Lat of the benchmark sphere
+    int BuilderVertexCount = 0;
+    builder_result BuilderResults[2] = {}; // vertex_full, position + uv
+    bool BuilderBenchmarkDone = false;
+
+    struct bvh_result
+    {
+        int TriangleCount;
+        int NodeCount;
+        float BuildTime;       // ms (average)
+        float RaysPerSecond[2]; // Millions (bvh, brute force)
+        bool Identical;         // Same closest hits
+    };
+    bvh_result BvhResult = {};
+    bool BvhBenchmarkDone = false;
+
+    struct stream_result
+    {
+        const char* Filename;
+        float FileSize;         // MB
+        int VertexCount;
+        int BlockCount;
+        float Time[2];          // ms (streamed, in memory)
+        float PeakMemory[2];    // MB above the resident memory before loading (streamed, in memory)
+        float AttributeMemory;  // MB of attributes kept by the streamed load
+        bool Identical;         // Same vertex buffer content
+    };
+    int StreamBudget = 4; // MB
+    stream_result StreamResults[2] = {};
+    bool StreamBenchmarkDone = false;
+
+    struct mipmap_result
+    {
+        int Width;
+        int Height;
+        int LevelCount;
+        float Time[3];      // ms per simd_level
+        bool Identical[3];  // Same levels than the scalar code
+        float DriverTime;   // ms (glGenerateMipmap: box filter in gamma space)
+    };
+    mipmap_result MipmapResult = {};
+    bool MipmapBenchmarkDone = false;
+};
@@ -55,6 +55,11 @@ demo_minimal::demo_minimal()
 {
     // Create render pipeline
     this->Program = GL::CreateProgram(gVertexShaderStr, gFragmentShaderStr);
+    {
+        GL::program_reflection Reflection = GL::ReflectProgram(Program);
+        TimeUniform = GL::GetUniform<float>(Reflection, "uTime");
+        ModelViewProjUniform = GL::GetUniform<mat4>(Reflection, "uModelViewProj");
+    }
     
     // Gen mesh
     {
@@ -117,14 +122,14 @@ void demo_minimal::Update(const platform_io& IO)
 
     // Use shader and send data
     glUseProgram(Program);
-    glUniform1f(glGetUniformLocation(Program, "uTime"), (float)IO.Time);
+    GL::Uniform(TimeUniform, (float)IO.Time);
 
     // Compute model-view-proj and send it to shader
     mat4 ProjectionTransform = Mat4::Perspective(Math::ToRadians(60.f), (float)IO.ScreenWidth / (float)IO.ScreenHeight, 0.1f, 100.f);
     mat4 ViewTransform = CameraGetInverseMatrix(Camera);
     mat4 ModelTransform = Mat4::Translate({ 0.f, 0.f, -2.f });
     mat4 ModelViewProj = ProjectionTransform * ViewTransform * ModelTransform;
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModelViewProj"), 1, GL_FALSE, ModelViewProj.e);
+    GL::Uniform(ModelViewProjUniform, ModelViewProj);
     
     // Display cube
     glBindTexture(GL_TEXTURE_2D, Texture);
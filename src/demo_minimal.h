@@ -3,6 +3,7 @@
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers.h"
 
 #include "camera.h"
 
@@ -19,6 +20,8 @@ private:
 
     // GL objects needed by this demo
     GLuint Program = 0;
+    GL::uniform<float> TimeUniform;
+    GL::uniform<mat4> ModelViewProjUniform;
     GLuint Texture = 0;
 
     GLuint VAO = 0;
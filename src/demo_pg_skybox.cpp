@@ -6,6 +6,7 @@
 #include "opengl_helpers.h"
 #include "maths.h"
 #include "mesh.h"
+#include "mesh_builders.h"
 
 #include "demo_pg_skybox.h"
 
@@ -15,6 +16,15 @@ struct vertex
     v2 UV;
 };
 
+// Compile-time vertex format (straight-line Mesh builders)
+template<>
+struct vertex_traits<vertex>
+{
+    static constexpr auto Position = &vertex::Position;
+    static constexpr auto Normal = nullptr;
+    static constexpr auto UV = &vertex::UV;
+};
+
 static const char* gVertexShaderStr = R"GLSL(
 // Attributes
 layout(location = 0) in vec3 aPosition;
@@ -49,6 +59,38 @@ void main()
     oColor = texture(uColorTexture, vUV);
 })GLSL";
 
+// Full screen triangle at the far plane (z = w)
+static const char* gCubemapVertexShaderStr = R"GLSL(
+// Uniforms
+uniform mat4 uInverseViewProjection; // Without the camera translation
+
+// Varyings
+out vec4 vDirection;
+
+void main()
+{
+    vec2 Position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    vDirection = uInverseViewProjection * vec4(Position, 1.0, 1.0);
+    gl_Position = vec4(Position, 1.0, 1.0);
+})GLSL";
+
+static const char* gCubemapFragmentShaderStr = R"GLSL(
+// Varyings
+in vec4 vDirection;
+
+// Uniforms
+uniform samplerCube uSkybox;
+
+// Shader outputs
+out vec4 oColor;
+
+void main()
+{
+    // Same orientation than the 6 faces of the inverted cube (see LoadCubemap face order)
+    vec3 Direction = vDirection.xyz / vDirection.w;
+    oColor = texture(uSkybox, vec3(-Direction.z, Direction.y, -Direction.x));
+})GLSL";
+
 demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
     : DemoBase(GLCache, GLDebug)
 {
@@ -56,6 +98,14 @@ demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
 
     // Create render pipeline
     this->Program = GL::CreateProgram(gVertexShaderStr, gFragmentShaderStr);
+    this->CubemapProgram = GL::CreateProgram(gCubemapVertexShaderStr, gCubemapFragmentShaderStr);
+    {
+        GL::program_reflection Reflection = GL::ReflectProgram(Program);
+        ProjectionUniform = GL::GetUniform<mat4>(Reflection, "uProjection");
+        ViewUniform = GL::GetUniform<mat4>(Reflection, "uView");
+        ModelUniform = GL::GetUniform<mat4>(Reflection, "uModel");
+        InverseViewProjectionUniform = GL::GetUniform<mat4>(GL::ReflectProgram(CubemapProgram), "uInverseViewProjection");
+    }
     
     // Gen skybox faces
     {
@@ -64,18 +114,11 @@ demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
         vertex* VerticesStart = &VerticeBuffer[0];
         vertex* VerticesEnd = VerticesStart + VerticeBuffer.size();
 
-        // Create a descriptor based on the `struct vertex` format
-        vertex_descriptor Descriptor = {};
-        Descriptor.Stride = sizeof(vertex);
-        Descriptor.HasUV = true;
-        Descriptor.PositionOffset = OFFSETOF(vertex, Position);
-        Descriptor.UVOffset = OFFSETOF(vertex, UV);
-
         vertex* Cur = VerticesStart;
         // Create the skybox mesh
         {
             this->SkyboxStart = (int)(Cur - VerticesStart);
-            Cur = (vertex*)Mesh::BuildInvertedCube(Cur, VerticesEnd, Descriptor);
+            Cur = Mesh::BuildInvertedCube(Cur, VerticesEnd);
             this->SkyboxCount = (int)(Cur - VerticesStart) - this->SkyboxStart;
         }
 
@@ -85,10 +128,8 @@ demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
         glBufferData(GL_ARRAY_BUFFER, (int)(Cur - VerticesStart) * sizeof(vertex), VerticesStart, GL_STATIC_DRAW);
     }
 
-    // Load skybox textures
+    // Load skybox textures (from cache, decoded in the background)
     {
-        glGenTextures(6, SkyboxTextures);
-
         const char* SkyboxFiles[] = {
             "media/Sky_NightTime01FT.png",
             "media/Sky_NightTime01BK.png",
@@ -101,13 +142,25 @@ demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
         // Load 6 textures
         for (int i = 0; i < 6; ++i)
         {
-            glBindTexture(GL_TEXTURE_2D, SkyboxTextures[i]);
-            GL::UploadTexture(SkyboxFiles[i], IMG_FLIP | IMG_FORCE_RGB);
+            SkyboxTextures[i] = GLCache.LoadTextureAsync(SkyboxFiles[i], IMG_FLIP | IMG_FORCE_RGB);
+            glBindTexture(GL_TEXTURE_2D, SkyboxTextures[i].GetTexture());
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         }
+
+        // Same images in one cubemap (not flipped: cubemap faces start at the top row)
+        const char* CubemapFiles[] = {
+            SkyboxFiles[0], // +X
+            SkyboxFiles[1], // -X
+            SkyboxFiles[4], // +Y
+            SkyboxFiles[5], // -Y
+            SkyboxFiles[3], // +Z
+            SkyboxFiles[2], // -Z
+        };
+        Cubemap = GLCache.LoadCubemap(CubemapFiles, IMG_FORCE_RGB);
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
     }
     
     // Create a vertex array and bind it
@@ -124,9 +177,10 @@ demo_pg_skybox::demo_pg_skybox(GL::cache& GLCache, GL::debug& GLDebug)
 demo_pg_skybox::~demo_pg_skybox()
 {
     // Cleanup GL
-    glDeleteTextures(6, SkyboxTextures);
+    // SkyboxTextures are released with their cache handles
     glDeleteBuffers(1, &VertexBuffer);
     glDeleteVertexArrays(1, &VAO);
+    glDeleteProgram(CubemapProgram);
     glDeleteProgram(Program);
 }
 
@@ -146,32 +200,67 @@ void demo_pg_skybox::Update(const platform_io& IO)
     glUseProgram(Program);
 
     mat4 ProjectionTransform = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uProjection"), 1, GL_FALSE, ProjectionTransform.e);
+    GL::Uniform(ProjectionUniform, ProjectionTransform);
 
     mat4 ViewTransform = CameraGetInverseMatrix(Camera);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uView"), 1, GL_FALSE, ViewTransform.e);
+    GL::Uniform(ViewUniform, ViewTransform);
     
     glBindVertexArray(VAO);
 
     // Draw skybox
+    if (SkyboxMode == SKYBOX_FACES)
     {
+        SkyboxTimers[SKYBOX_FACES].Begin();
+        SkyboxSamples[SKYBOX_FACES].Begin();
+
         // Disable depth 
         glDepthMask(GL_FALSE);
 
         // Place skybox at the camera position (simulating a fixed view)
         mat4 ModelTransform = Mat4::Translate(Camera.Position);
-        glUniformMatrix4fv(glGetUniformLocation(Program, "uModel"), 1, GL_FALSE, ModelTransform.e);
+        GL::Uniform(ModelUniform, ModelTransform);
 
         for (int i = 0; i < 6; ++i)
         {
-            glBindTexture(GL_TEXTURE_2D, SkyboxTextures[i]);
+            glBindTexture(GL_TEXTURE_2D, SkyboxTextures[i].GetTexture());
             glDrawArrays(GL_TRIANGLES, SkyboxStart + i * 6, 6);
         }
         glDepthMask(GL_TRUE);
+
+        SkyboxSamples[SKYBOX_FACES].End();
+        SkyboxTimers[SKYBOX_FACES].End();
     }
 
     // Render demo base scene
     DemoBase.Render(ProjectionTransform, ViewTransform, Mat4::RotateY(Math::Pi()));
+
+    // Draw skybox behind the opaque geometry
+    if (SkyboxMode == SKYBOX_CUBEMAP)
+    {
+        SkyboxTimers[SKYBOX_CUBEMAP].Begin();
+        SkyboxSamples[SKYBOX_CUBEMAP].Begin();
+
+        // Directions only depend on the camera rotation
+        mat4 ViewRotation = ViewTransform;
+        ViewRotation.c[3] = { 0.f, 0.f, 0.f, 1.f };
+        mat4 InverseViewProjection = Mat4::Inverse(ProjectionTransform * ViewRotation);
+
+        glUseProgram(CubemapProgram);
+        GL::Uniform(InverseViewProjectionUniform, InverseViewProjection);
+        glBindVertexArray(VAO);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, Cubemap.GetTexture());
+
+        // Depth is 1.0 where nothing was drawn (cleared value)
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+
+        SkyboxSamples[SKYBOX_CUBEMAP].End();
+        SkyboxTimers[SKYBOX_CUBEMAP].End();
+    }
+
     DemoBase.DisplayDebugUI();
 
     // Debug display
@@ -185,6 +274,15 @@ void demo_pg_skybox::Update(const platform_io& IO)
             ImGui::TreePop();
         }
 
+        ImGui::RadioButton("6 faces before the scene", &SkyboxMode, SKYBOX_FACES);
+        ImGui::RadioButton("Cubemap after the scene", &SkyboxMode, SKYBOX_CUBEMAP);
+        const char* ModeNames[] = { "6 faces", "Cubemap" };
+        for (int i = 0; i < SKYBOX_MODE_COUNT; ++i)
+        {
+            ImGui::Text("%s: GPU %.3f ms, %d samples passed (%.2f per pixel)", ModeNames[i], SkyboxTimers[i].GetMilliseconds(),
+                (int)SkyboxSamples[i].GetResult(), SkyboxSamples[i].GetResult() / ((float)IO.ScreenWidth * IO.ScreenHeight));
+        }
+
         if (ImGui::TreeNodeEx("Shader"))
         {
             GLImGui::InspectProgram(Program);
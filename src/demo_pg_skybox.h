@@ -9,6 +9,7 @@
 
 // Demo of the simplest skybox
 // 6 Faces + 6 Textures + Disabling depth write
+// Or a cubemap drawn after the scene on a full screen triangle at the far plane (hidden sky pixels fail the depth test)
 class demo_pg_skybox : public demo
 {
 public:
@@ -24,6 +25,9 @@ private:
 
     // GL objects needed by this demo
     GLuint Program = 0;
+    GL::uniform<mat4> ProjectionUniform;
+    GL::uniform<mat4> ViewUniform;
+    GL::uniform<mat4> ModelUniform;
     GLuint VAO = 0;
 
     // Buffer storing all the vertices
@@ -33,6 +37,21 @@ private:
     int SkyboxStart = 0;
     int SkyboxCount = 0;
 
-    // Textures
-    GLuint SkyboxTextures[6] = {};
+    // Textures (from cache)
+    GL::cache_handle SkyboxTextures[6];
+
+    enum skybox_mode
+    {
+        SKYBOX_FACES,   // Before the scene without depth writes
+        SKYBOX_CUBEMAP, // After the scene with GL_LEQUAL
+        SKYBOX_MODE_COUNT,
+    };
+    int SkyboxMode = SKYBOX_CUBEMAP;
+    GLuint CubemapProgram = 0;
+    GL::uniform<mat4> InverseViewProjectionUniform;
+    GL::cache_handle Cubemap;
+
+    // Skybox draw cost per mode (latest results of each)
+    GL::gpu_timer SkyboxTimers[SKYBOX_MODE_COUNT];
+    GL::gpu_sample_counter SkyboxSamples[SKYBOX_MODE_COUNT];
 };
@@ -11,66 +11,6 @@
 
 #include "demo_postprocess.h"
 
-// ================================================================================================
-// FRAMEBUFFER
-// ================================================================================================
-static demo_postprocess::framebuffer CreateFramebuffer(int ScreenWidth, int ScreenHeight)
-{
-	GLint PreviousFramebuffer;
-	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
-
-	// Create Framebuffer that will hold 1 color attachement
-	GLuint FBO;
-	glGenFramebuffers(1, &FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-    
-	// Create texture that will be used as color attachment
-	GLuint ColorTexture;
-	glGenTextures(1, &ColorTexture);
-	glBindTexture(GL_TEXTURE_2D, ColorTexture);
-    glObjectLabel(GL_TEXTURE, ColorTexture, -1, "ColorTexture");
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ScreenWidth, ScreenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    // Note: Here we store the depth stencil in a renderbuffer object, 
-    // but we can as well store it in a texture if we want to display it later
-    GLuint DepthStencilRenderbuffer;
-    glGenRenderbuffers(1, &DepthStencilRenderbuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, DepthStencilRenderbuffer);
-    glObjectLabel(GL_RENDERBUFFER, DepthStencilRenderbuffer, -1, "DepthStencilRenderbuffer");
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, ScreenWidth, ScreenHeight);
-	
-    // Setup attachements
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 0, GL_TEXTURE_2D, ColorTexture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, DepthStencilRenderbuffer);
-
-	unsigned int DrawAttachments[1] = { GL_COLOR_ATTACHMENT0 + 0 };
-	glDrawBuffers(1, DrawAttachments);
-
-    GLenum FramebufferStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (FramebufferStatus != GL_FRAMEBUFFER_COMPLETE)
-    {
-        fprintf(stderr, "demo_postprocess::framebuffer failed to complete (0x%x)\n", FramebufferStatus);
-    }
-    
-	glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
-
-	demo_postprocess::framebuffer Framebuffer = {};
-    Framebuffer.FBO = FBO;
-    Framebuffer.ColorTexture = ColorTexture;
-    Framebuffer.DepthStencilRenderbuffer = DepthStencilRenderbuffer;
-
-    return Framebuffer;    
-}
-
-static void DeleteFramebuffer(const demo_postprocess::framebuffer& Framebuffer)
-{
-    glDeleteRenderbuffers(1, &Framebuffer.DepthStencilRenderbuffer);
-    glDeleteTextures(1, &Framebuffer.ColorTexture);
-    glDeleteFramebuffers(1, &Framebuffer.FBO);
-}
-
 // ================================================================================================
 // POSTPROCESS PASS
 // ================================================================================================
@@ -116,11 +56,95 @@ void main()
     oColor.a = rgb4.a;
 })GLSL";
 
+// ================================================================================================
+// EFFECTS
+// ================================================================================================
+static const char* gEffectCommonStr = R"GLSL(
+// Varyings
+in vec2 vUV;
+
+// Uniforms
+uniform sampler2D uColorTexture;
+uniform sampler2D uSecondTexture;
+uniform sampler2D uDepthTexture;
+uniform vec4 uParams;      // See demo_postprocess::effect
+uniform vec2 uDepthParams; // uProjection[2][2] and uProjection[3][2]
+
+// Outputs
+out vec4 oColor;
+
+// Distance to the camera plane
+float view_depth(vec2 uv)
+{
+    return uDepthParams.y / (texture(uDepthTexture, uv).r * 2.0 - 1.0 + uDepthParams.x);
+}
+)GLSL";
+
+static const char* gEffectShaderStrs[demo_postprocess::EFFECT_COUNT] =
+{
+    // EFFECT_FOG
+    R"GLSL(
+void main()
+{
+    float fog = 1.0 - exp(-uParams.w * view_depth(vUV));
+    oColor = vec4(mix(texture(uColorTexture, vUV).rgb, uParams.rgb, fog), 1.0);
+})GLSL",
+
+    // EFFECT_BRIGHT_PASS (drawn at a lower resolution, bilinear filtering averages the source)
+    R"GLSL(
+void main()
+{
+    vec3 color = texture(uColorTexture, vUV).rgb;
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    oColor = vec4(color * max(luminance - uParams.x, 0.0) / max(luminance, 0.0001), 1.0);
+})GLSL",
+
+    // EFFECT_BLUR (one direction of a separable 9 taps gaussian)
+    R"GLSL(
+void main()
+{
+    const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+    vec2 texelStep = uParams.xy / vec2(textureSize(uColorTexture, 0));
+    vec3 color = texture(uColorTexture, vUV).rgb * weights[0];
+    for (int i = 1; i < 5; ++i)
+        color += (texture(uColorTexture, vUV + i * texelStep).rgb + texture(uColorTexture, vUV - i * texelStep).rgb) * weights[i];
+    oColor = vec4(color, 1.0);
+})GLSL",
+
+    // EFFECT_BLOOM_COMPOSITE
+    R"GLSL(
+void main()
+{
+    oColor = vec4(texture(uColorTexture, vUV).rgb + uParams.x * texture(uSecondTexture, vUV).rgb, 1.0);
+})GLSL",
+
+    // EFFECT_DOF_COMPOSITE (blurred image away from the focus distance)
+    R"GLSL(
+void main()
+{
+    float blur = clamp(abs(view_depth(vUV) - uParams.x) / uParams.y, 0.0, 1.0);
+    oColor = vec4(mix(texture(uColorTexture, vUV).rgb, texture(uSecondTexture, vUV).rgb, blur), 1.0);
+})GLSL",
+
+    // EFFECT_VIGNETTE
+    R"GLSL(
+void main()
+{
+    vec2 fromCenter = vUV - 0.5;
+    oColor = vec4(texture(uColorTexture, vUV).rgb * (1.0 - uParams.x * 2.0 * dot(fromCenter, fromCenter)), 1.0);
+})GLSL",
+};
+
 static demo_postprocess::postprocess_pass_data CreatePostProcessPass()
 {
 	demo_postprocess::postprocess_pass_data Data = {};
 
     Data.Program = GL::CreateProgram(gQuadVertexShaderStr, gQuadFragmentShaderStr);
+    {
+        GL::program_reflection Reflection = GL::ReflectProgram(Data.Program);
+        Data.TimeUniform = GL::GetUniform<float>(Reflection, "uTime");
+        Data.ColorTransformUniform = GL::GetUniform<mat4>(Reflection, "uColorTransform");
+    }
 
     // Gen unit quad
     {
@@ -161,12 +185,29 @@ static void DeletePostProcessPass(const demo_postprocess::postprocess_pass_data&
 	glDeleteVertexArrays(1, &Data.VAO);
 }
 
+static demo_postprocess::effect_program CreateEffectProgram(demo_postprocess::effect Effect)
+{
+    demo_postprocess::effect_program Data = {};
+
+    const char* FragmentShaderStrs[2] = { gEffectCommonStr, gEffectShaderStrs[Effect] };
+    Data.Program = GL::CreateProgramEx(1, &gQuadVertexShaderStr, 2, FragmentShaderStrs);
+
+    GL::program_reflection Reflection = GL::ReflectProgram(Data.Program);
+    Data.ParamsUniform = GL::GetUniform<v4>(Reflection, "uParams");
+    Data.DepthParamsUniform = GL::GetUniform<v2>(Reflection, "uDepthParams");
+    glUseProgram(Data.Program);
+    GL::Uniform(GL::GetUniform<int>(Reflection, "uColorTexture"), 0);
+    GL::Uniform(GL::GetUniform<int>(Reflection, "uSecondTexture"), 1);
+    GL::Uniform(GL::GetUniform<int>(Reflection, "uDepthTexture"), 2);
+    return Data;
+}
+
 static void DrawPostProcessPass(const demo_postprocess::postprocess_pass_data& Data, const platform_io& IO, GLuint Texture)
 {
     glUseProgram(Data.Program);
 
-    glUniform1f(glGetUniformLocation(Data.Program, "uTime"), (float)IO.Time);
-    glUniformMatrix4fv(glGetUniformLocation(Data.Program, "uColorTransform"), 1, GL_FALSE, Data.ColorTransform.e);
+    GL::Uniform(Data.TimeUniform, (float)IO.Time);
+    GL::Uniform(Data.ColorTransformUniform, Data.ColorTransform);
 
     glBindTexture(GL_TEXTURE_2D, Texture);
 	glBindVertexArray(Data.VAO);
@@ -179,14 +220,20 @@ static void DrawPostProcessPass(const demo_postprocess::postprocess_pass_data& D
 demo_postprocess::demo_postprocess(const platform_io& IO, GL::cache& GLCache, GL::debug& GLDebug)
     : DemoBase(GLCache, GLDebug)
 {
-    Framebuffer = CreateFramebuffer(IO.ScreenWidth, IO.ScreenHeight);
+    // Note: Here we store the depth stencil in a texture, the fog and depth of field read it
+    GLenum ColorFormat = GL_RGB8;
+    Framebuffer = GL::CreateFramebuffer(IO.ScreenWidth, IO.ScreenHeight, 1, &ColorFormat, true);
     PostProcessPassData = CreatePostProcessPass();
+    for (int Effect = 0; Effect < EFFECT_COUNT; ++Effect)
+        EffectPrograms[Effect] = CreateEffectProgram((effect)Effect);
 }
 
 demo_postprocess::~demo_postprocess()
 {
 	DeletePostProcessPass(PostProcessPassData);
-	DeleteFramebuffer(Framebuffer);
+	for (const effect_program& EffectProgram : EffectPrograms)
+		glDeleteProgram(EffectProgram.Program);
+	GL::DeleteFramebuffer(Framebuffer);
 }
 
 enum class color_transform : int
@@ -256,6 +303,76 @@ static mat4 DebugUI_GetColorTransformMatrix()
     }
 }
 
+int demo_postprocess::AddEffect(const char* Name, effect Effect, int Input, int SecondInput, float Scale, v4 Params, const mat4& ProjectionTransform)
+{
+    // Output named after its pass
+    int Output = RenderGraph.CreateTexture(Name, Scale, GL_RGBA8);
+    int Depth = (Effect == EFFECT_FOG || Effect == EFFECT_DOF_COMPOSITE) ? SCENE_DEPTH_TEXTURE : -1;
+    v2 DepthParams = { ProjectionTransform.c[2].z, ProjectionTransform.c[3].z };
+
+    const effect_program& EffectProgram = EffectPrograms[Effect];
+    int Pass = RenderGraph.AddPass(Name, [=]()
+    {
+        glUseProgram(EffectProgram.Program);
+        GL::Uniform(EffectProgram.ParamsUniform, Params);
+        GL::Uniform(EffectProgram.DepthParamsUniform, DepthParams);
+        if (Depth >= 0)
+        {
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, RenderGraph.GetTexture(Depth));
+        }
+        if (SecondInput >= 0)
+        {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, RenderGraph.GetTexture(SecondInput));
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, RenderGraph.GetTexture(Input));
+        glBindVertexArray(PostProcessPassData.VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    });
+    RenderGraph.Read(Pass, Input);
+    if (SecondInput >= 0)
+        RenderGraph.Read(Pass, SecondInput);
+    if (Depth >= 0)
+        RenderGraph.Read(Pass, Depth);
+    RenderGraph.Write(Pass, Output);
+    return Output;
+}
+
+void demo_postprocess::DeclareRenderGraph(const platform_io& IO, const mat4& ProjectionTransform)
+{
+    RenderGraph.Reset();
+    int Color = RenderGraph.ImportTexture("Scene color", Framebuffer.ColorTextures[0], Framebuffer.Width, Framebuffer.Height);
+    RenderGraph.ImportTexture("Scene depth", Framebuffer.DepthStencilTexture, Framebuffer.Width, Framebuffer.Height);
+
+    // Every effect is declared, only the enabled ones are read by the next effect (the others are culled)
+    int Fog = AddEffect("Fog", EFFECT_FOG, Color, -1, 1.f, FogParams, ProjectionTransform);
+    Color = FogEnabled ? Fog : Color;
+
+    int Bright = AddEffect("Bloom bright pass", EFFECT_BRIGHT_PASS, Color, -1, 0.5f, { BloomThreshold, 0.f, 0.f, 0.f }, ProjectionTransform);
+    int BloomBlurX = AddEffect("Bloom blur X", EFFECT_BLUR, Bright, -1, 0.5f, { 1.f, 0.f, 0.f, 0.f }, ProjectionTransform);
+    int BloomBlurY = AddEffect("Bloom blur Y", EFFECT_BLUR, BloomBlurX, -1, 0.5f, { 0.f, 1.f, 0.f, 0.f }, ProjectionTransform);
+    int Bloom = AddEffect("Bloom composite", EFFECT_BLOOM_COMPOSITE, Color, BloomBlurY, 1.f, { BloomIntensity, 0.f, 0.f, 0.f }, ProjectionTransform);
+    Color = BloomEnabled ? Bloom : Color;
+
+    int DofBlurX = AddEffect("Depth of field blur X", EFFECT_BLUR, Color, -1, 0.5f, { 2.f, 0.f, 0.f, 0.f }, ProjectionTransform);
+    int DofBlurY = AddEffect("Depth of field blur Y", EFFECT_BLUR, DofBlurX, -1, 0.5f, { 0.f, 2.f, 0.f, 0.f }, ProjectionTransform);
+    int DepthOfField = AddEffect("Depth of field composite", EFFECT_DOF_COMPOSITE, Color, DofBlurY, 1.f, { FocusDistance, FocusRange, 0.f, 0.f }, ProjectionTransform);
+    Color = DepthOfFieldEnabled ? DepthOfField : Color;
+
+    int Vignette = AddEffect("Vignette", EFFECT_VIGNETTE, Color, -1, 1.f, { VignetteStrength, 0.f, 0.f, 0.f }, ProjectionTransform);
+    Color = VignetteEnabled ? Vignette : Color;
+
+    // Color transform to the screen
+    int Pass = RenderGraph.AddPass("Color transform", [this, &IO, Color]()
+    {
+        DrawPostProcessPass(PostProcessPassData, IO, RenderGraph.GetTexture(Color));
+    });
+    RenderGraph.Read(Pass, Color);
+    RenderGraph.WriteScreen(Pass);
+}
+
 void demo_postprocess::Update(const platform_io& IO)
 {
     const float AspectRatio = (float)IO.ScreenWidth / (float)IO.ScreenHeight;
@@ -277,7 +394,7 @@ void demo_postprocess::Update(const platform_io& IO)
         DemoBase.Render(ProjectionTransform, ViewTransform, Mat4::Identity());
     }
 
-	// Second pass render FBO.ColorTexture to screen with postprocess shader
+	// Second pass render FBO.ColorTexture to screen through the effects of the render graph
     {
         glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
 
@@ -285,7 +402,10 @@ void demo_postprocess::Update(const platform_io& IO)
         glClearColor(0.f, 0.f, 0.f, 0.f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        DrawPostProcessPass(PostProcessPassData, IO, Framebuffer.ColorTexture);
+        // Effects, then the color transform
+        DeclareRenderGraph(IO, ProjectionTransform);
+        RenderGraph.Compile(IO.ScreenWidth, IO.ScreenHeight);
+        RenderGraph.Execute();
     }
 
     // Debug
@@ -298,8 +418,53 @@ void demo_postprocess::Update(const platform_io& IO)
             ImGui::TreePop();
         }
 
+        if (ImGui::TreeNodeEx("Effects", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Checkbox("Fog", &FogEnabled);
+            ImGui::ColorEdit3("Fog color", FogParams.e);
+            ImGui::SliderFloat("Fog density", &FogParams.w, 0.f, 0.2f);
+            ImGui::Checkbox("Bloom", &BloomEnabled);
+            ImGui::SliderFloat("Bloom threshold", &BloomThreshold, 0.f, 1.f);
+            ImGui::SliderFloat("Bloom intensity", &BloomIntensity, 0.f, 4.f);
+            ImGui::Checkbox("Depth of field", &DepthOfFieldEnabled);
+            ImGui::SliderFloat("Focus distance", &FocusDistance, 0.1f, 100.f);
+            ImGui::SliderFloat("Focus range", &FocusRange, 0.1f, 100.f);
+            ImGui::Checkbox("Vignette", &VignetteEnabled);
+            ImGui::SliderFloat("Vignette strength", &VignetteStrength, 0.f, 2.f);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNodeEx("Render graph"))
+        {
+            std::vector<render_graph::pass_info> Passes;
+            RenderGraph.GetPasses(Passes);
+            for (int i = 0; i < (int)Passes.size(); ++i)
+            {
+                if (Passes[i].Culled)
+                    ImGui::TextDisabled("%2d %s (culled)", i, Passes[i].Name);
+                else
+                    ImGui::Text("%2d %s: %.3f ms", i, Passes[i].Name, Passes[i].GpuTime);
+            }
+
+            ImGui::Separator();
+            std::vector<render_graph::texture_info> Textures;
+            RenderGraph.GetTextures(Textures);
+            for (const render_graph::texture_info& Texture : Textures)
+            {
+                if (Texture.PoolIndex >= 0)
+                    ImGui::Text("%s: %dx%d, pool texture %d, passes %d to %d", Texture.Name, Texture.Width, Texture.Height, Texture.PoolIndex, Texture.FirstPass, Texture.LastPass);
+                else
+                    ImGui::TextDisabled("%s: %dx%d", Texture.Name, Texture.Width, Texture.Height);
+            }
+
+            render_graph::stats Stats = RenderGraph.GetStats();
+            ImGui::Separator();
+            ImGui::Text("Pool: %d textures, %d KB (%d KB without aliasing)", Stats.PoolTextureCount, (int)(Stats.PoolSize / 1024), (int)(Stats.TransientSize / 1024));
+            ImGui::TreePop();
+        }
+
         ImGui::Text("First pass image:");
-        ImGui::Image((ImTextureID)(size_t)Framebuffer.ColorTexture, { IO.ScreenWidth / 3.f, IO.ScreenHeight / 3.f }, { 0.f, 1.f }, { 1.f, 0.f });
+        ImGui::Image((ImTextureID)(size_t)Framebuffer.ColorTextures[0], { IO.ScreenWidth / 3.f, IO.ScreenHeight / 3.f }, { 0.f, 1.f }, { 1.f, 0.f });
 
         PostProcessPassData.ColorTransform = DebugUI_GetColorTransformMatrix();
         ImGui::TreePop();
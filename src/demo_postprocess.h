@@ -3,28 +3,42 @@
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers.h"
 
 #include "camera.h"
+#include "render_graph.h"
 
 #include "demo_base.h"
 
 class demo_postprocess : public demo
 {
 public:
-    // New framebuffer to render offscreen
-    struct framebuffer
+    // First pass is the render inside demo_base::Update()
+
+    // Effects between the first and the last pass, all drawn with the quad of the last pass
+    enum effect
     {
-        GLuint FBO;
-        GLuint ColorTexture;
-        GLuint DepthStencilRenderbuffer;
+        EFFECT_FOG,              // Params: color (rgb), density (w)
+        EFFECT_BRIGHT_PASS,      // Params: luminance threshold (x)
+        EFFECT_BLUR,             // Params: direction in texels (xy)
+        EFFECT_BLOOM_COMPOSITE,  // Params: intensity (x)
+        EFFECT_DOF_COMPOSITE,    // Params: focus distance (x), focus range (y)
+        EFFECT_VIGNETTE,         // Params: strength (x)
+        EFFECT_COUNT,
+    };
+    struct effect_program
+    {
+        GLuint Program = 0;
+        GL::uniform<v4> ParamsUniform;
+        GL::uniform<v2> DepthParamsUniform;
     };
 
-    // First pass is the render inside demo_base::Update()
-
-    // Second pass (color transformation)
+    // Last pass (color transformation)
     struct postprocess_pass_data
     {
         GLuint Program = 0;
+        GL::uniform<float> TimeUniform;
+        GL::uniform<mat4> ColorTransformUniform;
         GLuint VAO = 0;
         GLuint VertexBuffer = 0; // We will store a quad (6 vertices)
         
@@ -41,5 +55,23 @@ private:
 
     demo_base DemoBase;
     postprocess_pass_data PostProcessPassData = {};
-    framebuffer Framebuffer = {};
+    effect_program EffectPrograms[EFFECT_COUNT];
+    render_graph RenderGraph;
+    static const int SCENE_DEPTH_TEXTURE = 1; // Imported after the scene color
+
+    // Effects are declared every frame, the disabled ones are culled by the render graph
+    bool FogEnabled = true;
+    v4 FogParams = { 0.25f, 0.25f, 0.3f, 0.03f };
+    bool BloomEnabled = true;
+    float BloomThreshold = 0.5f;
+    float BloomIntensity = 1.f;
+    bool DepthOfFieldEnabled = false;
+    float FocusDistance = 5.f;
+    float FocusRange = 20.f;
+    bool VignetteEnabled = true;
+    float VignetteStrength = 0.5f;
+
+    int AddEffect(const char* Name, effect Effect, int Input, int SecondInput, float Scale, v4 Params, const mat4& ProjectionTransform);
+    void DeclareRenderGraph(const platform_io& IO, const mat4& ProjectionTransform);
+    GL::framebuffer Framebuffer = {}; // New framebuffer to render offscreen
 };
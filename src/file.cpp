@@ -0,0 +1,148 @@
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "file.h"
+
+bool File::GetInfo(const char* Filename, file_info* Info)
+{
+#if defined(_WIN32)
+    struct _stat64 Stat;
+    if (_stat64(Filename, &Stat) != 0)
+        return false;
+#else
+    struct stat Stat;
+    if (stat(Filename, &Stat) != 0)
+        return false;
+#endif
+
+    Info->Size = (uint64_t)Stat.st_size;
+    Info->ModificationTime = (uint64_t)Stat.st_mtime;
+    return true;
+}
+
+bool File::Map(file_mapping* Mapping, const char* Filename, bool CopyOnWrite)
+{
+    *Mapping = {};
+
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(File, &Size) || Size.QuadPart == 0)
+    {
+        CloseHandle(File);
+        return false;
+    }
+
+    HANDLE FileMapping = CreateFileMappingA(File, nullptr, CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(File); // The mapping keeps its own reference on the file
+    if (FileMapping == nullptr)
+        return false;
+
+    void* Data = MapViewOfFile(FileMapping, CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (Data == nullptr)
+    {
+        CloseHandle(FileMapping);
+        return false;
+    }
+
+    Mapping->Data = Data;
+    Mapping->Size = (size_t)Size.QuadPart;
+    Mapping->Handle = FileMapping;
+#else
+    int File = open(Filename, O_RDONLY);
+    if (File < 0)
+        return false;
+
+    struct stat Stat;
+    if (fstat(File, &Stat) != 0 || Stat.st_size == 0)
+    {
+        close(File);
+        return false;
+    }
+
+    int Protection = CopyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* Data = mmap(nullptr, (size_t)Stat.st_size, Protection, MAP_PRIVATE, File, 0);
+    close(File); // The mapping keeps its own reference on the file
+    if (Data == MAP_FAILED)
+        return false;
+
+    Mapping->Data = Data;
+    Mapping->Size = (size_t)Stat.st_size;
+#endif
+
+    return true;
+}
+
+void File::Unmap(file_mapping* Mapping)
+{
+    if (Mapping->Data == nullptr)
+        return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(Mapping->Data);
+    CloseHandle((HANDLE)Mapping->Handle);
+#else
+    munmap(Mapping->Data, Mapping->Size);
+#endif
+
+    *Mapping = {};
+}
+
+static std::atomic<uint32_t> gTmpFileCounter{ 0 };
+
+bool File::WriteAtomic(const char* Filename, int ChunkCount, const void* const* Chunks, const size_t* ChunkSizes)
+{
+    // Unique temporary file: several threads (or processes) may write the same file at the same time
+#if defined(_WIN32)
+    unsigned long ProcessId = GetCurrentProcessId();
+#else
+    unsigned long ProcessId = (unsigned long)getpid();
+#endif
+    std::string TmpFilename = Filename;
+    TmpFilename += "." + std::to_string(ProcessId) + "." + std::to_string(gTmpFileCounter++) + ".tmp";
+
+    FILE* File = fopen(TmpFilename.c_str(), "wb");
+    if (File == nullptr)
+        return false;
+
+    bool Success = true;
+    for (int i = 0; i < ChunkCount && Success; ++i)
+        Success = fwrite(Chunks[i], 1, ChunkSizes[i], File) == ChunkSizes[i];
+
+    // Make sure the data reached the disk before the rename makes it visible
+    Success = Success && fflush(File) == 0;
+#if defined(_WIN32)
+    Success = Success && _commit(_fileno(File)) == 0;
+#else
+    Success = Success && fsync(fileno(File)) == 0;
+#endif
+    Success = (fclose(File) == 0) && Success;
+
+#if defined(_WIN32)
+    Success = Success && MoveFileExA(TmpFilename.c_str(), Filename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    Success = Success && rename(TmpFilename.c_str(), Filename) == 0;
+#endif
+
+    if (!Success)
+        remove(TmpFilename.c_str());
+
+    return Success;
+}
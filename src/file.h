@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a file mapped in memory
+struct file_mapping
+{
+    void* Data;
+    size_t Size;
+    void* Handle; // Platform specific
+};
+
+struct file_info
+{
+    uint64_t Size;
+    uint64_t ModificationTime;
+};
+
+namespace File
+{
+    bool GetInfo(const char* Filename, file_info* Info);
+
+    // With CopyOnWrite, pages can be modified in memory without being written back to the file
+    bool Map(file_mapping* Mapping, const char* Filename, bool CopyOnWrite = false);
+    void Unmap(file_mapping* Mapping);
+
+    // Write chunks to a temporary file then rename it so readers never see a half-written file
+    bool WriteAtomic(const char* Filename, int ChunkCount, const void* const* Chunks, const size_t* ChunkSizes);
+}
@@ -0,0 +1,205 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+struct job_pool
+{
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    std::condition_variable WakeUp;
+    std::condition_variable Done;
+    bool Quit = false;
+
+    // Current ParallelFor batch (only modified when no worker is running it)
+    std::mutex BatchMutex; // Only one batch at a time
+    const std::function<void(int)>* Job = nullptr;
+    int Count = 0;
+    uint64_t BatchId = 0;
+    int ActiveWorkers = 0;
+    std::atomic<int> NextIndex{ 0 };
+    std::atomic<int> Remaining{ 0 };
+
+    job_pool();
+    ~job_pool();
+};
+
+// Single thread for long tasks (asset loading) so that they never block the callers of ParallelFor
+struct background_queue
+{
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable WakeUp;
+    std::condition_variable Done;
+    std::deque<std::function<void()>> Tasks;
+    bool Busy = false;
+    bool Quit = false;
+
+    background_queue();
+    ~background_queue();
+};
+
+static thread_local bool gInsideJob = false;
+
+static void RunBatch(job_pool& Pool)
+{
+    gInsideJob = true;
+    int Index;
+    while ((Index = Pool.NextIndex.fetch_add(1)) < Pool.Count)
+    {
+        (*Pool.Job)(Index);
+        if (Pool.Remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> Lock(Pool.Mutex);
+            Pool.Done.notify_all();
+        }
+    }
+    gInsideJob = false;
+}
+
+job_pool::job_pool()
+{
+    int WorkerCount = (int)std::thread::hardware_concurrency() - 1;
+    for (int i = 0; i < WorkerCount; ++i)
+    {
+        Workers.emplace_back([this]()
+        {
+            uint64_t LastBatchId = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> Lock(Mutex);
+                    WakeUp.wait(Lock, [&]() { return Quit || BatchId != LastBatchId; });
+                    if (Quit)
+                        return;
+                    LastBatchId = BatchId;
+                    ActiveWorkers++;
+                }
+
+                RunBatch(*this);
+
+                std::lock_guard<std::mutex> Lock(Mutex);
+                if (--ActiveWorkers == 0)
+                    Done.notify_all();
+            }
+        });
+    }
+}
+
+job_pool::~job_pool()
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Quit = true;
+    }
+    WakeUp.notify_all();
+    for (std::thread& Worker : Workers)
+        Worker.join();
+}
+
+static job_pool& GetPool()
+{
+    static job_pool Pool;
+    return Pool;
+}
+
+background_queue::background_queue()
+{
+    Thread = std::thread([this]()
+    {
+        std::unique_lock<std::mutex> Lock(Mutex);
+        while (true)
+        {
+            WakeUp.wait(Lock, [&]() { return Quit || !Tasks.empty(); });
+            if (Quit)
+                return;
+
+            std::function<void()> Task = std::move(Tasks.front());
+            Tasks.pop_front();
+            Busy = true;
+            Lock.unlock();
+
+            Task();
+
+            Lock.lock();
+            Busy = false;
+            if (Tasks.empty())
+                Done.notify_all();
+        }
+    });
+}
+
+background_queue::~background_queue()
+{
+    // Remaining tasks are dropped
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Quit = true;
+    }
+    WakeUp.notify_all();
+    Thread.join();
+}
+
+static background_queue& GetBackgroundQueue()
+{
+    static background_queue Queue;
+    return Queue;
+}
+
+int Jobs::GetThreadCount()
+{
+    return (int)GetPool().Workers.size() + 1;
+}
+
+void Jobs::ParallelFor(int Count, const std::function<void(int Index)>& Job)
+{
+    job_pool& Pool = GetPool();
+    if (Count <= 0)
+        return;
+
+    if (gInsideJob || Count == 1 || Pool.Workers.empty())
+    {
+        for (int i = 0; i < Count; ++i)
+            Job(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> BatchLock(Pool.BatchMutex);
+    std::unique_lock<std::mutex> Lock(Pool.Mutex);
+
+    // Late workers might still be leaving the previous batch
+    Pool.Done.wait(Lock, [&]() { return Pool.ActiveWorkers == 0; });
+    Pool.Job = &Job;
+    Pool.Count = Count;
+    Pool.NextIndex = 0;
+    Pool.Remaining = Count;
+    Pool.BatchId++;
+    Lock.unlock();
+    Pool.WakeUp.notify_all();
+
+    RunBatch(Pool);
+
+    Lock.lock();
+    Pool.Done.wait(Lock, [&]() { return Pool.Remaining == 0 && Pool.ActiveWorkers == 0; });
+}
+
+void Jobs::RunInBackground(std::function<void()> Task)
+{
+    background_queue& Queue = GetBackgroundQueue();
+    {
+        std::lock_guard<std::mutex> Lock(Queue.Mutex);
+        Queue.Tasks.push_back(std::move(Task));
+    }
+    Queue.WakeUp.notify_one();
+}
+
+void Jobs::WaitBackground()
+{
+    background_queue& Queue = GetBackgroundQueue();
+    std::unique_lock<std::mutex> Lock(Queue.Mutex);
+    Queue.Done.wait(Lock, [&]() { return Queue.Tasks.empty() && !Queue.Busy; });
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <functional>
+
+// Minimal worker pool shared by the CPU heavy loaders/builders
+namespace Jobs
+{
+    // Worker threads + calling thread
+    int GetThreadCount();
+
+    // Run Job(Index) for each Index in [0, Count) and wait for completion.
+    // The calling thread takes part in the work. Nested calls run serially.
+    void ParallelFor(int Count, const std::function<void(int Index)>& Job);
+
+    // Run Task on the background thread and return immediately (tasks run one after the other in submission order).
+    // Tasks can use ParallelFor to spread their work on the workers.
+    void RunInBackground(std::function<void()> Task);
+    // Wait for the completion of all the background tasks
+    void WaitBackground();
+}
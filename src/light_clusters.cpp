@@ -0,0 +1,231 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "maths.h"
+#include "jobs.h"
+#include "light_clusters.h"
+
+// Cluster range of a light (inclusive), computed once before the parallel slices
+struct light_extent
+{
+    int MinX, MaxX;
+    int MinY, MaxY;
+    int MinZ, MaxZ; // MinZ > MaxZ if the light is outside the frustum
+    bool Unbounded;
+};
+
+// Output of a depth slice, concatenated in slice order
+struct slice_lists
+{
+    std::vector<uint32_t> Counts;  // Per cluster of the slice
+    std::vector<uint32_t> Indices; // Grouped by cluster
+    std::vector<uint32_t> Pairs;   // Scratch: cluster of the slice and light index
+    std::vector<v3> BoundsMin;     // Scratch: view space bounding box per cluster
+    std::vector<v3> BoundsMax;
+};
+
+cluster_grid Clusters::MakeGrid(const mat4& Projection, int SizeX, int SizeY, int SizeZ)
+{
+    cluster_grid Grid;
+    Grid.SizeX = SizeX;
+    Grid.SizeY = SizeY;
+    Grid.SizeZ = SizeZ;
+    Grid.Projection = Projection;
+    // Inverse of the depth terms of Mat4::Frustum
+    Grid.Near = Projection.c[3].z / (Projection.c[2].z - 1.f);
+    Grid.Far = Projection.c[3].z / (Projection.c[2].z + 1.f);
+    return Grid;
+}
+
+void Clusters::GetSliceScaleBias(const cluster_grid& Grid, float* Scale, float* Bias)
+{
+    *Scale = Grid.SizeZ / logf(Grid.Far / Grid.Near);
+    *Bias = -logf(Grid.Near) * *Scale;
+}
+
+float Clusters::GetLightRadius(v3 Attenuation, float Cutoff)
+{
+    float Distance = Attenuation.e[1] + Attenuation.e[2] * Attenuation.e[2];
+    if (Distance <= 0.f)
+        return (Attenuation.e[0] > 0.f && 1.f / Attenuation.e[0] < Cutoff) ? 0.f : FLT_MAX;
+    return Math::Max(0.f, (1.f / Cutoff - Attenuation.e[0]) / Distance);
+}
+
+static int GetSlice(const cluster_grid& Grid, float Scale, float Bias, float Depth)
+{
+    return Math::Clamp((int)floorf(logf(Depth) * Scale + Bias), 0, Grid.SizeZ - 1);
+}
+
+static int GetTile(float Ndc, int Size)
+{
+    return Math::Clamp((int)floorf((Ndc * 0.5f + 0.5f) * Size), 0, Size - 1);
+}
+
+static light_extent GetLightExtent(const cluster_grid& Grid, float Scale, float Bias, const cluster_light& Light)
+{
+    light_extent Extent = { 0, Grid.SizeX - 1, 0, Grid.SizeY - 1, 0, Grid.SizeZ - 1, Light.Radius == FLT_MAX };
+    if (Extent.Unbounded)
+        return Extent;
+
+    // Depth range (view space looks down -z)
+    v3 C = Light.Center;
+    float R = Light.Radius;
+    float MinDepth = Math::Max(-(C.z + R), Grid.Near);
+    float MaxDepth = Math::Min(-(C.z - R), Grid.Far);
+    if (MinDepth > MaxDepth)
+    {
+        Extent.MinZ = 1;
+        Extent.MaxZ = 0;
+        return Extent;
+    }
+    Extent.MinZ = GetSlice(Grid, Scale, Bias, MinDepth);
+    Extent.MaxZ = GetSlice(Grid, Scale, Bias, MaxDepth);
+
+    // Screen rectangle: projected corners of the bounding box part in front of the near plane
+    const mat4& P = Grid.Projection;
+    float MinNdc[2] = { FLT_MAX, FLT_MAX };
+    float MaxNdc[2] = { -FLT_MAX, -FLT_MAX };
+    float Zs[2] = { -MinDepth, -MaxDepth };
+    for (float Z : Zs)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            float X = C.x + ((i & 1) ? R : -R);
+            float Y = C.y + ((i & 2) ? R : -R);
+            float NdcX = (P.c[0].x * X + P.c[2].x * Z) / -Z;
+            float NdcY = (P.c[1].y * Y + P.c[2].y * Z) / -Z;
+            MinNdc[0] = Math::Min(MinNdc[0], NdcX);
+            MaxNdc[0] = Math::Max(MaxNdc[0], NdcX);
+            MinNdc[1] = Math::Min(MinNdc[1], NdcY);
+            MaxNdc[1] = Math::Max(MaxNdc[1], NdcY);
+        }
+    }
+    if (MaxNdc[0] < -1.f || MinNdc[0] > 1.f || MaxNdc[1] < -1.f || MinNdc[1] > 1.f)
+    {
+        Extent.MinZ = 1;
+        Extent.MaxZ = 0;
+        return Extent;
+    }
+    Extent.MinX = GetTile(MinNdc[0], Grid.SizeX);
+    Extent.MaxX = GetTile(MaxNdc[0], Grid.SizeX);
+    Extent.MinY = GetTile(MinNdc[1], Grid.SizeY);
+    Extent.MaxY = GetTile(MaxNdc[1], Grid.SizeY);
+    return Extent;
+}
+
+// View space point on the ray of a Ndc position, at a given depth
+static v3 GetViewPoint(const mat4& P, float NdcX, float NdcY, float Depth)
+{
+    return { Depth * (NdcX + P.c[2].x) / P.c[0].x, Depth * (NdcY + P.c[2].y) / P.c[1].y, -Depth };
+}
+
+static bool IsSphereInBox(v3 Center, float Radius, v3 Min, v3 Max)
+{
+    float DistanceSq = 0.f;
+    for (int i = 0; i < 3; ++i)
+    {
+        float D = Math::Max(0.f, Math::Max(Min.e[i] - Center.e[i], Center.e[i] - Max.e[i]));
+        DistanceSq += D * D;
+    }
+    return DistanceSq <= Radius * Radius;
+}
+
+static void AssignSlice(slice_lists& Slice, int Z, const cluster_grid& Grid, const cluster_light* Lights, const light_extent* Extents, int LightCount)
+{
+    int TileCount = Grid.SizeX * Grid.SizeY;
+    Slice.Pairs.clear();
+    Slice.Counts.assign(TileCount, 0);
+
+    // Froxel bounds from their 8 corners
+    float Depth0 = Grid.Near * powf(Grid.Far / Grid.Near, (float)Z / Grid.SizeZ);
+    float Depth1 = Grid.Near * powf(Grid.Far / Grid.Near, (float)(Z + 1) / Grid.SizeZ);
+    Slice.BoundsMin.assign(TileCount, { FLT_MAX, FLT_MAX, FLT_MAX });
+    Slice.BoundsMax.assign(TileCount, { -FLT_MAX, -FLT_MAX, -FLT_MAX });
+    for (int Tile = 0; Tile < TileCount; ++Tile)
+    {
+        int X = Tile % Grid.SizeX;
+        int Y = Tile / Grid.SizeX;
+        for (int Corner = 0; Corner < 8; ++Corner)
+        {
+            float NdcX = 2.f * (X + (Corner & 1)) / Grid.SizeX - 1.f;
+            float NdcY = 2.f * (Y + ((Corner >> 1) & 1)) / Grid.SizeY - 1.f;
+            v3 Point = GetViewPoint(Grid.Projection, NdcX, NdcY, (Corner & 4) ? Depth1 : Depth0);
+            for (int i = 0; i < 3; ++i)
+            {
+                Slice.BoundsMin[Tile].e[i] = Math::Min(Slice.BoundsMin[Tile].e[i], Point.e[i]);
+                Slice.BoundsMax[Tile].e[i] = Math::Max(Slice.BoundsMax[Tile].e[i], Point.e[i]);
+            }
+        }
+    }
+
+    for (int LightIndex = 0; LightIndex < LightCount; ++LightIndex)
+    {
+        const light_extent& Extent = Extents[LightIndex];
+        if (Z < Extent.MinZ || Z > Extent.MaxZ)
+            continue;
+
+        const cluster_light& Light = Lights[LightIndex];
+        for (int Y = Extent.MinY; Y <= Extent.MaxY; ++Y)
+        {
+            for (int X = Extent.MinX; X <= Extent.MaxX; ++X)
+            {
+                int Tile = Y * Grid.SizeX + X;
+                if (!Extent.Unbounded && !IsSphereInBox(Light.Center, Light.Radius, Slice.BoundsMin[Tile], Slice.BoundsMax[Tile]))
+                    continue;
+                Slice.Pairs.push_back((uint32_t)Tile);
+                Slice.Pairs.push_back((uint32_t)LightIndex);
+                Slice.Counts[Tile]++;
+            }
+        }
+    }
+
+    // Group by cluster (counting sort, light order is kept)
+    std::vector<uint32_t> Offsets(TileCount);
+    uint32_t Offset = 0;
+    for (int Tile = 0; Tile < TileCount; ++Tile)
+    {
+        Offsets[Tile] = Offset;
+        Offset += Slice.Counts[Tile];
+    }
+    Slice.Indices.resize(Offset);
+    for (size_t i = 0; i < Slice.Pairs.size(); i += 2)
+        Slice.Indices[Offsets[Slice.Pairs[i]]++] = Slice.Pairs[i + 1];
+}
+
+void Clusters::AssignLights(light_clusters& Clusters, const cluster_grid& Grid, const cluster_light* Lights, int LightCount)
+{
+    float Scale, Bias;
+    GetSliceScaleBias(Grid, &Scale, &Bias);
+
+    std::vector<light_extent> Extents(LightCount);
+    for (int i = 0; i < LightCount; ++i)
+        Extents[i] = GetLightExtent(Grid, Scale, Bias, Lights[i]);
+
+    std::vector<slice_lists> Slices(Grid.SizeZ);
+    Jobs::ParallelFor(Grid.SizeZ, [&](int Z)
+    {
+        AssignSlice(Slices[Z], Z, Grid, Lights, Extents.data(), LightCount);
+    });
+
+    // Concatenate the slices
+    int TileCount = Grid.SizeX * Grid.SizeY;
+    Clusters.Ranges.resize(2 * TileCount * Grid.SizeZ);
+    Clusters.Indices.clear();
+    Clusters.MaxLightsPerCluster = 0;
+    for (int Z = 0; Z < Grid.SizeZ; ++Z)
+    {
+        const slice_lists& Slice = Slices[Z];
+        uint32_t Offset = (uint32_t)Clusters.Indices.size();
+        for (int Tile = 0; Tile < TileCount; ++Tile)
+        {
+            uint32_t* Range = &Clusters.Ranges[2 * (Z * TileCount + Tile)];
+            Range[0] = Offset;
+            Range[1] = Slice.Counts[Tile];
+            Offset += Slice.Counts[Tile];
+            Clusters.MaxLightsPerCluster = Math::Max(Clusters.MaxLightsPerCluster, (int)Slice.Counts[Tile]);
+        }
+        Clusters.Indices.insert(Clusters.Indices.end(), Slice.Indices.begin(), Slice.Indices.end());
+    }
+}
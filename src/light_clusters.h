@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+// Bounding sphere of a light in view space
+struct cluster_light
+{
+    v3 Center;
+    float Radius; // FLT_MAX for directional or unbounded lights (present in every cluster)
+};
+
+// Grid of froxels over the view frustum: screen tiles times exponential depth slices
+struct cluster_grid
+{
+    int SizeX, SizeY, SizeZ;
+    mat4 Projection; // Perspective projection
+    float Near, Far;
+};
+
+struct light_clusters
+{
+    std::vector<uint32_t> Ranges;  // Offset and count in Indices per cluster (x first, then y, then z)
+    std::vector<uint32_t> Indices; // Light indices of all the clusters
+    int MaxLightsPerCluster;
+};
+
+namespace Clusters
+{
+
+cluster_grid MakeGrid(const mat4& Projection, int SizeX, int SizeY, int SizeZ);
+// Shader side lookup: slice = log(ViewDepth) * Scale + Bias
+void GetSliceScaleBias(const cluster_grid& Grid, float* Scale, float* Bias);
+// Distance where 1 / (c + l*d + q*q*d) falls under Cutoff (same attenuation as light_shade), FLT_MAX if it never does
+float GetLightRadius(v3 Attenuation, float Cutoff);
+// Lights are culled against each froxel bounding box, the depth slices are processed in parallel
+void AssignLights(light_clusters& Clusters, const cluster_grid& Grid, const cluster_light* Lights, int LightCount);
+}
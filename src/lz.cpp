@@ -0,0 +1,165 @@
+#include <cstring>
+#include <vector>
+
+#include "lz.h"
+
+// Sequence: token (literal count << 4 | match length - 4), literal count extension, literals, match offset (16 bits),
+// match length extension. Counts of 15 continue on the following bytes (255 adds 255 and continues).
+// The last sequence has literals only.
+
+static const int LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 0xFFFF;
+static const int LZ_HASH_BITS = 14;
+static const size_t LZ_WILD_COPY = 16; // Short copies move this many bytes at once when both buffers have room
+
+static uint32_t Read32(const uint8_t* Source)
+{
+    uint32_t Value;
+    memcpy(&Value, Source, sizeof(Value));
+    return Value;
+}
+
+static uint32_t Hash(uint32_t Value)
+{
+    return (Value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t* WriteLength(uint8_t* Destination, size_t Length)
+{
+    for (; Length >= 255; Length -= 255)
+        *Destination++ = 255;
+    *Destination++ = (uint8_t)Length;
+    return Destination;
+}
+
+static uint8_t* WriteSequence(uint8_t* Destination, const uint8_t* Literals, size_t LiteralCount, size_t Offset, size_t MatchLength)
+{
+    uint8_t* Token = Destination++;
+    size_t MatchCode = (MatchLength > 0) ? MatchLength - LZ_MIN_MATCH : 0;
+    *Token = (uint8_t)((LiteralCount < 15 ? LiteralCount : 15) << 4 | (MatchCode < 15 ? MatchCode : 15));
+
+    if (LiteralCount >= 15)
+        Destination = WriteLength(Destination, LiteralCount - 15);
+    memcpy(Destination, Literals, LiteralCount);
+    Destination += LiteralCount;
+
+    if (MatchLength > 0)
+    {
+        *Destination++ = (uint8_t)Offset;
+        *Destination++ = (uint8_t)(Offset >> 8);
+        if (MatchCode >= 15)
+            Destination = WriteLength(Destination, MatchCode - 15);
+    }
+    return Destination;
+}
+
+size_t Lz::GetMaxCompressedSize(size_t Size)
+{
+    return Size + Size / 255 + 16;
+}
+
+size_t Lz::Compress(uint8_t* Destination, const uint8_t* Source, size_t Size)
+{
+    // Last position of each hashed 4 bytes sequence (+ 1, 0 is empty)
+    std::vector<uint32_t> Table((size_t)1 << LZ_HASH_BITS, 0);
+
+    uint8_t* Output = Destination;
+    size_t Anchor = 0; // First pending literal
+    size_t Position = 0;
+    while (Size >= LZ_MIN_MATCH && Position <= Size - LZ_MIN_MATCH)
+    {
+        uint32_t Value = Read32(Source + Position);
+        uint32_t& Entry = Table[Hash(Value)];
+        size_t Candidate = Entry;
+        Entry = (uint32_t)(Position + 1);
+
+        if (Candidate == 0 || Position - (Candidate - 1) > LZ_MAX_OFFSET || Read32(Source + Candidate - 1) != Value)
+        {
+            ++Position;
+            continue;
+        }
+
+        size_t Match = Candidate - 1;
+        size_t Length = LZ_MIN_MATCH;
+        while (Position + Length < Size && Source[Match + Length] == Source[Position + Length])
+            ++Length;
+
+        Output = WriteSequence(Output, Source + Anchor, Position - Anchor, Position - Match, Length);
+        Position += Length;
+        Anchor = Position;
+    }
+
+    Output = WriteSequence(Output, Source + Anchor, Size - Anchor, 0, 0);
+    return (size_t)(Output - Destination);
+}
+
+bool Lz::Decompress(uint8_t* Destination, size_t Size, const uint8_t* Source, size_t CompressedSize)
+{
+    const uint8_t* Input = Source;
+    const uint8_t* InputEnd = Source + CompressedSize;
+    uint8_t* Output = Destination;
+    uint8_t* OutputEnd = Destination + Size;
+
+    auto ReadLength = [&](size_t Length) -> size_t
+    {
+        if (Length < 15)
+            return Length;
+        uint8_t Byte;
+        do
+        {
+            if (Input >= InputEnd)
+                return SIZE_MAX;
+            Byte = *Input++;
+            Length += Byte;
+        } while (Byte == 255);
+        return Length;
+    };
+
+    while (Input < InputEnd)
+    {
+        uint8_t Token = *Input++;
+
+        size_t LiteralCount = ReadLength(Token >> 4);
+        if (LiteralCount > (size_t)(InputEnd - Input) || LiteralCount > (size_t)(OutputEnd - Output))
+            return false;
+        if (LiteralCount <= LZ_WILD_COPY && InputEnd - Input >= (ptrdiff_t)LZ_WILD_COPY && OutputEnd - Output >= (ptrdiff_t)LZ_WILD_COPY)
+            memcpy(Output, Input, LZ_WILD_COPY);
+        else if (LiteralCount > 0)
+            memcpy(Output, Input, LiteralCount);
+        Input += LiteralCount;
+        Output += LiteralCount;
+
+        // Last sequence
+        if (Input == InputEnd)
+            break;
+
+        if (InputEnd - Input < 2)
+            return false;
+        size_t Offset = Input[0] | (size_t)Input[1] << 8;
+        Input += 2;
+        size_t MatchLength = ReadLength(Token & 15);
+        if (MatchLength == SIZE_MAX)
+            return false;
+        MatchLength += LZ_MIN_MATCH;
+        if (Offset == 0 || Offset > (size_t)(Output - Destination) || MatchLength > (size_t)(OutputEnd - Output))
+            return false;
+
+        const uint8_t* Match = Output - Offset;
+        if (Offset >= LZ_WILD_COPY && MatchLength <= LZ_WILD_COPY && OutputEnd - Output >= (ptrdiff_t)LZ_WILD_COPY)
+        {
+            memcpy(Output, Match, LZ_WILD_COPY);
+            Output += MatchLength;
+            continue;
+        }
+
+        // Overlapping matches repeat the last Offset bytes: the copied pattern doubles at each step (copies never overlap)
+        while (MatchLength > 0)
+        {
+            size_t CopySize = (size_t)(Output - Match) < MatchLength ? (size_t)(Output - Match) : MatchLength;
+            memcpy(Output, Match, CopySize);
+            Output += CopySize;
+            MatchLength -= CopySize;
+        }
+    }
+    return Output == OutputEnd;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte oriented LZ77 codec (LZ4 like sequences: literals + match of 4 bytes or more within 64 KB), favors decompression speed
+namespace Lz
+{
+    // Worst case compressed size (incompressible data)
+    size_t GetMaxCompressedSize(size_t Size);
+    // Returns the compressed size (Destination holds GetMaxCompressedSize(Size) bytes)
+    size_t Compress(uint8_t* Destination, const uint8_t* Source, size_t Size);
+    // Destination receives exactly Size bytes, returns false on corrupted input
+    bool Decompress(uint8_t* Destination, size_t Size, const uint8_t* Source, size_t CompressedSize);
+}
@@ -21,6 +21,7 @@
 #include "demo_base.h"
 #include "demo_pg_skybox.h"
 #include "demo_postprocess.h"
+#include "demo_benchmark.h"
 // TODO(demo): Add headers here
 
 #if 1
@@ -188,6 +189,7 @@ int main(int argc, char* argv[])
         glfwTerminate();
         return 1;
     }
+    GL::EnableCallCounts();
 
     // Setup KHR debug
     glDebugMessageCallback(OpenGLErrorCallback, nullptr);
@@ -229,8 +231,12 @@ int main(int argc, char* argv[])
             std::make_unique<demo_minimal>(),
             std::make_unique<demo_pg_skybox>(GLCache, GLDebug),
             std::make_unique<demo_postprocess>(App.IO, GLCache, GLDebug),
+            std::make_unique<demo_benchmark>(),
             // TODO(demo): Add other demos here
         };
+        GL::program_cache_stats ProgramCacheStats = GL::GetProgramCacheStats();
+        printf("Demos created in %.2f ms (program cache: %d hits, %d misses)\n", (glfwGetTime() - StartTime) * 1000.0,
+            ProgramCacheStats.Hits, ProgramCacheStats.Misses);
 
         // Main loop
         while (!glfwWindowShouldClose(App.Window))
@@ -296,6 +302,13 @@ int main(int argc, char* argv[])
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::Checkbox("Demo window", &ShowDemoWindow);
 
+            // Uniform lookups by name since the previous frame (should stay at 0)
+            {
+                GL::call_counts Calls = GL::GetCallCounts();
+                GL::ResetCallCounts();
+                ImGui::Text("Uniform lookups last frame: %d locations, %d blocks", Calls.GetUniformLocation, Calls.GetUniformBlockIndex);
+            }
+
             if (ImGui::CollapsingHeader("System info"))
             {
                 ImGui::Text("GL_VERSION: %s", glGetString(GL_VERSION));
@@ -306,6 +319,13 @@ int main(int argc, char* argv[])
             if (ShowDemoWindow)
                 ImGui::ShowDemoWindow(&ShowDemoWindow);
 
+            // Finish asset loads within a small time budget
+            GLCache.Update();
+            if (GLCache.GetPendingLoadCount() > 0)
+                ImGui::Text("Loading %d assets...", GLCache.GetPendingLoadCount());
+            if (ImGui::CollapsingHeader("GL cache"))
+                GLImGui::InspectCache(GLCache);
+
             // Display demo
             Demos[DemoId]->Update(App.IO);
 
@@ -1,3 +1,134 @@
 #pragma once
 
-// NOTE: Add your own maths functions
\ No newline at end of file
+#include <cstring>
+
+// NOTE: Add your own maths functions
+namespace Math
+{
+    inline float Abs(float Value) { return std::fabs(Value); }
+    inline float Round(float Value) { return std::round(Value); }
+}
+
+// ========================================================================
+// HALF FLOATS
+// ========================================================================
+namespace Math
+{
+    // Round to nearest even, overflows to infinity
+    inline uint16_t FloatToHalf(float Value)
+    {
+        uint32_t Bits;
+        memcpy(&Bits, &Value, sizeof(Bits));
+        uint32_t Sign = (Bits >> 16) & 0x8000;
+        uint32_t Abs = Bits & 0x7FFFFFFF;
+
+        if (Abs >= 0x7F800000) // Inf or NaN
+            return (uint16_t)(Sign | 0x7C00 | (Abs > 0x7F800000 ? 0x200 : 0));
+        if (Abs >= 0x477FF000) // Rounds above 65504
+            return (uint16_t)(Sign | 0x7C00);
+        if (Abs < 0x38800000) // Denormal
+        {
+            float AbsValue;
+            memcpy(&AbsValue, &Abs, sizeof(AbsValue));
+            return (uint16_t)(Sign | (uint32_t)std::nearbyint(AbsValue * 16777216.f));
+        }
+
+        uint32_t Rebiased = Abs - 0x38000000; // Exponent bias from 127 to 15
+        Rebiased += 0xFFF + ((Rebiased >> 13) & 1);
+        return (uint16_t)(Sign | (Rebiased >> 13));
+    }
+
+    inline float HalfToFloat(uint16_t Value)
+    {
+        uint32_t Sign = (uint32_t)(Value & 0x8000) << 16;
+        uint32_t Exponent = (Value >> 10) & 0x1F;
+        uint32_t Mantissa = Value & 0x3FF;
+
+        uint32_t Bits;
+        if (Exponent == 0) // Denormal
+        {
+            float Result = Mantissa / 16777216.f;
+            return Sign ? -Result : Result;
+        }
+        else if (Exponent == 31)
+            Bits = Sign | 0x7F800000 | (Mantissa << 13);
+        else
+            Bits = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+
+        float Result;
+        memcpy(&Result, &Bits, sizeof(Result));
+        return Result;
+    }
+}
+
+// ========================================================================
+// VEC3 FUNCTIONS
+// ========================================================================
+inline v3 operator+(v3 A, v3 B) { return { A.x + B.x, A.y + B.y, A.z + B.z }; }
+inline v3& operator+=(v3& A, v3 B) { A = A + B; return A; }
+inline v3& operator-=(v3& A, v3 B) { A = A - B; return A; }
+
+namespace Vec3
+{
+    inline float Dot(v3 A, v3 B)
+    {
+        return A.x * B.x + A.y * B.y + A.z * B.z;
+    }
+}
+
+// ========================================================================
+// FRUSTUM
+// ========================================================================
+// Normalized planes (xyz: inward normal, w: distance) in the space before the matrix they are extracted from
+struct frustum
+{
+    v4 Planes[6]; // Left, right, bottom, top, near, far
+};
+
+namespace Frustum
+{
+    // Gribb/Hartmann extraction from a projection, view-projection or model-view-projection matrix
+    inline frustum FromMatrix(const mat4& M)
+    {
+        frustum Result;
+        for (int i = 0; i < 6; ++i)
+        {
+            int Row = i / 2;
+            float Sign = (i % 2 == 0) ? 1.f : -1.f;
+            v4& Plane = Result.Planes[i];
+            for (int j = 0; j < 4; ++j)
+                Plane.e[j] = M.c[j].e[3] + Sign * M.c[j].e[Row];
+
+            // Note: v4 operators only scale xyz
+            float Length = Math::Sqrt(Plane.x * Plane.x + Plane.y * Plane.y + Plane.z * Plane.z);
+            for (int j = 0; j < 4 && Length > 0.f; ++j)
+                Plane.e[j] /= Length;
+        }
+        return Result;
+    }
+
+    inline bool IsSphereVisible(const frustum& Frustum, v3 Center, float Radius)
+    {
+        for (const v4& Plane : Frustum.Planes)
+        {
+            if (Plane.x * Center.x + Plane.y * Center.y + Plane.z * Center.z + Plane.w < -Radius)
+                return false;
+        }
+        return true;
+    }
+
+    // Conservative: boxes crossing two planes outside the frustum corner are kept
+    inline bool IsBoxVisible(const frustum& Frustum, v3 Min, v3 Max)
+    {
+        for (const v4& Plane : Frustum.Planes)
+        {
+            // Corner furthest along the plane normal
+            float x = Plane.x >= 0.f ? Max.x : Min.x;
+            float y = Plane.y >= 0.f ? Max.y : Min.y;
+            float z = Plane.z >= 0.f ? Max.z : Min.z;
+            if (Plane.x * x + Plane.y * y + Plane.z * z + Plane.w < 0.f)
+                return false;
+        }
+        return true;
+    }
+}
@@ -2,39 +2,203 @@
 #include <cstdint>
 #include <cstdio>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <vector>
 #include <string>
 
-#include <tiny_obj_loader.h>
-
 #include "maths.h"
 #include "mesh.h"
+#include "mesh_builders.h"
 
 using namespace Mesh;
 
-static void* ConvertVertices(void* VerticesDst, const vertex_descriptor& Descriptor, vertex_full* VerticesSrc, int Count)
+// ================================================================================================
+// VERTEX FORMATS
+// ================================================================================================
+static int16_t EncodeSnorm16(float Value) { return (int16_t)Math::Round(Math::Clamp(Value, -1.f, 1.f) * 32767.f); }
+static float DecodeSnorm16(int16_t Value) { return Math::Max(Value / 32767.f, -1.f); }
+static float SignNotZero(float Value) { return (Value >= 0.f) ? 1.f : -1.f; }
+
+static void StoreV3(uint8_t* Dst, vertex_format Format, v3 Value)
+{
+    switch (Format)
+    {
+    case VERTEX_FORMAT_FLOAT:
+        memcpy(Dst, &Value, sizeof(v3));
+        break;
+
+    case VERTEX_FORMAT_HALF:
+    {
+        uint16_t Halves[4] = { Math::FloatToHalf(Value.x), Math::FloatToHalf(Value.y), Math::FloatToHalf(Value.z), 0 };
+        memcpy(Dst, Halves, sizeof(Halves));
+        break;
+    }
+
+    case VERTEX_FORMAT_SNORM10:
+    {
+        // GL_INT_2_10_10_10_REV: x in the low bits, w = 0
+        uint32_t Packed = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            int Component = (int)Math::Round(Math::Clamp(Value.e[i], -1.f, 1.f) * 511.f);
+            Packed |= ((uint32_t)Component & 0x3FF) << (i * 10);
+        }
+        memcpy(Dst, &Packed, sizeof(Packed));
+        break;
+    }
+
+    case VERTEX_FORMAT_OCTAHEDRAL:
+    {
+        // Project on the octahedron and fold the lower hemisphere
+        float L1Norm = Math::Abs(Value.x) + Math::Abs(Value.y) + Math::Abs(Value.z);
+        float X = (L1Norm > 0.f) ? Value.x / L1Norm : 0.f;
+        float Y = (L1Norm > 0.f) ? Value.y / L1Norm : 0.f;
+        if (Value.z < 0.f)
+        {
+            float FoldedX = (1.f - Math::Abs(Y)) * SignNotZero(X);
+            float FoldedY = (1.f - Math::Abs(X)) * SignNotZero(Y);
+            X = FoldedX;
+            Y = FoldedY;
+        }
+        int16_t Encoded[2] = { EncodeSnorm16(X), EncodeSnorm16(Y) };
+        memcpy(Dst, Encoded, sizeof(Encoded));
+        break;
+    }
+
+    default:
+        assert(false && "Unsupported vec3 vertex format");
+    }
+}
+
+static v3 LoadV3(const uint8_t* Src, vertex_format Format)
+{
+    v3 Value = {};
+    switch (Format)
+    {
+    case VERTEX_FORMAT_FLOAT:
+        memcpy(&Value, Src, sizeof(v3));
+        break;
+
+    case VERTEX_FORMAT_HALF:
+    {
+        uint16_t Halves[3];
+        memcpy(Halves, Src, sizeof(Halves));
+        Value = { Math::HalfToFloat(Halves[0]), Math::HalfToFloat(Halves[1]), Math::HalfToFloat(Halves[2]) };
+        break;
+    }
+
+    case VERTEX_FORMAT_SNORM10:
+    {
+        uint32_t Packed;
+        memcpy(&Packed, Src, sizeof(Packed));
+        for (int i = 0; i < 3; ++i)
+        {
+            int Component = (int)((Packed >> (i * 10)) & 0x3FF);
+            if (Component >= 512)
+                Component -= 1024;
+            Value.e[i] = Math::Max(Component / 511.f, -1.f);
+        }
+        break;
+    }
+
+    case VERTEX_FORMAT_OCTAHEDRAL:
+    {
+        int16_t Encoded[2];
+        memcpy(Encoded, Src, sizeof(Encoded));
+        Value.x = DecodeSnorm16(Encoded[0]);
+        Value.y = DecodeSnorm16(Encoded[1]);
+        Value.z = 1.f - Math::Abs(Value.x) - Math::Abs(Value.y);
+        if (Value.z < 0.f)
+        {
+            float X = Value.x;
+            Value.x = (1.f - Math::Abs(Value.y)) * SignNotZero(X);
+            Value.y = (1.f - Math::Abs(X)) * SignNotZero(Value.y);
+        }
+        Value = Vec3::Normalize(Value);
+        break;
+    }
+
+    default:
+        assert(false && "Unsupported vec3 vertex format");
+    }
+    return Value;
+}
+
+static void StoreV2(uint8_t* Dst, vertex_format Format, v2 Value)
+{
+    switch (Format)
+    {
+    case VERTEX_FORMAT_FLOAT:
+        memcpy(Dst, &Value, sizeof(v2));
+        break;
+
+    case VERTEX_FORMAT_HALF:
+    {
+        uint16_t Halves[2] = { Math::FloatToHalf(Value.x), Math::FloatToHalf(Value.y) };
+        memcpy(Dst, Halves, sizeof(Halves));
+        break;
+    }
+
+    case VERTEX_FORMAT_UNORM16:
+    {
+        uint16_t Encoded[2];
+        for (int i = 0; i < 2; ++i)
+            Encoded[i] = (uint16_t)Math::Round(Math::Clamp(Value.e[i], 0.f, 1.f) * 65535.f);
+        memcpy(Dst, Encoded, sizeof(Encoded));
+        break;
+    }
+
+    default:
+        assert(false && "Unsupported vec2 vertex format");
+    }
+}
+
+int Mesh::GetAttributeSize(vertex_format Format, int ComponentCount)
+{
+    switch (Format)
+    {
+    case VERTEX_FORMAT_FLOAT:      return 4 * ComponentCount;
+    case VERTEX_FORMAT_HALF:       return (2 * ComponentCount + 3) & ~3;
+    case VERTEX_FORMAT_UNORM16:    return (2 * ComponentCount + 3) & ~3;
+    case VERTEX_FORMAT_SNORM10:    return 4;
+    case VERTEX_FORMAT_OCTAHEDRAL: return 4;
+    default:                       return 0;
+    }
+}
+
+vertex_descriptor Mesh::PackedDescriptor(vertex_format PositionFormat, vertex_format NormalFormat, vertex_format UVFormat)
+{
+    vertex_descriptor Descriptor = {};
+    Descriptor.HasNormal = true;
+    Descriptor.HasUV = true;
+    Descriptor.PositionFormat = PositionFormat;
+    Descriptor.NormalFormat = NormalFormat;
+    Descriptor.UVFormat = UVFormat;
+
+    Descriptor.PositionOffset = 0;
+    Descriptor.NormalOffset = Descriptor.PositionOffset + GetAttributeSize(PositionFormat, 3);
+    Descriptor.UVOffset = Descriptor.NormalOffset + GetAttributeSize(NormalFormat, 3);
+    Descriptor.Stride = Descriptor.UVOffset + GetAttributeSize(UVFormat, 2);
+    return Descriptor;
+}
+
+void* Mesh::ConvertVertices(void* VerticesDst, const vertex_descriptor& Descriptor, const vertex_full* VerticesSrc, int Count)
 {
     uint8_t* Buffer = (uint8_t*)VerticesDst;
 
     for (int i = 0; i < Count; ++i)
     {
-        vertex_full& VertexSrc = VerticesSrc[i];
+        const vertex_full& VertexSrc = VerticesSrc[i];
         uint8_t* VertexStart = Buffer + i * Descriptor.Stride;
 
-        v3* PositionDst = (v3*)(VertexStart + Descriptor.PositionOffset);
-        *PositionDst = VertexSrc.Position;
+        StoreV3(VertexStart + Descriptor.PositionOffset, Descriptor.PositionFormat, VertexSrc.Position);
 
         if (Descriptor.HasNormal)
-        {
-            v3* NormalDst = (v3*)(VertexStart + Descriptor.NormalOffset);
-            *NormalDst = VertexSrc.Normal;
-        }
+            StoreV3(VertexStart + Descriptor.NormalOffset, Descriptor.NormalFormat, VertexSrc.Normal);
 
         if (Descriptor.HasUV)
-        {
-            v2* UVDst = (v2*)(VertexStart + Descriptor.UVOffset);
-            *UVDst = VertexSrc.UV;
-        }
+            StoreV2(VertexStart + Descriptor.UVOffset, Descriptor.UVFormat, VertexSrc.UV);
     }
 
     return Buffer + Descriptor.Stride * Count;
@@ -46,331 +210,351 @@ static int GetVertexCount(void* Vertices, void* End, const vertex_descriptor& De
     return SizeInBytes / Descriptor.Stride;
 }
 
-void* Mesh::Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform)
+void* Mesh::Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform, simd_level SimdLevel)
 {
     uint8_t* Buffer = (uint8_t*)Vertices;
     int Count = GetVertexCount(Vertices, End, Descriptor);
 
     mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(Transform));
-    for (int i = 0; i < Count; ++i)
+
+    // Remaining vertices (or unsupported layouts) are transformed one by one
+    int First = Mesh::TransformSimd(Vertices, Count, Descriptor, Transform, NormalMatrix, SimdLevel);
+    for (int i = First; i < Count; ++i)
     {
         uint8_t* VertexStart = Buffer + i * Descriptor.Stride;
         
-        v3* Position = (v3*)(VertexStart + Descriptor.PositionOffset);
-        v4 TransformedPosition = Transform * Vec4::vec4(*Position, 1.f);
-        *Position = TransformedPosition.xyz / TransformedPosition.w; // normalized homogeneous coordinate
+        uint8_t* Position = VertexStart + Descriptor.PositionOffset;
+        v4 TransformedPosition = Transform * Vec4::vec4(LoadV3(Position, Descriptor.PositionFormat), 1.f);
+        StoreV3(Position, Descriptor.PositionFormat, TransformedPosition.xyz / TransformedPosition.w); // normalized homogeneous coordinate
 
         if (Descriptor.HasNormal)
         {
-            v3* Normal           = (v3*)(VertexStart + Descriptor.NormalOffset);
-            v4 TransformedNormal = NormalMatrix * Vec4::vec4(*Normal, 0.f);
-            *Normal              = Vec3::Normalize(TransformedNormal.xyz);
+            uint8_t* Normal      = VertexStart + Descriptor.NormalOffset;
+            v4 TransformedNormal = NormalMatrix * Vec4::vec4(LoadV3(Normal, Descriptor.NormalFormat), 0.f);
+            StoreV3(Normal, Descriptor.NormalFormat, Vec3::Normalize(TransformedNormal.xyz));
         }
     }
     return Buffer + Descriptor.Stride * Count;
 }
 
+// ================================================================================================
+// BUILDERS
+// ================================================================================================
+// Runtime descriptor path, see mesh_builders.h for the generic builders and the vertex_traits path
 void* Mesh::BuildQuad(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
-    if (GetVertexCount(Vertices, End, Descriptor) < 6)
-    {
-        fprintf(stderr, "Not enough vertices to create quad\n");
-        return Vertices;
-    }
-
-    v3 Normal = { 0.f, 0.f, 1.f };
-
-    vertex_full TopLeft     = { { -0.5f, 0.5f, 0.f }, Normal, { 0.f, 1.f } };
-    vertex_full TopRight    = { {  0.5f, 0.5f, 0.f }, Normal, { 1.f, 1.f } };
-    vertex_full BottomLeft  = { { -0.5f,-0.5f, 0.f }, Normal, { 0.f, 0.f } };
-    vertex_full BottomRight = { {  0.5f,-0.5f, 0.f }, Normal, { 1.f, 0.f } };
-
-    vertex_full QuadVertices[] = {
-        TopLeft,
-        BottomLeft,
-        TopRight,
-        BottomLeft,
-        BottomRight,
-        TopRight
-    };
-
-    return ConvertVertices(Vertices, Descriptor, QuadVertices, 6);
+    return BuildQuadT(descriptor_output{ Descriptor }, Vertices, End);
 }
 
 void* Mesh::BuildCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
-    if (GetVertexCount(Vertices, End, Descriptor) < (6 * 6))
-    {
-        fprintf(stderr, "Not enough vertices to create cube\n");
-        return Vertices;
-    }
-
-    void* V = Vertices;
-
-    // Back face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.0f,-0.5f }) * Mat4::RotateY(-1.f, 0.f));
-    // Front face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.0f, 0.5f }) * Mat4::RotateY( 1.f, 0.f));
-    // Left face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({-0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f, 1.f));
-    // Right face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f,-1.f));
-    // Top face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.5f, 0.0f }) * Mat4::RotateX( 0.f,-1.f));
-    // Bottom face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f,-0.5f, 0.0f }) * Mat4::RotateX( 0.f, 1.f));
-
-    return V;
+    return BuildCubeT(descriptor_output{ Descriptor }, Vertices, End);
 }
 
 void* Mesh::BuildInvertedCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
-    void* V = Vertices;
-
-    // FRONT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // BACK FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(Math::Pi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // RIGHT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // LEFT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // TOP FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // BOTTOM FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-
-    return V;
+    return BuildInvertedCubeT(descriptor_output{ Descriptor }, Vertices, End);
 }
 
 void* Mesh::BuildSphere(void* Vertices, void* End, const vertex_descriptor& Descriptor, int Lon, int Lat)
 {
-    if (GetVertexCount(Vertices, End, Descriptor) < (Lon * Lat * 6))
+    return BuildSphereT(descriptor_output{ Descriptor }, Vertices, End, Lon, Lat);
+}
+
+// ================================================================================================
+// MESH CACHE
+// ================================================================================================
+static const uint32_t MESH_CACHE_MAGIC = 0x4D524249; // "IBRM"
+static const uint64_t MESH_CACHE_SECTION_ALIGNMENT = 16; // Sections are cast from the mapping
+static const uint32_t MESH_CACHE_VERSION = 5; // 2: Optimized index order and vertex cache stats
+                                              // 3: Levels of detail
+                                              // 4: Ranges with bounds
+                                              // 5: Meshlets
+
+static uint32_t GetVertexLayoutTag()
+{
+    return (uint32_t)(sizeof(vertex_full) << 24 | offsetof(vertex_full, Position) << 16 | offsetof(vertex_full, Normal) << 8 | offsetof(vertex_full, UV));
+}
+
+static std::string GetCacheFilename(const char* Filename)
+{
+    std::string CachedFile = Filename;
+    CachedFile += ".cache";
+    return CachedFile;
+}
+
+static bool SaveObjCache(const indexed_mesh& Mesh, const char* Filename)
+{
+    mesh_cache_header Header = {};
+    Header.Magic = MESH_CACHE_MAGIC;
+    Header.Version = MESH_CACHE_VERSION;
+    Header.VertexLayout = GetVertexLayoutTag();
+    Header.VertexCount = (uint32_t)Mesh.Vertices.size();
+    Header.IndexCount = (uint32_t)Mesh.Indices.size();
+    Header.LodCount = (uint32_t)Mesh.Lods.size();
+    Header.RangeCount = (uint32_t)Mesh.Ranges.size();
+    Header.MeshletCount = (uint32_t)Mesh.Meshlets.size();
+    Header.IndexSize = (Header.VertexCount <= 0x10000) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    file_info SourceInfo = {};
+    File::GetInfo(Filename, &SourceInfo);
+    Header.SourceSize = SourceInfo.Size;
+    Header.SourceModificationTime = SourceInfo.ModificationTime;
+    Header.SourceCacheStats = Mesh.SourceCacheStats;
+    Header.CacheStats = Mesh.CacheStats;
+
+    Header.BoundsMin = Header.BoundsMax = Mesh.Vertices.empty() ? v3{} : Mesh.Vertices[0].Position;
+    for (const vertex_full& Vertex : Mesh.Vertices)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            Header.BoundsMin.e[i] = Math::Min(Header.BoundsMin.e[i], Vertex.Position.e[i]);
+            Header.BoundsMax.e[i] = Math::Max(Header.BoundsMax.e[i], Vertex.Position.e[i]);
+        }
+    }
+
+    // Store indices in their gpu format
+    std::vector<uint16_t> Indices16;
+    const void* Indices = Mesh.Indices.data();
+    if (Header.IndexSize == sizeof(uint16_t))
     {
-        fprintf(stderr, "Not enough vertices to create sphere\n");
-        return Vertices;
+        Indices16.assign(Mesh.Indices.begin(), Mesh.Indices.end());
+        Indices = Indices16.data();
     }
 
-    uint8_t* Cur = (uint8_t*)Vertices;
-    for (int i = 0; i < Lat; ++i)
+    // Sections follow the header, each one is padded to MESH_CACHE_SECTION_ALIGNMENT
+    static const uint8_t Padding[MESH_CACHE_SECTION_ALIGNMENT] = {};
+    const void* SectionData[MESH_CACHE_SECTION_COUNT] = { Mesh.Vertices.data(), Indices, Mesh.Lods.data(), Mesh.Ranges.data(), Mesh.Meshlets.data() };
+    size_t SectionSizes[MESH_CACHE_SECTION_COUNT] = { Header.VertexCount * sizeof(vertex_full), Header.IndexCount * Header.IndexSize, Header.LodCount * sizeof(mesh_lod), Header.RangeCount * sizeof(mesh_range), Header.MeshletCount * sizeof(mesh_meshlet) };
+    const void* Chunks[MESH_CACHE_SECTION_COUNT * 2 + 1] = { &Header };
+    size_t ChunkSizes[MESH_CACHE_SECTION_COUNT * 2 + 1] = { sizeof(mesh_cache_header) };
+    int ChunkCount = 1;
+    uint64_t Offset = sizeof(mesh_cache_header);
+    for (int i = 0; i < MESH_CACHE_SECTION_COUNT; ++i)
     {
-        // Theta varies from 0 to 180
-        float Theta        = Math::Pi() * (float)(i+0) / Lat;
-        float ThetaCos     = Math::Cos(Theta);
-        float ThetaSin     = Math::Sin(Theta);
-        
-        float ThetaNext    = Math::Pi() * (float)(i+1) / Lat;
-        float ThetaNextCos = Math::Cos(ThetaNext);
-        float ThetaNextSin = Math::Sin(ThetaNext);
+        uint64_t AlignedOffset = (Offset + MESH_CACHE_SECTION_ALIGNMENT - 1) & ~(MESH_CACHE_SECTION_ALIGNMENT - 1);
+        Chunks[ChunkCount] = Padding;
+        ChunkSizes[ChunkCount++] = (size_t)(AlignedOffset - Offset);
+        Chunks[ChunkCount] = SectionData[i];
+        ChunkSizes[ChunkCount++] = SectionSizes[i];
+
+        Header.Sections[i].Offset = AlignedOffset;
+        Header.Sections[i].Size = SectionSizes[i];
+        Offset = AlignedOffset + SectionSizes[i];
+    }
+    Header.FileSize = Offset;
 
-        for (int j = 0; j < Lon; ++j)
-        {
-            // Phi varies from 0 to 360
-            float Phi        = Math::TwoPi() * (float)(j+0) / Lon;
-            float PhiCos     = Math::Cos(Phi);
-            float PhiSin     = Math::Sin(Phi);
-            
-            float PhiNext    = Math::TwoPi() * (float)(j+1) / Lon;
-            float PhiNextCos = Math::Cos(PhiNext);
-            float PhiNextSin = Math::Sin(PhiNext);
-
-            // Compute positions
-            v3 P0 = {     ThetaSin * PhiCos,         ThetaCos,     ThetaSin * PhiSin     };
-            v3 P1 = {     ThetaSin * PhiNextCos,     ThetaCos,     ThetaSin * PhiNextSin };
-            v3 P2 = { ThetaNextSin * PhiCos,     ThetaNextCos, ThetaNextSin * PhiSin     };
-            v3 P3 = { ThetaNextSin * PhiNextCos, ThetaNextCos, ThetaNextSin * PhiNextSin };
-
-            vertex_full Quad[6];
-
-            Quad[0].Position = Quad[0].Normal = P0;
-            Quad[1].Position = Quad[1].Normal = P1;
-            Quad[2].Position = Quad[2].Normal = P2;
-            Quad[3].Position = Quad[3].Normal = P2;
-            Quad[4].Position = Quad[4].Normal = P1;
-            Quad[5].Position = Quad[5].Normal = P3;
-
-            // Set uv
-            float U0 = 1.f - (j + 0.f) / (float)Lon;
-            float U1 = 1.f - (j + 1.f) / (float)Lon;
-            float V0 = 1.f - (i + 0.f) / (float)Lat;
-            float V1 = 1.f - (i + 1.f) / (float)Lat;
-
-            Quad[0].UV = { U0, V0 };
-            Quad[1].UV = { U1, V0 };
-            Quad[2].UV = { U0, V1 };
-            Quad[3].UV = Quad[2].UV;
-            Quad[4].UV = Quad[1].UV;
-            Quad[5].UV = { U1, V1 };
-
-            Cur = (uint8_t*)ConvertVertices(Cur, Descriptor, Quad, 6);
-        }
+    std::string CachedFile = GetCacheFilename(Filename);
+    if (!File::WriteAtomic(CachedFile.c_str(), ChunkCount, Chunks, ChunkSizes))
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        return false;
     }
 
-    // Transform pos from [-1;+1] to [-0.5;+0.5] to make a unit sphere
-    return Mesh::Transform(Vertices, Cur, Descriptor, Mat4::Scale({ 0.5f, 0.5f, 0.5f }));
+    printf("Saved to cache: %s (%d vertices, %d indices)\n", Filename, (int)Header.VertexCount, (int)Header.IndexCount);
+    return true;
 }
 
-// Implement dumb caching to avoid parsing .obj again and again
-bool LoadObjFromCache(std::vector<vertex_full>& Mesh, const char* Filename)
+static bool ValidateObjCache(const file_mapping& Mapping, const char* Filename)
 {
-    std::string CachedFile = Filename;
-    CachedFile += ".cache";
+    if (Mapping.Size < sizeof(mesh_cache_header))
+        return false;
+
+    const mesh_cache_header* Header = (const mesh_cache_header*)Mapping.Data;
+    if (Header->Magic != MESH_CACHE_MAGIC
+     || Header->Version != MESH_CACHE_VERSION
+     || Header->VertexLayout != GetVertexLayoutTag()
+     || Header->FileSize != Mapping.Size
+     || (Header->IndexSize != sizeof(uint16_t) && Header->IndexSize != sizeof(uint32_t)))
+        return false;
+
+    for (int i = 0; i < MESH_CACHE_SECTION_COUNT; ++i)
+    {
+        const mesh_cache_section& Section = Header->Sections[i];
+        if (Section.Offset > Mapping.Size || Section.Size > Mapping.Size - Section.Offset
+         || Section.Offset % MESH_CACHE_SECTION_ALIGNMENT != 0)
+            return false;
+    }
 
-    FILE* File = fopen(CachedFile.c_str(), "rb");
-    if (File == nullptr)
+    if (Header->Sections[MESH_CACHE_VERTICES].Size != (uint64_t)Header->VertexCount * sizeof(vertex_full)
+     || Header->Sections[MESH_CACHE_INDICES].Size != (uint64_t)Header->IndexCount * Header->IndexSize
+     || Header->Sections[MESH_CACHE_LODS].Size != (uint64_t)Header->LodCount * sizeof(mesh_lod)
+     || Header->Sections[MESH_CACHE_RANGES].Size != (uint64_t)Header->RangeCount * sizeof(mesh_range)
+     || Header->Sections[MESH_CACHE_MESHLETS].Size != (uint64_t)Header->MeshletCount * sizeof(mesh_meshlet)
+     || Header->LodCount == 0 || Header->LodCount > MESH_MAX_LODS)
         return false;
 
-    size_t VertexCount = 0;
-    fread(&VertexCount, sizeof(size_t), 1, File);
-    Mesh.resize(VertexCount);
-    fread(&Mesh[0], sizeof(vertex_full), VertexCount, File);
-    fclose(File);
+    const mesh_lod* Lods = (const mesh_lod*)((const uint8_t*)Mapping.Data + Header->Sections[MESH_CACHE_LODS].Offset);
+    for (int i = 0; i < (int)Header->LodCount; ++i)
+    {
+        if (Lods[i].IndexOffset > Header->IndexCount || Lods[i].IndexCount > Header->IndexCount - Lods[i].IndexOffset)
+            return false;
+    }
+
+    // Ranges and meshlets must stay inside the full mesh
+    const mesh_range* Ranges = (const mesh_range*)((const uint8_t*)Mapping.Data + Header->Sections[MESH_CACHE_RANGES].Offset);
+    for (int i = 0; i < (int)Header->RangeCount; ++i)
+    {
+        if (Ranges[i].IndexOffset > Lods[0].IndexCount || Ranges[i].IndexCount > Lods[0].IndexCount - Ranges[i].IndexOffset)
+            return false;
+    }
+    const mesh_meshlet* Meshlets = (const mesh_meshlet*)((const uint8_t*)Mapping.Data + Header->Sections[MESH_CACHE_MESHLETS].Offset);
+    for (int i = 0; i < (int)Header->MeshletCount; ++i)
+    {
+        if (Meshlets[i].IndexOffset > Lods[0].IndexCount || Meshlets[i].IndexCount > Lods[0].IndexCount - Meshlets[i].IndexOffset)
+            return false;
+    }
 
-    printf("Loaded from cache: %s (%d vertices)\n", Filename, (int)VertexCount);
+    // Staleness check (the source file might be missing if only the cache is distributed)
+    file_info SourceInfo;
+    if (File::GetInfo(Filename, &SourceInfo)
+        && (SourceInfo.Size != Header->SourceSize || SourceInfo.ModificationTime != Header->SourceModificationTime))
+        return false;
+
+    // Indices are read by the cpu (analysis, culling) and the gpu without further checks
+    const uint8_t* Indices = (const uint8_t*)Mapping.Data + Header->Sections[MESH_CACHE_INDICES].Offset;
+    uint32_t MaxIndex = 0;
+    if (Header->IndexSize == sizeof(uint16_t))
+    {
+        for (uint32_t i = 0; i < Header->IndexCount; ++i)
+            MaxIndex = Math::Max(MaxIndex, (uint32_t)((const uint16_t*)Indices)[i]);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < Header->IndexCount; ++i)
+            MaxIndex = Math::Max(MaxIndex, ((const uint32_t*)Indices)[i]);
+    }
+    if (Header->IndexCount > 0 && MaxIndex >= Header->VertexCount)
+        return false;
 
     return true;
 }
 
-void SaveObjToCache(const std::vector<vertex_full>& Mesh, const char* Filename)
+bool Mesh::MapObjCache(mesh_cache& Cache, const char* Filename, float Scale)
 {
-    std::string CachedFile = Filename;
-    CachedFile += ".cache";
+    Cache = {};
+
+    std::string CachedFile = GetCacheFilename(Filename);
+    if (!File::Map(&Cache.Mapping, CachedFile.c_str(), Scale != 1.f))
+        return false;
+
+    if (!ValidateObjCache(Cache.Mapping, Filename))
+    {
+        UnmapObjCache(Cache);
+        return false;
+    }
+
+    uint8_t* Data = (uint8_t*)Cache.Mapping.Data;
+    Cache.Header = (const mesh_cache_header*)Data;
+    Cache.Vertices = (const vertex_full*)(Data + Cache.Header->Sections[MESH_CACHE_VERTICES].Offset);
+    Cache.Indices = Data + Cache.Header->Sections[MESH_CACHE_INDICES].Offset;
+    Cache.Lods = (const mesh_lod*)(Data + Cache.Header->Sections[MESH_CACHE_LODS].Offset);
+    Cache.Ranges = (const mesh_range*)(Data + Cache.Header->Sections[MESH_CACHE_RANGES].Offset);
+    Cache.Meshlets = (const mesh_meshlet*)(Data + Cache.Header->Sections[MESH_CACHE_MESHLETS].Offset);
+    Cache.BoundsMin = Cache.Header->BoundsMin * Scale;
+    Cache.BoundsMax = Cache.Header->BoundsMax * Scale;
+
+    // Rescale positions (only touched pages are copied in memory)
+    if (Scale != 1.f)
+    {
+        vertex_full* Vertices = (vertex_full*)Cache.Vertices;
+        for (int i = 0; i < (int)Cache.Header->VertexCount; ++i)
+            Vertices[i].Position *= Scale;
+    }
 
-    FILE* File = fopen(CachedFile.c_str(), "wb");
-    size_t VertexCount = Mesh.size();
-    fwrite(&VertexCount, sizeof(size_t), 1, File);
-    fwrite(&Mesh[0], sizeof(vertex_full), VertexCount, File);
-    fclose(File);
+    return true;
+}
 
-    printf("Saved to cache: %s (%d vertices)\n", Filename, (int)VertexCount);
+void Mesh::UnmapObjCache(mesh_cache& Cache)
+{
+    File::Unmap(&Cache.Mapping);
+    Cache = {};
 }
 
-bool Mesh::LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale)
+// Load welded mesh from cache or parse it (and cache it)
+static bool LoadObjUnscaled(indexed_mesh& Mesh, const char* Filename)
 {
-    if (!LoadObjFromCache(Mesh, Filename))
+    mesh_cache Cache;
+    if (Mesh::MapObjCache(Cache, Filename, 1.f))
     {
-        std::string Warn;
-        std::string Err;
-        tinyobj::attrib_t Attrib;
-        std::vector<tinyobj::shape_t> Shapes;
-
-        tinyobj::LoadObj(&Attrib, &Shapes, nullptr, &Warn, &Err, Filename, "media/", true);
-        if (!Err.empty())
-        {
-            fprintf(stderr, "Warning loading obj: %s\n", Err.c_str());
-        }
-        if (!Err.empty())
-        {
-            fprintf(stderr, "Error loading obj: %s\n", Err.c_str());
-            return false;
-        }
+        const mesh_cache_header& Header = *Cache.Header;
+        Mesh.Vertices.assign(Cache.Vertices, Cache.Vertices + Header.VertexCount);
+        if (Header.IndexSize == sizeof(uint16_t))
+            Mesh.Indices.assign((const uint16_t*)Cache.Indices, (const uint16_t*)Cache.Indices + Header.IndexCount);
+        else
+            Mesh.Indices.assign((const uint32_t*)Cache.Indices, (const uint32_t*)Cache.Indices + Header.IndexCount);
+        Mesh.Lods.assign(Cache.Lods, Cache.Lods + Header.LodCount);
+        Mesh.Ranges.assign(Cache.Ranges, Cache.Ranges + Header.RangeCount);
+        Mesh.Meshlets.assign(Cache.Meshlets, Cache.Meshlets + Header.MeshletCount);
+        Mesh.SourceCacheStats = Header.SourceCacheStats;
+        Mesh.CacheStats = Header.CacheStats;
+        Mesh::UnmapObjCache(Cache);
+
+        printf("Loaded from cache: %s (%d vertices, %d indices)\n", Filename, (int)Mesh.Vertices.size(), (int)Mesh.Indices.size());
+        return true;
+    }
 
-        bool HasNormals = !Attrib.normals.empty();
-        bool HasTexCoords = !Attrib.texcoords.empty();
+    printf("Cache missing or outdated, parsing: %s\n", Filename);
+    std::vector<vertex_full> Vertices;
+    std::vector<uint32_t> ShapeOffsets;
+    if (!Mesh::ParseObj(Vertices, Filename, OBJ_PARSER_PARALLEL, &ShapeOffsets))
+        return false;
 
-        // Build all meshes
-        for (int MeshId = 0; MeshId < (int)Shapes.size(); ++MeshId)
-        {
-            const tinyobj::mesh_t& MeshDef = Shapes[MeshId].mesh;
-
-            int IndexId = 0;
-            for (int FaceId = 0; FaceId < (int)MeshDef.num_face_vertices.size(); ++FaceId)
-            {
-                int FaceVertices = MeshDef.num_face_vertices[FaceId];
-                assert(FaceVertices == 3);
-
-                for (int j = 0; j < FaceVertices; ++j)
-                {
-                    const tinyobj::index_t& Index = MeshDef.indices[IndexId];
-                    vertex_full V = {};
-                    V.Position = {
-                        Attrib.vertices[Index.vertex_index * 3 + 0],
-                        Attrib.vertices[Index.vertex_index * 3 + 1],
-                        Attrib.vertices[Index.vertex_index * 3 + 2]
-                    };
-
-                    if (HasNormals)
-                    {
-                        V.Normal = {
-                            Attrib.normals[Index.normal_index * 3 + 0],
-                            Attrib.normals[Index.normal_index * 3 + 1],
-                            Attrib.normals[Index.normal_index * 3 + 2]
-                        };
-                    }
-
-                    if (HasTexCoords)
-                    {
-                        V.UV = {
-                            Attrib.texcoords[Index.texcoord_index * 2 + 0],
-                            Attrib.texcoords[Index.texcoord_index * 2 + 1]
-                        };
-                    }
-
-                    Mesh.push_back(V);
-
-                    IndexId++;
-                }
-            }
-        }
+    Mesh::WeldVertices(Mesh, Vertices.data(), (int)Vertices.size());
 
-        // Build normals if missing
-        if (!HasNormals)
-        {
-            for (int i = 0; i < (int)Mesh.size(); i += 3)
-            {
-                vertex_full& V0 = Mesh[i + 0];
-                vertex_full& V1 = Mesh[i + 1];
-                vertex_full& V2 = Mesh[i + 2];
-
-                v3 Normal = Vec3::Cross((V1.Position - V0.Position), (V2.Position - V0.Position));
-                V0.Normal = V1.Normal = V2.Normal = Normal;
-            }
-        }
+    // One range per shape (welding keeps one index per parsed vertex)
+    Mesh.Ranges.clear();
+    for (int i = 0; i < (int)ShapeOffsets.size(); ++i)
+    {
+        uint32_t End = (i + 1 < (int)ShapeOffsets.size()) ? ShapeOffsets[i + 1] : (uint32_t)Vertices.size();
+        mesh_range Range = {};
+        Range.IndexOffset = ShapeOffsets[i];
+        Range.IndexCount = End - ShapeOffsets[i];
+        Mesh.Ranges.push_back(Range);
+    }
+    Mesh::OptimizeMesh(Mesh);
+    SaveObjCache(Mesh, Filename);
+    return true;
+}
 
-        // Build UVs if missing
-        if (!HasTexCoords)
-        {
-            // TODO: Maybe triplanar texturing can make best results
-            for (int i = 0; i < (int)Mesh.size(); ++i)
-            {
-                vertex_full& V = Mesh[i];
-
-                float Length = Vec3::Length(V.Position);
-                if (Length != 0.f)
-                {
-                    v3 Pos = V.Position / Length;
-                    V.UV.x = 0.5f + Math::Atan2(Pos.z, Pos.x);
-                    V.UV.y = Pos.y;
-                }
-            }
-        }
+bool Mesh::LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale)
+{
+    indexed_mesh Indexed;
+    if (!LoadObjUnscaled(Indexed, Filename))
+        return false;
 
-        SaveObjToCache(Mesh, Filename);
+    // Expand indices of the full mesh and rescale positions
+    Mesh.resize(Indexed.Lods[0].IndexCount);
+    for (int i = 0; i < (int)Mesh.size(); ++i)
+    {
+        Mesh[i] = Indexed.Vertices[Indexed.Indices[i]];
+        Mesh[i].Position *= Scale;
     }
 
+    return true;
+}
+
+bool Mesh::LoadObjIndexed(indexed_mesh& Mesh, const char* Filename, float Scale)
+{
+    if (!LoadObjUnscaled(Mesh, Filename))
+        return false;
+
     // Rescale positions
-    for (int i = 0; i < Mesh.size(); ++i)
+    for (vertex_full& Vertex : Mesh.Vertices)
+        Vertex.Position *= Scale;
+    for (mesh_lod& Lod : Mesh.Lods)
+        Lod.Error *= Scale;
+    for (mesh_range& Range : Mesh.Ranges)
+    {
+        Range.BoundsMin *= Scale;
+        Range.BoundsMax *= Scale;
+        Range.Center *= Scale;
+        Range.Radius *= Scale;
+    }
+    for (mesh_meshlet& Meshlet : Mesh.Meshlets)
     {
-        v3& Position = Mesh[i].Position;
-        Position *= Scale;
+        Meshlet.Center *= Scale;
+        Meshlet.Radius *= Scale;
     }
 
     return true;
@@ -378,19 +562,79 @@ bool Mesh::LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filen
 
 void* Mesh::LoadObj(void* Vertices, void* End, const vertex_descriptor& Descriptor, const char* Filename, float Scale)
 {
-    std::vector<vertex_full> Mesh;
-    if (!LoadObjNoConvertion(Mesh, Filename, Scale))
-        return Vertices;
+    return LoadObjT(descriptor_output{ Descriptor }, Vertices, End, Filename, Scale);
+}
+
+static uint32_t HashVertex(const vertex_full& Vertex)
+{
+    // FNV-1a over the raw vertex bytes (welding only merges bitwise identical vertices)
+    const uint8_t* Bytes = (const uint8_t*)&Vertex;
+    uint32_t Hash = 2166136261u;
+    for (int i = 0; i < (int)sizeof(vertex_full); ++i)
+        Hash = (Hash ^ Bytes[i]) * 16777619u;
+    return Hash;
+}
+
+void Mesh::WeldVertices(indexed_mesh& Mesh, const vertex_full* Vertices, int Count)
+{
+    Mesh.Vertices.clear();
+    Mesh.Indices.resize(Count);
+
+    // Open addressing hash table storing indices inside Mesh.Vertices (power of two size, load factor <= 0.5)
+    uint32_t TableSize = 1;
+    while (TableSize < (uint32_t)Count * 2)
+        TableSize *= 2;
+    const uint32_t EmptySlot = 0xFFFFFFFF;
+    std::vector<uint32_t> Table(TableSize, EmptySlot);
+
+    for (int i = 0; i < Count; ++i)
+    {
+        const vertex_full& Vertex = Vertices[i];
+        uint32_t Slot = HashVertex(Vertex) & (TableSize - 1);
+        while (Table[Slot] != EmptySlot && memcmp(&Mesh.Vertices[Table[Slot]], &Vertex, sizeof(vertex_full)) != 0)
+            Slot = (Slot + 1) & (TableSize - 1);
+
+        if (Table[Slot] == EmptySlot)
+        {
+            Table[Slot] = (uint32_t)Mesh.Vertices.size();
+            Mesh.Vertices.push_back(Vertex);
+        }
+        Mesh.Indices[i] = Table[Slot];
+    }
+}
+
+template<typename index_type>
+static vertex_cache_stats AnalyzeVertexCacheT(const index_type* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+    // Simulate a FIFO post-transform cache: a vertex is still cached if less than CacheSize misses happened since it was inserted
+    std::vector<int> InsertionTime(VertexCount, -CacheSize - 1);
+    int Misses = 0;
+    for (int i = 0; i < IndexCount; ++i)
+    {
+        index_type Index = Indices[i];
+        if (Misses - InsertionTime[Index] > CacheSize)
+        {
+            InsertionTime[Index] = Misses;
+            Misses++;
+        }
+    }
 
-    // Check size
-    int MeshSize = (int)Mesh.size();
-    int SizeAvailable = GetVertexCount(Vertices, End, Descriptor);
-    if (MeshSize > SizeAvailable)
+    vertex_cache_stats Stats = {};
+    if (IndexCount > 0)
     {
-        fprintf(stderr, "Mesh '%s' does not fit inside vertex buffer (%d needed, %d available)\n", Filename, MeshSize, SizeAvailable);
-        MeshSize = SizeAvailable;
+        Stats.ACMR = (float)Misses / (IndexCount / 3);
+        Stats.ATVR = (float)Misses / VertexCount;
+        Stats.HitRate = 1.f - (float)Misses / IndexCount;
     }
+    return Stats;
+}
+
+vertex_cache_stats Mesh::AnalyzeVertexCache(const uint16_t* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+    return AnalyzeVertexCacheT(Indices, IndexCount, VertexCount, CacheSize);
+}
 
-    // Convert to output vertex format
-    return ConvertVertices(Vertices, Descriptor, &Mesh[0], MeshSize);
+vertex_cache_stats Mesh::AnalyzeVertexCache(const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+    return AnalyzeVertexCacheT(Indices, IndexCount, VertexCount, CacheSize);
 }
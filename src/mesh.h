@@ -1,8 +1,22 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 #include "types.h"
+#include "file.h"
+#include "simd.h"
+
+// Component format of a vertex attribute (zero initialized descriptors use floats)
+enum vertex_format
+{
+	VERTEX_FORMAT_FLOAT,      // 32 bits floats
+	VERTEX_FORMAT_HALF,       // 16 bits floats (positions are padded to 8 bytes)
+	VERTEX_FORMAT_UNORM16,    // 16 bits unsigned normalized, clamped to [0;1] (uvs)
+	VERTEX_FORMAT_SNORM10,    // 10:10:10:2 signed normalized (normals)
+	VERTEX_FORMAT_OCTAHEDRAL, // 2 x 16 bits signed normalized octahedral encoding (normals, decoded in the shader)
+};
 
 // Descriptor for interleaved vertex formats
 struct vertex_descriptor
@@ -13,6 +27,9 @@ struct vertex_descriptor
 	int NormalOffset;
 	bool HasUV;
 	int UVOffset;
+	vertex_format PositionFormat;
+	vertex_format NormalFormat;
+	vertex_format UVFormat;
 };
 
 struct vertex_full
@@ -22,14 +39,188 @@ struct vertex_full
 	v2 UV;
 };
 
+// Result of a post-transform vertex cache simulation
+struct vertex_cache_stats
+{
+	float ACMR;    // Average cache miss ratio (transformed vertices per triangle)
+	float ATVR;    // Average transform to vertex ratio (1.0 is optimal)
+	float HitRate; // Ratio of indices found in the cache
+};
+
+// Maximum number of levels of detail per mesh (including the full mesh)
+static const int MESH_MAX_LODS = 5;
+
+// Range of indexed_mesh::Indices drawing one level of detail
+struct mesh_lod
+{
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	float Error; // Maximum geometric deviation from the full mesh (in mesh units)
+};
+
+// Maximum triangle count of a mesh_range (shapes are split further along their longest axis)
+static const int MESH_RANGE_MAX_TRIANGLES = 512;
+
+// Spatially coherent range of the full mesh indices with its bounds (used for culling)
+struct mesh_range
+{
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	v3 BoundsMin;
+	v3 BoundsMax;
+	v3 Center; // Bounding sphere
+	float Radius;
+};
+
+// Maximum triangle count of a mesh_meshlet (ranges are split in meshlets of equal size)
+static const int MESH_MESHLET_MAX_TRIANGLES = 128;
+
+// Small cluster of a mesh_range with bounds for per frame culling
+struct mesh_meshlet
+{
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	v3 Center; // Bounding sphere
+	float Radius;
+	v3 ConeAxis;      // Average triangle normal
+	float ConeCutoff; // Back facing if Dot(Center - Eye, ConeAxis) >= ConeCutoff * Length(Center - Eye) + Radius (1 if never)
+};
+
+// Triangle list with welded vertices
+struct indexed_mesh
+{
+	std::vector<vertex_full> Vertices;
+	std::vector<uint32_t> Indices; // All levels of detail (Lods[0] is the full mesh)
+	std::vector<mesh_lod> Lods;
+	std::vector<mesh_range> Ranges; // Partition of Lods[0] (one range per .obj shape before Mesh::OptimizeMesh)
+	std::vector<mesh_meshlet> Meshlets; // Partition of Ranges
+	vertex_cache_stats SourceCacheStats; // Before Mesh::OptimizeMesh
+	vertex_cache_stats CacheStats;
+};
+
+enum mesh_cache_section_type
+{
+	MESH_CACHE_VERTICES,
+	MESH_CACHE_INDICES,
+	MESH_CACHE_LODS,
+	MESH_CACHE_RANGES,
+	MESH_CACHE_MESHLETS,
+	MESH_CACHE_SECTION_COUNT
+};
+
+struct mesh_cache_section
+{
+	uint64_t Offset; // From the start of the file (16 bytes aligned)
+	uint64_t Size;
+};
+
+// Header of the binary cache written next to the .obj ("<filename>.cache")
+struct mesh_cache_header
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VertexLayout; // Size and attribute offsets of vertex_full
+	uint32_t IndexSize;    // 2 or 4 bytes
+	uint64_t FileSize;
+	uint64_t SourceSize;   // Used to detect outdated cache
+	uint64_t SourceModificationTime;
+	uint32_t VertexCount;
+	uint32_t IndexCount;   // All levels of detail
+	uint32_t LodCount;
+	uint32_t RangeCount;
+	uint32_t MeshletCount;
+	v3 BoundsMin;
+	v3 BoundsMax;
+	vertex_cache_stats SourceCacheStats;
+	vertex_cache_stats CacheStats;
+	mesh_cache_section Sections[MESH_CACHE_SECTION_COUNT];
+};
+
+enum obj_parser
+{
+	OBJ_PARSER_TINYOBJ,
+	OBJ_PARSER_PARALLEL, // Multithreaded, same output as tinyobj (polygons are triangulated as fans)
+};
+
+// Memory and time spent by Mesh::StreamObj
+struct obj_stream_stats
+{
+	int VertexCount;
+	int BlockCount;        // File blocks read (both passes)
+	size_t AttributeBytes; // Positions, uvs and normals kept in memory to resolve the faces
+	size_t StartResident;  // Resident memory before the first block
+	size_t PeakResident;   // Highest resident memory sampled after each block
+	float Time;            // Milliseconds
+};
+
+// Mesh cache mapped in memory (pointers are inside the mapping)
+struct mesh_cache
+{
+	file_mapping Mapping;
+	const mesh_cache_header* Header;
+	const vertex_full* Vertices;
+	const void* Indices; // uint16_t or uint32_t (see Header->IndexSize)
+	const mesh_lod* Lods;
+	const mesh_range* Ranges; // Unscaled bounds
+	const mesh_meshlet* Meshlets;
+	v3 BoundsMin;        // Scaled bounds
+	v3 BoundsMax;
+};
+
 namespace Mesh
 {
 
-void* Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform);
+// Interleaved position, normal and uv (PackedDescriptor(FLOAT, FLOAT, FLOAT) matches vertex_full)
+vertex_descriptor PackedDescriptor(vertex_format PositionFormat, vertex_format NormalFormat, vertex_format UVFormat);
+// Size in bytes of an attribute (padded to 4 bytes)
+int GetAttributeSize(vertex_format Format, int ComponentCount);
+void* ConvertVertices(void* Vertices, const vertex_descriptor& Descriptor, const vertex_full* VerticesSrc, int Count);
+// Vectorized for vertex_full and position only (v3) layouts (SimdLevel is clamped to the cpu capabilities)
+void* Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform, simd_level SimdLevel = SIMD_AVX2);
+// SIMD part of Mesh::Transform, returns the number of transformed vertices (0 if the layout is not supported)
+int TransformSimd(void* Vertices, int Count, const vertex_descriptor& Descriptor, const mat4& Transform, const mat4& NormalMatrix, simd_level SimdLevel);
 void* BuildQuad(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildCube(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildInvertedCube(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildSphere(void* Vertices, void* End, const vertex_descriptor& Descriptor, int Lon, int Lat);
 void* LoadObj(void* Vertices, void* End, const vertex_descriptor& Descriptor, const char* Filename, float Scale);
 bool LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale);
+bool LoadObjIndexed(indexed_mesh& Mesh, const char* Filename, float Scale);
+// Parse .obj without cache nor scale (one vertex per face corner)
+// ShapeOffsets receives the first vertex of each shape ('o' and 'g' statements)
+bool ParseObj(std::vector<vertex_full>& Mesh, const char* Filename, obj_parser Parser = OBJ_PARSER_PARALLEL, std::vector<uint32_t>* ShapeOffsets = nullptr);
+// Parse .obj in blocks of BlockSize bytes without loading the whole file nor the expanded vertices (same output as ParseObj, scaled)
+// Begin receives the vertex count once the attributes are loaded, then Write receives the vertices in order by small batches
+bool StreamObj(const char* Filename, float Scale, size_t BlockSize, const std::function<void(int VertexCount)>& Begin,
+               const std::function<void(const vertex_full* Vertices, int Count)>& Write, obj_stream_stats* Stats = nullptr);
+// Map the cache of a previously loaded .obj, fails if the cache is missing, invalid or outdated
+bool MapObjCache(mesh_cache& Cache, const char* Filename, float Scale);
+void UnmapObjCache(mesh_cache& Cache);
+void WeldVertices(indexed_mesh& Mesh, const vertex_full* Vertices, int Count);
+vertex_cache_stats AnalyzeVertexCache(const uint16_t* Indices, int IndexCount, int VertexCount, int CacheSize = 32);
+vertex_cache_stats AnalyzeVertexCache(const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize = 32);
+
+// Optimizations applied to loaded meshes before caching them
+// Reorder triangles for post-transform cache locality (Tipsify)
+void OptimizeVertexCache(uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize = 16);
+// Reorder clusters of triangles to draw outward facing ones first (keeps ACMR within Threshold of the input)
+void OptimizeOverdraw(uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, float Threshold = 1.05f, int CacheSize = 16);
+// Reorder vertices by first use (and remove unused ones)
+void OptimizeVertexFetch(indexed_mesh& Mesh);
+// Split Mesh.Ranges to MESH_RANGE_MAX_TRIANGLES and reorder triangles to keep each range contiguous
+void SplitRanges(indexed_mesh& Mesh);
+// Split Mesh.Ranges in meshlets of similarly facing triangles (reorders triangles inside each range)
+void BuildMeshlets(indexed_mesh& Mesh);
+// Compute bounding volumes of Mesh.Ranges and Mesh.Meshlets (boxes, spheres and normal cones)
+void ComputeBounds(indexed_mesh& Mesh);
+// Split ranges and meshlets, run the 3 optimizations above (per meshlet), build the levels of detail and fill Mesh cache stats
+void OptimizeMesh(indexed_mesh& Mesh);
+
+// Simplify a triangle list with edge collapses (quadric error metric with normal and uv costs), vertices are left untouched
+// Stops at TargetIndexCount or before exceeding TargetError (relative to the mesh extent), returns the index count written to Destination
+int Simplify(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float TargetError, float* ResultError = nullptr);
+// Vertex clustering on a grid (ignores topology and attributes), Destination must hold IndexCount indices
+int SimplifySloppy(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float* ResultError = nullptr);
+// Append simplified levels of detail to Mesh.Indices (each one halves the triangle count of the previous one)
+void BuildLods(indexed_mesh& Mesh, int MaxLodCount = MESH_MAX_LODS);
 }
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "maths.h"
+#include "mesh.h"
+
+// Compile-time description of a vertex struct, specialize it with member pointers (nullptr for missing attributes):
+//
+//     template<>
+//     struct vertex_traits<vertex>
+//     {
+//         static constexpr auto Position = &vertex::Position; // v3
+//         static constexpr auto Normal = nullptr;             // v3
+//         static constexpr auto UV = &vertex::UV;             // v2
+//     };
+//
+// The Mesh functions templated on the vertex type then compile to straight-line code without descriptor checks.
+template<typename vertex>
+struct vertex_traits;
+
+template<>
+struct vertex_traits<vertex_full>
+{
+    static constexpr auto Position = &vertex_full::Position;
+    static constexpr auto Normal = &vertex_full::Normal;
+    static constexpr auto UV = &vertex_full::UV;
+};
+
+namespace Mesh
+{
+    // Attribute helpers (nullptr attributes compile to nothing)
+    template<typename vertex, typename type>
+    inline void SetAttribute(vertex& Vertex, type vertex::* Member, const type& Value) { Vertex.*Member = Value; }
+    template<typename vertex, typename type>
+    inline void SetAttribute(vertex& Vertex, std::nullptr_t Member, const type& Value) {}
+
+    template<typename vertex, typename type>
+    inline int GetAttributeOffset(type vertex::* Member)
+    {
+        vertex Vertex;
+        return (int)((uint8_t*)&(Vertex.*Member) - (uint8_t*)&Vertex);
+    }
+    template<typename vertex>
+    inline int GetAttributeOffset(std::nullptr_t Member) { return 0; }
+
+    template<typename vertex>
+    inline void TransformNormal(vertex& Vertex, v3 vertex::* Member, const mat4& NormalMatrix)
+    {
+        v4 TransformedNormal = NormalMatrix * Vec4::vec4(Vertex.*Member, 0.f);
+        Vertex.*Member = Vec3::Normalize(TransformedNormal.xyz);
+    }
+    template<typename vertex>
+    inline void TransformNormal(vertex& Vertex, std::nullptr_t Member, const mat4& NormalMatrix) {}
+
+    template<typename vertex>
+    inline bool HasNormal() { return std::is_member_object_pointer<decltype(vertex_traits<vertex>::Normal)>::value; }
+    template<typename vertex>
+    inline bool HasUV() { return std::is_member_object_pointer<decltype(vertex_traits<vertex>::UV)>::value; }
+
+    // Runtime descriptor matching the traits (float formats)
+    template<typename vertex>
+    vertex_descriptor GetDescriptor()
+    {
+        vertex_descriptor Descriptor = {};
+        Descriptor.Stride = sizeof(vertex);
+        Descriptor.PositionOffset = GetAttributeOffset<vertex>(vertex_traits<vertex>::Position);
+        Descriptor.HasNormal = HasNormal<vertex>();
+        Descriptor.NormalOffset = GetAttributeOffset<vertex>(vertex_traits<vertex>::Normal);
+        Descriptor.HasUV = HasUV<vertex>();
+        Descriptor.UVOffset = GetAttributeOffset<vertex>(vertex_traits<vertex>::UV);
+        return Descriptor;
+    }
+
+    template<typename vertex>
+    vertex* ConvertVertices(vertex* Vertices, const vertex_full* VerticesSrc, int Count)
+    {
+        auto Position = vertex_traits<vertex>::Position;
+        auto Normal = vertex_traits<vertex>::Normal;
+        auto UV = vertex_traits<vertex>::UV;
+
+        for (int i = 0; i < Count; ++i)
+        {
+            Vertices[i].*Position = VerticesSrc[i].Position;
+            SetAttribute(Vertices[i], Normal, VerticesSrc[i].Normal);
+            SetAttribute(Vertices[i], UV, VerticesSrc[i].UV);
+        }
+        return Vertices + Count;
+    }
+
+    template<typename vertex>
+    vertex* Transform(vertex* Vertices, vertex* End, const mat4& Transform)
+    {
+        auto Position = vertex_traits<vertex>::Position;
+        auto Normal = vertex_traits<vertex>::Normal;
+        int Count = (int)(End - Vertices);
+
+        mat4 NormalMatrix = HasNormal<vertex>() ? Mat4::Transpose(Mat4::Inverse(Transform)) : Mat4::Identity();
+
+        // vertex_full and position only layouts are vectorized
+        int First = Mesh::TransformSimd(Vertices, Count, GetDescriptor<vertex>(), Transform, NormalMatrix, SIMD_AVX2);
+        for (int i = First; i < Count; ++i)
+        {
+            v4 TransformedPosition = Transform * Vec4::vec4(Vertices[i].*Position, 1.f);
+            Vertices[i].*Position = TransformedPosition.xyz / TransformedPosition.w;
+            TransformNormal(Vertices[i], Normal, NormalMatrix);
+        }
+        return End;
+    }
+
+    // ================================================================================================
+    // BUILDERS
+    // ================================================================================================
+    // Builders are written once for both APIs, 'output' converts and transforms generated vertices:
+    // - descriptor_output: runtime vertex_descriptor (void* buffers)
+    // - traits_output: vertex_traits (typed buffers)
+    struct descriptor_output
+    {
+        const vertex_descriptor& Descriptor;
+
+        int GetVertexCount(void* Vertices, void* End) const { return (int)((uint8_t*)End - (uint8_t*)Vertices) / Descriptor.Stride; }
+        void* Convert(void* Vertices, const vertex_full* VerticesSrc, int Count) const { return Mesh::ConvertVertices(Vertices, Descriptor, VerticesSrc, Count); }
+        void* Transform(void* Vertices, void* End, const mat4& Transform) const { return Mesh::Transform(Vertices, End, Descriptor, Transform); }
+    };
+
+    template<typename vertex>
+    struct traits_output
+    {
+        int GetVertexCount(vertex* Vertices, vertex* End) const { return (int)(End - Vertices); }
+        vertex* Convert(vertex* Vertices, const vertex_full* VerticesSrc, int Count) const { return Mesh::ConvertVertices(Vertices, VerticesSrc, Count); }
+        vertex* Transform(vertex* Vertices, vertex* End, const mat4& Transform) const { return Mesh::Transform(Vertices, End, Transform); }
+    };
+
+    template<typename output, typename pointer>
+    pointer BuildQuadT(const output& Output, pointer Vertices, pointer End)
+    {
+        if (Output.GetVertexCount(Vertices, End) < 6)
+        {
+            fprintf(stderr, "Not enough vertices to create quad\n");
+            return Vertices;
+        }
+
+        v3 Normal = { 0.f, 0.f, 1.f };
+
+        vertex_full TopLeft     = { { -0.5f, 0.5f, 0.f }, Normal, { 0.f, 1.f } };
+        vertex_full TopRight    = { {  0.5f, 0.5f, 0.f }, Normal, { 1.f, 1.f } };
+        vertex_full BottomLeft  = { { -0.5f,-0.5f, 0.f }, Normal, { 0.f, 0.f } };
+        vertex_full BottomRight = { {  0.5f,-0.5f, 0.f }, Normal, { 1.f, 0.f } };
+
+        vertex_full QuadVertices[] = {
+            TopLeft,
+            BottomLeft,
+            TopRight,
+            BottomLeft,
+            BottomRight,
+            TopRight
+        };
+
+        return Output.Convert(Vertices, QuadVertices, 6);
+    }
+
+    template<typename output, typename pointer>
+    pointer BuildCubeT(const output& Output, pointer Vertices, pointer End)
+    {
+        if (Output.GetVertexCount(Vertices, End) < (6 * 6))
+        {
+            fprintf(stderr, "Not enough vertices to create cube\n");
+            return Vertices;
+        }
+
+        pointer V = Vertices;
+
+        // Back face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.0f, 0.0f,-0.5f }) * Mat4::RotateY(-1.f, 0.f));
+        // Front face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.0f, 0.0f, 0.5f }) * Mat4::RotateY( 1.f, 0.f));
+        // Left face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({-0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f, 1.f));
+        // Right face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f,-1.f));
+        // Top face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.0f, 0.5f, 0.0f }) * Mat4::RotateX( 0.f,-1.f));
+        // Bottom face
+        V = Output.Transform(V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.0f,-0.5f, 0.0f }) * Mat4::RotateX( 0.f, 1.f));
+
+        return V;
+    }
+
+    template<typename output, typename pointer>
+    pointer BuildInvertedCubeT(const output& Output, pointer Vertices, pointer End)
+    {
+        pointer V = Vertices;
+
+        // FRONT FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::Translate({ 0.f, 0.f, -0.5f }));
+        // BACK FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::RotateY(Math::Pi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
+        // RIGHT FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::RotateY(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
+        // LEFT FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::RotateY(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
+        // TOP FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
+        // BOTTOM FACE
+        V = Output.Transform(
+            V, BuildQuadT(Output, V, End),
+            Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
+
+        return V;
+    }
+
+    template<typename output, typename pointer>
+    pointer BuildSphereT(const output& Output, pointer Vertices, pointer End, int Lon, int Lat)
+    {
+        if (Output.GetVertexCount(Vertices, End) < (Lon * Lat * 6))
+        {
+            fprintf(stderr, "Not enough vertices to create sphere\n");
+            return Vertices;
+        }
+
+        pointer Cur = Vertices;
+        for (int i = 0; i < Lat; ++i)
+        {
+            // Theta varies from 0 to 180
+            float Theta        = Math::Pi() * (float)(i+0) / Lat;
+            float ThetaCos     = Math::Cos(Theta);
+            float ThetaSin     = Math::Sin(Theta);
+
+            float ThetaNext    = Math::Pi() * (float)(i+1) / Lat;
+            float ThetaNextCos = Math::Cos(ThetaNext);
+            float ThetaNextSin = Math::Sin(ThetaNext);
+
+            for (int j = 0; j < Lon; ++j)
+            {
+                // Phi varies from 0 to 360
+                float Phi        = Math::TwoPi() * (float)(j+0) / Lon;
+                float PhiCos     = Math::Cos(Phi);
+                float PhiSin     = Math::Sin(Phi);
+
+                float PhiNext    = Math::TwoPi() * (float)(j+1) / Lon;
+                float PhiNextCos = Math::Cos(PhiNext);
+                float PhiNextSin = Math::Sin(PhiNext);
+
+                // Compute positions
+                v3 P0 = {     ThetaSin * PhiCos,         ThetaCos,     ThetaSin * PhiSin     };
+                v3 P1 = {     ThetaSin * PhiNextCos,     ThetaCos,     ThetaSin * PhiNextSin };
+                v3 P2 = { ThetaNextSin * PhiCos,     ThetaNextCos, ThetaNextSin * PhiSin     };
+                v3 P3 = { ThetaNextSin * PhiNextCos, ThetaNextCos, ThetaNextSin * PhiNextSin };
+
+                vertex_full Quad[6];
+
+                Quad[0].Position = Quad[0].Normal = P0;
+                Quad[1].Position = Quad[1].Normal = P1;
+                Quad[2].Position = Quad[2].Normal = P2;
+                Quad[3].Position = Quad[3].Normal = P2;
+                Quad[4].Position = Quad[4].Normal = P1;
+                Quad[5].Position = Quad[5].Normal = P3;
+
+                // Set uv
+                float U0 = 1.f - (j + 0.f) / (float)Lon;
+                float U1 = 1.f - (j + 1.f) / (float)Lon;
+                float V0 = 1.f - (i + 0.f) / (float)Lat;
+                float V1 = 1.f - (i + 1.f) / (float)Lat;
+
+                Quad[0].UV = { U0, V0 };
+                Quad[1].UV = { U1, V0 };
+                Quad[2].UV = { U0, V1 };
+                Quad[3].UV = Quad[2].UV;
+                Quad[4].UV = Quad[1].UV;
+                Quad[5].UV = { U1, V1 };
+
+                Cur = Output.Convert(Cur, Quad, 6);
+            }
+        }
+
+        // Transform pos from [-1;+1] to [-0.5;+0.5] to make a unit sphere
+        return Output.Transform(Vertices, Cur, Mat4::Scale({ 0.5f, 0.5f, 0.5f }));
+    }
+
+    template<typename output, typename pointer>
+    pointer LoadObjT(const output& Output, pointer Vertices, pointer End, const char* Filename, float Scale)
+    {
+        std::vector<vertex_full> Mesh;
+        if (!LoadObjNoConvertion(Mesh, Filename, Scale))
+            return Vertices;
+
+        // Check size
+        int MeshSize = (int)Mesh.size();
+        int SizeAvailable = Output.GetVertexCount(Vertices, End);
+        if (MeshSize > SizeAvailable)
+        {
+            fprintf(stderr, "Mesh '%s' does not fit inside vertex buffer (%d needed, %d available)\n", Filename, MeshSize, SizeAvailable);
+            MeshSize = SizeAvailable;
+        }
+
+        // Convert to output vertex format
+        return Output.Convert(Vertices, &Mesh[0], MeshSize);
+    }
+
+    // Typed builders
+    template<typename vertex>
+    vertex* BuildQuad(vertex* Vertices, vertex* End) { return BuildQuadT(traits_output<vertex>(), Vertices, End); }
+    template<typename vertex>
+    vertex* BuildCube(vertex* Vertices, vertex* End) { return BuildCubeT(traits_output<vertex>(), Vertices, End); }
+    template<typename vertex>
+    vertex* BuildInvertedCube(vertex* Vertices, vertex* End) { return BuildInvertedCubeT(traits_output<vertex>(), Vertices, End); }
+    template<typename vertex>
+    vertex* BuildSphere(vertex* Vertices, vertex* End, int Lon, int Lat) { return BuildSphereT(traits_output<vertex>(), Vertices, End, Lon, Lat); }
+    template<typename vertex>
+    vertex* LoadObj(vertex* Vertices, vertex* End, const char* Filename, float Scale) { return LoadObjT(traits_output<vertex>(), Vertices, End, Filename, Scale); }
+}
@@ -0,0 +1,574 @@
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "maths.h"
+#include "jobs.h"
+#include "simd.h"
+#include "mesh_bvh.h"
+
+// ================================================================================================
+// BUILD
+// ================================================================================================
+// Nodes are built one tree level at a time: the nodes of a level own disjoint triangle ranges, so they
+// are split in parallel (the first levels have few nodes, the binning of their triangles is parallel instead).
+
+static const int BVH_BIN_COUNT = 16;
+static const int BVH_MAX_LEAF_TRIANGLES = 4;  // Larger leaves are always split
+static const int BVH_MAX_DEPTH = 64;          // Deeper nodes use median splits (keeps the traversal stack bounded)
+static const float BVH_TRAVERSAL_COST = 1.f;  // Relative to a triangle test
+static const int BVH_PARALLEL_BINNING_MIN_TRIANGLES = 16 * 1024;
+
+struct bvh_aabb
+{
+    v3 Min;
+    v3 Max;
+
+    static bvh_aabb Empty() { return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } }; }
+
+    void Grow(v3 Point)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            Min.e[i] = Math::Min(Min.e[i], Point.e[i]);
+            Max.e[i] = Math::Max(Max.e[i], Point.e[i]);
+        }
+    }
+
+    void Grow(const bvh_aabb& Box)
+    {
+        Grow(Box.Min);
+        Grow(Box.Max);
+    }
+
+    // Half the surface area (the SAH only uses ratios)
+    float Area() const
+    {
+        v3 Extent = Max - Min;
+        if (Extent.x < 0.f)
+            return 0.f;
+        return Extent.x * Extent.y + Extent.y * Extent.z + Extent.z * Extent.x;
+    }
+};
+
+struct bvh_bin
+{
+    bvh_aabb Bounds;
+    bvh_aabb CentroidBounds;
+    int Count;
+};
+
+struct bvh_bins
+{
+    bvh_bin Bins[3][BVH_BIN_COUNT];
+
+    void Reset()
+    {
+        for (int Axis = 0; Axis < 3; ++Axis)
+            for (bvh_bin& Bin : Bins[Axis])
+                Bin = { bvh_aabb::Empty(), bvh_aabb::Empty(), 0 };
+    }
+};
+
+// Node waiting to be split
+struct bvh_task
+{
+    uint32_t Node;
+    uint32_t First;
+    uint32_t Count;
+    int Depth;
+    bvh_aabb CentroidBounds;
+};
+
+struct bvh_split_result
+{
+    bool Leaf;
+    uint32_t LeftCount;
+    bvh_aabb Bounds[2];
+    bvh_aabb CentroidBounds[2];
+};
+
+struct bvh_builder
+{
+    std::vector<bvh_aabb> TriangleBounds;
+    std::vector<v3> Centroids;
+    std::vector<uint32_t> Order; // Triangles sorted by node
+    std::vector<bvh_node>* Nodes;
+};
+
+static int GetBinIndex(float Value, float Min, float Scale)
+{
+    return Math::Clamp((int)((Value - Min) * Scale), 0, BVH_BIN_COUNT - 1);
+}
+
+static void GetBinScales(const bvh_aabb& CentroidBounds, float* Scales)
+{
+    for (int Axis = 0; Axis < 3; ++Axis)
+    {
+        float Extent = CentroidBounds.Max.e[Axis] - CentroidBounds.Min.e[Axis];
+        Scales[Axis] = (Extent > 0.f) ? BVH_BIN_COUNT / Extent : 0.f;
+    }
+}
+
+static void BinTriangles(const bvh_builder& Builder, const uint32_t* Order, int Count, const bvh_aabb& CentroidBounds, bvh_bins& Bins)
+{
+    float Scales[3];
+    GetBinScales(CentroidBounds, Scales);
+    Bins.Reset();
+    for (int i = 0; i < Count; ++i)
+    {
+        uint32_t Triangle = Order[i];
+        v3 Centroid = Builder.Centroids[Triangle];
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            bvh_bin& Bin = Bins.Bins[Axis][GetBinIndex(Centroid.e[Axis], CentroidBounds.Min.e[Axis], Scales[Axis])];
+            Bin.Bounds.Grow(Builder.TriangleBounds[Triangle]);
+            Bin.CentroidBounds.Grow(Centroid);
+            Bin.Count++;
+        }
+    }
+}
+
+static void BinTrianglesParallel(const bvh_builder& Builder, const uint32_t* Order, int Count, const bvh_aabb& CentroidBounds, bvh_bins& Bins)
+{
+    int ChunkCount = Jobs::GetThreadCount() * 4;
+    std::vector<bvh_bins> ChunkBins(ChunkCount);
+    Jobs::ParallelFor(ChunkCount, [&](int ChunkId)
+    {
+        int First = (int)((int64_t)Count * ChunkId / ChunkCount);
+        int Last = (int)((int64_t)Count * (ChunkId + 1) / ChunkCount);
+        BinTriangles(Builder, Order + First, Last - First, CentroidBounds, ChunkBins[ChunkId]);
+    });
+
+    Bins.Reset();
+    for (const bvh_bins& Chunk : ChunkBins)
+    {
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            for (int i = 0; i < BVH_BIN_COUNT; ++i)
+            {
+                bvh_bin& Bin = Bins.Bins[Axis][i];
+                Bin.Bounds.Grow(Chunk.Bins[Axis][i].Bounds);
+                Bin.CentroidBounds.Grow(Chunk.Bins[Axis][i].CentroidBounds);
+                Bin.Count += Chunk.Bins[Axis][i].Count;
+            }
+        }
+    }
+}
+
+// Fallback when the SAH finds no split: halves along the longest centroid axis
+static void SplitMedian(bvh_builder& Builder, const bvh_task& Task, bvh_split_result& Result)
+{
+    uint32_t* Order = &Builder.Order[Task.First];
+    v3 Extent = Task.CentroidBounds.Max - Task.CentroidBounds.Min;
+    int Axis = (Extent.x >= Extent.y && Extent.x >= Extent.z) ? 0 : (Extent.y >= Extent.z ? 1 : 2);
+
+    uint32_t Half = Task.Count / 2;
+    std::nth_element(Order, Order + Half, Order + Task.Count, [&](uint32_t A, uint32_t B)
+    {
+        return Builder.Centroids[A].e[Axis] < Builder.Centroids[B].e[Axis];
+    });
+
+    Result.LeftCount = Half;
+    for (int Side = 0; Side < 2; ++Side)
+    {
+        Result.Bounds[Side] = Result.CentroidBounds[Side] = bvh_aabb::Empty();
+        uint32_t First = Side ? Half : 0;
+        uint32_t Last = Side ? Task.Count : Half;
+        for (uint32_t i = First; i < Last; ++i)
+        {
+            Result.Bounds[Side].Grow(Builder.TriangleBounds[Order[i]]);
+            Result.CentroidBounds[Side].Grow(Builder.Centroids[Order[i]]);
+        }
+    }
+}
+
+static bvh_split_result SplitNode(bvh_builder& Builder, const bvh_task& Task, bool ParallelBinning)
+{
+    bvh_split_result Result = {};
+    Result.Leaf = true;
+    if (Task.Count <= 1)
+        return Result;
+
+    if (Task.Depth >= BVH_MAX_DEPTH)
+    {
+        Result.Leaf = false;
+        SplitMedian(Builder, Task, Result);
+        return Result;
+    }
+
+    bvh_bins Bins;
+    if (ParallelBinning && Task.Count >= (uint32_t)BVH_PARALLEL_BINNING_MIN_TRIANGLES)
+        BinTrianglesParallel(Builder, &Builder.Order[Task.First], Task.Count, Task.CentroidBounds, Bins);
+    else
+        BinTriangles(Builder, &Builder.Order[Task.First], Task.Count, Task.CentroidBounds, Bins);
+
+    // Sweep the bins of each axis (right to left then left to right) to evaluate every split plane
+    const bvh_node& Node = (*Builder.Nodes)[Task.Node];
+    float NodeArea = bvh_aabb{ Node.BoundsMin, Node.BoundsMax }.Area();
+    float BestCost = (float)Task.Count;
+    int BestAxis = -1;
+    int BestBin = 0;
+    for (int Axis = 0; Axis < 3; ++Axis)
+    {
+        if (Task.CentroidBounds.Max.e[Axis] <= Task.CentroidBounds.Min.e[Axis])
+            continue;
+
+        const bvh_bin* AxisBins = Bins.Bins[Axis];
+        float RightCosts[BVH_BIN_COUNT];
+        bvh_aabb Right = bvh_aabb::Empty();
+        int RightCount = 0;
+        for (int i = BVH_BIN_COUNT - 1; i > 0; --i)
+        {
+            Right.Grow(AxisBins[i].Bounds);
+            RightCount += AxisBins[i].Count;
+            RightCosts[i] = Right.Area() * RightCount;
+        }
+
+        bvh_aabb Left = bvh_aabb::Empty();
+        int LeftCount = 0;
+        for (int i = 0; i < BVH_BIN_COUNT - 1; ++i)
+        {
+            Left.Grow(AxisBins[i].Bounds);
+            LeftCount += AxisBins[i].Count;
+            if (LeftCount == 0 || LeftCount == (int)Task.Count)
+                continue;
+
+            float Cost = BVH_TRAVERSAL_COST + (NodeArea > 0.f ? (Left.Area() * LeftCount + RightCosts[i + 1]) / NodeArea : (float)Task.Count);
+            if (Cost < BestCost)
+            {
+                BestCost = Cost;
+                BestAxis = Axis;
+                BestBin = i;
+            }
+        }
+    }
+
+    if (BestAxis < 0)
+    {
+        if (Task.Count > (uint32_t)BVH_MAX_LEAF_TRIANGLES)
+        {
+            Result.Leaf = false;
+            SplitMedian(Builder, Task, Result);
+        }
+        return Result;
+    }
+
+    // Partition with the same bin computation than the binning
+    float Scales[3];
+    GetBinScales(Task.CentroidBounds, Scales);
+    float Min = Task.CentroidBounds.Min.e[BestAxis];
+    float Scale = Scales[BestAxis];
+    uint32_t* Order = &Builder.Order[Task.First];
+    uint32_t* Middle = std::partition(Order, Order + Task.Count, [&](uint32_t Triangle)
+    {
+        return GetBinIndex(Builder.Centroids[Triangle].e[BestAxis], Min, Scale) <= BestBin;
+    });
+
+    Result.Leaf = false;
+    Result.LeftCount = (uint32_t)(Middle - Order);
+    for (int Side = 0; Side < 2; ++Side)
+    {
+        Result.Bounds[Side] = Result.CentroidBounds[Side] = bvh_aabb::Empty();
+        int First = Side ? BestBin + 1 : 0;
+        int Last = Side ? BVH_BIN_COUNT : BestBin + 1;
+        for (int i = First; i < Last; ++i)
+        {
+            Result.Bounds[Side].Grow(Bins.Bins[BestAxis][i].Bounds);
+            Result.CentroidBounds[Side].Grow(Bins.Bins[BestAxis][i].CentroidBounds);
+        }
+    }
+    return Result;
+}
+
+// GetPosition(Corner) returns the position of the corner Corner % 3 of the triangle Corner / 3
+template <typename F>
+static void BuildBvhT(mesh_bvh& Bvh, int TriangleCount, const F& GetPosition)
+{
+    Bvh.Nodes.clear();
+    Bvh.Positions.clear();
+    Bvh.TriangleIds.clear();
+    if (TriangleCount == 0)
+        return;
+
+    bvh_builder Builder;
+    Builder.TriangleBounds.resize(TriangleCount);
+    Builder.Centroids.resize(TriangleCount);
+    Builder.Order.resize(TriangleCount);
+    Builder.Nodes = &Bvh.Nodes;
+    Jobs::ParallelFor(TriangleCount / 1024 + 1, [&](int ChunkId)
+    {
+        int Last = Math::Min(TriangleCount, (ChunkId + 1) * 1024);
+        for (int i = ChunkId * 1024; i < Last; ++i)
+        {
+            bvh_aabb Bounds = bvh_aabb::Empty();
+            for (int j = 0; j < 3; ++j)
+                Bounds.Grow(GetPosition(i * 3 + j));
+            Builder.TriangleBounds[i] = Bounds;
+            Builder.Centroids[i] = (Bounds.Min + Bounds.Max) * 0.5f;
+            Builder.Order[i] = i;
+        }
+    });
+
+    bvh_aabb RootBounds = bvh_aabb::Empty();
+    bvh_aabb RootCentroidBounds = bvh_aabb::Empty();
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        RootBounds.Grow(Builder.TriangleBounds[i]);
+        RootCentroidBounds.Grow(Builder.Centroids[i]);
+    }
+
+    Bvh.Nodes.reserve(TriangleCount * 2 / BVH_MAX_LEAF_TRIANGLES + 1);
+    Bvh.Nodes.push_back({ RootBounds.Min, 0, RootBounds.Max, (uint32_t)TriangleCount });
+
+    std::vector<bvh_task> Level = { { 0, 0, (uint32_t)TriangleCount, 0, RootCentroidBounds } };
+    std::vector<bvh_task> NextLevel;
+    std::vector<bvh_split_result> Results;
+    while (!Level.empty())
+    {
+        Results.resize(Level.size());
+        if ((int)Level.size() < Jobs::GetThreadCount())
+        {
+            for (int i = 0; i < (int)Level.size(); ++i)
+                Results[i] = SplitNode(Builder, Level[i], true);
+        }
+        else
+        {
+            Jobs::ParallelFor((int)Level.size(), [&](int i) { Results[i] = SplitNode(Builder, Level[i], false); });
+        }
+
+        // Children are allocated in pairs, in level order
+        NextLevel.clear();
+        for (int i = 0; i < (int)Level.size(); ++i)
+        {
+            const bvh_task& Task = Level[i];
+            const bvh_split_result& Result = Results[i];
+            if (Result.Leaf)
+            {
+                Bvh.Nodes[Task.Node].Index = Task.First;
+                Bvh.Nodes[Task.Node].Count = Task.Count;
+                continue;
+            }
+
+            uint32_t Child = (uint32_t)Bvh.Nodes.size();
+            Bvh.Nodes[Task.Node].Index = Child;
+            Bvh.Nodes[Task.Node].Count = 0;
+            for (int Side = 0; Side < 2; ++Side)
+            {
+                uint32_t First = Side ? Task.First + Result.LeftCount : Task.First;
+                uint32_t Count = Side ? Task.Count - Result.LeftCount : Result.LeftCount;
+                Bvh.Nodes.push_back({ Result.Bounds[Side].Min, 0, Result.Bounds[Side].Max, Count });
+                NextLevel.push_back({ Child + Side, First, Count, Task.Depth + 1, Result.CentroidBounds[Side] });
+            }
+        }
+        Level.swap(NextLevel);
+    }
+
+    // Triangles in leaf order
+    Bvh.TriangleIds = Builder.Order;
+    Bvh.Positions.resize(TriangleCount * 3);
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+            Bvh.Positions[i * 3 + j] = GetPosition(Bvh.TriangleIds[i] * 3 + j);
+    }
+}
+
+void Mesh::BuildBvh(mesh_bvh& Bvh, const vertex_full* Vertices, int VertexCount)
+{
+    BuildBvhT(Bvh, VertexCount / 3, [Vertices](uint32_t Corner) { return Vertices[Corner].Position; });
+}
+
+void Mesh::BuildBvh(mesh_bvh& Bvh, const vertex_full* Vertices, const uint32_t* Indices, int IndexCount)
+{
+    BuildBvhT(Bvh, IndexCount / 3, [Vertices, Indices](uint32_t Corner) { return Vertices[Indices[Corner]].Position; });
+}
+
+// ================================================================================================
+// TRAVERSAL
+// ================================================================================================
+struct bvh_ray
+{
+    v3 Origin;
+    v3 Direction;
+    v3 InvDirection;
+};
+
+// Returns the mask of the 4 boxes hit before MaxDistance (and their entry distances)
+static int IntersectBoxes4(const bvh_node* const* Boxes, const bvh_ray& Ray, float MaxDistance, float* Distances)
+{
+#if SIMD_X86
+    __m128 Near = _mm_setzero_ps();
+    __m128 Far = _mm_set1_ps(MaxDistance);
+    for (int Axis = 0; Axis < 3; ++Axis)
+    {
+        __m128 Min = _mm_setr_ps(Boxes[0]->BoundsMin.e[Axis], Boxes[1]->BoundsMin.e[Axis], Boxes[2]->BoundsMin.e[Axis], Boxes[3]->BoundsMin.e[Axis]);
+        __m128 Max = _mm_setr_ps(Boxes[0]->BoundsMax.e[Axis], Boxes[1]->BoundsMax.e[Axis], Boxes[2]->BoundsMax.e[Axis], Boxes[3]->BoundsMax.e[Axis]);
+        __m128 Origin = _mm_set1_ps(Ray.Origin.e[Axis]);
+        __m128 InvDirection = _mm_set1_ps(Ray.InvDirection.e[Axis]);
+        __m128 T0 = _mm_mul_ps(_mm_sub_ps(Min, Origin), InvDirection);
+        __m128 T1 = _mm_mul_ps(_mm_sub_ps(Max, Origin), InvDirection);
+        Near = _mm_max_ps(Near, _mm_min_ps(T0, T1));
+        Far = _mm_min_ps(Far, _mm_max_ps(T0, T1));
+    }
+    _mm_storeu_ps(Distances, Near);
+    return _mm_movemask_ps(_mm_cmple_ps(Near, Far));
+#else
+    int Mask = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        float Near = 0.f;
+        float Far = MaxDistance;
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            float T0 = (Boxes[i]->BoundsMin.e[Axis] - Ray.Origin.e[Axis]) * Ray.InvDirection.e[Axis];
+            float T1 = (Boxes[i]->BoundsMax.e[Axis] - Ray.Origin.e[Axis]) * Ray.InvDirection.e[Axis];
+            Near = Math::Max(Near, Math::Min(T0, T1));
+            Far = Math::Min(Far, Math::Max(T0, T1));
+        }
+        Distances[i] = Near;
+        Mask |= (Near <= Far) << i;
+    }
+    return Mask;
+#endif
+}
+
+// Moller-Trumbore (double sided)
+static bool IntersectTriangle(const bvh_ray& Ray, const v3* P, float MaxDistance, ray_hit* Hit)
+{
+    v3 Edge1 = P[1] - P[0];
+    v3 Edge2 = P[2] - P[0];
+    v3 PVec = Vec3::Cross(Ray.Direction, Edge2);
+    float Det = Vec3::Dot(Edge1, PVec);
+    if (Det == 0.f)
+        return false;
+
+    float InvDet = 1.f / Det;
+    v3 TVec = Ray.Origin - P[0];
+    float U = Vec3::Dot(TVec, PVec) * InvDet;
+    if (U < 0.f || U > 1.f)
+        return false;
+
+    v3 QVec = Vec3::Cross(TVec, Edge1);
+    float V = Vec3::Dot(Ray.Direction, QVec) * InvDet;
+    if (V < 0.f || U + V > 1.f)
+        return false;
+
+    float Distance = Vec3::Dot(Edge2, QVec) * InvDet;
+    if (Distance < 0.f || Distance >= MaxDistance)
+        return false;
+
+    Hit->Distance = Distance;
+    Hit->U = U;
+    Hit->V = V;
+    return true;
+}
+
+template<bool AnyHit>
+static bool RaycastT(const mesh_bvh& Bvh, v3 Origin, v3 Direction, float MaxDistance, ray_hit* Hit)
+{
+    if (Bvh.Nodes.empty())
+        return false;
+
+    bvh_ray Ray = { Origin, Direction, { 1.f / Direction.x, 1.f / Direction.y, 1.f / Direction.z } };
+    bool Found = false;
+    Hit->Distance = MaxDistance;
+
+    struct stack_entry
+    {
+        uint32_t Node;
+        float Distance; // Entry distance of the node box
+    };
+    stack_entry Stack[4 * BVH_MAX_DEPTH + 64];
+    int StackSize = 0;
+
+    // The root is tested like its children (padded to 4 boxes)
+    const bvh_node* Nodes = Bvh.Nodes.data();
+    const bvh_node* Boxes[4] = { &Nodes[0], &Nodes[0], &Nodes[0], &Nodes[0] };
+    float Distances[4];
+    if ((IntersectBoxes4(Boxes, Ray, MaxDistance, Distances) & 1) == 0)
+        return false;
+    Stack[StackSize++] = { 0, Distances[0] };
+
+    while (StackSize > 0)
+    {
+        // Pop up to 2 nodes that can still hold a closer hit and test their boxes (or children boxes) at once
+        int BoxCount = 0;
+        for (int Popped = 0; Popped < 2 && StackSize > 0;)
+        {
+            const stack_entry& Entry = Stack[--StackSize];
+            if (Entry.Distance > Hit->Distance)
+                continue;
+
+            const bvh_node& Node = Nodes[Entry.Node];
+            if (Node.Count > 0)
+            {
+                // Leaf root
+                Boxes[BoxCount++] = &Node;
+            }
+            else
+            {
+                Boxes[BoxCount++] = &Nodes[Node.Index];
+                Boxes[BoxCount++] = &Nodes[Node.Index + 1];
+            }
+            Popped++;
+        }
+        if (BoxCount == 0)
+            break;
+        for (int i = BoxCount; i < 4; ++i)
+            Boxes[i] = Boxes[0];
+
+        int Mask = IntersectBoxes4(Boxes, Ray, Hit->Distance, Distances) & ((1 << BoxCount) - 1);
+
+        // Leaves are intersected right away (shortens the ray), inner nodes are pushed far to near
+        int InnerNodes[4];
+        int InnerCount = 0;
+        for (int i = 0; i < BoxCount; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                continue;
+
+            const bvh_node& Node = *Boxes[i];
+            if (Node.Count == 0)
+            {
+                int j = InnerCount++;
+                for (; j > 0 && Distances[InnerNodes[j - 1]] < Distances[i]; --j)
+                    InnerNodes[j] = InnerNodes[j - 1];
+                InnerNodes[j] = i;
+                continue;
+            }
+
+            for (uint32_t Triangle = Node.Index; Triangle < Node.Index + Node.Count; ++Triangle)
+            {
+                if (IntersectTriangle(Ray, &Bvh.Positions[Triangle * 3], Hit->Distance, Hit))
+                {
+                    Hit->TriangleId = Bvh.TriangleIds[Triangle];
+                    Found = true;
+                    if (AnyHit)
+                        return true;
+                }
+            }
+        }
+
+        for (int i = 0; i < InnerCount; ++i)
+        {
+            assert(StackSize < (int)(sizeof(Stack) / sizeof(Stack[0])));
+            Stack[StackSize++] = { (uint32_t)(Boxes[InnerNodes[i]] - Nodes), Distances[InnerNodes[i]] };
+        }
+    }
+
+    return Found;
+}
+
+bool Mesh::Raycast(const mesh_bvh& Bvh, v3 Origin, v3 Direction, float MaxDistance, ray_hit* Hit)
+{
+    return RaycastT<false>(Bvh, Origin, Direction, MaxDistance, Hit);
+}
+
+bool Mesh::RaycastAny(const mesh_bvh& Bvh, v3 Origin, v3 Direction, float MaxDistance)
+{
+    ray_hit Hit;
+    return RaycastT<true>(Bvh, Origin, Direction, MaxDistance, &Hit);
+}
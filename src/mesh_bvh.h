@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "mesh.h"
+
+// Bounding volume hierarchy over a triangle list (binary tree, binned SAH build)
+struct bvh_node
+{
+    v3 BoundsMin;
+    uint32_t Index; // First child (inner node, the two children are adjacent) or first triangle (leaf)
+    v3 BoundsMax;
+    uint32_t Count; // Triangle count (0 for inner nodes)
+};
+static_assert(sizeof(bvh_node) == 32, "bvh_node must stay 32 bytes");
+
+struct mesh_bvh
+{
+    std::vector<bvh_node> Nodes;       // Nodes[0] is the root
+    std::vector<v3> Positions;         // 3 per triangle, in leaf order
+    std::vector<uint32_t> TriangleIds; // Source triangle of each leaf triangle
+};
+
+struct ray_hit
+{
+    float Distance;      // In units of the ray direction length
+    uint32_t TriangleId; // Source triangle
+    float U, V;          // Barycentric coordinates of the hit point (relative to the 2nd and 3rd vertices)
+};
+
+namespace Mesh
+{
+
+// Vertices is a triangle list (as given by Mesh::LoadObjNoConvertion), the build is multithreaded
+void BuildBvh(mesh_bvh& Bvh, const vertex_full* Vertices, int VertexCount);
+// Indexed triangle list, the triangle ids follow the index order (Indices[TriangleId * 3] is the first corner)
+void BuildBvh(mesh_bvh& Bvh, const vertex_full* Vertices, const uint32_t* Indices, int IndexCount);
+// Closest hit in [0, MaxDistance] (triangles are double sided)
+bool Raycast(const mesh_bvh& Bvh, v3 Origin, v3 Direction, float MaxDistance, ray_hit* Hit);
+// Any hit in [0, MaxDistance] (occlusion queries)
+bool RaycastAny(const mesh_bvh& Bvh, v3 Origin, v3 Direction, float MaxDistance);
+}
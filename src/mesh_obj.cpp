@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+#include "maths.h"
+#include "file.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "process_info.h"
+
+// ================================================================================================
+// TINYOBJ PARSER
+// ================================================================================================
+static bool ParseObjTinyObj(std::vector<vertex_full>& Mesh, const char* Filename, bool* HasNormalsOut, bool* HasTexCoordsOut, std::vector<uint32_t>& ShapeOffsets)
+{
+    std::string Warn;
+    std::string Err;
+    tinyobj::attrib_t Attrib;
+    std::vector<tinyobj::shape_t> Shapes;
+
+    tinyobj::LoadObj(&Attrib, &Shapes, nullptr, &Warn, &Err, Filename, "media/", true);
+    if (!Err.empty())
+    {
+        fprintf(stderr, "Warning loading obj: %s\n", Err.c_str());
+    }
+    if (!Err.empty())
+    {
+        fprintf(stderr, "Error loading obj: %s\n", Err.c_str());
+        return false;
+    }
+
+    bool HasNormals = !Attrib.normals.empty();
+    bool HasTexCoords = !Attrib.texcoords.empty();
+
+    // Build all meshes
+    size_t IndexCount = 0;
+    for (const tinyobj::shape_t& Shape : Shapes)
+        IndexCount += Shape.mesh.indices.size();
+    Mesh.reserve(IndexCount);
+
+    for (int MeshId = 0; MeshId < (int)Shapes.size(); ++MeshId)
+    {
+        const tinyobj::mesh_t& MeshDef = Shapes[MeshId].mesh;
+        ShapeOffsets.push_back((uint32_t)Mesh.size());
+
+        int IndexId = 0;
+        for (int FaceId = 0; FaceId < (int)MeshDef.num_face_vertices.size(); ++FaceId)
+        {
+            int FaceVertices = MeshDef.num_face_vertices[FaceId];
+            assert(FaceVertices == 3);
+
+            for (int j = 0; j < FaceVertices; ++j)
+            {
+                const tinyobj::index_t& Index = MeshDef.indices[IndexId];
+                vertex_full V = {};
+                V.Position = {
+                    Attrib.vertices[Index.vertex_index * 3 + 0],
+                    Attrib.vertices[Index.vertex_index * 3 + 1],
+                    Attrib.vertices[Index.vertex_index * 3 + 2]
+                };
+
+                if (HasNormals)
+                {
+                    V.Normal = {
+                        Attrib.normals[Index.normal_index * 3 + 0],
+                        Attrib.normals[Index.normal_index * 3 + 1],
+                        Attrib.normals[Index.normal_index * 3 + 2]
+                    };
+                }
+
+                if (HasTexCoords)
+                {
+                    V.UV = {
+                        Attrib.texcoords[Index.texcoord_index * 2 + 0],
+                        Attrib.texcoords[Index.texcoord_index * 2 + 1]
+                    };
+                }
+
+                Mesh.push_back(V);
+
+                IndexId++;
+            }
+        }
+    }
+
+    *HasNormalsOut = HasNormals;
+    *HasTexCoordsOut = HasTexCoords;
+    return true;
+}
+
+// ================================================================================================
+// PARALLEL PARSER
+// ================================================================================================
+// The file is mapped and split in line-aligned chunks parsed independently.
+// Relative (negative) indices are resolved once the attribute counts of the previous chunks are known.
+
+enum obj_attribute
+{
+    OBJ_POSITION,
+    OBJ_UV,
+    OBJ_NORMAL,
+    OBJ_ATTRIBUTE_COUNT
+};
+
+struct obj_corner
+{
+    int Index[OBJ_ATTRIBUTE_COUNT]; // -1 if missing
+    int RelativeMask;              // Bit set if the index is relative to the start of the chunk
+};
+
+struct obj_chunk
+{
+    const char* Begin;
+    const char* End;
+
+    std::vector<float> Attributes[OBJ_ATTRIBUTE_COUNT];
+    std::vector<obj_corner> Corners; // Triangulated faces
+    std::vector<int> ShapeStarts;    // Corner count at each 'o' or 'g' statement
+    int AttributeBase[OBJ_ATTRIBUTE_COUNT]; // Attributes count of previous chunks
+    int FirstCorner;                        // Corner count of previous chunks
+};
+
+static const int gObjAttributeSize[OBJ_ATTRIBUTE_COUNT] = { 3, 2, 3 };
+
+static bool IsDigit(char C) { return C >= '0' && C <= '9'; }
+static bool IsSpace(char C) { return C == ' ' || C == '\t'; }
+
+// Same algorithm as tinyobj's tryParseDouble to get bit exact results
+static float ParseFloat(const char*& Cur, const char* End)
+{
+    while (Cur < End && IsSpace(*Cur))
+        Cur++;
+
+    double Sign = 1.0;
+    if (Cur < End && (*Cur == '+' || *Cur == '-'))
+        Sign = (*Cur++ == '-') ? -1.0 : 1.0;
+
+    double Mantissa = 0.0;
+    while (Cur < End && IsDigit(*Cur))
+        Mantissa = Mantissa * 10 + (*Cur++ - '0');
+
+    if (Cur < End && *Cur == '.')
+    {
+        static const double PowLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        Cur++;
+        for (int Read = 1; Cur < End && IsDigit(*Cur); ++Read)
+            Mantissa += (*Cur++ - '0') * (Read < 8 ? PowLut[Read] : std::pow(10.0, -Read));
+    }
+
+    int Exponent = 0;
+    if (Cur < End && (*Cur == 'e' || *Cur == 'E'))
+    {
+        Cur++;
+        int ExponentSign = 1;
+        if (Cur < End && (*Cur == '+' || *Cur == '-'))
+            ExponentSign = (*Cur++ == '-') ? -1 : 1;
+        while (Cur < End && IsDigit(*Cur))
+            Exponent = Exponent * 10 + (*Cur++ - '0');
+        Exponent *= ExponentSign;
+    }
+
+    // Skip unknown characters (e.g. "nan") until the next separator
+    while (Cur < End && !IsSpace(*Cur) && *Cur != '\r' && *Cur != '\n')
+        Cur++;
+
+    return (float)(Sign * (Exponent ? std::ldexp(Mantissa * std::pow(5.0, Exponent), Exponent) : Mantissa));
+}
+
+static int ParseInt(const char*& Cur, const char* End)
+{
+    int Sign = 1;
+    if (Cur < End && (*Cur == '+' || *Cur == '-'))
+        Sign = (*Cur++ == '-') ? -1 : 1;
+
+    int Value = 0;
+    while (Cur < End && IsDigit(*Cur))
+        Value = Value * 10 + (*Cur++ - '0');
+    return Sign * Value;
+}
+
+// Parse "v", "v/t", "v//n" or "v/t/n"
+// LocalCount holds the attribute counts used to resolve relative indices
+static bool ParseCorner(const char*& Cur, const char* End, const int* LocalCount, obj_corner* Corner)
+{
+    while (Cur < End && IsSpace(*Cur))
+        Cur++;
+    if (Cur == End || !(IsDigit(*Cur) || *Cur == '-' || *Cur == '+'))
+        return false;
+
+    *Corner = {};
+    for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+    {
+        Corner->Index[Attribute] = -1;
+        if (Attribute > 0)
+        {
+            if (Cur == End || *Cur != '/')
+                continue;
+            Cur++;
+        }
+
+        if (Cur == End || !(IsDigit(*Cur) || *Cur == '-' || *Cur == '+'))
+            continue;
+
+        int Index = ParseInt(Cur, End);
+        if (Index > 0)
+        {
+            Corner->Index[Attribute] = Index - 1;
+        }
+        else if (Index < 0)
+        {
+            Corner->Index[Attribute] = LocalCount[Attribute] + Index;
+            Corner->RelativeMask |= 1 << Attribute;
+        }
+    }
+    return true;
+}
+
+static void ParseObjChunk(obj_chunk& Chunk)
+{
+    const char* Cur = Chunk.Begin;
+    const char* End = Chunk.End;
+
+    while (Cur < End)
+    {
+        const char* LineEnd = Cur;
+        while (LineEnd < End && *LineEnd != '\n')
+            LineEnd++;
+
+        while (Cur < LineEnd && IsSpace(*Cur))
+            Cur++;
+
+        if (LineEnd - Cur > 2 && Cur[0] == 'v')
+        {
+            int Attribute = -1;
+            if (IsSpace(Cur[1]))                     { Attribute = OBJ_POSITION; Cur += 2; }
+            else if (Cur[1] == 't' && IsSpace(Cur[2])) { Attribute = OBJ_UV;       Cur += 3; }
+            else if (Cur[1] == 'n' && IsSpace(Cur[2])) { Attribute = OBJ_NORMAL;   Cur += 3; }
+
+            if (Attribute >= 0)
+            {
+                std::vector<float>& Values = Chunk.Attributes[Attribute];
+                for (int i = 0; i < gObjAttributeSize[Attribute]; ++i)
+                    Values.push_back(ParseFloat(Cur, LineEnd));
+            }
+        }
+        else if (LineEnd - Cur >= 1 && (Cur[0] == 'o' || Cur[0] == 'g') && (LineEnd - Cur == 1 || IsSpace(Cur[1]) || Cur[1] == '\r'))
+        {
+            Chunk.ShapeStarts.push_back((int)Chunk.Corners.size());
+        }
+        else if (LineEnd - Cur > 2 && Cur[0] == 'f' && IsSpace(Cur[1]))
+        {
+            // Triangulate as a fan
+            Cur += 2;
+            int LocalCount[OBJ_ATTRIBUTE_COUNT];
+            for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+                LocalCount[Attribute] = (int)Chunk.Attributes[Attribute].size() / gObjAttributeSize[Attribute];
+
+            obj_corner First, Previous, Corner;
+            int CornerCount = 0;
+            while (ParseCorner(Cur, LineEnd, LocalCount, &Corner))
+            {
+                if (CornerCount == 0)
+                    First = Corner;
+                else if (CornerCount >= 2)
+                {
+                    Chunk.Corners.push_back(First);
+                    Chunk.Corners.push_back(Previous);
+                    Chunk.Corners.push_back(Corner);
+                }
+                Previous = Corner;
+                CornerCount++;
+            }
+        }
+
+        Cur = LineEnd + 1;
+    }
+}
+
+static bool ParseObjParallel(std::vector<vertex_full>& Mesh, const char* Filename, bool* HasNormalsOut, bool* HasTexCoordsOut, std::vector<uint32_t>& ShapeOffsets)
+{
+    file_mapping Mapping;
+    if (!File::Map(&Mapping, Filename))
+    {
+        fprintf(stderr, "Error loading obj: Cannot open file [%s]\n", Filename);
+        return false;
+    }
+
+    // Split file in line-aligned chunks (several per thread to balance the work)
+    const char* FileBegin = (const char*)Mapping.Data;
+    const char* FileEnd = FileBegin + Mapping.Size;
+    const size_t MinChunkSize = 64 * 1024;
+    int ChunkCount = (int)Math::Min<size_t>(Jobs::GetThreadCount() * 8, Mapping.Size / MinChunkSize + 1);
+
+    std::vector<obj_chunk> Chunks(ChunkCount);
+    const char* Cur = FileBegin;
+    for (int i = 0; i < ChunkCount; ++i)
+    {
+        const char* ChunkEnd = (i == ChunkCount - 1) ? FileEnd : Math::Max(Cur, FileBegin + Mapping.Size * (i + 1) / ChunkCount);
+        while (ChunkEnd < FileEnd && ChunkEnd[-1] != '\n')
+            ChunkEnd++;
+        Chunks[i].Begin = Cur;
+        Chunks[i].End = ChunkEnd;
+        Cur = ChunkEnd;
+    }
+
+    Jobs::ParallelFor(ChunkCount, [&](int ChunkId) { ParseObjChunk(Chunks[ChunkId]); });
+
+    // Prefix sums to place each chunk inside the merged arrays
+    int AttributeCount[OBJ_ATTRIBUTE_COUNT] = {};
+    int CornerCount = 0;
+    for (obj_chunk& Chunk : Chunks)
+    {
+        for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+        {
+            Chunk.AttributeBase[Attribute] = AttributeCount[Attribute];
+            AttributeCount[Attribute] += (int)Chunk.Attributes[Attribute].size() / gObjAttributeSize[Attribute];
+        }
+        Chunk.FirstCorner = CornerCount;
+        CornerCount += (int)Chunk.Corners.size();
+        for (int ShapeStart : Chunk.ShapeStarts)
+            ShapeOffsets.push_back((uint32_t)(Chunk.FirstCorner + ShapeStart));
+    }
+
+    // Merge attributes in file order
+    std::vector<float> Attributes[OBJ_ATTRIBUTE_COUNT];
+    for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+        Attributes[Attribute].resize(AttributeCount[Attribute] * gObjAttributeSize[Attribute]);
+
+    Jobs::ParallelFor(ChunkCount, [&](int ChunkId)
+    {
+        obj_chunk& Chunk = Chunks[ChunkId];
+        for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+        {
+            std::vector<float>& Values = Chunk.Attributes[Attribute];
+            std::copy(Values.begin(), Values.end(), Attributes[Attribute].begin() + Chunk.AttributeBase[Attribute] * gObjAttributeSize[Attribute]);
+        }
+    });
+
+    // Expand corners into vertices
+    Mesh.resize(CornerCount);
+    Jobs::ParallelFor(ChunkCount, [&](int ChunkId)
+    {
+        const obj_chunk& Chunk = Chunks[ChunkId];
+        for (int i = 0; i < (int)Chunk.Corners.size(); ++i)
+        {
+            const obj_corner& Corner = Chunk.Corners[i];
+            float* Dst[OBJ_ATTRIBUTE_COUNT];
+            vertex_full& V = Mesh[Chunk.FirstCorner + i];
+            V = {};
+            Dst[OBJ_POSITION] = V.Position.e;
+            Dst[OBJ_UV] = V.UV.e;
+            Dst[OBJ_NORMAL] = V.Normal.e;
+
+            for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+            {
+                int Index = Corner.Index[Attribute];
+                if (Corner.RelativeMask & (1 << Attribute))
+                    Index += Chunk.AttributeBase[Attribute];
+                if (Index < 0 || Index >= AttributeCount[Attribute])
+                    continue;
+
+                int Size = gObjAttributeSize[Attribute];
+                for (int j = 0; j < Size; ++j)
+                    Dst[Attribute][j] = Attributes[Attribute][Index * Size + j];
+            }
+        }
+    });
+
+    File::Unmap(&Mapping);
+
+    *HasNormalsOut = AttributeCount[OBJ_NORMAL] > 0;
+    *HasTexCoordsOut = AttributeCount[OBJ_UV] > 0;
+    return true;
+}
+
+// ================================================================================================
+// MISSING ATTRIBUTES
+// ================================================================================================
+// Vertices are expanded triangles (Count is a multiple of 3)
+static void BuildMissingAttributes(vertex_full* Vertices, int Count, bool HasNormals, bool HasTexCoords)
+{
+    // Build normals if missing
+    if (!HasNormals)
+    {
+        for (int i = 0; i < Count; i += 3)
+        {
+            vertex_full& V0 = Vertices[i + 0];
+            vertex_full& V1 = Vertices[i + 1];
+            vertex_full& V2 = Vertices[i + 2];
+
+            v3 Normal = Vec3::Cross((V1.Position - V0.Position), (V2.Position - V0.Position));
+            V0.Normal = V1.Normal = V2.Normal = Normal;
+        }
+    }
+
+    // Build UVs if missing
+    if (!HasTexCoords)
+    {
+        // TODO: Maybe triplanar texturing can make best results
+        for (int i = 0; i < Count; ++i)
+        {
+            vertex_full& V = Vertices[i];
+
+            float Length = Vec3::Length(V.Position);
+            if (Length != 0.f)
+            {
+                v3 Pos = V.Position / Length;
+                V.UV.x = 0.5f + Math::Atan2(Pos.z, Pos.x);
+                V.UV.y = Pos.y;
+            }
+        }
+    }
+}
+
+// ================================================================================================
+// STREAMING PARSER
+// ================================================================================================
+// The file is read twice by line-aligned blocks: the first pass loads the attributes and counts the vertices,
+// the second one expands the faces by batches. Only the attributes and one block stay in memory.
+
+static const int gObjStreamBatchSize = 3 * 1024;
+
+// Call Function(Begin, End) for each block of complete lines, Buffer grows if a line is longer than a block
+template<typename function>
+static int ForEachBlock(FILE* File, std::vector<char>& Buffer, function Function)
+{
+    int BlockCount = 0;
+    size_t Used = 0; // Partial line carried over from the previous block
+    for (;;)
+    {
+        if (Used == Buffer.size())
+            Buffer.resize(Buffer.size() * 2);
+
+        size_t Read = fread(Buffer.data() + Used, 1, Buffer.size() - Used, File);
+        size_t Size = Used + Read;
+        if (Read == 0)
+        {
+            if (Size > 0)
+                Function((const char*)Buffer.data(), (const char*)Buffer.data() + Size);
+            return BlockCount + (Size > 0);
+        }
+
+        size_t LineEnd = Size;
+        while (LineEnd > 0 && Buffer[LineEnd - 1] != '\n')
+            LineEnd--;
+        if (LineEnd == 0)
+        {
+            Used = Size;
+            continue;
+        }
+
+        Function((const char*)Buffer.data(), (const char*)Buffer.data() + LineEnd);
+        BlockCount++;
+
+        Used = Size - LineEnd;
+        memmove(Buffer.data(), Buffer.data() + LineEnd, Used);
+    }
+}
+
+// Returns the attribute of a "v", "vt" or "vn" line (Cur is moved to the first value), -1 otherwise
+static int ParseAttributeType(const char*& Cur, const char* LineEnd)
+{
+    if (LineEnd - Cur <= 2 || Cur[0] != 'v')
+        return -1;
+    if (IsSpace(Cur[1]))                       { Cur += 2; return OBJ_POSITION; }
+    if (Cur[1] == 't' && IsSpace(Cur[2]))      { Cur += 3; return OBJ_UV; }
+    if (Cur[1] == 'n' && IsSpace(Cur[2]))      { Cur += 3; return OBJ_NORMAL; }
+    return -1;
+}
+
+static bool IsFaceLine(const char* Cur, const char* LineEnd)
+{
+    return LineEnd - Cur > 2 && Cur[0] == 'f' && IsSpace(Cur[1]);
+}
+
+bool Mesh::StreamObj(const char* Filename, float Scale, size_t BlockSize, const std::function<void(int VertexCount)>& Begin,
+                     const std::function<void(const vertex_full* Vertices, int Count)>& Write, obj_stream_stats* StatsOut)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    FILE* File = fopen(Filename, "rb");
+    if (File == nullptr)
+    {
+        fprintf(stderr, "Error loading obj: Cannot open file [%s]\n", Filename);
+        return false;
+    }
+
+    obj_stream_stats Stats = {};
+    Stats.StartResident = ProcessInfo::GetResidentMemory();
+    Stats.PeakResident = Stats.StartResident;
+    auto SampleMemory = [&]() { Stats.PeakResident = Math::Max(Stats.PeakResident, ProcessInfo::GetResidentMemory()); };
+
+    std::vector<char> Buffer(Math::Max<size_t>(BlockSize, 256));
+    std::vector<float> Attributes[OBJ_ATTRIBUTE_COUNT];
+    int AttributeCount[OBJ_ATTRIBUTE_COUNT] = {};
+
+    // First pass: load attributes and count the vertices of the triangulated faces
+    int VertexCount = 0;
+    Stats.BlockCount += ForEachBlock(File, Buffer, [&](const char* Cur, const char* End)
+    {
+        while (Cur < End)
+        {
+            const char* LineEnd = Cur;
+            while (LineEnd < End && *LineEnd != '\n')
+                LineEnd++;
+            while (Cur < LineEnd && IsSpace(*Cur))
+                Cur++;
+
+            int Attribute = ParseAttributeType(Cur, LineEnd);
+            if (Attribute >= 0)
+            {
+                std::vector<float>& Values = Attributes[Attribute];
+                for (int i = 0; i < gObjAttributeSize[Attribute]; ++i)
+                    Values.push_back(ParseFloat(Cur, LineEnd));
+                AttributeCount[Attribute]++;
+            }
+            else if (IsFaceLine(Cur, LineEnd))
+            {
+                Cur += 2;
+                obj_corner Corner;
+                int CornerCount = 0;
+                while (ParseCorner(Cur, LineEnd, AttributeCount, &Corner))
+                    CornerCount++;
+                VertexCount += Math::Max(CornerCount - 2, 0) * 3;
+            }
+
+            Cur = LineEnd + 1;
+        }
+        SampleMemory();
+    });
+
+    for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+        Stats.AttributeBytes += Attributes[Attribute].capacity() * sizeof(float);
+    Stats.VertexCount = VertexCount;
+    Begin(VertexCount);
+
+    bool HasNormals = AttributeCount[OBJ_NORMAL] > 0;
+    bool HasTexCoords = AttributeCount[OBJ_UV] > 0;
+
+    // Second pass: count attributes again to resolve relative indices and expand the faces
+    int LineCount[OBJ_ATTRIBUTE_COUNT] = {};
+    std::vector<vertex_full> Batch;
+    Batch.reserve(gObjStreamBatchSize);
+    int WrittenCount = 0;
+
+    auto FlushBatch = [&]()
+    {
+        BuildMissingAttributes(Batch.data(), (int)Batch.size(), HasNormals, HasTexCoords);
+        for (vertex_full& V : Batch)
+            V.Position *= Scale;
+        Write(Batch.data(), (int)Batch.size());
+        WrittenCount += (int)Batch.size();
+        Batch.clear();
+    };
+
+    auto AddVertex = [&](const obj_corner& Corner)
+    {
+        vertex_full V = {};
+        float* Dst[OBJ_ATTRIBUTE_COUNT];
+        Dst[OBJ_POSITION] = V.Position.e;
+        Dst[OBJ_UV] = V.UV.e;
+        Dst[OBJ_NORMAL] = V.Normal.e;
+
+        for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+        {
+            int Index = Corner.Index[Attribute];
+            if (Index < 0 || Index >= AttributeCount[Attribute])
+                continue;
+
+            int Size = gObjAttributeSize[Attribute];
+            for (int j = 0; j < Size; ++j)
+                Dst[Attribute][j] = Attributes[Attribute][Index * Size + j];
+        }
+        Batch.push_back(V);
+    };
+
+    rewind(File);
+    Stats.BlockCount += ForEachBlock(File, Buffer, [&](const char* Cur, const char* End)
+    {
+        while (Cur < End)
+        {
+            const char* LineEnd = Cur;
+            while (LineEnd < End && *LineEnd != '\n')
+                LineEnd++;
+            while (Cur < LineEnd && IsSpace(*Cur))
+                Cur++;
+
+            int Attribute = ParseAttributeType(Cur, LineEnd);
+            if (Attribute >= 0)
+            {
+                LineCount[Attribute]++;
+            }
+            else if (IsFaceLine(Cur, LineEnd))
+            {
+                // Triangulate as a fan
+                Cur += 2;
+                obj_corner First, Previous, Corner;
+                int CornerCount = 0;
+                while (ParseCorner(Cur, LineEnd, LineCount, &Corner))
+                {
+                    if (CornerCount == 0)
+                        First = Corner;
+                    else if (CornerCount >= 2)
+                    {
+                        if ((int)Batch.size() + 3 > gObjStreamBatchSize)
+                            FlushBatch();
+                        AddVertex(First);
+                        AddVertex(Previous);
+                        AddVertex(Corner);
+                    }
+                    Previous = Corner;
+                    CornerCount++;
+                }
+            }
+
+            Cur = LineEnd + 1;
+        }
+        SampleMemory();
+    });
+    if (!Batch.empty())
+        FlushBatch();
+
+    fclose(File);
+    assert(WrittenCount == VertexCount);
+
+    Stats.Time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+    if (StatsOut)
+        *StatsOut = Stats;
+    return true;
+}
+
+// ================================================================================================
+// PARSING
+// ================================================================================================
+bool Mesh::ParseObj(std::vector<vertex_full>& Mesh, const char* Filename, obj_parser Parser, std::vector<uint32_t>* ShapeOffsetsOut)
+{
+    Mesh.clear();
+
+    bool HasNormals = false;
+    bool HasTexCoords = false;
+    std::vector<uint32_t> ShapeOffsets;
+    bool Success = (Parser == OBJ_PARSER_TINYOBJ)
+        ? ParseObjTinyObj(Mesh, Filename, &HasNormals, &HasTexCoords, ShapeOffsets)
+        : ParseObjParallel(Mesh, Filename, &HasNormals, &HasTexCoords, ShapeOffsets);
+
+    if (!Success)
+        return false;
+
+    // Both parsers give the same shapes once empty ones are removed
+    if (ShapeOffsetsOut)
+    {
+        ShapeOffsets.push_back(0);
+        std::sort(ShapeOffsets.begin(), ShapeOffsets.end());
+        ShapeOffsets.erase(std::unique(ShapeOffsets.begin(), ShapeOffsets.end()), ShapeOffsets.end());
+        while (!ShapeOffsets.empty() && ShapeOffsets.back() >= (uint32_t)Mesh.size())
+            ShapeOffsets.pop_back();
+        *ShapeOffsetsOut = ShapeOffsets;
+    }
+
+    BuildMissingAttributes(Mesh.data(), (int)Mesh.size(), HasNormals, HasTexCoords);
+    return true;
+}
@@ -0,0 +1,595 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "maths.h"
+#include "mesh.h"
+
+// FIFO post-transform cache simulation (same model as Mesh::AnalyzeVertexCache)
+struct fifo_cache
+{
+    std::vector<int> InsertionTime;
+    int Time;
+    int Misses; // Since last reset
+    int CacheSize;
+
+    fifo_cache(int VertexCount, int CacheSize)
+        : InsertionTime(VertexCount, -CacheSize - 1), Time(0), Misses(0), CacheSize(CacheSize)
+    {
+    }
+
+    // Flush the cache (without touching InsertionTime)
+    void Reset()
+    {
+        Time += CacheSize + 1;
+        Misses = 0;
+    }
+
+    // Returns the number of misses (0 to 3)
+    int AccessTriangle(const uint32_t* Triangle)
+    {
+        int PreviousMisses = Misses;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (Time - InsertionTime[Triangle[i]] > CacheSize)
+            {
+                InsertionTime[Triangle[i]] = Time++;
+                Misses++;
+            }
+        }
+        return Misses - PreviousMisses;
+    }
+};
+
+// Triangles using each vertex
+struct vertex_adjacency
+{
+    std::vector<int> Offsets; // VertexCount + 1
+    std::vector<int> Triangles;
+
+    vertex_adjacency(const uint32_t* Indices, int IndexCount, int VertexCount)
+        : Offsets(VertexCount + 1, 0), Triangles(IndexCount)
+    {
+        for (int i = 0; i < IndexCount; ++i)
+            Offsets[Indices[i] + 1]++;
+        for (int i = 0; i < VertexCount; ++i)
+            Offsets[i + 1] += Offsets[i];
+
+        std::vector<int> Cursors(Offsets.begin(), Offsets.end() - 1);
+        for (int i = 0; i < IndexCount; ++i)
+            Triangles[Cursors[Indices[i]]++] = i / 3;
+    }
+};
+
+// ================================================================================================
+// VERTEX CACHE
+// ================================================================================================
+// Tipsify (Sander, Nehab and Barczak, "Fast triangle reordering for vertex locality and reduced overdraw", 2007)
+// Triangles are emitted as fans around a vertex, the next fanning vertex is chosen among the vertices still in the cache.
+void Mesh::OptimizeVertexCache(uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+    int TriangleCount = IndexCount / 3;
+    vertex_adjacency Adjacency(Indices, IndexCount, VertexCount);
+
+    std::vector<int> LiveTriangles(VertexCount);
+    for (int i = 0; i < VertexCount; ++i)
+        LiveTriangles[i] = Adjacency.Offsets[i + 1] - Adjacency.Offsets[i];
+
+    std::vector<int> CacheTime(VertexCount, 0);
+    std::vector<bool> Emitted(TriangleCount, false);
+    std::vector<int> DeadEnds;
+    std::vector<int> Candidates;
+    std::vector<uint32_t> Output;
+    Output.reserve(TriangleCount * 3);
+
+    int Time = CacheSize + 1;
+    int Cursor = 0;
+    int FanningVertex = (VertexCount > 0) ? 0 : -1;
+    while (FanningVertex >= 0)
+    {
+        // Emit all the remaining triangles around the fanning vertex
+        Candidates.clear();
+        for (int i = Adjacency.Offsets[FanningVertex]; i < Adjacency.Offsets[FanningVertex + 1]; ++i)
+        {
+            int Triangle = Adjacency.Triangles[i];
+            if (Emitted[Triangle])
+                continue;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                uint32_t Vertex = Indices[Triangle * 3 + j];
+                Output.push_back(Vertex);
+                DeadEnds.push_back(Vertex);
+                Candidates.push_back(Vertex);
+                LiveTriangles[Vertex]--;
+                if (Time - CacheTime[Vertex] > CacheSize)
+                    CacheTime[Vertex] = Time++;
+            }
+            Emitted[Triangle] = true;
+        }
+
+        // Next fanning vertex: the one that will stay in cache the longest after emitting its triangles
+        int BestVertex = -1;
+        int BestPriority = -1;
+        for (int Vertex : Candidates)
+        {
+            if (LiveTriangles[Vertex] == 0)
+                continue;
+
+            int Priority = 0;
+            if (Time - CacheTime[Vertex] + 2 * LiveTriangles[Vertex] <= CacheSize)
+                Priority = Time - CacheTime[Vertex];
+            if (Priority > BestPriority)
+            {
+                BestPriority = Priority;
+                BestVertex = Vertex;
+            }
+        }
+
+        // Dead end: use the most recent vertex with live triangles, then scan in input order
+        while (BestVertex < 0 && !DeadEnds.empty())
+        {
+            int Vertex = DeadEnds.back();
+            DeadEnds.pop_back();
+            if (LiveTriangles[Vertex] > 0)
+                BestVertex = Vertex;
+        }
+        while (BestVertex < 0 && Cursor < VertexCount)
+        {
+            if (LiveTriangles[Cursor] > 0)
+                BestVertex = Cursor;
+            Cursor++;
+        }
+
+        FanningVertex = BestVertex;
+    }
+
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+// ================================================================================================
+// OVERDRAW
+// ================================================================================================
+// Triangles are split in clusters at cache discontinuities (hard boundaries) and where the cluster ACMR is
+// already close to the overall one (soft boundaries). Clusters are then sorted so that the ones facing away
+// from the mesh center are drawn first, which is a view independent approximation of front to back order.
+static void OptimizeOverdrawAround(uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, v3 MeshCenter, float Threshold, int CacheSize)
+{
+    int TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0)
+        return;
+
+    // Hard boundaries: triangles with 3 cache misses
+    fifo_cache Cache(VertexCount, CacheSize);
+    std::vector<int> HardClusters;
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        if (Cache.AccessTriangle(&Indices[i * 3]) == 3 || i == 0)
+            HardClusters.push_back(i);
+    }
+    HardClusters.push_back(TriangleCount);
+
+    // Soft boundaries
+    std::vector<int> Clusters;
+    for (int ClusterId = 0; ClusterId < (int)HardClusters.size() - 1; ++ClusterId)
+    {
+        int Start = HardClusters[ClusterId];
+        int End = HardClusters[ClusterId + 1];
+
+        Cache.Reset();
+        for (int i = Start; i < End; ++i)
+            Cache.AccessTriangle(&Indices[i * 3]);
+        float ClusterThreshold = Threshold * Cache.Misses / (End - Start);
+
+        Cache.Reset();
+        int SubStart = Start;
+        Clusters.push_back(Start);
+        for (int i = Start; i < End; ++i)
+        {
+            Cache.AccessTriangle(&Indices[i * 3]);
+            if (i + 1 < End && (float)Cache.Misses / (i + 1 - SubStart) <= ClusterThreshold)
+            {
+                Clusters.push_back(i + 1);
+                SubStart = i + 1;
+                Cache.Reset();
+            }
+        }
+    }
+    int ClusterCount = (int)Clusters.size();
+    Clusters.push_back(TriangleCount);
+
+    // Sort key: distance of the cluster to the mesh center along the cluster normal
+    std::vector<float> SortKeys(ClusterCount);
+    for (int ClusterId = 0; ClusterId < ClusterCount; ++ClusterId)
+    {
+        v3 Center = {};
+        v3 Normal = {};
+        float Area = 0.f;
+        for (int i = Clusters[ClusterId]; i < Clusters[ClusterId + 1]; ++i)
+        {
+            v3 P0 = Vertices[Indices[i * 3 + 0]].Position;
+            v3 P1 = Vertices[Indices[i * 3 + 1]].Position;
+            v3 P2 = Vertices[Indices[i * 3 + 2]].Position;
+            v3 TriangleNormal = Vec3::Cross(P1 - P0, P2 - P0); // Length is twice the area
+            float TriangleArea = Vec3::Length(TriangleNormal);
+
+            Center += (P0 + P1 + P2) * TriangleArea;
+            Normal += TriangleNormal;
+            Area += TriangleArea;
+        }
+
+        float NormalLength = Vec3::Length(Normal);
+        if (Area == 0.f || NormalLength == 0.f)
+            continue;
+
+        Center *= 1.f / (3.f * Area);
+        SortKeys[ClusterId] = Vec3::Dot(Center - MeshCenter, Normal * (1.f / NormalLength));
+    }
+
+    std::vector<int> Order(ClusterCount);
+    for (int i = 0; i < ClusterCount; ++i)
+        Order[i] = i;
+    std::stable_sort(Order.begin(), Order.end(), [&](int A, int B) { return SortKeys[A] > SortKeys[B]; });
+
+    std::vector<uint32_t> Output;
+    Output.reserve(TriangleCount * 3);
+    for (int ClusterId : Order)
+        Output.insert(Output.end(), &Indices[Clusters[ClusterId] * 3], &Indices[Clusters[ClusterId + 1] * 3]);
+
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+static v3 ComputeMeshCenter(const vertex_full* Vertices, int VertexCount)
+{
+    v3 MeshCenter = {};
+    for (int i = 0; i < VertexCount; ++i)
+        MeshCenter += Vertices[i].Position;
+    return MeshCenter * (1.f / Math::Max(VertexCount, 1));
+}
+
+void Mesh::OptimizeOverdraw(uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, float Threshold, int CacheSize)
+{
+    OptimizeOverdrawAround(Indices, IndexCount, Vertices, VertexCount, ComputeMeshCenter(Vertices, VertexCount), Threshold, CacheSize);
+}
+
+// ================================================================================================
+// VERTEX FETCH
+// ================================================================================================
+void Mesh::OptimizeVertexFetch(indexed_mesh& Mesh)
+{
+    const uint32_t Unused = 0xFFFFFFFF;
+    std::vector<uint32_t> Remap(Mesh.Vertices.size(), Unused);
+    std::vector<vertex_full> Vertices;
+    Vertices.reserve(Mesh.Vertices.size());
+
+    for (uint32_t& Index : Mesh.Indices)
+    {
+        if (Remap[Index] == Unused)
+        {
+            Remap[Index] = (uint32_t)Vertices.size();
+            Vertices.push_back(Mesh.Vertices[Index]);
+        }
+        Index = Remap[Index];
+    }
+
+    Mesh.Vertices.swap(Vertices);
+}
+
+// ================================================================================================
+// RANGES
+// ================================================================================================
+struct range_triangle
+{
+    uint32_t Indices[3];
+    v3 Centroid;
+    int Facing; // Dominant axis of the normal (+x, -x, +y, -y, +z, -z) or 6 for mixed groups
+};
+
+// Median split along the longest axis of the centroids until ranges fit MaxTriangles
+static void SplitRange(range_triangle* Triangles, int TriangleCount, uint32_t IndexOffset, int MaxTriangles, std::vector<mesh_range>& Ranges)
+{
+    if (TriangleCount <= MaxTriangles)
+    {
+        mesh_range Range = {};
+        Range.IndexOffset = IndexOffset;
+        Range.IndexCount = TriangleCount * 3;
+        Ranges.push_back(Range);
+        return;
+    }
+
+    v3 Min = Triangles[0].Centroid;
+    v3 Max = Triangles[0].Centroid;
+    for (int i = 1; i < TriangleCount; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            Min.e[j] = Math::Min(Min.e[j], Triangles[i].Centroid.e[j]);
+            Max.e[j] = Math::Max(Max.e[j], Triangles[i].Centroid.e[j]);
+        }
+    }
+
+    v3 Extent = Max - Min;
+    int Axis = (Extent.x >= Extent.y && Extent.x >= Extent.z) ? 0 : (Extent.y >= Extent.z ? 1 : 2);
+
+    int Half = TriangleCount / 2;
+    std::nth_element(Triangles, Triangles + Half, Triangles + TriangleCount, [Axis](const range_triangle& A, const range_triangle& B)
+    {
+        return A.Centroid.e[Axis] < B.Centroid.e[Axis];
+    });
+
+    SplitRange(Triangles, Half, IndexOffset, MaxTriangles, Ranges);
+    SplitRange(Triangles + Half, TriangleCount - Half, IndexOffset + Half * 3, MaxTriangles, Ranges);
+}
+
+void Mesh::SplitRanges(indexed_mesh& Mesh)
+{
+    if (Mesh.Ranges.empty())
+    {
+        mesh_range Range = {};
+        Range.IndexCount = (uint32_t)Mesh.Indices.size();
+        Mesh.Ranges.push_back(Range);
+    }
+
+    std::vector<mesh_range> Ranges;
+    std::vector<range_triangle> Triangles;
+    for (const mesh_range& Shape : Mesh.Ranges)
+    {
+        uint32_t* Indices = &Mesh.Indices[Shape.IndexOffset];
+        int TriangleCount = Shape.IndexCount / 3;
+        if (TriangleCount == 0)
+            continue;
+
+        Triangles.resize(TriangleCount);
+        for (int i = 0; i < TriangleCount; ++i)
+        {
+            range_triangle& Triangle = Triangles[i];
+            v3 Centroid = {};
+            for (int j = 0; j < 3; ++j)
+            {
+                Triangle.Indices[j] = Indices[i * 3 + j];
+                Centroid += Mesh.Vertices[Triangle.Indices[j]].Position;
+            }
+            Triangle.Centroid = Centroid * (1.f / 3.f);
+        }
+
+        SplitRange(Triangles.data(), TriangleCount, Shape.IndexOffset, MESH_RANGE_MAX_TRIANGLES, Ranges);
+
+        for (int i = 0; i < TriangleCount; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+                Indices[i * 3 + j] = Triangles[i].Indices[j];
+        }
+    }
+
+    Mesh.Ranges.swap(Ranges);
+}
+
+// Bounding sphere and cone of the triangle normals (the cone cutoff is the sine of its half angle)
+static void ComputeMeshletBounds(mesh_meshlet& Meshlet, const uint32_t* Indices, const vertex_full* Vertices)
+{
+    int TriangleCount = Meshlet.IndexCount / 3;
+    v3 Min = Vertices[Indices[0]].Position;
+    v3 Max = Min;
+    for (int i = 1; i < (int)Meshlet.IndexCount; ++i)
+    {
+        v3 Position = Vertices[Indices[i]].Position;
+        for (int j = 0; j < 3; ++j)
+        {
+            Min.e[j] = Math::Min(Min.e[j], Position.e[j]);
+            Max.e[j] = Math::Max(Max.e[j], Position.e[j]);
+        }
+    }
+    Meshlet.Center = (Min + Max) * 0.5f;
+    Meshlet.Radius = 0.f;
+    for (int i = 0; i < (int)Meshlet.IndexCount; ++i)
+        Meshlet.Radius = Math::Max(Meshlet.Radius, Vec3::Length(Vertices[Indices[i]].Position - Meshlet.Center));
+
+    // Unit normals of non degenerate triangles
+    std::vector<v3> Normals;
+    Normals.reserve(TriangleCount);
+    v3 Axis = {};
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        v3 P0 = Vertices[Indices[i * 3 + 0]].Position;
+        v3 P1 = Vertices[Indices[i * 3 + 1]].Position;
+        v3 P2 = Vertices[Indices[i * 3 + 2]].Position;
+        v3 Normal = Vec3::Cross(P1 - P0, P2 - P0);
+        float Length = Vec3::Length(Normal);
+        if (Length == 0.f)
+            continue;
+        Normals.push_back(Normal / Length);
+        Axis += Normals.back();
+    }
+
+    Meshlet.ConeAxis = {};
+    Meshlet.ConeCutoff = 1.f;
+    float AxisLength = Vec3::Length(Axis);
+    if (AxisLength == 0.f)
+        return;
+    Meshlet.ConeAxis = Axis / AxisLength;
+
+    float MinDot = 1.f;
+    for (v3 Normal : Normals)
+        MinDot = Math::Min(MinDot, Vec3::Dot(Normal, Meshlet.ConeAxis));
+
+    // Cones wider than a half space can never be back facing
+    if (MinDot > 0.f)
+        Meshlet.ConeCutoff = Math::Sqrt(1.f - MinDot * MinDot);
+}
+
+void Mesh::ComputeBounds(indexed_mesh& Mesh)
+{
+    for (mesh_range& Range : Mesh.Ranges)
+    {
+        const uint32_t* Indices = &Mesh.Indices[Range.IndexOffset];
+        if (Range.IndexCount == 0)
+            continue;
+
+        Range.BoundsMin = Range.BoundsMax = Mesh.Vertices[Indices[0]].Position;
+        for (int i = 1; i < (int)Range.IndexCount; ++i)
+        {
+            v3 Position = Mesh.Vertices[Indices[i]].Position;
+            for (int j = 0; j < 3; ++j)
+            {
+                Range.BoundsMin.e[j] = Math::Min(Range.BoundsMin.e[j], Position.e[j]);
+                Range.BoundsMax.e[j] = Math::Max(Range.BoundsMax.e[j], Position.e[j]);
+            }
+        }
+
+        // Sphere around the box center (tight enough for small ranges)
+        Range.Center = (Range.BoundsMin + Range.BoundsMax) * 0.5f;
+        Range.Radius = 0.f;
+        for (int i = 0; i < (int)Range.IndexCount; ++i)
+            Range.Radius = Math::Max(Range.Radius, Vec3::Length(Mesh.Vertices[Indices[i]].Position - Range.Center));
+    }
+
+    for (mesh_meshlet& Meshlet : Mesh.Meshlets)
+    {
+        if (Meshlet.IndexCount > 0)
+            ComputeMeshletBounds(Meshlet, &Mesh.Indices[Meshlet.IndexOffset], Mesh.Vertices.data());
+    }
+}
+
+void Mesh::BuildMeshlets(indexed_mesh& Mesh)
+{
+    std::vector<mesh_range> Clusters;
+    std::vector<range_triangle> Triangles;
+    for (const mesh_range& Range : Mesh.Ranges)
+    {
+        uint32_t* Indices = &Mesh.Indices[Range.IndexOffset];
+        int TriangleCount = Range.IndexCount / 3;
+        if (TriangleCount == 0)
+            continue;
+
+        // Group triangles by facing direction so that meshlet normal cones stay narrow
+        int FacingCounts[7] = {};
+        Triangles.resize(TriangleCount);
+        for (int i = 0; i < TriangleCount; ++i)
+        {
+            range_triangle& Triangle = Triangles[i];
+            v3 P[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                Triangle.Indices[j] = Indices[i * 3 + j];
+                P[j] = Mesh.Vertices[Triangle.Indices[j]].Position;
+            }
+            Triangle.Centroid = (P[0] + P[1] + P[2]) * (1.f / 3.f);
+
+            v3 Normal = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+            int Axis = 0;
+            for (int j = 1; j < 3; ++j)
+            {
+                if (Math::Abs(Normal.e[j]) > Math::Abs(Normal.e[Axis]))
+                    Axis = j;
+            }
+            Triangle.Facing = Axis * 2 + (Normal.e[Axis] < 0.f ? 1 : 0);
+            FacingCounts[Triangle.Facing]++;
+        }
+
+        // Small groups would give tiny meshlets, they are merged in a mixed group
+        for (range_triangle& Triangle : Triangles)
+        {
+            if (FacingCounts[Triangle.Facing] < MESH_MESHLET_MAX_TRIANGLES / 4)
+                Triangle.Facing = 6;
+        }
+        // The sort is stable and groups are cut in runs of equal size, so meshlets keep the optimized triangle order
+        std::stable_sort(Triangles.begin(), Triangles.end(), [](const range_triangle& A, const range_triangle& B) { return A.Facing < B.Facing; });
+
+        for (int First = 0; First < TriangleCount;)
+        {
+            int Last = First;
+            while (Last < TriangleCount && Triangles[Last].Facing == Triangles[First].Facing)
+                Last++;
+            int MeshletCount = (Last - First + MESH_MESHLET_MAX_TRIANGLES - 1) / MESH_MESHLET_MAX_TRIANGLES;
+            for (int i = 0; i < MeshletCount; ++i)
+            {
+                mesh_range Cluster = {};
+                int ClusterFirst = First + (Last - First) * i / MeshletCount;
+                int ClusterLast = First + (Last - First) * (i + 1) / MeshletCount;
+                Cluster.IndexOffset = Range.IndexOffset + ClusterFirst * 3;
+                Cluster.IndexCount = (ClusterLast - ClusterFirst) * 3;
+                Clusters.push_back(Cluster);
+            }
+            First = Last;
+        }
+
+        for (int i = 0; i < TriangleCount; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+                Indices[i * 3 + j] = Triangles[i].Indices[j];
+        }
+    }
+
+    Mesh.Meshlets.clear();
+    for (const mesh_range& Cluster : Clusters)
+    {
+        mesh_meshlet Meshlet = {};
+        Meshlet.IndexOffset = Cluster.IndexOffset;
+        Meshlet.IndexCount = Cluster.IndexCount;
+        Mesh.Meshlets.push_back(Meshlet);
+    }
+}
+
+// ================================================================================================
+// MESH
+// ================================================================================================
+// Vertex cache and overdraw optimizations of a range with local vertex indices, so that their per vertex
+// state stays proportional to the range (Remap is all 0xFFFFFFFF before and after the call)
+struct range_optimizer
+{
+    std::vector<uint32_t> Remap;    // Mesh vertex to local vertex
+    std::vector<uint32_t> Vertices; // Local vertex to mesh vertex
+    std::vector<vertex_full> LocalVertices;
+    std::vector<uint32_t> LocalIndices;
+};
+
+static void OptimizeRange(range_optimizer& Optimizer, uint32_t* Indices, int IndexCount, const vertex_full* Vertices, v3 MeshCenter)
+{
+    Optimizer.Vertices.clear();
+    Optimizer.LocalVertices.clear();
+    Optimizer.LocalIndices.resize(IndexCount);
+    for (int i = 0; i < IndexCount; ++i)
+    {
+        uint32_t& LocalIndex = Optimizer.Remap[Indices[i]];
+        if (LocalIndex == 0xFFFFFFFF)
+        {
+            LocalIndex = (uint32_t)Optimizer.Vertices.size();
+            Optimizer.Vertices.push_back(Indices[i]);
+            Optimizer.LocalVertices.push_back(Vertices[Indices[i]]);
+        }
+        Optimizer.LocalIndices[i] = LocalIndex;
+    }
+
+    // Default parameters of Mesh::OptimizeOverdraw, the sort key uses the center of the whole mesh
+    int LocalVertexCount = (int)Optimizer.Vertices.size();
+    Mesh::OptimizeVertexCache(Optimizer.LocalIndices.data(), IndexCount, LocalVertexCount);
+    OptimizeOverdrawAround(Optimizer.LocalIndices.data(), IndexCount, Optimizer.LocalVertices.data(), LocalVertexCount, MeshCenter, 1.05f, 16);
+
+    for (int i = 0; i < IndexCount; ++i)
+        Indices[i] = Optimizer.Vertices[Optimizer.LocalIndices[i]];
+    for (uint32_t Vertex : Optimizer.Vertices)
+        Optimizer.Remap[Vertex] = 0xFFFFFFFF;
+}
+
+void Mesh::OptimizeMesh(indexed_mesh& Mesh)
+{
+    int VertexCount = (int)Mesh.Vertices.size();
+    int IndexCount = (int)Mesh.Indices.size();
+
+    Mesh.SourceCacheStats = AnalyzeVertexCache(Mesh.Indices.data(), IndexCount, VertexCount);
+
+    // Ranges stay contiguous, so cache and overdraw optimizations run inside each range (then meshlets are cut)
+    SplitRanges(Mesh);
+    v3 MeshCenter = ComputeMeshCenter(Mesh.Vertices.data(), VertexCount);
+    range_optimizer Optimizer;
+    Optimizer.Remap.assign(VertexCount, 0xFFFFFFFF);
+    for (const mesh_range& Range : Mesh.Ranges)
+        OptimizeRange(Optimizer, &Mesh.Indices[Range.IndexOffset], Range.IndexCount, Mesh.Vertices.data(), MeshCenter);
+    BuildMeshlets(Mesh);
+    BuildLods(Mesh);
+    // Levels of detail only use vertices of the full mesh (fetch order follows the full mesh)
+    OptimizeVertexFetch(Mesh);
+    ComputeBounds(Mesh);
+
+    Mesh.CacheStats = AnalyzeVertexCache(Mesh.Indices.data(), IndexCount, (int)Mesh.Vertices.size());
+}
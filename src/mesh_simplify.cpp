@@ -0,0 +1,795 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "maths.h"
+#include "mesh.h"
+
+// Attribute weights relative to the normalized positions (the mesh extent is 1)
+static const float SIMPLIFY_NORMAL_WEIGHT = 0.5f;
+static const float SIMPLIFY_UV_WEIGHT = 1.f;
+static const float SIMPLIFY_BORDER_WEIGHT = 2.f;
+static const int SIMPLIFY_ATTRIBUTE_COUNT = 5; // Normal (3) and uv (2)
+
+// ================================================================================================
+// QUADRICS
+// ================================================================================================
+// Symmetric matrix A, vector B and constant C: Error(x) = x.A.x + 2 B.x + C
+struct quadric
+{
+    float A00, A11, A22;
+    float A10, A20, A21;
+    float B0, B1, B2;
+    float C;
+};
+
+// Area weighted squared distance to the triangle planes (Garland & Heckbert)
+struct position_quadric
+{
+    quadric Q;
+    float W;
+};
+
+// Area weighted squared difference between a vertex attribute and its linear interpolation over the triangles (Hoppe)
+// Interpolated attribute k is G[k].x + D[k], Q[k] stores (G[k].x + D[k])^2
+struct attribute_quadric
+{
+    quadric Q[SIMPLIFY_ATTRIBUTE_COUNT];
+    v3 G[SIMPLIFY_ATTRIBUTE_COUNT];
+    float D[SIMPLIFY_ATTRIBUTE_COUNT];
+    float W;
+};
+
+// Outer product of (Normal, Distance) scaled by Weight
+static quadric QuadricFromPlane(v3 Normal, float Distance, float Weight)
+{
+    quadric Q;
+    Q.A00 = Weight * Normal.x * Normal.x;
+    Q.A11 = Weight * Normal.y * Normal.y;
+    Q.A22 = Weight * Normal.z * Normal.z;
+    Q.A10 = Weight * Normal.y * Normal.x;
+    Q.A20 = Weight * Normal.z * Normal.x;
+    Q.A21 = Weight * Normal.z * Normal.y;
+    Q.B0  = Weight * Normal.x * Distance;
+    Q.B1  = Weight * Normal.y * Distance;
+    Q.B2  = Weight * Normal.z * Distance;
+    Q.C   = Weight * Distance * Distance;
+    return Q;
+}
+
+static void QuadricAdd(quadric& Q, const quadric& R)
+{
+    Q.A00 += R.A00; Q.A11 += R.A11; Q.A22 += R.A22;
+    Q.A10 += R.A10; Q.A20 += R.A20; Q.A21 += R.A21;
+    Q.B0  += R.B0;  Q.B1  += R.B1;  Q.B2  += R.B2;
+    Q.C   += R.C;
+}
+
+static float QuadricEval(const quadric& Q, v3 X)
+{
+    float Rx = Q.B0 + Q.A00 * X.x + Q.A10 * X.y + Q.A20 * X.z;
+    float Ry = Q.B1 + Q.A10 * X.x + Q.A11 * X.y + Q.A21 * X.z;
+    float Rz = Q.B2 + Q.A20 * X.x + Q.A21 * X.y + Q.A22 * X.z;
+    return X.x * Rx + X.y * Ry + X.z * Rz + Q.B0 * X.x + Q.B1 * X.y + Q.B2 * X.z + Q.C;
+}
+
+static void AttributeQuadricAdd(attribute_quadric& Q, const attribute_quadric& R)
+{
+    for (int k = 0; k < SIMPLIFY_ATTRIBUTE_COUNT; ++k)
+    {
+        QuadricAdd(Q.Q[k], R.Q[k]);
+        Q.G[k] += R.G[k];
+        Q.D[k] += R.D[k];
+    }
+    Q.W += R.W;
+}
+
+// Sum of (G.x + D - a)^2 with the attribute values of the target vertex
+static float AttributeQuadricEval(const attribute_quadric& Q, v3 X, const float* Attributes)
+{
+    float Error = 0.f;
+    for (int k = 0; k < SIMPLIFY_ATTRIBUTE_COUNT; ++k)
+    {
+        float A = Attributes[k];
+        Error += QuadricEval(Q.Q[k], X) - 2.f * A * (Vec3::Dot(Q.G[k], X) + Q.D[k]) + Q.W * A * A;
+    }
+    return Error;
+}
+
+static attribute_quadric AttributeQuadricFromTriangle(const v3* P, const float* A0, const float* A1, const float* A2, float Weight)
+{
+    attribute_quadric Q = {};
+
+    v3 P10 = P[1] - P[0];
+    v3 P20 = P[2] - P[0];
+    float D00 = Vec3::Dot(P10, P10);
+    float D01 = Vec3::Dot(P10, P20);
+    float D11 = Vec3::Dot(P20, P20);
+    float Det = D00 * D11 - D01 * D01;
+    if (Det == 0.f)
+        return Q;
+    float InvDet = 1.f / Det;
+
+    for (int k = 0; k < SIMPLIFY_ATTRIBUTE_COUNT; ++k)
+    {
+        // Gradient inside the triangle plane so that G.P[i] + D == A[i]
+        float A10 = A1[k] - A0[k];
+        float A20 = A2[k] - A0[k];
+        v3 G = P10 * ((D11 * A10 - D01 * A20) * InvDet) + P20 * ((D00 * A20 - D01 * A10) * InvDet);
+        float D = A0[k] - Vec3::Dot(G, P[0]);
+
+        Q.Q[k] = QuadricFromPlane(G, D, Weight);
+        Q.G[k] = G * Weight;
+        Q.D[k] = D * Weight;
+    }
+    Q.W = Weight;
+    return Q;
+}
+
+// ================================================================================================
+// SIMPLIFICATION
+// ================================================================================================
+enum vertex_kind
+{
+    VERTEX_MANIFOLD, // Free to collapse to any neighbour
+    VERTEX_BORDER,   // Only collapses along border edges
+    VERTEX_LOCKED,   // Non-manifold, never collapsed (can still be a target)
+};
+
+// Edge between two positions with the number of triangles using it
+struct simplify_edge
+{
+    uint32_t P0;
+    uint32_t P1;
+    int TriangleCount;
+};
+
+struct simplify_collapse
+{
+    uint32_t From; // Positions (From is moved to To)
+    uint32_t To;
+    float Error;
+};
+
+struct simplify_context
+{
+    int VertexCount;
+    std::vector<uint32_t> Indices;      // Triangles (collapsed ones are removed at the end of each pass)
+    std::vector<uint32_t> PositionIds;  // First vertex sharing the same position
+    std::vector<uint32_t> NextWedge;    // Circular list of the vertices sharing the same position
+    std::vector<v3> Positions;          // Normalized positions
+    std::vector<float> Attributes;      // Weighted attributes (SIMPLIFY_ATTRIBUTE_COUNT per vertex)
+    std::vector<position_quadric> PositionQuadrics; // Per position
+    std::vector<attribute_quadric> AttributeQuadrics; // Per vertex
+    std::vector<uint8_t> Kinds;         // Per position
+    std::vector<uint32_t> WedgeTargets; // Scratch: vertex replacing each vertex of the collapsed position
+
+    // Triangles around each position (rebuilt each pass)
+    std::vector<uint32_t> TriangleOffsets;
+    std::vector<uint32_t> Triangles;
+};
+
+static const uint32_t NoWedge = 0xFFFFFFFF;
+
+// Positions that compare equal hash the same (-0 is hashed as +0)
+static uint32_t HashPosition(v3 Position)
+{
+    uint32_t Bits[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        float Component = (Position.e[i] == 0.f) ? 0.f : Position.e[i];
+        memcpy(&Bits[i], &Component, sizeof(uint32_t));
+    }
+    return (Bits[0] * 73856093u) ^ (Bits[1] * 19349663u) ^ (Bits[2] * 83492791u);
+}
+
+static bool SamePosition(v3 A, v3 B)
+{
+    return A.x == B.x && A.y == B.y && A.z == B.z;
+}
+
+static void BuildPositionIds(simplify_context& Context, const vertex_full* Vertices)
+{
+    int VertexCount = Context.VertexCount;
+    Context.PositionIds.resize(VertexCount);
+    Context.NextWedge.resize(VertexCount);
+
+    uint32_t TableSize = 1;
+    while (TableSize < (uint32_t)VertexCount * 2)
+        TableSize *= 2;
+    std::vector<uint32_t> Table(TableSize, NoWedge);
+
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        uint32_t Slot = HashPosition(Vertices[i].Position) & (TableSize - 1);
+        while (Table[Slot] != NoWedge && !SamePosition(Vertices[Table[Slot]].Position, Vertices[i].Position))
+            Slot = (Slot + 1) & (TableSize - 1);
+
+        if (Table[Slot] == NoWedge)
+        {
+            Table[Slot] = i;
+            Context.PositionIds[i] = i;
+            Context.NextWedge[i] = i;
+        }
+        else
+        {
+            // Insert after the first wedge
+            uint32_t First = Table[Slot];
+            Context.PositionIds[i] = First;
+            Context.NextWedge[i] = Context.NextWedge[First];
+            Context.NextWedge[First] = i;
+        }
+    }
+}
+
+// Edges of the remaining triangles sorted by positions
+static void BuildEdges(std::vector<simplify_edge>& Edges, const simplify_context& Context)
+{
+    std::vector<uint64_t> Keys;
+    Keys.reserve(Context.Indices.size());
+    for (size_t i = 0; i < Context.Indices.size(); i += 3)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t P0 = Context.PositionIds[Context.Indices[i + j]];
+            uint32_t P1 = Context.PositionIds[Context.Indices[i + (j + 1) % 3]];
+            Keys.push_back((uint64_t)Math::Min(P0, P1) << 32 | Math::Max(P0, P1));
+        }
+    }
+    std::sort(Keys.begin(), Keys.end());
+
+    Edges.clear();
+    for (size_t i = 0; i < Keys.size();)
+    {
+        size_t End = i + 1;
+        while (End < Keys.size() && Keys[End] == Keys[i])
+            ++End;
+        Edges.push_back({ (uint32_t)(Keys[i] >> 32), (uint32_t)Keys[i], (int)(End - i) });
+        i = End;
+    }
+}
+
+static void ClassifyVertices(simplify_context& Context, const std::vector<simplify_edge>& Edges)
+{
+    Context.Kinds.assign(Context.VertexCount, VERTEX_MANIFOLD);
+    for (const simplify_edge& Edge : Edges)
+    {
+        uint8_t Kind = (Edge.TriangleCount == 1) ? VERTEX_BORDER : (Edge.TriangleCount > 2) ? VERTEX_LOCKED : VERTEX_MANIFOLD;
+        Context.Kinds[Edge.P0] = Math::Max(Context.Kinds[Edge.P0], Kind);
+        Context.Kinds[Edge.P1] = Math::Max(Context.Kinds[Edge.P1], Kind);
+    }
+}
+
+static void BuildTriangleAdjacency(simplify_context& Context)
+{
+    const std::vector<uint32_t>& Indices = Context.Indices;
+    Context.TriangleOffsets.assign(Context.VertexCount + 1, 0);
+    for (uint32_t Index : Indices)
+        Context.TriangleOffsets[Context.PositionIds[Index] + 1]++;
+    for (int i = 0; i < Context.VertexCount; ++i)
+        Context.TriangleOffsets[i + 1] += Context.TriangleOffsets[i];
+
+    Context.Triangles.resize(Indices.size());
+    std::vector<uint32_t> Cursors(Context.TriangleOffsets.begin(), Context.TriangleOffsets.end() - 1);
+    for (size_t i = 0; i < Indices.size(); ++i)
+        Context.Triangles[Cursors[Context.PositionIds[Indices[i]]]++] = (uint32_t)(i / 3);
+}
+
+static void BuildQuadrics(simplify_context& Context, const std::vector<simplify_edge>& Edges)
+{
+    Context.PositionQuadrics.assign(Context.VertexCount, {});
+    Context.AttributeQuadrics.assign(Context.VertexCount, {});
+
+    const std::vector<uint32_t>& Indices = Context.Indices;
+    for (size_t i = 0; i < Indices.size(); i += 3)
+    {
+        const uint32_t* Triangle = &Indices[i];
+        v3 P[3] = { Context.Positions[Triangle[0]], Context.Positions[Triangle[1]], Context.Positions[Triangle[2]] };
+        v3 Normal = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+        float Length = Vec3::Length(Normal);
+        if (Length == 0.f)
+            continue;
+
+        float Area = Length * 0.5f;
+        Normal = Normal / Length;
+        position_quadric Plane = { QuadricFromPlane(Normal, -Vec3::Dot(Normal, P[0]), Area), Area };
+        attribute_quadric Attribute = AttributeQuadricFromTriangle(P,
+            &Context.Attributes[Triangle[0] * SIMPLIFY_ATTRIBUTE_COUNT],
+            &Context.Attributes[Triangle[1] * SIMPLIFY_ATTRIBUTE_COUNT],
+            &Context.Attributes[Triangle[2] * SIMPLIFY_ATTRIBUTE_COUNT], Area);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            position_quadric& Q = Context.PositionQuadrics[Context.PositionIds[Triangle[j]]];
+            QuadricAdd(Q.Q, Plane.Q);
+            Q.W += Plane.W;
+            AttributeQuadricAdd(Context.AttributeQuadrics[Triangle[j]], Attribute);
+
+            // Keep borders in place with a plane perpendicular to the triangle
+            uint32_t P0 = Context.PositionIds[Triangle[j]];
+            uint32_t P1 = Context.PositionIds[Triangle[(j + 1) % 3]];
+            simplify_edge Key = { Math::Min(P0, P1), Math::Max(P0, P1), 0 };
+            auto Edge = std::lower_bound(Edges.begin(), Edges.end(), Key, [](const simplify_edge& A, const simplify_edge& B)
+                { return A.P0 < B.P0 || (A.P0 == B.P0 && A.P1 < B.P1); });
+            if (Edge != Edges.end() && Edge->P0 == Key.P0 && Edge->P1 == Key.P1 && Edge->TriangleCount == 1)
+            {
+                v3 EdgeVector = P[(j + 1) % 3] - P[j];
+                float EdgeLength = Vec3::Length(EdgeVector);
+                v3 BorderNormal = Vec3::Normalize(Vec3::Cross(EdgeVector, Normal));
+                float Weight = EdgeLength * EdgeLength * SIMPLIFY_BORDER_WEIGHT;
+                quadric Border = QuadricFromPlane(BorderNormal, -Vec3::Dot(BorderNormal, P[j]), Weight);
+                for (uint32_t Position : { P0, P1 })
+                {
+                    QuadricAdd(Context.PositionQuadrics[Position].Q, Border);
+                    Context.PositionQuadrics[Position].W += Weight;
+                }
+            }
+        }
+    }
+}
+
+static bool IsTriangleCollapsed(const simplify_context& Context, const uint32_t* Triangle)
+{
+    uint32_t P0 = Context.PositionIds[Triangle[0]];
+    uint32_t P1 = Context.PositionIds[Triangle[1]];
+    uint32_t P2 = Context.PositionIds[Triangle[2]];
+    return P0 == P1 || P1 == P2 || P2 == P0;
+}
+
+// Find the vertex of To replacing each vertex of From (through the triangles sharing the edge)
+// Returns false if a vertex of From does not share a triangle with To (seams can only collapse along themselves)
+static bool FindWedgeTargets(simplify_context& Context, uint32_t From, uint32_t To)
+{
+    for (uint32_t i = Context.TriangleOffsets[From]; i < Context.TriangleOffsets[From + 1]; ++i)
+    {
+        const uint32_t* Triangle = &Context.Indices[Context.Triangles[i] * 3];
+        if (IsTriangleCollapsed(Context, Triangle))
+            continue;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t Wedge = Triangle[j];
+            uint32_t Next = Triangle[(j + 1) % 3];
+            uint32_t Previous = Triangle[(j + 2) % 3];
+            if (Context.PositionIds[Wedge] != From || Context.WedgeTargets[Wedge] != NoWedge)
+                continue;
+            if (Context.PositionIds[Next] == To)
+                Context.WedgeTargets[Wedge] = Next;
+            else if (Context.PositionIds[Previous] == To)
+                Context.WedgeTargets[Wedge] = Previous;
+        }
+    }
+
+    bool Found = true;
+    uint32_t Wedge = From;
+    do
+    {
+        // Unused vertices are ignored
+        if (Context.WedgeTargets[Wedge] == NoWedge)
+            Found = Found && Context.NextWedge[Wedge] == Wedge;
+        Wedge = Context.NextWedge[Wedge];
+    } while (Wedge != From);
+    return Found;
+}
+
+static void ClearWedgeTargets(simplify_context& Context, uint32_t From)
+{
+    uint32_t Wedge = From;
+    do
+    {
+        Context.WedgeTargets[Wedge] = NoWedge;
+        Wedge = Context.NextWedge[Wedge];
+    } while (Wedge != From);
+}
+
+// Squared error (relative to the mesh extent) of moving From onto To, FLT_MAX if the collapse is not allowed
+static float GetCollapseError(simplify_context& Context, uint32_t From, uint32_t To)
+{
+    if (!FindWedgeTargets(Context, From, To))
+    {
+        ClearWedgeTargets(Context, From);
+        return FLT_MAX;
+    }
+
+    v3 Target = Context.Positions[To];
+    const position_quadric& QFrom = Context.PositionQuadrics[From];
+    const position_quadric& QTo = Context.PositionQuadrics[To];
+    float Error = QuadricEval(QFrom.Q, Target) + QuadricEval(QTo.Q, Target);
+    float Weight = QFrom.W + QTo.W;
+
+    uint32_t Wedge = From;
+    do
+    {
+        uint32_t WedgeTarget = Context.WedgeTargets[Wedge];
+        if (WedgeTarget != NoWedge)
+        {
+            const float* Attributes = &Context.Attributes[WedgeTarget * SIMPLIFY_ATTRIBUTE_COUNT];
+            Error += AttributeQuadricEval(Context.AttributeQuadrics[Wedge], Target, Attributes);
+            Error += AttributeQuadricEval(Context.AttributeQuadrics[WedgeTarget], Target, Attributes);
+        }
+        Wedge = Context.NextWedge[Wedge];
+    } while (Wedge != From);
+
+    ClearWedgeTargets(Context, From);
+    return Math::Abs(Error) / (Weight > 0.f ? Weight : 1.f);
+}
+
+// Reject collapses flipping (or nearly flipping) the remaining triangles around From
+static bool HasFlippedTriangles(const simplify_context& Context, uint32_t From, uint32_t To)
+{
+    v3 Target = Context.Positions[To];
+    for (uint32_t i = Context.TriangleOffsets[From]; i < Context.TriangleOffsets[From + 1]; ++i)
+    {
+        const uint32_t* Triangle = &Context.Indices[Context.Triangles[i] * 3];
+        if (IsTriangleCollapsed(Context, Triangle))
+            continue;
+
+        v3 P[3];
+        v3 Moved[3];
+        bool HasTo = false;
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t Position = Context.PositionIds[Triangle[j]];
+            HasTo = HasTo || Position == To;
+            P[j] = Context.Positions[Triangle[j]];
+            Moved[j] = (Position == From) ? Target : P[j];
+        }
+        if (HasTo)
+            continue;
+
+        v3 Normal = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+        v3 MovedNormal = Vec3::Cross(Moved[1] - Moved[0], Moved[2] - Moved[0]);
+        float Dot = Vec3::Dot(Normal, MovedNormal);
+        if (Dot <= 0.f || Dot * Dot < 0.0625f * Vec3::Dot(Normal, Normal) * Vec3::Dot(MovedNormal, MovedNormal))
+            return true;
+    }
+    return false;
+}
+
+// Returns the number of removed triangles
+static int ApplyCollapse(simplify_context& Context, uint32_t From, uint32_t To)
+{
+    FindWedgeTargets(Context, From, To);
+
+    QuadricAdd(Context.PositionQuadrics[To].Q, Context.PositionQuadrics[From].Q);
+    Context.PositionQuadrics[To].W += Context.PositionQuadrics[From].W;
+
+    uint32_t Wedge = From;
+    do
+    {
+        if (Context.WedgeTargets[Wedge] != NoWedge)
+            AttributeQuadricAdd(Context.AttributeQuadrics[Context.WedgeTargets[Wedge]], Context.AttributeQuadrics[Wedge]);
+        Wedge = Context.NextWedge[Wedge];
+    } while (Wedge != From);
+
+    int RemovedTriangles = 0;
+    for (uint32_t i = Context.TriangleOffsets[From]; i < Context.TriangleOffsets[From + 1]; ++i)
+    {
+        uint32_t* Triangle = &Context.Indices[Context.Triangles[i] * 3];
+        if (IsTriangleCollapsed(Context, Triangle))
+            continue;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            if (Context.PositionIds[Triangle[j]] == From)
+                Triangle[j] = Context.WedgeTargets[Triangle[j]];
+        }
+        RemovedTriangles += IsTriangleCollapsed(Context, Triangle) ? 1 : 0;
+    }
+
+    ClearWedgeTargets(Context, From);
+    return RemovedTriangles;
+}
+
+static float GetExtent(const vertex_full* Vertices, int VertexCount, v3* MinOut)
+{
+    v3 Min = VertexCount ? Vertices[0].Position : v3{};
+    v3 Max = Min;
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            Min.e[j] = Math::Min(Min.e[j], Vertices[i].Position.e[j]);
+            Max.e[j] = Math::Max(Max.e[j], Vertices[i].Position.e[j]);
+        }
+    }
+    if (MinOut)
+        *MinOut = Min;
+    return Math::Max(Max.x - Min.x, Math::Max(Max.y - Min.y, Max.z - Min.z));
+}
+
+int Mesh::Simplify(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float TargetError, float* ResultError)
+{
+    simplify_context Context;
+    Context.VertexCount = VertexCount;
+    Context.Indices.assign(Indices, Indices + IndexCount);
+    Context.WedgeTargets.assign(VertexCount, NoWedge);
+    BuildPositionIds(Context, Vertices);
+
+    // Work in a unit cube so that errors and attribute weights do not depend on the mesh scale
+    v3 Min;
+    float Extent = GetExtent(Vertices, VertexCount, &Min);
+    float InvExtent = (Extent > 0.f) ? 1.f / Extent : 0.f;
+    Context.Positions.resize(VertexCount);
+    Context.Attributes.resize((size_t)VertexCount * SIMPLIFY_ATTRIBUTE_COUNT);
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        const vertex_full& Vertex = Vertices[i];
+        Context.Positions[i] = (Vertex.Position - Min) * InvExtent;
+        float* Attributes = &Context.Attributes[(size_t)i * SIMPLIFY_ATTRIBUTE_COUNT];
+        Attributes[0] = Vertex.Normal.x * SIMPLIFY_NORMAL_WEIGHT;
+        Attributes[1] = Vertex.Normal.y * SIMPLIFY_NORMAL_WEIGHT;
+        Attributes[2] = Vertex.Normal.z * SIMPLIFY_NORMAL_WEIGHT;
+        Attributes[3] = Vertex.UV.x * SIMPLIFY_UV_WEIGHT;
+        Attributes[4] = Vertex.UV.y * SIMPLIFY_UV_WEIGHT;
+    }
+
+    std::vector<simplify_edge> Edges;
+    BuildEdges(Edges, Context);
+    BuildQuadrics(Context, Edges);
+
+    std::vector<simplify_collapse> Collapses;
+    std::vector<uint8_t> Locked(VertexCount);
+    int TriangleCount = IndexCount / 3;
+    int TargetTriangleCount = TargetIndexCount / 3;
+    float ErrorLimit = TargetError * TargetError;
+    float MaxError = 0.f;
+
+    while (TriangleCount > TargetTriangleCount)
+    {
+        BuildEdges(Edges, Context);
+        ClassifyVertices(Context, Edges);
+        BuildTriangleAdjacency(Context);
+
+        // Cheapest allowed direction of each edge
+        Collapses.clear();
+        for (const simplify_edge& Edge : Edges)
+        {
+            simplify_collapse Best = { 0, 0, FLT_MAX };
+            for (int Direction = 0; Direction < 2; ++Direction)
+            {
+                uint32_t From = Direction ? Edge.P1 : Edge.P0;
+                uint32_t To = Direction ? Edge.P0 : Edge.P1;
+                uint8_t Kind = Context.Kinds[From];
+                if (Kind == VERTEX_LOCKED || (Kind == VERTEX_BORDER && Edge.TriangleCount != 1))
+                    continue;
+
+                float Error = GetCollapseError(Context, From, To);
+                if (Error < Best.Error)
+                    Best = { From, To, Error };
+            }
+            if (Best.Error <= ErrorLimit)
+                Collapses.push_back(Best);
+        }
+        if (Collapses.empty())
+            break;
+
+        std::sort(Collapses.begin(), Collapses.end(), [](const simplify_collapse& A, const simplify_collapse& B) { return A.Error < B.Error; });
+
+        // Each collapse removes about 2 triangles, allow some slack as locked vertices skip collapses
+        size_t CollapseGoal = (TriangleCount - TargetTriangleCount + 1) / 2;
+        float PassErrorLimit = (CollapseGoal < Collapses.size()) ? Collapses[CollapseGoal].Error * 1.5f : FLT_MAX;
+
+        // Apply the collapses without touching the same position twice (quadrics and adjacency stay valid during the pass)
+        std::fill(Locked.begin(), Locked.end(), 0);
+        int AppliedCount = 0;
+        for (const simplify_collapse& Collapse : Collapses)
+        {
+            if (TriangleCount <= TargetTriangleCount || Collapse.Error > PassErrorLimit)
+                break;
+            if (Locked[Collapse.From] || Locked[Collapse.To])
+                continue;
+            if (HasFlippedTriangles(Context, Collapse.From, Collapse.To))
+                continue;
+
+            TriangleCount -= ApplyCollapse(Context, Collapse.From, Collapse.To);
+            Locked[Collapse.From] = Locked[Collapse.To] = 1;
+            MaxError = Math::Max(MaxError, Collapse.Error);
+            AppliedCount++;
+        }
+
+        // Remove collapsed triangles
+        std::vector<uint32_t>& Remaining = Context.Indices;
+        size_t WriteIndex = 0;
+        for (size_t i = 0; i < Remaining.size(); i += 3)
+        {
+            if (IsTriangleCollapsed(Context, &Remaining[i]))
+                continue;
+            for (int j = 0; j < 3; ++j)
+                Remaining[WriteIndex++] = Remaining[i + j];
+        }
+        Remaining.resize(WriteIndex);
+
+        if (AppliedCount == 0)
+            break;
+    }
+
+    std::copy(Context.Indices.begin(), Context.Indices.end(), Destination);
+    if (ResultError)
+        *ResultError = sqrtf(MaxError);
+    return (int)Context.Indices.size();
+}
+
+// ================================================================================================
+// VERTEX CLUSTERING
+// ================================================================================================
+// Assign a dense cell id to each vertex, returns the cell count
+static int ComputeCells(std::vector<uint32_t>& Cells, const std::vector<v3>& Positions, int GridSize)
+{
+    int VertexCount = (int)Positions.size();
+    uint32_t TableSize = 1;
+    while (TableSize < (uint32_t)VertexCount * 2)
+        TableSize *= 2;
+    std::vector<uint32_t> Keys(TableSize, NoWedge);
+    std::vector<uint32_t> Ids(TableSize);
+
+    int CellCount = 0;
+    float Scale = GridSize - 0.5f; // Keep the max coordinate inside the last cell
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        uint32_t X = (uint32_t)(Positions[i].x * Scale);
+        uint32_t Y = (uint32_t)(Positions[i].y * Scale);
+        uint32_t Z = (uint32_t)(Positions[i].z * Scale);
+        uint32_t Key = (Z * GridSize + Y) * GridSize + X;
+
+        uint32_t Slot = (Key * 2654435761u) & (TableSize - 1);
+        while (Keys[Slot] != NoWedge && Keys[Slot] != Key)
+            Slot = (Slot + 1) & (TableSize - 1);
+
+        if (Keys[Slot] == NoWedge)
+        {
+            Keys[Slot] = Key;
+            Ids[Slot] = CellCount++;
+        }
+        Cells[i] = Ids[Slot];
+    }
+    return CellCount;
+}
+
+static int CountClusteredIndices(const uint32_t* Indices, int IndexCount, const std::vector<uint32_t>& Cells)
+{
+    int Count = 0;
+    for (int i = 0; i < IndexCount; i += 3)
+    {
+        uint32_t C0 = Cells[Indices[i + 0]];
+        uint32_t C1 = Cells[Indices[i + 1]];
+        uint32_t C2 = Cells[Indices[i + 2]];
+        Count += (C0 != C1 && C1 != C2 && C2 != C0) ? 3 : 0;
+    }
+    return Count;
+}
+
+int Mesh::SimplifySloppy(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float* ResultError)
+{
+    v3 Min;
+    float Extent = GetExtent(Vertices, VertexCount, &Min);
+    float InvExtent = (Extent > 0.f) ? 1.f / Extent : 0.f;
+    std::vector<v3> Positions(VertexCount);
+    for (int i = 0; i < VertexCount; ++i)
+        Positions[i] = (Vertices[i].Position - Min) * InvExtent;
+
+    // Finest grid keeping at most TargetIndexCount indices (the count roughly grows with the grid size)
+    std::vector<uint32_t> Cells(VertexCount);
+    int GridSize = 1;
+    int MinGridSize = 2;
+    int MaxGridSize = 1024;
+    while (MinGridSize <= MaxGridSize)
+    {
+        int Middle = (MinGridSize + MaxGridSize) / 2;
+        ComputeCells(Cells, Positions, Middle);
+        if (CountClusteredIndices(Indices, IndexCount, Cells) <= TargetIndexCount)
+        {
+            GridSize = Middle;
+            MinGridSize = Middle + 1;
+        }
+        else
+        {
+            MaxGridSize = Middle - 1;
+        }
+    }
+    int CellCount = ComputeCells(Cells, Positions, GridSize);
+
+    // Each cell is replaced by its vertex closest to the planes of the cell triangles
+    std::vector<quadric> CellQuadrics(CellCount, quadric{});
+    for (int i = 0; i < IndexCount; i += 3)
+    {
+        v3 P[3] = { Positions[Indices[i + 0]], Positions[Indices[i + 1]], Positions[Indices[i + 2]] };
+        v3 Normal = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+        float Length = Vec3::Length(Normal);
+        if (Length == 0.f)
+            continue;
+        Normal = Normal / Length;
+        quadric Plane = QuadricFromPlane(Normal, -Vec3::Dot(Normal, P[0]), Length * 0.5f);
+        for (int j = 0; j < 3; ++j)
+            QuadricAdd(CellQuadrics[Cells[Indices[i + j]]], Plane);
+    }
+
+    std::vector<uint32_t> Representatives(CellCount, NoWedge);
+    std::vector<float> RepresentativeErrors(CellCount, FLT_MAX);
+    for (int i = 0; i < IndexCount; ++i)
+    {
+        uint32_t Vertex = Indices[i];
+        uint32_t Cell = Cells[Vertex];
+        float Error = QuadricEval(CellQuadrics[Cell], Positions[Vertex]);
+        if (Error < RepresentativeErrors[Cell])
+        {
+            RepresentativeErrors[Cell] = Error;
+            Representatives[Cell] = Vertex;
+        }
+    }
+
+    // Keep non-degenerate triangles once (rotated to start with the smallest index to detect duplicates)
+    struct triangle { uint32_t V[3]; };
+    std::vector<triangle> Triangles;
+    float MaxError = 0.f;
+    for (int i = 0; i < IndexCount; i += 3)
+    {
+        triangle Triangle;
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t Vertex = Indices[i + j];
+            Triangle.V[j] = Representatives[Cells[Vertex]];
+            MaxError = Math::Max(MaxError, Vec3::Length(Positions[Triangle.V[j]] - Positions[Vertex]));
+        }
+        if (Triangle.V[0] == Triangle.V[1] || Triangle.V[1] == Triangle.V[2] || Triangle.V[2] == Triangle.V[0])
+            continue;
+
+        while (Triangle.V[0] > Triangle.V[1] || Triangle.V[0] > Triangle.V[2])
+            Triangle = { { Triangle.V[1], Triangle.V[2], Triangle.V[0] } };
+        Triangles.push_back(Triangle);
+    }
+
+    auto Less = [](const triangle& A, const triangle& B) { return memcmp(A.V, B.V, sizeof(A.V)) < 0; };
+    auto Equal = [](const triangle& A, const triangle& B) { return memcmp(A.V, B.V, sizeof(A.V)) == 0; };
+    std::sort(Triangles.begin(), Triangles.end(), Less);
+    Triangles.erase(std::unique(Triangles.begin(), Triangles.end(), Equal), Triangles.end());
+
+    for (size_t i = 0; i < Triangles.size(); ++i)
+        memcpy(&Destination[i * 3], Triangles[i].V, sizeof(Triangles[i].V));
+    if (ResultError)
+        *ResultError = MaxError;
+    return (int)Triangles.size() * 3;
+}
+
+// ================================================================================================
+// LEVELS OF DETAIL
+// ================================================================================================
+void Mesh::BuildLods(indexed_mesh& Mesh, int MaxLodCount)
+{
+    int VertexCount = (int)Mesh.Vertices.size();
+    float Extent = GetExtent(Mesh.Vertices.data(), VertexCount, nullptr);
+
+    Mesh.Lods.clear();
+    Mesh.Lods.push_back({ 0, (uint32_t)Mesh.Indices.size(), 0.f });
+
+    std::vector<uint32_t> Indices;
+    while ((int)Mesh.Lods.size() < MaxLodCount)
+    {
+        mesh_lod Previous = Mesh.Lods.back();
+        int TargetIndexCount = (int)Previous.IndexCount / 6 * 3;
+
+        Indices.resize(Previous.IndexCount);
+        float Error = 0.f;
+        int IndexCount = Simplify(Indices.data(), &Mesh.Indices[Previous.IndexOffset], (int)Previous.IndexCount,
+            Mesh.Vertices.data(), VertexCount, TargetIndexCount, 0.05f, &Error);
+
+        // Edge collapses keep seams and borders, fallback to vertex clustering when they stall
+        if (IndexCount > (int)Previous.IndexCount * 9 / 10)
+            IndexCount = SimplifySloppy(Indices.data(), &Mesh.Indices[Previous.IndexOffset], (int)Previous.IndexCount,
+                Mesh.Vertices.data(), VertexCount, TargetIndexCount, &Error);
+
+        // Stop when the mesh cannot be simplified further
+        if (IndexCount == 0 || IndexCount > (int)Previous.IndexCount * 9 / 10)
+            break;
+
+        OptimizeVertexCache(Indices.data(), IndexCount, VertexCount);
+
+        // Errors are measured against the previous level
+        mesh_lod Lod = { (uint32_t)Mesh.Indices.size(), (uint32_t)IndexCount, Previous.Error + Error * Extent };
+        Mesh.Indices.insert(Mesh.Indices.end(), Indices.begin(), Indices.begin() + IndexCount);
+        Mesh.Lods.push_back(Lod);
+    }
+}
@@ -0,0 +1,277 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "maths.h"
+#include "simd.h"
+#include "mesh.h"
+
+// Vectorized Mesh::Transform for float layouts: vertex_full and packed positions (v3 array)
+// Operations are done in the same order as the scalar code (no fma) so the results are identical.
+
+enum transform_layout
+{
+    TRANSFORM_LAYOUT_UNSUPPORTED,
+    TRANSFORM_LAYOUT_FULL,     // vertex_full
+    TRANSFORM_LAYOUT_POSITION, // v3
+};
+
+static transform_layout GetTransformLayout(const vertex_descriptor& Descriptor)
+{
+    if (Descriptor.PositionFormat != VERTEX_FORMAT_FLOAT || Descriptor.PositionOffset != 0)
+        return TRANSFORM_LAYOUT_UNSUPPORTED;
+
+    if (Descriptor.HasNormal)
+    {
+        if (Descriptor.Stride == sizeof(vertex_full) && Descriptor.NormalFormat == VERTEX_FORMAT_FLOAT
+            && Descriptor.NormalOffset == offsetof(vertex_full, Normal))
+            return TRANSFORM_LAYOUT_FULL;
+    }
+    else if (Descriptor.Stride == sizeof(v3))
+    {
+        return TRANSFORM_LAYOUT_POSITION;
+    }
+    return TRANSFORM_LAYOUT_UNSUPPORTED;
+}
+
+#if SIMD_X86
+// ================================================================================================
+// SSE4.1 (4 vertices per iteration)
+// ================================================================================================
+#define SSE_TRANSPOSE4(R0, R1, R2, R3)                           \
+    {                                                            \
+        __m128 T0 = _mm_unpacklo_ps(R0, R1);                     \
+        __m128 T1 = _mm_unpacklo_ps(R2, R3);                     \
+        __m128 T2 = _mm_unpackhi_ps(R0, R1);                     \
+        __m128 T3 = _mm_unpackhi_ps(R2, R3);                     \
+        R0 = _mm_shuffle_ps(T0, T1, _MM_SHUFFLE(1, 0, 1, 0));    \
+        R1 = _mm_shuffle_ps(T0, T1, _MM_SHUFFLE(3, 2, 3, 2));    \
+        R2 = _mm_shuffle_ps(T2, T3, _MM_SHUFFLE(1, 0, 1, 0));    \
+        R3 = _mm_shuffle_ps(T2, T3, _MM_SHUFFLE(3, 2, 3, 2));    \
+    }
+
+SIMD_TARGET_SSE41
+static void TransformPositionsSSE(const __m128* M, __m128& X, __m128& Y, __m128& Z)
+{
+    __m128 TX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X, M[0]), _mm_mul_ps(Y, M[4])), _mm_mul_ps(Z, M[8])), M[12]);
+    __m128 TY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X, M[1]), _mm_mul_ps(Y, M[5])), _mm_mul_ps(Z, M[9])), M[13]);
+    __m128 TZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X, M[2]), _mm_mul_ps(Y, M[6])), _mm_mul_ps(Z, M[10])), M[14]);
+    __m128 TW = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X, M[3]), _mm_mul_ps(Y, M[7])), _mm_mul_ps(Z, M[11])), M[15]);
+
+    __m128 InvW = _mm_div_ps(_mm_set1_ps(1.f), TW);
+    X = _mm_mul_ps(TX, InvW);
+    Y = _mm_mul_ps(TY, InvW);
+    Z = _mm_mul_ps(TZ, InvW);
+}
+
+SIMD_TARGET_SSE41
+static void TransformNormalsSSE(const __m128* N, __m128& X, __m128& Y, __m128& Z)
+{
+    __m128 TX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, N[0]), _mm_mul_ps(Y, N[4])), _mm_mul_ps(Z, N[8]));
+    __m128 TY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, N[1]), _mm_mul_ps(Y, N[5])), _mm_mul_ps(Z, N[9]));
+    __m128 TZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, N[2]), _mm_mul_ps(Y, N[6])), _mm_mul_ps(Z, N[10]));
+
+    __m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(TX, TX), _mm_mul_ps(TY, TY)), _mm_mul_ps(TZ, TZ)));
+    __m128 InvLength = _mm_div_ps(_mm_set1_ps(1.f), Length);
+    X = _mm_mul_ps(TX, InvLength);
+    Y = _mm_mul_ps(TY, InvLength);
+    Z = _mm_mul_ps(TZ, InvLength);
+}
+
+SIMD_TARGET_SSE41
+static int TransformSSE(float* Vertices, int Count, transform_layout Layout, const mat4& Transform, const mat4& NormalMatrix)
+{
+    __m128 M[16];
+    __m128 N[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        M[i] = _mm_set1_ps(Transform.e[i]);
+        N[i] = _mm_set1_ps(NormalMatrix.e[i]);
+    }
+
+    int i = 0;
+    if (Layout == TRANSFORM_LAYOUT_FULL)
+    {
+        // Each vertex is 2 registers: (px py pz nx) (ny nz u v)
+        for (; i + 4 <= Count; i += 4)
+        {
+            float* V = Vertices + i * 8;
+            __m128 A0 = _mm_loadu_ps(V + 0),  B0 = _mm_loadu_ps(V + 4);
+            __m128 A1 = _mm_loadu_ps(V + 8),  B1 = _mm_loadu_ps(V + 12);
+            __m128 A2 = _mm_loadu_ps(V + 16), B2 = _mm_loadu_ps(V + 20);
+            __m128 A3 = _mm_loadu_ps(V + 24), B3 = _mm_loadu_ps(V + 28);
+            SSE_TRANSPOSE4(A0, A1, A2, A3);
+            SSE_TRANSPOSE4(B0, B1, B2, B3);
+
+            TransformPositionsSSE(M, A0, A1, A2);
+            TransformNormalsSSE(N, A3, B0, B1);
+
+            SSE_TRANSPOSE4(A0, A1, A2, A3);
+            SSE_TRANSPOSE4(B0, B1, B2, B3);
+            _mm_storeu_ps(V + 0, A0);  _mm_storeu_ps(V + 4, B0);
+            _mm_storeu_ps(V + 8, A1);  _mm_storeu_ps(V + 12, B1);
+            _mm_storeu_ps(V + 16, A2); _mm_storeu_ps(V + 20, B2);
+            _mm_storeu_ps(V + 24, A3); _mm_storeu_ps(V + 28, B3);
+        }
+    }
+    else
+    {
+        // 4 bytes loads read the x of the next vertex: stop one vertex before the end
+        // and store in order so that the untouched lane is overwritten with the right value.
+        for (; i + 4 < Count; i += 4)
+        {
+            float* V = Vertices + i * 3;
+            __m128 R0 = _mm_loadu_ps(V + 0);
+            __m128 R1 = _mm_loadu_ps(V + 3);
+            __m128 R2 = _mm_loadu_ps(V + 6);
+            __m128 R3 = _mm_loadu_ps(V + 9);
+            SSE_TRANSPOSE4(R0, R1, R2, R3);
+
+            TransformPositionsSSE(M, R0, R1, R2);
+
+            SSE_TRANSPOSE4(R0, R1, R2, R3);
+            _mm_storeu_ps(V + 0, R0);
+            _mm_storeu_ps(V + 3, R1);
+            _mm_storeu_ps(V + 6, R2);
+            _mm_storeu_ps(V + 9, R3);
+        }
+    }
+    return i;
+}
+
+// ================================================================================================
+// AVX2 (8 vertices per iteration, vertex i in the low lane and vertex i+4 in the high lane)
+// ================================================================================================
+#define AVX_TRANSPOSE4(R0, R1, R2, R3)                              \
+    {                                                               \
+        __m256 T0 = _mm256_unpacklo_ps(R0, R1);                     \
+        __m256 T1 = _mm256_unpacklo_ps(R2, R3);                     \
+        __m256 T2 = _mm256_unpackhi_ps(R0, R1);                     \
+        __m256 T3 = _mm256_unpackhi_ps(R2, R3);                     \
+        R0 = _mm256_shuffle_ps(T0, T1, _MM_SHUFFLE(1, 0, 1, 0));    \
+        R1 = _mm256_shuffle_ps(T0, T1, _MM_SHUFFLE(3, 2, 3, 2));    \
+        R2 = _mm256_shuffle_ps(T2, T3, _MM_SHUFFLE(1, 0, 1, 0));    \
+        R3 = _mm256_shuffle_ps(T2, T3, _MM_SHUFFLE(3, 2, 3, 2));    \
+    }
+
+SIMD_TARGET_AVX2
+static __m256 LoadLanesAVX(const float* Low, const float* High)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(Low)), _mm_loadu_ps(High), 1);
+}
+
+SIMD_TARGET_AVX2
+static void StoreLanesAVX(float* Low, float* High, __m256 Value)
+{
+    _mm_storeu_ps(Low, _mm256_castps256_ps128(Value));
+    _mm_storeu_ps(High, _mm256_extractf128_ps(Value, 1));
+}
+
+SIMD_TARGET_AVX2
+static void TransformPositionsAVX(const __m256* M, __m256& X, __m256& Y, __m256& Z)
+{
+    __m256 TX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, M[0]), _mm256_mul_ps(Y, M[4])), _mm256_mul_ps(Z, M[8])), M[12]);
+    __m256 TY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, M[1]), _mm256_mul_ps(Y, M[5])), _mm256_mul_ps(Z, M[9])), M[13]);
+    __m256 TZ = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, M[2]), _mm256_mul_ps(Y, M[6])), _mm256_mul_ps(Z, M[10])), M[14]);
+    __m256 TW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, M[3]), _mm256_mul_ps(Y, M[7])), _mm256_mul_ps(Z, M[11])), M[15]);
+
+    __m256 InvW = _mm256_div_ps(_mm256_set1_ps(1.f), TW);
+    X = _mm256_mul_ps(TX, InvW);
+    Y = _mm256_mul_ps(TY, InvW);
+    Z = _mm256_mul_ps(TZ, InvW);
+}
+
+SIMD_TARGET_AVX2
+static void TransformNormalsAVX(const __m256* N, __m256& X, __m256& Y, __m256& Z)
+{
+    __m256 TX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, N[0]), _mm256_mul_ps(Y, N[4])), _mm256_mul_ps(Z, N[8]));
+    __m256 TY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, N[1]), _mm256_mul_ps(Y, N[5])), _mm256_mul_ps(Z, N[9]));
+    __m256 TZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, N[2]), _mm256_mul_ps(Y, N[6])), _mm256_mul_ps(Z, N[10]));
+
+    __m256 Length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(TX, TX), _mm256_mul_ps(TY, TY)), _mm256_mul_ps(TZ, TZ)));
+    __m256 InvLength = _mm256_div_ps(_mm256_set1_ps(1.f), Length);
+    X = _mm256_mul_ps(TX, InvLength);
+    Y = _mm256_mul_ps(TY, InvLength);
+    Z = _mm256_mul_ps(TZ, InvLength);
+}
+
+SIMD_TARGET_AVX2
+static int TransformAVX(float* Vertices, int Count, transform_layout Layout, const mat4& Transform, const mat4& NormalMatrix)
+{
+    __m256 M[16];
+    __m256 N[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        M[i] = _mm256_set1_ps(Transform.e[i]);
+        N[i] = _mm256_set1_ps(NormalMatrix.e[i]);
+    }
+
+    int i = 0;
+    if (Layout == TRANSFORM_LAYOUT_FULL)
+    {
+        for (; i + 8 <= Count; i += 8)
+        {
+            float* V = Vertices + i * 8;
+            float* H = V + 4 * 8;
+            __m256 A0 = LoadLanesAVX(V + 0,  H + 0),  B0 = LoadLanesAVX(V + 4,  H + 4);
+            __m256 A1 = LoadLanesAVX(V + 8,  H + 8),  B1 = LoadLanesAVX(V + 12, H + 12);
+            __m256 A2 = LoadLanesAVX(V + 16, H + 16), B2 = LoadLanesAVX(V + 20, H + 20);
+            __m256 A3 = LoadLanesAVX(V + 24, H + 24), B3 = LoadLanesAVX(V + 28, H + 28);
+            AVX_TRANSPOSE4(A0, A1, A2, A3);
+            AVX_TRANSPOSE4(B0, B1, B2, B3);
+
+            TransformPositionsAVX(M, A0, A1, A2);
+            TransformNormalsAVX(N, A3, B0, B1);
+
+            AVX_TRANSPOSE4(A0, A1, A2, A3);
+            AVX_TRANSPOSE4(B0, B1, B2, B3);
+            StoreLanesAVX(V + 0,  H + 0,  A0); StoreLanesAVX(V + 4,  H + 4,  B0);
+            StoreLanesAVX(V + 8,  H + 8,  A1); StoreLanesAVX(V + 12, H + 12, B1);
+            StoreLanesAVX(V + 16, H + 16, A2); StoreLanesAVX(V + 20, H + 20, B2);
+            StoreLanesAVX(V + 24, H + 24, A3); StoreLanesAVX(V + 28, H + 28, B3);
+        }
+    }
+    else
+    {
+        // Same overlapping scheme as the SSE version: low lanes are stored before high lanes
+        for (; i + 8 < Count; i += 8)
+        {
+            float* V = Vertices + i * 3;
+            float* H = V + 4 * 3;
+            __m256 R0 = LoadLanesAVX(V + 0, H + 0);
+            __m256 R1 = LoadLanesAVX(V + 3, H + 3);
+            __m256 R2 = LoadLanesAVX(V + 6, H + 6);
+            __m256 R3 = LoadLanesAVX(V + 9, H + 9);
+            AVX_TRANSPOSE4(R0, R1, R2, R3);
+
+            TransformPositionsAVX(M, R0, R1, R2);
+
+            AVX_TRANSPOSE4(R0, R1, R2, R3);
+            _mm_storeu_ps(V + 0, _mm256_castps256_ps128(R0));
+            _mm_storeu_ps(V + 3, _mm256_castps256_ps128(R1));
+            _mm_storeu_ps(V + 6, _mm256_castps256_ps128(R2));
+            _mm_storeu_ps(V + 9, _mm256_castps256_ps128(R3));
+            _mm_storeu_ps(H + 0, _mm256_extractf128_ps(R0, 1));
+            _mm_storeu_ps(H + 3, _mm256_extractf128_ps(R1, 1));
+            _mm_storeu_ps(H + 6, _mm256_extractf128_ps(R2, 1));
+            _mm_storeu_ps(H + 9, _mm256_extractf128_ps(R3, 1));
+        }
+    }
+    return i;
+}
+#endif
+
+int Mesh::TransformSimd(void* Vertices, int Count, const vertex_descriptor& Descriptor, const mat4& Transform, const mat4& NormalMatrix, simd_level SimdLevel)
+{
+    transform_layout Layout = GetTransformLayout(Descriptor);
+    if (Layout == TRANSFORM_LAYOUT_UNSUPPORTED)
+        return 0;
+
+#if SIMD_X86
+    simd_level Level = Math::Min(SimdLevel, Simd::GetSupportedLevel());
+    if (Level == SIMD_AVX2)
+        return TransformAVX((float*)Vertices, Count, Layout, Transform, NormalMatrix);
+    if (Level == SIMD_SSE41)
+        return TransformSSE((float*)Vertices, Count, Layout, Transform, NormalMatrix);
+#endif
+    return 0;
+}
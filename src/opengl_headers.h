@@ -1,2 +1,7 @@
+#include <glad/glad.h>
 
-#include <glad/glad.h>
\ No newline at end of file
+// GL_EXT_texture_compression_s3tc (not part of the core profile)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
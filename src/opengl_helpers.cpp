@@ -1,5 +1,11 @@
 
+#include <atomic>
 #include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <string>
 #include <map>
@@ -7,7 +13,11 @@
 #include <stb_image.h>
 
 #include "platform.h"
+#include "file.h"
+#include "jobs.h"
+#include "maths.h"
 #include "mesh.h"
+#include "texture.h"
 
 #include "opengl_helpers.h"
 
@@ -25,7 +35,7 @@ struct light
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
-    float attenuation[3];
+    vec3 attenuation; // constant, linear, quadratic
 };
 
 struct material
@@ -44,15 +54,13 @@ light gDefaultLight = light(
     vec3(0.2, 0.2, 0.2),
     vec3(0.8, 0.8, 0.8),
     vec3(0.9, 0.9, 0.9),
-    float[3](1.0, 0.0, 0.0));
+    vec3(1.0, 0.0, 0.0));
 
-// Default material
-uniform material gDefaultMaterial = material(
-    vec3(0.2, 0.2, 0.2),
-    vec3(0.8, 0.8, 0.8),
-    vec3(0.0, 0.0, 0.0),
-    vec3(0.0, 0.0, 0.0),
-    0.0);
+// Current material (range of a GL::material_buffer bound to GL::MATERIAL_BLOCK_BINDING)
+layout(std140) uniform uMaterialBlock
+{
+    material uMaterial;
+};
 
 // Phong shading function
 // viewPosition : fragment position in view-space
@@ -96,57 +104,321 @@ vec3 light_shade(light light, material material, vec3 viewPosition, vec3 viewNor
 // =================================
 )GLSL";
 
-void GL::UniformLight(GLuint Program, const char* LightUniformName, const light& Light)
+GL::program_reflection GL::ReflectProgram(GLuint Program)
+{
+	program_reflection Reflection;
+	Reflection.Program = Program;
+
+	GLint Count = 0, MaxLength = 0;
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORMS, &Count);
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &MaxLength);
+	std::vector<char> Name(Math::Max(MaxLength, 1));
+	for (GLuint i = 0; i < (GLuint)Count; ++i)
+	{
+		program_reflection::uniform_info Uniform;
+		glGetActiveUniform(Program, i, (GLsizei)Name.size(), nullptr, &Uniform.Size, &Uniform.Type, Name.data());
+		Uniform.Name = Name.data();
+		if (Uniform.Name.size() > 3 && Uniform.Name.compare(Uniform.Name.size() - 3, 3, "[0]") == 0)
+			Uniform.Name.resize(Uniform.Name.size() - 3);
+
+		// Members of uniform blocks have no location
+		Uniform.Location = glGetUniformLocation(Program, Name.data());
+		glGetActiveUniformsiv(Program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &Uniform.BlockIndex);
+		glGetActiveUniformsiv(Program, 1, &i, GL_UNIFORM_OFFSET, &Uniform.Offset);
+		Reflection.Uniforms.push_back(Uniform);
+	}
+
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_BLOCKS, &Count);
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &MaxLength);
+	Name.resize(Math::Max(MaxLength, 1));
+	for (GLuint i = 0; i < (GLuint)Count; ++i)
+	{
+		program_reflection::block_info Block;
+		glGetActiveUniformBlockName(Program, i, (GLsizei)Name.size(), nullptr, Name.data());
+		glGetActiveUniformBlockiv(Program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &Block.DataSize);
+		Block.Name = Name.data();
+		Block.Index = i;
+		Reflection.Blocks.push_back(Block);
+	}
+
+	return Reflection;
+}
+
+static bool IsIntegerUniformType(GLenum Type)
+{
+	switch (Type)
+	{
+	case GL_INT:
+	case GL_BOOL:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+GLint GL::FindUniform(const program_reflection& Reflection, const char* Name, GLenum Type)
+{
+	for (const program_reflection::uniform_info& Uniform : Reflection.Uniforms)
+	{
+		if (Uniform.Name != Name)
+			continue;
+
+		if (Uniform.Type != Type && !(Type == GL_INT && IsIntegerUniformType(Uniform.Type)))
+		{
+			fprintf(stderr, "Uniform type mismatch: %s (0x%x instead of 0x%x)\n", Name, Uniform.Type, Type);
+			return -1;
+		}
+		return Uniform.Location;
+	}
+	return -1;
+}
+
+GLuint GL::FindUniformBlock(const program_reflection& Reflection, const char* Name)
+{
+	for (const program_reflection::block_info& Block : Reflection.Blocks)
+	{
+		if (Block.Name == Name)
+			return Block.Index;
+	}
+	return GL_INVALID_INDEX;
+}
+
+GL::light_uniforms GL::GetLightUniforms(const program_reflection& Reflection, const char* LightUniformName)
+{
+	light_uniforms Uniforms;
+	std::string Prefix = std::string(LightUniformName) + ".";
+	Uniforms.Enabled      = GetUniform<int>(Reflection, (Prefix + "enabled").c_str());
+	Uniforms.ViewPosition = GetUniform<v4>(Reflection, (Prefix + "viewPosition").c_str());
+	Uniforms.Ambient      = GetUniform<v3>(Reflection, (Prefix + "ambient").c_str());
+	Uniforms.Diffuse      = GetUniform<v3>(Reflection, (Prefix + "diffuse").c_str());
+	Uniforms.Specular     = GetUniform<v3>(Reflection, (Prefix + "specular").c_str());
+	Uniforms.Attenuation  = GetUniform<v3>(Reflection, (Prefix + "attenuation").c_str());
+	return Uniforms;
+}
+
+
+void GL::UniformLight(const light_uniforms& Uniforms, const light& Light)
+{
+	Uniform(Uniforms.Enabled, Light.Enabled);
+	Uniform(Uniforms.ViewPosition, Light.ViewPosition);
+	Uniform(Uniforms.Ambient, Light.Ambient);
+	Uniform(Uniforms.Diffuse, Light.Diffuse);
+	Uniform(Uniforms.Specular, Light.Specular);
+	Uniform(Uniforms.Attenuation, Light.Attenuation);
+}
+
+bool GL::CheckUniformBlockLayout(const program_reflection& Reflection, const char* BlockName, const char* MemberPrefix,
+								 const std140_member* Members, int MemberCount, GLint DataSize)
 {
-	glUseProgram(Program);
-	char UniformMemberName[255];
+	GLuint BlockIndex = FindUniformBlock(Reflection, BlockName);
+	if (BlockIndex == GL_INVALID_INDEX)
+		return true;
 
-	sprintf(UniformMemberName, "%s.enabled", LightUniformName);
-	glUniform1i(glGetUniformLocation(Program, UniformMemberName), Light.Enabled);
+	bool Valid = true;
+	for (const program_reflection::block_info& Block : Reflection.Blocks)
+	{
+		if (Block.Index == BlockIndex && Block.DataSize != DataSize)
+		{
+			fprintf(stderr, "Uniform block size mismatch: %s (%d bytes instead of %d)\n", BlockName, Block.DataSize, DataSize);
+			Valid = false;
+		}
+	}
 
-	sprintf(UniformMemberName, "%s.viewPosition", LightUniformName);
-	glUniform4fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.ViewPosition.e);
+	for (int i = 0; i < MemberCount; ++i)
+	{
+		std::string Name = std::string(MemberPrefix) + Members[i].Name;
+		for (const program_reflection::uniform_info& Uniform : Reflection.Uniforms)
+		{
+			if (Uniform.BlockIndex != (GLint)BlockIndex || Uniform.Name != Name)
+				continue;
+			if (Uniform.Offset != (GLint)Members[i].Offset)
+			{
+				fprintf(stderr, "Uniform block offset mismatch: %s.%s (%d instead of %d)\n", BlockName, Name.c_str(), Uniform.Offset, (int)Members[i].Offset);
+				Valid = false;
+			}
+		}
+	}
+	return Valid;
+}
 
-	sprintf(UniformMemberName, "%s.ambient", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Ambient.e);
+GL::material_buffer GL::CreateMaterialBuffer(const material* Materials, int Count)
+{
+	GLint Alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
 
-	sprintf(UniformMemberName, "%s.diffuse", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Diffuse.e);
+	material_buffer MaterialBuffer = {};
+	MaterialBuffer.Stride = (sizeof(material) + Alignment - 1) / Alignment * Alignment;
+	MaterialBuffer.Count = Count;
 
-	sprintf(UniformMemberName, "%s.specular", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Specular.e);
+	std::vector<uint8_t> Data(MaterialBuffer.Stride * Count);
+	for (int i = 0; i < Count; ++i)
+		memcpy(&Data[MaterialBuffer.Stride * i], &Materials[i], sizeof(material));
 
-	sprintf(UniformMemberName, "%s.attenuation", LightUniformName);
-	glUniform1fv(glGetUniformLocation(Program, UniformMemberName), 3, Light.Attenuation.e);
+	glGenBuffers(1, &MaterialBuffer.Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, MaterialBuffer.Buffer);
+	glBufferData(GL_UNIFORM_BUFFER, Data.size(), Data.data(), GL_STATIC_DRAW);
+	return MaterialBuffer;
 }
 
-void UniformMaterial(GLuint Program, const char* MaterialUniformName, const material& Material)
+void GL::DeleteMaterialBuffer(const material_buffer& MaterialBuffer)
 {
-	glUseProgram(Program);
-	char UniformMemberName[255];
+	glDeleteBuffers(1, &MaterialBuffer.Buffer);
+}
 
-	sprintf(UniformMemberName, "%s.ambient", MaterialUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Material.Ambient.e);
+void GL::UpdateMaterial(const material_buffer& MaterialBuffer, int Index, const material& Material)
+{
+	assert(Index >= 0 && Index < MaterialBuffer.Count);
+	glBindBuffer(GL_UNIFORM_BUFFER, MaterialBuffer.Buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, MaterialBuffer.Stride * Index, sizeof(material), &Material);
+}
 
-	sprintf(UniformMemberName, "%s.diffuse", MaterialUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Material.Diffuse.e);
+void GL::BindMaterial(const material_buffer& MaterialBuffer, int Index)
+{
+	assert(Index >= 0 && Index < MaterialBuffer.Count);
+	glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, MaterialBuffer.Buffer, MaterialBuffer.Stride * Index, sizeof(material));
+}
 
-	sprintf(UniformMemberName, "%s.specular", MaterialUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Material.Specular.e);
+GL::texture_buffer GL::CreateTextureBuffer(GLenum InternalFormat)
+{
+	texture_buffer TextureBuffer = {};
+	glGenBuffers(1, &TextureBuffer.Buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, TextureBuffer.Buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+	glGenTextures(1, &TextureBuffer.Texture);
+	glBindTexture(GL_TEXTURE_BUFFER, TextureBuffer.Texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, InternalFormat, TextureBuffer.Buffer);
+	return TextureBuffer;
+}
 
-	sprintf(UniformMemberName, "%s.emission", MaterialUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Material.Emission.e);
+void GL::DeleteTextureBuffer(const texture_buffer& TextureBuffer)
+{
+	glDeleteTextures(1, &TextureBuffer.Texture);
+	glDeleteBuffers(1, &TextureBuffer.Buffer);
+}
 
-	sprintf(UniformMemberName, "%s.shininess", MaterialUniformName);
-	glUniform1f(glGetUniformLocation(Program, UniformMemberName), Material.Shininess);
+void GL::UploadTextureBuffer(const texture_buffer& TextureBuffer, const void* Data, GLsizeiptr Size)
+{
+	// The texture keeps referencing the buffer object, only its storage changes
+	glBindBuffer(GL_TEXTURE_BUFFER, TextureBuffer.Buffer);
+	glBufferData(GL_TEXTURE_BUFFER, Math::Max<GLsizeiptr>(Size, 16), nullptr, GL_STREAM_DRAW);
+	if (Size > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, Size, Data);
 }
 
-GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+GL::framebuffer GL::CreateFramebuffer(int Width, int Height, int ColorTextureCount, const GLenum* ColorFormats, bool DepthStencilTexture)
 {
-	GLuint Shader = glCreateShader(ShaderType);
+	GLint PreviousFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
+
+	framebuffer Framebuffer = {};
+	Framebuffer.Width = Width;
+	Framebuffer.Height = Height;
+	Framebuffer.ColorTextureCount = Math::Min(ColorTextureCount, (int)framebuffer::MAX_COLOR_TEXTURES);
+	glGenFramebuffers(1, &Framebuffer.FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer.FBO);
+
+	// Color attachments
+	GLenum DrawAttachments[framebuffer::MAX_COLOR_TEXTURES];
+	glGenTextures(Framebuffer.ColorTextureCount, Framebuffer.ColorTextures);
+	for (int i = 0; i < Framebuffer.ColorTextureCount; ++i)
+	{
+		GLuint ColorTexture = Framebuffer.ColorTextures[i];
+		glBindTexture(GL_TEXTURE_2D, ColorTexture);
+		glObjectLabel(GL_TEXTURE, ColorTexture, -1, "ColorTexture");
+		glTexImage2D(GL_TEXTURE_2D, 0, ColorFormats[i], Width, Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, ColorTexture, 0);
+		DrawAttachments[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	glDrawBuffers(Framebuffer.ColorTextureCount, DrawAttachments);
 
-	std::vector<const char*> Sources;
-	Sources.reserve(4);
+	// Depth stencil in a texture only when it is displayed or read by a later pass
+	if (DepthStencilTexture)
+	{
+		glGenTextures(1, &Framebuffer.DepthStencilTexture);
+		glBindTexture(GL_TEXTURE_2D, Framebuffer.DepthStencilTexture);
+		glObjectLabel(GL_TEXTURE, Framebuffer.DepthStencilTexture, -1, "DepthStencilTexture");
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, Width, Height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, Framebuffer.DepthStencilTexture, 0);
+	}
+	else
+	{
+		glGenRenderbuffers(1, &Framebuffer.DepthStencilRenderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, Framebuffer.DepthStencilRenderbuffer);
+		glObjectLabel(GL_RENDERBUFFER, Framebuffer.DepthStencilRenderbuffer, -1, "DepthStencilRenderbuffer");
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, Framebuffer.DepthStencilRenderbuffer);
+	}
+
+	GLenum FramebufferStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (FramebufferStatus != GL_FRAMEBUFFER_COMPLETE)
+		fprintf(stderr, "GL::CreateFramebuffer failed to complete (0x%x)\n", FramebufferStatus);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+	return Framebuffer;
+}
+
+void GL::DeleteFramebuffer(const framebuffer& Framebuffer)
+{
+	glDeleteRenderbuffers(1, &Framebuffer.DepthStencilRenderbuffer);
+	glDeleteTextures(1, &Framebuffer.DepthStencilTexture);
+	glDeleteTextures(Framebuffer.ColorTextureCount, Framebuffer.ColorTextures);
+	glDeleteFramebuffers(1, &Framebuffer.FBO);
+}
+
+static GL::call_counts gCallCounts = {};
+static PFNGLGETUNIFORMLOCATIONPROC gGetUniformLocation = nullptr;
+static PFNGLGETUNIFORMBLOCKINDEXPROC gGetUniformBlockIndex = nullptr;
+
+static GLint APIENTRY CountGetUniformLocation(GLuint Program, const GLchar* Name)
+{
+	gCallCounts.GetUniformLocation++;
+	return gGetUniformLocation(Program, Name);
+}
+
+static GLuint APIENTRY CountGetUniformBlockIndex(GLuint Program, const GLchar* Name)
+{
+	gCallCounts.GetUniformBlockIndex++;
+	return gGetUniformBlockIndex(Program, Name);
+}
+
+void GL::EnableCallCounts()
+{
+	// Must be called after loading GL (once)
+	if (gGetUniformLocation != nullptr)
+		return;
+	gGetUniformLocation = glad_glGetUniformLocation;
+	glad_glGetUniformLocation = CountGetUniformLocation;
+	gGetUniformBlockIndex = glad_glGetUniformBlockIndex;
+	glad_glGetUniformBlockIndex = CountGetUniformBlockIndex;
+}
+
+GL::call_counts GL::GetCallCounts()
+{
+	return gCallCounts;
+}
+
+void GL::ResetCallCounts()
+{
+	gCallCounts = {};
+}
+
+// Strings given to glShaderSource
+static void GetShaderSources(std::vector<const char*>& Sources, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+{
+	Sources.clear();
 	Sources.push_back("#version 330 core");
 
 	if (InjectLightShading)
@@ -154,6 +426,15 @@ GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char**
 
 	for (int i = 0; i < ShaderStrsCount; ++i)
 		Sources.push_back(ShaderStrs[i]);
+}
+
+GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+{
+	GLuint Shader = glCreateShader(ShaderType);
+
+	std::vector<const char*> Sources;
+	Sources.reserve(4);
+	GetShaderSources(Sources, ShaderStrsCount, ShaderStrs, InjectLightShading);
 
 	glShaderSource(Shader, (GLsizei)Sources.size(), &Sources[0], nullptr);
 	glCompileShader(Shader);
@@ -175,9 +456,169 @@ GLuint GL::CompileShader(GLenum ShaderType, const char* ShaderStr, bool InjectLi
 	return GL::CompileShaderEx(ShaderType, 1, &ShaderStr, InjectLightShading);
 }
 
+static void LinkProgram(GLuint Program)
+{
+	glLinkProgram(Program);
+
+	GLint LinkStatus;
+	glGetProgramiv(Program, GL_LINK_STATUS, &LinkStatus);
+	if (LinkStatus == GL_FALSE)
+	{
+		char Infolog[1024];
+		glGetProgramInfoLog(Program, ARRAY_SIZE(Infolog), nullptr, Infolog);
+		fprintf(stderr, "Program error: %s\n", Infolog);
+	}
+}
+
+struct program_cache_header
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Hash;         // Sources and driver (also in the filename)
+	uint32_t BinaryFormat;
+	uint32_t BinarySize;
+};
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x50524249; // "IBRP"
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+static program_cache_stats gProgramCacheStats = {};
+
+// Needs at least one binary format (drivers can expose the extension without any)
+static bool IsProgramBinarySupported()
+{
+	static const bool Supported = []()
+	{
+		if (!GLAD_GL_ARB_get_program_binary)
+			return false;
+		GLint FormatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+		return FormatCount > 0;
+	}();
+	return Supported;
+}
+
+// FNV-1a, the terminator is hashed too so that the string boundaries matter
+static uint64_t HashString(uint64_t Hash, const char* String)
+{
+	const uint64_t Prime = 0x100000001B3ull;
+	for (const char* C = String; *C; ++C)
+		Hash = (Hash ^ (uint8_t)*C) * Prime;
+	return Hash * Prime;
+}
+
+// Binaries are only valid for the driver that produced them
+static uint64_t HashProgram(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
+{
+	uint64_t Hash = 0xCBF29CE484222325ull;
+	Hash = HashString(Hash, (const char*)glGetString(GL_VENDOR));
+	Hash = HashString(Hash, (const char*)glGetString(GL_RENDERER));
+	Hash = HashString(Hash, (const char*)glGetString(GL_VERSION));
+	Hash = HashString(Hash, InjectLightShading ? "1" : "0");
+
+	std::vector<const char*> Sources;
+	GetShaderSources(Sources, VSStringsCount, VSStrings, false);
+	for (const char* Source : Sources)
+		Hash = HashString(Hash, Source);
+	Hash = HashString(Hash, "|");
+	GetShaderSources(Sources, FSStringsCount, FSStrings, InjectLightShading);
+	for (const char* Source : Sources)
+		Hash = HashString(Hash, Source);
+	return Hash;
+}
+
+static std::string GetProgramCacheFilename(uint64_t Hash)
+{
+	char Filename[64];
+	snprintf(Filename, sizeof(Filename), "media/program_%016llx.cache", (unsigned long long)Hash);
+	return Filename;
+}
+
+// Returns 0 if missing, outdated or rejected by the driver
+static GLuint LoadProgramBinary(uint64_t Hash)
+{
+	file_mapping Mapping;
+	if (!File::Map(&Mapping, GetProgramCacheFilename(Hash).c_str()))
+		return 0;
+
+	GLuint Program = 0;
+	const program_cache_header* Header = (const program_cache_header*)Mapping.Data;
+	if (Mapping.Size >= sizeof(program_cache_header)
+	 && Header->Magic == PROGRAM_CACHE_MAGIC
+	 && Header->Version == PROGRAM_CACHE_VERSION
+	 && Header->Hash == Hash
+	 && Header->BinarySize == Mapping.Size - sizeof(program_cache_header))
+	{
+		Program = glCreateProgram();
+		glProgramBinary(Program, Header->BinaryFormat, Header + 1, (GLsizei)Header->BinarySize);
+
+		GLint LinkStatus;
+		glGetProgramiv(Program, GL_LINK_STATUS, &LinkStatus);
+		if (LinkStatus == GL_FALSE)
+		{
+			glDeleteProgram(Program);
+			Program = 0;
+		}
+	}
+	File::Unmap(&Mapping);
+	return Program;
+}
+
+static void SaveProgramBinary(GLuint Program, uint64_t Hash)
+{
+	GLint LinkStatus, BinarySize = 0;
+	glGetProgramiv(Program, GL_LINK_STATUS, &LinkStatus);
+	glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &BinarySize);
+	if (LinkStatus == GL_FALSE || BinarySize <= 0)
+		return;
+
+	program_cache_header Header = {};
+	Header.Magic = PROGRAM_CACHE_MAGIC;
+	Header.Version = PROGRAM_CACHE_VERSION;
+	Header.Hash = Hash;
+	std::vector<uint8_t> Binary(BinarySize);
+	GLenum BinaryFormat = 0;
+	glGetProgramBinary(Program, BinarySize, &BinarySize, &BinaryFormat, Binary.data());
+	Header.BinaryFormat = BinaryFormat;
+	Header.BinarySize = (uint32_t)BinarySize;
+
+	std::string Filename = GetProgramCacheFilename(Hash);
+	const void* Chunks[] = { &Header, Binary.data() };
+	size_t ChunkSizes[] = { sizeof(Header), (size_t)BinarySize };
+	if (!File::WriteAtomic(Filename.c_str(), 2, Chunks, ChunkSizes))
+		fprintf(stderr, "Failed to write program cache: %s\n", Filename.c_str());
+}
+
+// Set after each link or binary load (both start from the initial program state)
+static void BindLightShadingBlocks(GLuint Program)
+{
+	GLuint MaterialBlockIndex = glGetUniformBlockIndex(Program, "uMaterialBlock");
+	if (MaterialBlockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(Program, MaterialBlockIndex, GL::MATERIAL_BLOCK_BINDING);
+}
+
 GLuint GL::CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
 {
+	// Warm cache: no compilation nor link
+	bool BinarySupported = IsProgramBinarySupported();
+	uint64_t Hash = 0;
+	if (BinarySupported)
+	{
+		Hash = HashProgram(VSStringsCount, VSStrings, FSStringsCount, FSStrings, InjectLightShading);
+		GLuint Program = LoadProgramBinary(Hash);
+		if (Program != 0)
+		{
+			gProgramCacheStats.Hits++;
+			if (InjectLightShading)
+				BindLightShadingBlocks(Program);
+			return Program;
+		}
+	}
+	gProgramCacheStats.Misses++;
+
 	GLuint Program = glCreateProgram();
+	if (BinarySupported)
+		glProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
 	GLuint VertexShader = GL::CompileShaderEx(GL_VERTEX_SHADER, VSStringsCount, VSStrings);
 	GLuint FragmentShader = GL::CompileShaderEx(GL_FRAGMENT_SHADER, FSStringsCount, FSStrings, InjectLightShading);
@@ -185,24 +626,67 @@ GLuint GL::CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStr
 	glAttachShader(Program, VertexShader);
 	glAttachShader(Program, FragmentShader);
 
-	glLinkProgram(Program);
+	LinkProgram(Program);
 
 	glDeleteShader(VertexShader);
 	glDeleteShader(FragmentShader);
 
+	if (BinarySupported)
+		SaveProgramBinary(Program, Hash);
+
+	if (InjectLightShading)
+		BindLightShadingBlocks(Program);
 	return Program;
 }
 
+GL::program_cache_stats GL::GetProgramCacheStats()
+{
+	return gProgramCacheStats;
+}
+
 GLuint GL::CreateProgram(const char* VSString, const char* FSString, bool InjectLightShading)
 {
 	return GL::CreateProgramEx(1, &VSString, 1, &FSString, InjectLightShading);
 }
 
-void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+void GL::VertexAttribPointer(GLuint Location, vertex_format Format, int ComponentCount, GLsizei Stride, GLsizei Offset)
 {
-    // Flip
-    stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
+	void* Pointer = (void*)(size_t)Offset;
+	switch (Format)
+	{
+	case VERTEX_FORMAT_FLOAT:      glVertexAttribPointer(Location, ComponentCount, GL_FLOAT, GL_FALSE, Stride, Pointer); break;
+	case VERTEX_FORMAT_HALF:       glVertexAttribPointer(Location, ComponentCount, GL_HALF_FLOAT, GL_FALSE, Stride, Pointer); break;
+	case VERTEX_FORMAT_UNORM16:    glVertexAttribPointer(Location, ComponentCount, GL_UNSIGNED_SHORT, GL_TRUE, Stride, Pointer); break;
+	case VERTEX_FORMAT_SNORM10:    glVertexAttribPointer(Location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, Stride, Pointer); break;
+	case VERTEX_FORMAT_OCTAHEDRAL: glVertexAttribPointer(Location, 2, GL_SHORT, GL_TRUE, Stride, Pointer); break;
+	default: assert(false);
+	}
+}
+
+void GL::SetupVertexAttributes(const vertex_descriptor& Descriptor, GLint PositionLocation, GLint NormalLocation, GLint UVLocation)
+{
+	if (PositionLocation >= 0)
+	{
+		glEnableVertexAttribArray(PositionLocation);
+		GL::VertexAttribPointer(PositionLocation, Descriptor.PositionFormat, 3, Descriptor.Stride, Descriptor.PositionOffset);
+	}
+
+	if (NormalLocation >= 0 && Descriptor.HasNormal)
+	{
+		glEnableVertexAttribArray(NormalLocation);
+		GL::VertexAttribPointer(NormalLocation, Descriptor.NormalFormat, 3, Descriptor.Stride, Descriptor.NormalOffset);
+	}
+
+	if (UVLocation >= 0 && Descriptor.HasUV)
+	{
+		glEnableVertexAttribArray(UVLocation);
+		GL::VertexAttribPointer(UVLocation, Descriptor.UVFormat, 2, Descriptor.Stride, Descriptor.UVOffset);
+	}
+}
 
+// No GL calls (thread safe: rows are flipped here instead of using the global stb_image flag)
+static uint8_t* DecodeImage(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut, int* ChannelsOut)
+{
     // Desired channels
     int DesiredChannels = 0;
 	int Channels = 0;
@@ -223,26 +707,28 @@ void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int*
     if (Image == nullptr)
     {
         fprintf(stderr, "Image loading failed on '%s'\n", Filename);
-        return;
+        return nullptr;
     }
 
-    GLint Format = (Channels == 3) ? GL_RGB : GL_RGBA;
-    
-    // Uploading
-    glTexImage2D(GL_TEXTURE_2D, 0, Format, Width, Height, 0, Format, GL_UNSIGNED_BYTE, Image);
-    stbi_image_free(Image);
-
-    // Mipmaps
-    if (ImageFlags & IMG_GEN_MIPMAPS)
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-    if (WidthOut)
-        *WidthOut = Width;
-
-    if (HeightOut)
-        *HeightOut = Height;
+    // Flip
+    if (ImageFlags & IMG_FLIP)
+    {
+        size_t RowSize = (size_t)Width * Channels;
+        std::vector<uint8_t> Row(RowSize);
+        for (int y = 0; y < Height / 2; ++y)
+        {
+            uint8_t* Top = Image + y * RowSize;
+            uint8_t* Bottom = Image + (Height - 1 - y) * RowSize;
+            memcpy(Row.data(), Top, RowSize);
+            memcpy(Top, Bottom, RowSize);
+            memcpy(Bottom, Row.data(), RowSize);
+        }
+    }
 
-    stbi_set_flip_vertically_on_load(0); // Always reset to default value
+    *WidthOut = Width;
+    *HeightOut = Height;
+    *ChannelsOut = Channels;
+    return Image;
 }
 
 void GL::UploadCheckerboardTexture(int Width, int Height, int SquareSize)
@@ -263,130 +749,1317 @@ void GL::UploadCheckerboardTexture(int Width, int Height, int SquareSize)
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Width, Width, 0, GL_RGBA, GL_FLOAT, &Texels[0]);
 }
 
-struct GL::cache::data
+// CPU side of a mesh load (no GL calls: runs on the background thread for asynchronous loads)
+struct mesh_source
 {
-	struct mesh
-	{
-		GLuint VertexBuffer;
-		int Size;
-	};
+	GL::mesh Mesh;       // Everything but the buffers
+	mesh_cache Cache;    // Mapped if Mesh.WarmCache
+	indexed_mesh TmpMesh;
+	std::vector<uint16_t> TmpIndices16;
+	std::vector<uint8_t> TmpVertices;
+	const void* Vertices;
+	const void* Indices;
+	int IndexSize;       // Bytes per index
+	int TotalIndexCount; // All levels of detail
+};
+
+// CPU side of a texture load (no GL calls: runs on the background thread for asynchronous loads)
+struct texture_source
+{
+	texture_cache Cache;      // Mapped if WarmCache
+	texture_data Texture;     // Built if not WarmCache
+	bool WarmCache;
+	texture_format Format;
+	int Width;
+	int Height;
+	int Channels;             // Of the source image
+	int LevelCount;
+	texture_level Levels[TEXTURE_MAX_LEVELS];
+	const uint8_t* Texels;    // All levels if built (read by chunks from the cache otherwise)
+	size_t Size;              // All levels, 0 if decoding failed
+};
+
+// Value of the cache maps, referenced by handles (map nodes never move)
+struct GL::cache_resource
+{
+	uint64_t* UseCounter = nullptr; // Of the owning cache
+	std::string Name;
+	int RefCount = 0;
+	uint64_t LastUse = 0; // Use counter when last loaded or released
+	size_t Size = 0;      // Bytes in VRAM
+	bool IsMesh = false;
+	bool Pending = false; // Asynchronous load in progress (placeholder until then)
+
+	// Mesh
+	mesh Mesh = {};
+
+	// Texture
+	GLuint TextureID = 0;
+	int Width = 0;
+	int Height = 0;
+};
+
+GL::cache_handle::cache_handle(cache_resource* Resource)
+	: Resource(Resource)
+{
+	if (Resource)
+		Resource->RefCount++;
+}
+
+GL::cache_handle::cache_handle(const cache_handle& Other)
+	: cache_handle(Other.Resource)
+{
+}
+
+GL::cache_handle& GL::cache_handle::operator=(const cache_handle& Other)
+{
+	if (Other.Resource)
+		Other.Resource->RefCount++;
+	Reset();
+	Resource = Other.Resource;
+	return *this;
+}
+
+GL::cache_handle::~cache_handle()
+{
+	Reset();
+}
+
+void GL::cache_handle::Reset()
+{
+	// Unreferenced resources are evicted in least recently released order
+	if (Resource && --Resource->RefCount == 0)
+		Resource->LastUse = ++*Resource->UseCounter;
+	Resource = nullptr;
+}
+
+GLuint GL::cache_handle::GetTexture() const
+{
+	return (Resource && !Resource->IsMesh) ? Resource->TextureID : 0;
+}
+
+const GL::mesh& GL::cache_handle::GetMesh() const
+{
+	static const mesh EmptyMesh = {};
+	return (Resource && Resource->IsMesh) ? Resource->Mesh : EmptyMesh;
+}
 
+struct GL::cache::data
+{
 	struct texture_identifier
 	{
 		std::string Filename;
 		int ImageFlags;
 
+		// The same file can be loaded with different flags
 		bool operator<(const texture_identifier& Other) const
 		{
-			return Filename < Other.Filename;
+			if (Filename != Other.Filename)
+				return Filename < Other.Filename;
+			return ImageFlags < Other.ImageFlags;
 		}
 	};
 
-	struct texture
+	// Asynchronous load: the background task sets Parsed, then Update() uploads the data by slices
+	struct pending_load
 	{
-		GLuint TextureID;
-		int Width;
-		int Height;
+		std::atomic<bool> Parsed{ false };
+		std::chrono::steady_clock::time_point StartTime;
+		bool IsMesh = false;
+
+		// Texture
+		texture_identifier TextureKey;
+		texture_source TextureSource = {};
+		GLuint PixelBuffer = 0;
+
+		// Mesh
+		std::string Filename;
+		std::string MeshKey;
+		float Scale = 1.f;
+		vertex_descriptor Descriptor = {};
+		mesh_source MeshSource = {};
+
+		size_t UploadedSize = 0; // Bytes already copied to the pixel buffer or the mesh buffers
 	};
 
-	std::vector<vertex_full> TmpBuffer;
-	std::map<std::string, mesh> VertexBufferMap;
-	std::map<texture_identifier, texture> TextureMap;
+	// Upload one slice of the load, returns true once the resource is complete
+	bool UploadSlice(pending_load& Load);
+
+	void InitResource(cache_resource& Resource, const std::string& Name, bool IsMesh);
+	void SetResourceSize(cache_resource& Resource, size_t Size);
+	void DeleteResource(cache_resource& Resource);
+	// Delete the least recently used unreferenced resources until the resident size fits the budget
+	void Evict();
+
+	mesh_source TmpSource; // Reused by synchronous loads
+	texture_source TmpTextureSource;
+	std::vector<uint8_t> TextureScratch; // One chunk decompressed from a texture cache
+	bool TextureCompression = false; // S3TC support (BC5 is core)
+	uint64_t UseCounter = 0;
+	size_t Budget = 0;       // Bytes
+	size_t ResidentSize = 0; // Sum of the resource sizes
+	std::map<std::string, cache_resource> MeshMap;
+	std::map<texture_identifier, cache_resource> TextureMap;
+	std::deque<std::unique_ptr<pending_load>> PendingLoads; // Submission order (background tasks complete in the same order)
 };
 
-GL::cache::cache()
+static void ReleaseMeshSource(mesh_source& Source)
 {
-	Data = new cache::data();
+	if (Source.Mesh.WarmCache)
+		Mesh::UnmapObjCache(Source.Cache);
 }
 
-GL::cache::~cache()
+// S3TC is an extension (BC5 is core)
+static bool IsTextureCompressionSupported()
 {
-	for (const auto& KeyValue : Data->TextureMap)
-		glDeleteTextures(1, &KeyValue.second.TextureID);
+	static const bool Supported = []()
+	{
+		GLint ExtensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionCount);
+		for (int i = 0; i < ExtensionCount; ++i)
+		{
+			if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0)
+				return true;
+		}
+		return false;
+	}();
+	return Supported;
+}
 
-	for (const auto& KeyValue : Data->VertexBufferMap)
-		glDeleteBuffers(1, &KeyValue.second.VertexBuffer);
+static void ReleaseTextureSource(texture_source& Source)
+{
+	if (Source.WarmCache)
+		Texture::UnmapCache(Source.Cache);
+	std::vector<uint8_t>().swap(Source.Texture.Data);
+	Source.WarmCache = false;
+	Source.Texels = nullptr;
+	Source.Size = 0;
+}
 
-	delete Data;
+GL::cache::cache(size_t BudgetBytes)
+{
+	Data = new cache::data();
+	Data->TextureCompression = IsTextureCompressionSupported();
+	Data->Budget = BudgetBytes;
 }
 
-GLuint GL::cache::LoadObj(const char* Filename, float Scale, int* VertexCountOut)
+GL::cache::~cache()
 {
-	assert(Data != nullptr);
+	// Background tasks write into the pending loads
+	Jobs::WaitBackground();
+	for (const auto& Load : Data->PendingLoads)
+	{
+		if (Load->IsMesh)
+			ReleaseMeshSource(Load->MeshSource);
+		else
+			ReleaseTextureSource(Load->TextureSource);
+		glDeleteBuffers(1, &Load->PixelBuffer);
+	}
 
-	auto Found = Data->VertexBufferMap.find(Filename);
-	if (Found != Data->VertexBufferMap.end())
+	for (auto& KeyValue : Data->TextureMap)
 	{
-		if (VertexCountOut)
-			*VertexCountOut = Found->second.Size;
-		return Found->second.VertexBuffer;
+		assert(KeyValue.second.RefCount == 0);
+		glDeleteTextures(1, &KeyValue.second.TextureID);
 	}
 
-	Data->TmpBuffer.clear();
-	Mesh::LoadObjNoConvertion(Data->TmpBuffer, Filename, Scale);
+	for (auto& KeyValue : Data->MeshMap)
+	{
+		assert(KeyValue.second.RefCount == 0);
+		glDeleteBuffers(1, &KeyValue.second.Mesh.VertexBuffer);
+		glDeleteBuffers(1, &KeyValue.second.Mesh.IndexBuffer);
+	}
 
-	// Upload mesh to gpu
-	GLuint MeshBuffer = 0;
-	glGenBuffers(1, &MeshBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, MeshBuffer);
-	glBufferData(GL_ARRAY_BUFFER, Data->TmpBuffer.size() * sizeof(vertex_full), &Data->TmpBuffer[0], GL_STATIC_DRAW);
+	delete Data;
+}
 
-	if (VertexCountOut)
-		*VertexCountOut = (int)Data->TmpBuffer.size();
-	
-	Data->VertexBufferMap[Filename] = { MeshBuffer, (int)Data->TmpBuffer.size() };
+void GL::cache::data::InitResource(cache_resource& Resource, const std::string& Name, bool IsMesh)
+{
+	Resource.UseCounter = &UseCounter;
+	Resource.Name = Name;
+	Resource.IsMesh = IsMesh;
+	Resource.LastUse = ++UseCounter;
+}
 
-	return MeshBuffer;
+void GL::cache::data::SetResourceSize(cache_resource& Resource, size_t Size)
+{
+	ResidentSize = ResidentSize - Resource.Size + Size;
+	Resource.Size = Size;
 }
 
-GLuint GL::cache::LoadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+void GL::cache::data::DeleteResource(cache_resource& Resource)
 {
-	assert(Data != nullptr);
+	if (Resource.IsMesh)
+	{
+		glDeleteBuffers(1, &Resource.Mesh.VertexBuffer);
+		glDeleteBuffers(1, &Resource.Mesh.IndexBuffer);
+	}
+	else
+	{
+		glDeleteTextures(1, &Resource.TextureID);
+	}
+	SetResourceSize(Resource, 0);
+}
 
-	GL::cache::data::texture_identifier TextureIdentifier = { Filename, ImageFlags };
-	
-	auto Found = Data->TextureMap.find(TextureIdentifier);
-	if (Found != Data->TextureMap.end())
+// Oldest resource without handles nor pending load (Map.end() if none)
+template <typename map>
+static typename map::iterator FindEvictableResource(map& Map)
+{
+	auto Oldest = Map.end();
+	for (auto It = Map.begin(); It != Map.end(); ++It)
 	{
-		if (WidthOut)  *WidthOut  = Found->second.Width;
-		if (HeightOut) *HeightOut = Found->second.Height;
-		return Found->second.TextureID;
+		const GL::cache_resource& Resource = It->second;
+		if (Resource.RefCount == 0 && !Resource.Pending && (Oldest == Map.end() || Resource.LastUse < Oldest->second.LastUse))
+			Oldest = It;
 	}
+	return Oldest;
+}
+
+void GL::cache::data::Evict()
+{
+	while (ResidentSize > Budget)
+	{
+		auto Mesh = FindEvictableResource(MeshMap);
+		auto Texture = FindEvictableResource(TextureMap);
+		bool HasMesh = (Mesh != MeshMap.end());
+		bool HasTexture = (Texture != TextureMap.end());
+		if (!HasMesh && !HasTexture)
+			break;
+
+		cache_resource& Resource = (HasMesh && (!HasTexture || Mesh->second.LastUse < Texture->second.LastUse)) ? Mesh->second : Texture->second;
+		printf("Evicted: %s (%.1f KB)\n", Resource.Name.c_str(), Resource.Size / 1024.f);
+		DeleteResource(Resource);
+		if (Resource.IsMesh)
+			MeshMap.erase(Mesh);
+		else
+			TextureMap.erase(Texture);
+	}
+}
+
+void GL::cache::SetBudget(size_t BudgetBytes)
+{
+	Data->Budget = BudgetBytes;
+	Data->Evict();
+}
+
+size_t GL::cache::GetBudget() const
+{
+	return Data->Budget;
+}
+
+size_t GL::cache::GetResidentSize() const
+{
+	return Data->ResidentSize;
+}
+
+void GL::cache::GetResources(std::vector<cache_resource_info>& Resources) const
+{
+	Resources.clear();
+	for (const auto& KeyValue : Data->MeshMap)
+		Resources.push_back({ KeyValue.second.Name.c_str(), KeyValue.second.Size, KeyValue.second.RefCount, true, KeyValue.second.Pending });
+	for (const auto& KeyValue : Data->TextureMap)
+		Resources.push_back({ KeyValue.second.Name.c_str(), KeyValue.second.Size, KeyValue.second.RefCount, false, KeyValue.second.Pending });
+}
+
+static void SetCacheStats(GL::mesh* Mesh, const vertex_cache_stats& SourceStats, const vertex_cache_stats& Stats)
+{
+	Mesh->CacheHitRate = Stats.HitRate;
+	Mesh->SourceACMR = SourceStats.ACMR;
+	Mesh->ACMR = Stats.ACMR;
+	Mesh->SourceATVR = SourceStats.ATVR;
+	Mesh->ATVR = Stats.ATVR;
+}
+
+static void SetLodsAndBounds(GL::mesh* Mesh, const mesh_lod* Lods, int LodCount, v3 BoundsMin, v3 BoundsMax)
+{
+	Mesh->LodCount = Math::Min(LodCount, MESH_MAX_LODS);
+	for (int i = 0; i < Mesh->LodCount; ++i)
+		Mesh->Lods[i] = Lods[i];
+	Mesh->IndexCount = (LodCount > 0) ? (int)Lods[0].IndexCount : 0;
+
+	Mesh->BoundsCenter = (BoundsMin + BoundsMax) * 0.5f;
+	Mesh->BoundsRadius = Vec3::Length(BoundsMax - BoundsMin) * 0.5f;
+}
+
+static void SetCullingData(GL::mesh* Mesh, const mesh_range* Ranges, int RangeCount, const mesh_meshlet* Meshlets, int MeshletCount, float Scale)
+{
+	Mesh->Ranges.assign(Ranges, Ranges + RangeCount);
+	for (mesh_range& Range : Mesh->Ranges)
+	{
+		Range.BoundsMin *= Scale;
+		Range.BoundsMax *= Scale;
+		Range.Center *= Scale;
+		Range.Radius *= Scale;
+	}
+
+	Mesh->Meshlets.assign(Meshlets, Meshlets + MeshletCount);
+	for (mesh_meshlet& Meshlet : Mesh->Meshlets)
+	{
+		Meshlet.Center *= Scale;
+		Meshlet.Radius *= Scale;
+	}
+}
+
+static void PrepareMesh(mesh_source& Source, const char* Filename, float Scale, const vertex_descriptor& Descriptor)
+{
+	GL::mesh& Mesh = Source.Mesh;
+	Mesh = {};
+	Mesh.Descriptor = Descriptor;
+
+	// Warm cache: mapped pages are uploaded directly
+	Mesh.WarmCache = Mesh::MapObjCache(Source.Cache, Filename, Scale);
+	if (Mesh.WarmCache)
+	{
+		mesh_cache& Cache = Source.Cache;
+		Mesh.VertexCount = (int)Cache.Header->VertexCount;
+		Source.TotalIndexCount = (int)Cache.Header->IndexCount;
+		SetCacheStats(&Mesh, Cache.Header->SourceCacheStats, Cache.Header->CacheStats);
+		SetLodsAndBounds(&Mesh, Cache.Lods, (int)Cache.Header->LodCount, Cache.BoundsMin, Cache.BoundsMax);
+		for (int i = 0; i < Mesh.LodCount; ++i)
+			Mesh.Lods[i].Error *= Scale;
+		SetCullingData(&Mesh, Cache.Ranges, (int)Cache.Header->RangeCount, Cache.Meshlets, (int)Cache.Header->MeshletCount, Scale);
+		Source.Vertices = Cache.Vertices;
+		Source.Indices = Cache.Indices;
+		Source.IndexSize = (int)Cache.Header->IndexSize;
+	}
+	else
+	{
+		// Cold cache: parse .obj (also writes the cache file)
+		indexed_mesh& TmpMesh = Source.TmpMesh;
+		Mesh::LoadObjIndexed(TmpMesh, Filename, Scale);
+		Mesh.VertexCount = (int)TmpMesh.Vertices.size();
+		Source.TotalIndexCount = (int)TmpMesh.Indices.size();
+		SetCacheStats(&Mesh, TmpMesh.SourceCacheStats, TmpMesh.CacheStats);
+
+		v3 BoundsMin = {}, BoundsMax = {};
+		for (int i = 0; i < Mesh.VertexCount; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				float Value = TmpMesh.Vertices[i].Position.e[j];
+				BoundsMin.e[j] = (i == 0) ? Value : Math::Min(BoundsMin.e[j], Value);
+				BoundsMax.e[j] = (i == 0) ? Value : Math::Max(BoundsMax.e[j], Value);
+			}
+		}
+		SetLodsAndBounds(&Mesh, TmpMesh.Lods.data(), (int)TmpMesh.Lods.size(), BoundsMin, BoundsMax);
+		SetCullingData(&Mesh, TmpMesh.Ranges.data(), (int)TmpMesh.Ranges.size(), TmpMesh.Meshlets.data(), (int)TmpMesh.Meshlets.size(), 1.f);
+		Source.Vertices = TmpMesh.Vertices.data();
+		Source.Indices = TmpMesh.Indices.data();
+		Source.IndexSize = sizeof(uint32_t);
+
+		// Use 16 bits indices when possible
+		if (Mesh.VertexCount <= 0x10000)
+		{
+			Source.TmpIndices16.assign(TmpMesh.Indices.begin(), TmpMesh.Indices.end());
+			Source.Indices = Source.TmpIndices16.data();
+			Source.IndexSize = sizeof(uint16_t);
+		}
+	}
+
+	Mesh.IndexType = (Source.IndexSize == sizeof(uint16_t)) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	// Convert to the requested vertex format
+	vertex_descriptor FullDescriptor = Mesh::PackedDescriptor(VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT);
+	if (memcmp(&Descriptor, &FullDescriptor, sizeof(vertex_descriptor)) != 0)
+	{
+		Source.TmpVertices.resize((size_t)Mesh.VertexCount * Descriptor.Stride);
+		Mesh::ConvertVertices(Source.TmpVertices.data(), Descriptor, (const vertex_full*)Source.Vertices, Mesh.VertexCount);
+		Source.Vertices = Source.TmpVertices.data();
+	}
+}
+
+static void PrintMeshInfo(const GL::mesh& Mesh, const char* Filename, int TotalIndexCount)
+{
+	printf("Loaded mesh: %s in %.2f ms (%s cache)\n", Filename, Mesh.LoadTime, Mesh.WarmCache ? "warm" : "cold");
+
+	// Compare with the previous non-indexed layout (one vertex_full per triangle corner, no post-transform cache reuse)
+	int IndexSize = (Mesh.IndexType == GL_UNSIGNED_SHORT) ? 2 : 4;
+	int FlatSize = Mesh.IndexCount * (int)sizeof(vertex_full);
+	int IndexedSize = Mesh.VertexCount * Mesh.Descriptor.Stride + Mesh.IndexCount * IndexSize;
+	printf("Indexed mesh: %s (%d vertices of %d bytes, %d indices, %d bits) VRAM %.1f KB -> %.1f KB (%.1f KB saved), cache hit rate 0.0%% -> %.1f%%\n",
+		Filename, Mesh.VertexCount, Mesh.Descriptor.Stride, Mesh.IndexCount, IndexSize * 8,
+		FlatSize / 1024.f, IndexedSize / 1024.f, (FlatSize - IndexedSize) / 1024.f, Mesh.CacheHitRate * 100.f);
+	printf("Optimized mesh: %s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", Filename, Mesh.SourceACMR, Mesh.ACMR, Mesh.SourceATVR, Mesh.ATVR);
+	printf("Levels of detail: %s", Filename);
+	for (int i = 0; i < Mesh.LodCount; ++i)
+		printf(" [%d triangles, error %.3f]", (int)Mesh.Lods[i].IndexCount / 3, Mesh.Lods[i].Error);
+	printf(" (%.1f KB of indices)\n", (TotalIndexCount - Mesh.IndexCount) * IndexSize / 1024.f);
+	printf("Culling ranges: %s (%d ranges, %d meshlets)\n", Filename, (int)Mesh.Ranges.size(), (int)Mesh.Meshlets.size());
+}
+
+// Same file can be cached in several vertex formats
+static std::string GetMeshKey(const char* Filename, const vertex_descriptor& Descriptor)
+{
+	std::string Key = Filename;
+	Key += '|';
+	Key += (char)('0' + Descriptor.PositionFormat);
+	Key += (char)('0' + Descriptor.NormalFormat);
+	Key += (char)('0' + Descriptor.UVFormat);
+	return Key;
+}
+
+static float GetMillisecondsSince(std::chrono::steady_clock::time_point StartTime)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+// Vertex and index buffers (all levels of detail)
+static size_t GetMeshSize(const mesh_source& Source)
+{
+	return (size_t)Source.Mesh.VertexCount * Source.Mesh.Descriptor.Stride + (size_t)Source.TotalIndexCount * Source.IndexSize;
+}
+
+GL::cache_handle GL::cache::LoadObj(const char* Filename, float Scale, const vertex_descriptor* Descriptor)
+{
+	assert(Data != nullptr);
+
+	vertex_descriptor FullDescriptor = Mesh::PackedDescriptor(VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT);
+	if (Descriptor == nullptr)
+		Descriptor = &FullDescriptor;
+
+	std::string Key = GetMeshKey(Filename, *Descriptor);
+	auto Found = Data->MeshMap.find(Key);
+	if (Found != Data->MeshMap.end())
+	{
+		// Referenced before updating so that it cannot be evicted
+		cache_handle Handle(&Found->second);
+		Found->second.LastUse = ++Data->UseCounter;
+
+		// Finish the asynchronous loads up to this one
+		if (Found->second.Pending)
+		{
+			Jobs::WaitBackground();
+			Update(FLT_MAX);
+		}
+		return Handle;
+	}
+
+	auto StartTime = std::chrono::steady_clock::now();
+
+	mesh_source& Source = Data->TmpSource;
+	PrepareMesh(Source, Filename, Scale, *Descriptor);
+	mesh Mesh = Source.Mesh;
+
+	// Upload mesh to gpu
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, Mesh.VertexCount * Descriptor->Stride, Source.Vertices, GL_STATIC_DRAW);
+
+	// Bind to no VAO to avoid modifying the element buffer of the currently bound one
+	glBindVertexArray(0);
+	glGenBuffers(1, &Mesh.IndexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh.IndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, Source.TotalIndexCount * Source.IndexSize, Source.Indices, GL_STATIC_DRAW);
+
+	ReleaseMeshSource(Source);
+
+	Mesh.LoadTime = GetMillisecondsSince(StartTime);
+	PrintMeshInfo(Mesh, Filename, Source.TotalIndexCount);
+
+	cache_resource& Resource = Data->MeshMap[Key];
+	Data->InitResource(Resource, Key, true);
+	Resource.Mesh = Mesh;
+	Data->SetResourceSize(Resource, GetMeshSize(Source));
+
+	cache_handle Handle(&Resource);
+	Data->Evict();
+	return Handle;
+}
+
+GL::cache_handle GL::cache::LoadObjAsync(const char* Filename, float Scale, const vertex_descriptor* Descriptor)
+{
+	assert(Data != nullptr);
+
+	vertex_descriptor FullDescriptor = Mesh::PackedDescriptor(VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_FLOAT);
+	if (Descriptor == nullptr)
+		Descriptor = &FullDescriptor;
+
+	std::string Key = GetMeshKey(Filename, *Descriptor);
+	auto Found = Data->MeshMap.find(Key);
+	if (Found != Data->MeshMap.end())
+	{
+		Found->second.LastUse = ++Data->UseCounter;
+		return cache_handle(&Found->second);
+	}
+
+	// Empty mesh until uploaded, its buffer names are final so that vertex arrays can be setup right away
+	cache_resource& Resource = Data->MeshMap[Key];
+	Data->InitResource(Resource, Key, true);
+	Resource.Pending = true;
+	mesh& Mesh = Resource.Mesh;
+	Mesh.Descriptor = *Descriptor;
+	Mesh.IndexType = GL_UNSIGNED_SHORT;
+	Mesh.Pending = true;
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glGenBuffers(1, &Mesh.IndexBuffer);
+
+	data::pending_load* Load = new data::pending_load();
+	Load->StartTime = std::chrono::steady_clock::now();
+	Load->IsMesh = true;
+	Load->Filename = Filename;
+	Load->MeshKey = Key;
+	Load->Scale = Scale;
+	Load->Descriptor = *Descriptor;
+	Data->PendingLoads.emplace_back(Load);
+
+	Jobs::RunInBackground([Load]()
+	{
+		PrepareMesh(Load->MeshSource, Load->Filename.c_str(), Load->Scale, Load->Descriptor);
+		Load->Parsed = true;
+	});
+
+	return cache_handle(&Resource);
+}
+
+static void PrepareTexture(texture_source& Source, const char* Filename, int ImageFlags, bool TextureCompression)
+{
+	Source.Texels = nullptr;
+	Source.Size = 0;
+
+	// BC1/BC3 need S3TC, BC5 is core
+	bool Compress = !(ImageFlags & IMG_UNCOMPRESSED) && (TextureCompression || (ImageFlags & IMG_NORMAL_MAP));
+
+	// Warm cache: mapped levels are uploaded directly (rebuilt if the compression support changed)
+	Source.WarmCache = Texture::MapCache(Source.Cache, Filename, ImageFlags);
+	if (Source.WarmCache && Texture::IsCompressed((texture_format)Source.Cache.Header->Format) != Compress)
+	{
+		Texture::UnmapCache(Source.Cache);
+		Source.WarmCache = false;
+	}
+	if (Source.WarmCache)
+	{
+		const texture_cache_header& Header = *Source.Cache.Header;
+		Source.Format = (texture_format)Header.Format;
+		Source.Width = (int)Header.Width;
+		Source.Height = (int)Header.Height;
+		Source.Channels = (int)Header.Channels;
+		Source.LevelCount = (int)Header.LevelCount;
+		memcpy(Source.Levels, Header.Levels, sizeof(Source.Levels));
+		Source.Size = (size_t)Header.DataSize;
+		return;
+	}
+
+	// Cold cache: decode the image and build the levels (also writes the cache file)
+	int Width, Height, Channels;
+	uint8_t* Image = DecodeImage(Filename, ImageFlags, &Width, &Height, &Channels);
+	if (Image == nullptr)
+		return;
+
+	// Grey (+ alpha) images are expanded to RGBA
+	const uint8_t* Pixels = Image;
+	std::vector<uint8_t> Expanded;
+	if (Channels < 3)
+	{
+		size_t PixelCount = (size_t)Width * Height;
+		Expanded.resize(PixelCount * 4);
+		for (size_t i = 0; i < PixelCount; ++i)
+		{
+			uint8_t Grey = Image[i * Channels];
+			Expanded[i * 4 + 0] = Expanded[i * 4 + 1] = Expanded[i * 4 + 2] = Grey;
+			Expanded[i * 4 + 3] = (Channels == 2) ? Image[i * 2 + 1] : 255;
+		}
+		Pixels = Expanded.data();
+		Channels = 4;
+	}
+
+	texture_format Format = (Channels == 3) ? TEXTURE_FORMAT_RGB8 : TEXTURE_FORMAT_RGBA8;
+	if (Compress)
+		Format = Texture::ChooseCompressedFormat(Pixels, Width, Height, Channels, (ImageFlags & IMG_NORMAL_MAP) != 0);
+
+	int BuildFlags = 0;
+	if (ImageFlags & IMG_GEN_MIPMAPS)
+		BuildFlags |= TEXTURE_BUILD_MIPMAPS;
+	if (ImageFlags & IMG_NORMAL_MAP)
+		BuildFlags |= TEXTURE_BUILD_LINEAR;
+
+	texture_data& Data = Source.Texture;
+	Texture::Build(Data, Pixels, Width, Height, Channels, Format, BuildFlags);
+	stbi_image_free(Image);
+	Texture::SaveCache(Data, Filename, ImageFlags);
+
+	Source.Format = Data.Format;
+	Source.Width = Data.Width;
+	Source.Height = Data.Height;
+	Source.Channels = Data.Channels;
+	Source.LevelCount = Data.LevelCount;
+	memcpy(Source.Levels, Data.Levels, sizeof(Source.Levels));
+	Source.Texels = Data.Data.data();
+	Source.Size = Data.Data.size();
+}
+
+static GLenum GetTextureInternalFormat(texture_format Format)
+{
+	switch (Format)
+	{
+	case TEXTURE_FORMAT_RGB8:  return GL_RGB8;
+	case TEXTURE_FORMAT_BC1:   return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_FORMAT_BC3:   return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TEXTURE_FORMAT_BC5:   return GL_COMPRESSED_RG_RGTC2;
+	default:                   return GL_RGBA8;
+	}
+}
+
+// Specify all the levels of the bound texture, Texels is nullptr + offset when a pixel unpack buffer is bound
+// Target is GL_TEXTURE_2D or a face of the bound GL_TEXTURE_CUBE_MAP
+static void UploadTextureLevels(const texture_source& Source, const uint8_t* Texels, GLenum Target = GL_TEXTURE_2D)
+{
+	GLenum InternalFormat = GetTextureInternalFormat(Source.Format);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < Source.LevelCount; ++i)
+	{
+		const texture_level& Level = Source.Levels[i];
+		if (Texture::IsCompressed(Source.Format))
+			glCompressedTexImage2D(Target, i, InternalFormat, Level.Width, Level.Height, 0, (GLsizei)Level.Size, Texels + Level.Offset);
+		else
+			glTexImage2D(Target, i, InternalFormat, Level.Width, Level.Height, 0, (Source.Format == TEXTURE_FORMAT_RGB8) ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, Texels + Level.Offset);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Placeholder levels beyond are ignored
+	glTexParameteri((Target == GL_TEXTURE_2D) ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, Source.LevelCount - 1);
+}
+
+static void PrintTextureInfo(const texture_source& Source, const char* Filename, float LoadTime)
+{
+	printf("Loaded texture: %s in %.2f ms (%s cache)\n", Filename, LoadTime, Source.WarmCache ? "warm" : "cold");
+
+	// Compare with the uncompressed texels of the same levels
+	texture_format UncompressedFormat = (Source.Channels == 3) ? TEXTURE_FORMAT_RGB8 : TEXTURE_FORMAT_RGBA8;
+	size_t UncompressedSize = 0;
+	for (int i = 0; i < Source.LevelCount; ++i)
+		UncompressedSize += Texture::GetLevelSize(UncompressedFormat, (int)Source.Levels[i].Width, (int)Source.Levels[i].Height);
+	printf("Texture format: %s (%s, %dx%d, %d levels) VRAM %.1f KB -> %.1f KB (%.1f KB saved)\n",
+		Filename, Texture::GetFormatName(Source.Format), Source.Width, Source.Height, Source.LevelCount,
+		UncompressedSize / 1024.f, Source.Size / 1024.f, ((float)UncompressedSize - (float)Source.Size) / 1024.f);
+}
+
+static size_t GetTextureChunkSize(const texture_source& Source, int Chunk)
+{
+	return Math::Min<size_t>(TEXTURE_CACHE_CHUNK_SIZE, Source.Size - (size_t)Chunk * TEXTURE_CACHE_CHUNK_SIZE);
+}
+
+// Texels of a chunk: in memory if built, decompressed to Scratch if read from the cache (nullptr if corrupted).
+// Decompression never targets mapped buffers directly: they can be uncached memory and matches read the output back.
+static const uint8_t* ReadTextureChunk(const texture_source& Source, int Chunk, uint8_t* Scratch)
+{
+	if (!Source.WarmCache)
+		return Source.Texels + (size_t)Chunk * TEXTURE_CACHE_CHUNK_SIZE;
+	return Texture::ReadCacheChunk(Source.Cache, Chunk, Scratch) ? Scratch : nullptr;
+}
+
+// Specify the bound texture, chunks read from the cache are decompressed in parallel into a pixel buffer
+static bool UploadTextureSource(const texture_source& Source, GLenum Target = GL_TEXTURE_2D)
+{
+	if (!Source.WarmCache)
+	{
+		UploadTextureLevels(Source, Source.Texels, Target);
+		return true;
+	}
+
+	GLuint PixelBuffer;
+	glGenBuffers(1, &PixelBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, Source.Size, nullptr, GL_STREAM_DRAW);
+	uint8_t* Texels = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, Source.Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	std::vector<uint8_t> ClientTexels;
+	if (Texels == nullptr)
+	{
+		ClientTexels.resize(Source.Size);
+		Texels = ClientTexels.data();
+	}
+
+	// One scratch chunk per worker
+	int ChunkCount = (int)Source.Cache.Header->ChunkCount;
+	int WorkerCount = Math::Min(Jobs::GetThreadCount(), ChunkCount);
+	std::atomic<bool> Valid{ true };
+	Jobs::ParallelFor(WorkerCount, [&](int Worker)
+	{
+		std::vector<uint8_t> Scratch(TEXTURE_CACHE_CHUNK_SIZE);
+		for (int Chunk = Worker; Chunk < ChunkCount; Chunk += WorkerCount)
+		{
+			if (Texture::ReadCacheChunk(Source.Cache, Chunk, Scratch.data()))
+				memcpy(Texels + (size_t)Chunk * TEXTURE_CACHE_CHUNK_SIZE, Scratch.data(), GetTextureChunkSize(Source, Chunk));
+			else
+				Valid = false;
+		}
+	});
+
+	if (ClientTexels.empty())
+	{
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		if (Valid)
+			UploadTextureLevels(Source, nullptr, Target);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (Valid)
+			UploadTextureLevels(Source, ClientTexels.data(), Target);
+	}
+	glDeleteBuffers(1, &PixelBuffer);
+	return Valid;
+}
+
+void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+{
+	texture_source Source = {};
+	PrepareTexture(Source, Filename, ImageFlags, IsTextureCompressionSupported());
+	if (Source.Size > 0 && !UploadTextureSource(Source))
+		fprintf(stderr, "Corrupted texture cache: %s\n", Filename);
+
+	if (WidthOut)
+		*WidthOut = Source.Width;
+
+	if (HeightOut)
+		*HeightOut = Source.Height;
+
+	ReleaseTextureSource(Source);
+}
+
+// Same file can be cached with several image flags
+static std::string GetTextureName(const char* Filename, int ImageFlags)
+{
+	char Flags[16];
+	snprintf(Flags, sizeof(Flags), "|0x%x", ImageFlags);
+	return std::string(Filename) + Flags;
+}
+
+GL::cache_handle GL::cache::LoadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+{
+	assert(Data != nullptr);
+
+	GL::cache::data::texture_identifier TextureIdentifier = { Filename, ImageFlags };
+	
+	auto Found = Data->TextureMap.find(TextureIdentifier);
+	if (Found != Data->TextureMap.end())
+	{
+		// Referenced before updating so that it cannot be evicted
+		cache_handle Handle(&Found->second);
+		Found->second.LastUse = ++Data->UseCounter;
+
+		// Finish the asynchronous loads up to this one
+		if (Found->second.Pending)
+		{
+			Jobs::WaitBackground();
+			Update(FLT_MAX);
+		}
+		if (WidthOut)  *WidthOut  = Found->second.Width;
+		if (HeightOut) *HeightOut = Found->second.Height;
+		return Handle;
+	}
+
+	auto StartTime = std::chrono::steady_clock::now();
+
+	texture_source& Source = Data->TmpTextureSource;
+	PrepareTexture(Source, Filename, ImageFlags, Data->TextureCompression);
 
 	GLuint Texture;
 	glGenTextures(1, &Texture);
 	glBindTexture(GL_TEXTURE_2D, Texture);
-	int Width, Height;
-	GL::UploadTexture(Filename, ImageFlags, &Width, &Height);
+	int Width = 0, Height = 0;
+	size_t Size = 0;
+	if (Source.Size > 0)
+	{
+		if (UploadTextureSource(Source))
+		{
+			Width = Source.Width;
+			Height = Source.Height;
+			Size = Source.Size;
+			PrintTextureInfo(Source, Filename, GetMillisecondsSince(StartTime));
+		}
+		else
+		{
+			fprintf(stderr, "Corrupted texture cache: %s\n", Filename);
+		}
+	}
+	ReleaseTextureSource(Source);
 
 	if (WidthOut)  *WidthOut  = Width;
 	if (HeightOut) *HeightOut = Height;
 
-	Data->TextureMap[TextureIdentifier] = { Texture, Width, Height };
+	cache_resource& Resource = Data->TextureMap[TextureIdentifier];
+	Data->InitResource(Resource, GetTextureName(Filename, ImageFlags), false);
+	Resource.TextureID = Texture;
+	Resource.Width = Width;
+	Resource.Height = Height;
+	Data->SetResourceSize(Resource, Size);
+
+	cache_handle Handle(&Resource);
+	Data->Evict();
+	return Handle;
+}
+
+GL::cache_handle GL::cache::LoadCubemap(const char* const Filenames[6], int ImageFlags)
+{
+	assert(Data != nullptr);
+
+	// Keyed by all the faces
+	std::string Faces = Filenames[0];
+	for (int i = 1; i < 6; ++i)
+		Faces += std::string(";") + Filenames[i];
+	GL::cache::data::texture_identifier TextureIdentifier = { Faces, ImageFlags };
+
+	auto Found = Data->TextureMap.find(TextureIdentifier);
+	if (Found != Data->TextureMap.end())
+	{
+		Found->second.LastUse = ++Data->UseCounter;
+		return cache_handle(&Found->second);
+	}
+
+	auto StartTime = std::chrono::steady_clock::now();
+
+	GLuint Texture;
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, Texture);
+	int Width = 0, Height = 0;
+	size_t Size = 0;
+	bool WarmCache = true;
+	texture_source& Source = Data->TmpTextureSource;
+	for (int i = 0; i < 6; ++i)
+	{
+		// Faces must have the same size and format to be complete
+		PrepareTexture(Source, Filenames[i], ImageFlags, Data->TextureCompression);
+		if (Source.Size > 0 && UploadTextureSource(Source, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i))
+		{
+			Width = Source.Width;
+			Height = Source.Height;
+			Size += Source.Size;
+			WarmCache = WarmCache && Source.WarmCache;
+		}
+		else
+		{
+			fprintf(stderr, "Failed to load cubemap face: %s\n", Filenames[i]);
+		}
+		ReleaseTextureSource(Source);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, (ImageFlags & IMG_GEN_MIPMAPS) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	printf("Loaded cubemap: %s (%dx%d, %.1f KB) in %.2f ms (%s cache)\n", Filenames[0], Width, Height, Size / 1024.f,
+		GetMillisecondsSince(StartTime), WarmCache ? "warm" : "cold");
+
+	cache_resource& Resource = Data->TextureMap[TextureIdentifier];
+	Data->InitResource(Resource, GetTextureName(Filenames[0], ImageFlags) + " (cubemap)", false);
+	Resource.TextureID = Texture;
+	Resource.Width = Width;
+	Resource.Height = Height;
+	Data->SetResourceSize(Resource, Size);
+
+	cache_handle Handle(&Resource);
+	Data->Evict();
+	return Handle;
+}
+
+GL::cache_handle GL::cache::LoadTextureAsync(const char* Filename, int ImageFlags)
+{
+	assert(Data != nullptr);
+
+	GL::cache::data::texture_identifier TextureIdentifier = { Filename, ImageFlags };
+
+	auto Found = Data->TextureMap.find(TextureIdentifier);
+	if (Found != Data->TextureMap.end())
+	{
+		Found->second.LastUse = ++Data->UseCounter;
+		return cache_handle(&Found->second);
+	}
 
-	return Texture;
+	// Checkerboard until uploaded
+	const int PlaceholderSize = 64;
+	GLuint Texture;
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	GL::UploadCheckerboardTexture(PlaceholderSize, PlaceholderSize, 8);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0); // Complete with mipmap filters
+
+	cache_resource& Resource = Data->TextureMap[TextureIdentifier];
+	Data->InitResource(Resource, GetTextureName(Filename, ImageFlags), false);
+	Resource.TextureID = Texture;
+	Resource.Width = PlaceholderSize;
+	Resource.Height = PlaceholderSize;
+	Resource.Pending = true;
+	Data->SetResourceSize(Resource, PlaceholderSize * PlaceholderSize * 4);
+
+	data::pending_load* Load = new data::pending_load();
+	Load->StartTime = std::chrono::steady_clock::now();
+	Load->TextureKey = TextureIdentifier;
+	Data->PendingLoads.emplace_back(Load);
+
+	bool TextureCompression = Data->TextureCompression;
+	Jobs::RunInBackground([Load, TextureCompression]()
+	{
+		PrepareTexture(Load->TextureSource, Load->TextureKey.Filename.c_str(), Load->TextureKey.ImageFlags, TextureCompression);
+		Load->Parsed = true;
+	});
+
+	return cache_handle(&Resource);
+}
+
+// Copy to a buffer range that the GPU never used (no synchronization needed)
+static void CopyToBuffer(GLenum Target, size_t Offset, const void* Source, size_t Size)
+{
+	void* Destination = glMapBufferRange(Target, Offset, Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (Destination == nullptr)
+	{
+		glBufferSubData(Target, Offset, Size, Source);
+		return;
+	}
+	memcpy(Destination, Source, Size);
+	glUnmapBuffer(Target);
+}
+
+static const size_t gUploadSliceSize = 256 * 1024;
+
+bool GL::cache::data::UploadSlice(pending_load& Load)
+{
+	if (Load.IsMesh)
+	{
+		cache_resource& Resource = MeshMap[Load.MeshKey];
+		mesh& Mesh = Resource.Mesh;
+		mesh_source& Source = Load.MeshSource;
+		size_t VertexSize = (size_t)Source.Mesh.VertexCount * Load.Descriptor.Stride;
+		size_t IndexSize = (size_t)Source.TotalIndexCount * Source.IndexSize;
+
+		// Bind to no VAO to avoid modifying the element buffer of the currently bound one
+		glBindVertexArray(0);
+		if (Load.UploadedSize == 0)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, VertexSize, nullptr, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh.IndexBuffer);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexSize, nullptr, GL_STATIC_DRAW);
+		}
+
+		// Vertices then indices
+		if (Load.UploadedSize < VertexSize + IndexSize)
+		{
+			bool Vertices = Load.UploadedSize < VertexSize;
+			GLenum Target = Vertices ? GL_ARRAY_BUFFER : GL_ELEMENT_ARRAY_BUFFER;
+			size_t Offset = Vertices ? Load.UploadedSize : Load.UploadedSize - VertexSize;
+			size_t SliceSize = Math::Min(gUploadSliceSize, (Vertices ? VertexSize : IndexSize) - Offset);
+			const uint8_t* Src = (const uint8_t*)(Vertices ? Source.Vertices : Source.Indices) + Offset;
+
+			glBindBuffer(Target, Vertices ? Mesh.VertexBuffer : Mesh.IndexBuffer);
+			CopyToBuffer(Target, Offset, Src, SliceSize);
+			Load.UploadedSize += SliceSize;
+			return false;
+		}
+
+		// Publish the mesh data (buffer names are unchanged)
+		GLuint VertexBuffer = Mesh.VertexBuffer;
+		GLuint IndexBuffer = Mesh.IndexBuffer;
+		Mesh = Source.Mesh;
+		Mesh.VertexBuffer = VertexBuffer;
+		Mesh.IndexBuffer = IndexBuffer;
+		Mesh.LoadTime = GetMillisecondsSince(Load.StartTime);
+		Resource.Pending = false;
+		SetResourceSize(Resource, GetMeshSize(Source));
+		ReleaseMeshSource(Source);
+		PrintMeshInfo(Mesh, Load.Filename.c_str(), Source.TotalIndexCount);
+		return true;
+	}
+
+	cache_resource& Texture = TextureMap[Load.TextureKey];
+	texture_source& Source = Load.TextureSource;
+	if (Source.Size == 0)
+	{
+		// Keep the placeholder
+		Texture.Pending = false;
+		return true;
+	}
+
+	// All levels are copied to a pixel buffer one chunk per slice (decompressed if read from the cache),
+	// then the texture is specified from it at once
+	if (Load.PixelBuffer == 0)
+	{
+		glGenBuffers(1, &Load.PixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Load.PixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, Source.Size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Load.PixelBuffer);
+
+	if (Load.UploadedSize < Source.Size)
+	{
+		int Chunk = (int)(Load.UploadedSize / TEXTURE_CACHE_CHUNK_SIZE);
+		size_t ChunkSize = GetTextureChunkSize(Source, Chunk);
+		TextureScratch.resize(TEXTURE_CACHE_CHUNK_SIZE);
+		const uint8_t* Texels = ReadTextureChunk(Source, Chunk, TextureScratch.data());
+		if (Texels)
+			CopyToBuffer(GL_PIXEL_UNPACK_BUFFER, Load.UploadedSize, Texels, ChunkSize);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		Load.UploadedSize += ChunkSize;
+		if (Texels)
+			return false;
+
+		// Keep the placeholder
+		fprintf(stderr, "Corrupted texture cache: %s\n", Load.TextureKey.Filename.c_str());
+		glDeleteBuffers(1, &Load.PixelBuffer);
+		Load.PixelBuffer = 0;
+		Texture.Pending = false;
+		ReleaseTextureSource(Source);
+		return true;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, Texture.TextureID);
+	UploadTextureLevels(Source, nullptr);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &Load.PixelBuffer);
+	Load.PixelBuffer = 0;
+
+	Texture.Width = Source.Width;
+	Texture.Height = Source.Height;
+	Texture.Pending = false;
+	SetResourceSize(Texture, Source.Size);
+	PrintTextureInfo(Source, Load.TextureKey.Filename.c_str(), GetMillisecondsSince(Load.StartTime));
+	ReleaseTextureSource(Source);
+	return true;
+}
+
+void GL::cache::Update(float BudgetMilliseconds)
+{
+	assert(Data != nullptr);
+
+	auto StartTime = std::chrono::steady_clock::now();
+	while (!Data->PendingLoads.empty() && GetMillisecondsSince(StartTime) < BudgetMilliseconds)
+	{
+		// Background tasks complete in submission order
+		data::pending_load& Load = *Data->PendingLoads.front();
+		if (!Load.Parsed)
+			break;
+
+		if (Data->UploadSlice(Load))
+			Data->PendingLoads.pop_front();
+	}
+
+	Data->Evict();
+}
+
+int GL::cache::GetPendingLoadCount() const
+{
+	return (int)Data->PendingLoads.size();
+}
+
+GL::mesh GL::StreamObj(const char* Filename, float Scale, const vertex_descriptor& Descriptor, size_t MemoryBudget, obj_stream_stats* Stats)
+{
+	auto StartTime = std::chrono::steady_clock::now();
+
+	// Half of the budget for the file blocks, half for the mapped window (whole vertices)
+	size_t BlockSize = Math::Max<size_t>(MemoryBudget / 2, 4096);
+	size_t WindowSize = Math::Max<size_t>(MemoryBudget / 2 / Descriptor.Stride, 1) * Descriptor.Stride;
+
+	mesh Mesh = {};
+	Mesh.Descriptor = Descriptor;
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+
+	size_t BufferSize = 0;
+	size_t WindowOffset = 0;
+	size_t WindowCapacity = 0;
+	size_t WindowUsed = 0;
+	uint8_t* Window = nullptr;
+	bool MapFailed = false;
+
+	auto Begin = [&](int VertexCount)
+	{
+		Mesh.VertexCount = VertexCount;
+		BufferSize = (size_t)VertexCount * Descriptor.Stride;
+		glBufferData(GL_ARRAY_BUFFER, BufferSize, nullptr, GL_STATIC_DRAW);
+	};
+
+	auto Write = [&](const vertex_full* Vertices, int Count)
+	{
+		while (Count > 0 && !MapFailed)
+		{
+			// Invalidated range: the driver does not need to preserve nor synchronize the previous content
+			if (Window == nullptr)
+			{
+				WindowCapacity = Math::Min(WindowSize, BufferSize - WindowOffset);
+				WindowUsed = 0;
+				Window = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, WindowOffset, WindowCapacity, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+				MapFailed = (Window == nullptr);
+				if (MapFailed)
+					break;
+			}
+
+			int WindowCount = Math::Min(Count, (int)((WindowCapacity - WindowUsed) / Descriptor.Stride));
+			Mesh::ConvertVertices(Window + WindowUsed, Descriptor, Vertices, WindowCount);
+			WindowUsed += (size_t)WindowCount * Descriptor.Stride;
+			Vertices += WindowCount;
+			Count -= WindowCount;
+
+			if (WindowUsed == WindowCapacity)
+			{
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+				WindowOffset += WindowCapacity;
+				Window = nullptr;
+			}
+		}
+	};
+
+	bool Success = Mesh::StreamObj(Filename, Scale, BlockSize, Begin, Write, Stats);
+	if (Window != nullptr)
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	if (!Success || MapFailed)
+	{
+		glDeleteBuffers(1, &Mesh.VertexBuffer);
+		return mesh{};
+	}
+
+	Mesh.LoadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	return Mesh;
+}
+
+GL::gpu_query::gpu_query(GLenum Target)
+	: Target(Target)
+{
+	glGenQueries(QUERY_COUNT, Queries);
+}
+
+GL::gpu_query::~gpu_query()
+{
+	glDeleteQueries(QUERY_COUNT, Queries);
+}
+
+void GL::gpu_query::Begin()
+{
+	// Oldest query of the ring is read before being reused
+	GLuint Query = Queries[Frame % QUERY_COUNT];
+	if (Frame >= QUERY_COUNT)
+	{
+		GLuint Available = 0;
+		glGetQueryObjectuiv(Query, GL_QUERY_RESULT_AVAILABLE, &Available);
+		if (Available)
+			glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Result);
+	}
+	glBeginQuery(Target, Query);
+}
+
+void GL::gpu_query::End()
+{
+	glEndQuery(Target);
+	Frame++;
+}
+
+GL::uniform_ring::uniform_ring(GLsizeiptr FrameSize)
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+	this->FrameSize = (FrameSize + Alignment - 1) / Alignment * Alignment;
+
+	glGenBuffers(1, &Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+	glBufferData(GL_UNIFORM_BUFFER, this->FrameSize * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW);
+}
+
+GL::uniform_ring::~uniform_ring()
+{
+	for (GLsync Fence : Fences)
+		glDeleteSync(Fence);
+	glDeleteBuffers(1, &Buffer);
+}
+
+void GL::uniform_ring::BeginFrame()
+{
+	assert(Mapped == nullptr);
+	glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+
+	// Nothing can be in flight in a new buffer
+	if (Overflow)
+	{
+		for (GLsync& Fence : Fences)
+		{
+			glDeleteSync(Fence);
+			Fence = nullptr;
+		}
+		FrameSize *= 2;
+		glBufferData(GL_UNIFORM_BUFFER, FrameSize * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW);
+		Overflow = false;
+	}
+
+	// Wait until the GPU has consumed this region FRAMES_IN_FLIGHT frames ago
+	Region = (Region + 1) % FRAMES_IN_FLIGHT;
+	WaitTime = 0.f;
+	if (Fences[Region] != nullptr)
+	{
+		auto StartTime = std::chrono::steady_clock::now();
+		while (glClientWaitSync(Fences[Region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+		WaitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+		glDeleteSync(Fences[Region]);
+		Fences[Region] = nullptr;
+	}
+
+	GLbitfield Access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+	Mapped = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, FrameSize * Region, FrameSize, Access);
+	UsedSize = 0;
+}
+
+GLintptr GL::uniform_ring::Push(const void* Data, GLsizeiptr Size)
+{
+	assert(Mapped != nullptr);
+	if (UsedSize + Size > FrameSize)
+	{
+		Overflow = true;
+		return -1;
+	}
+
+	GLintptr Offset = UsedSize;
+	memcpy(Mapped + Offset, Data, Size);
+	UsedSize = (UsedSize + Size + Alignment - 1) / Alignment * Alignment;
+	return FrameSize * Region + Offset;
+}
+
+void GL::uniform_ring::Unmap()
+{
+	assert(Mapped != nullptr);
+	glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+	if (UsedSize > 0)
+		glFlushMappedBufferRange(GL_UNIFORM_BUFFER, 0, UsedSize);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	Mapped = nullptr;
+	LastUsedSize = UsedSize;
+}
+
+void GL::uniform_ring::EndFrame()
+{
+	assert(Mapped == nullptr);
+	Fences[Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 struct GL::debug::data
 {
 	GLuint WireframeProgram;
+	GL::uniform<mat4> WireframeModelViewProj;
 	GLuint WireframeVAO;
-	std::vector<v3> BaryBufferData;
-	GLuint BaryBuffer;
 };
 
 static const char* gWireframeVertexShaderStr = R"GLSL(
 layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec3 aBC;
 uniform mat4 uModelViewProj;
-out vec3 vBC;
 
 void main()
 {
-    vBC = aBC;
     gl_Position = uModelViewProj * vec4(aPosition, 1.0);
 })GLSL";
 
+// Generate barycentric coordinates per triangle (works with shared vertices of indexed meshes)
+static const char* gWireframeGeometryShaderStr = R"GLSL(
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+out vec3 vBC;
+
+void main()
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        vBC = vec3(i == 0, i == 1, i == 2);
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+})GLSL";
+
 static const char* gWireframeFragmentShaderStr = R"GLSL(
 in vec3 vBC;
 out vec4 oColor;
@@ -408,49 +2081,43 @@ void main()
 GL::debug::debug()
 {
 	Data = new debug::data();
-	Data->WireframeProgram = GL::CreateProgram(gWireframeVertexShaderStr, gWireframeFragmentShaderStr);
-	glGenBuffers(1, &Data->BaryBuffer);
+
+	GLuint VertexShader = GL::CompileShader(GL_VERTEX_SHADER, gWireframeVertexShaderStr);
+	GLuint GeometryShader = GL::CompileShader(GL_GEOMETRY_SHADER, gWireframeGeometryShaderStr);
+	GLuint FragmentShader = GL::CompileShader(GL_FRAGMENT_SHADER, gWireframeFragmentShaderStr);
+	Data->WireframeProgram = glCreateProgram();
+	glAttachShader(Data->WireframeProgram, VertexShader);
+	glAttachShader(Data->WireframeProgram, GeometryShader);
+	glAttachShader(Data->WireframeProgram, FragmentShader);
+	LinkProgram(Data->WireframeProgram);
+	Data->WireframeModelViewProj = GetUniform<mat4>(ReflectProgram(Data->WireframeProgram), "uModelViewProj");
+	glDeleteShader(VertexShader);
+	glDeleteShader(GeometryShader);
+	glDeleteShader(FragmentShader);
+
 	glGenVertexArrays(1, &Data->WireframeVAO);
 	glBindVertexArray(Data->WireframeVAO);
 	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
 }
 
 GL::debug::~debug()
 {
 	glDeleteProgram(Data->WireframeProgram);
 	glDeleteVertexArrays(1, &Data->WireframeVAO);
-	glDeleteBuffers(1, &Data->BaryBuffer);
 	delete Data;
 }
 
-void GL::debug::WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, int VertexCount)
+void GL::debug::WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, GLuint MeshIBO)
 {
 	assert(Data != nullptr);
-	assert(VertexCount % 3 == 0);
 
 	// Bind vertex array
 	glBindVertexArray(Data->WireframeVAO);
 
-	// Build more barycentric coordinates attributes if needed
-	if (VertexCount > Data->BaryBufferData.size())
-	{
-		int OldSize = (int)Data->BaryBufferData.size();
-		Data->BaryBufferData.resize(VertexCount);
-		for (int i = OldSize; i < VertexCount; i += 3)
-		{
-			Data->BaryBufferData[i + 0] = { 1.f, 0.f, 0.f };
-			Data->BaryBufferData[i + 1] = { 0.f, 1.f, 0.f };
-			Data->BaryBufferData[i + 2] = { 0.f, 0.f, 1.f };
-		}
-		glBindBuffer(GL_ARRAY_BUFFER, Data->BaryBuffer);
-		glBufferData(GL_ARRAY_BUFFER, Data->BaryBufferData.size() * sizeof(v3), &Data->BaryBufferData[0], GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	}
-
-	// Bind position buffer
+	// Bind position buffer (and index buffer)
 	glBindBuffer(GL_ARRAY_BUFFER, MeshVBO);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, PositionStride, (void*)(size_t)PositionOffset);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MeshIBO);
 
 	// Setup rendering
 	glDisable(GL_DEPTH_TEST);
@@ -458,6 +2125,12 @@ void GL::debug::WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+void GL::debug::WireframePrepare(GLuint MeshVBO, const vertex_descriptor& Descriptor, GLuint MeshIBO)
+{
+	WireframePrepare(MeshVBO, Descriptor.Stride, Descriptor.PositionOffset, MeshIBO);
+	GL::VertexAttribPointer(0, Descriptor.PositionFormat, 3, Descriptor.Stride, Descriptor.PositionOffset);
+}
+
 void GL::debug::WireframeDrawArray(GLint First, GLsizei Count, const mat4& MVP)
 {
 	assert(Data != nullptr);
@@ -465,6 +2138,17 @@ void GL::debug::WireframeDrawArray(GLint First, GLsizei Count, const mat4& MVP)
 	glUseProgram(Data->WireframeProgram);
 	//glUniform1f(glGetUniformLocation(Data->WireframeShader, "uLineWidth"), LineWidth);
 	//glUniform4fv(glGetUniformLocation(Data->WireframeShader, "uLineColor"), 1, LineColor.e);
-	glUniformMatrix4fv(glGetUniformLocation(Data->WireframeProgram, "uModelViewProj"), 1, GL_FALSE, MVP.e);
+	Uniform(Data->WireframeModelViewProj, MVP);
 	glDrawArrays(GL_TRIANGLES, First, Count);
 }
+
+
+void GL::debug::WireframeDrawElements(GLsizei Count, GLenum IndexType, const mat4& MVP, GLsizei First)
+{
+	assert(Data != nullptr);
+
+	glUseProgram(Data->WireframeProgram);
+	Uniform(Data->WireframeModelViewProj, MVP);
+	GLsizei IndexSize = (IndexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+	glDrawElements(GL_TRIANGLES, Count, IndexType, (void*)((size_t)First * IndexSize));
+}
\ No newline at end of file
@@ -1,30 +1,36 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
+
 #include "opengl_headers.h"
 #include "types.h"
+#include "mesh.h"
 
 enum image_flags
 {
-    IMG_FLIP        = 1 << 0,
-    IMG_FORCE_RGB   = 1 << 1,
-    IMG_FORCE_RGBA  = 1 << 2,
-    IMG_GEN_MIPMAPS = 1 << 3,
+    IMG_FLIP         = 1 << 0,
+    IMG_FORCE_RGB    = 1 << 1,
+    IMG_FORCE_RGBA   = 1 << 2,
+    IMG_GEN_MIPMAPS  = 1 << 3, // Filtered on the CPU (gamma correct, alpha coverage preserving) and stored in the texture cache
+    IMG_NORMAL_MAP   = 1 << 4, // Compressed to BC5 (xy only), filtered without sRGB decoding
+    IMG_UNCOMPRESSED = 1 << 5, // Keep RGB8/RGBA8 texels instead of BC1/BC3
 };
 
 namespace GL
 {
-    // Same memory layout than 'struct light' in glsl shader
+    // Same memory layout than 'struct light' in glsl shader (std140)
     struct alignas(16) light
     {
         int Enabled; float _Pad0[3];
         v4 ViewPosition; // (must be in view-space/eye-coordinates)
         v3 Ambient;  float _Pad1;
         v3 Diffuse;  float _Pad2;
-        v3 Specular;
+        v3 Specular; float _Pad3;
         v3 Attenuation;
     };
 
-    // Same memory layout than 'struct material' in glsl shader
+    // Same memory layout than 'struct material' in glsl shader (std140)
     struct alignas(16) material
     {
         v3 Ambient;  float _Pad0;
@@ -34,44 +40,420 @@ namespace GL
         float Shininess;
     };
 
+    // Member of a C++ struct mirrored by a glsl struct inside a std140 uniform block
+    struct std140_member
+    {
+        const char* Name; // glsl name
+        GLenum Type;      // Scalars, vectors and mat4 (no arrays or nested structs)
+        size_t Offset;    // offsetof() the C++ member
+    };
+
+    constexpr size_t Std140Alignment(GLenum Type)
+    {
+        switch (Type)
+        {
+        case GL_FLOAT_VEC2: return 8;
+        case GL_FLOAT_VEC3:
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_FLOAT_MAT4: return 16;
+        default:            return 4; // GL_BOOL, GL_INT, GL_FLOAT
+        }
+    }
+
+    constexpr size_t Std140Size(GLenum Type)
+    {
+        switch (Type)
+        {
+        case GL_FLOAT_VEC2: return 8;
+        case GL_FLOAT_VEC3: return 12;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:   return 16;
+        case GL_FLOAT_MAT4: return 64;
+        default:            return 4;
+        }
+    }
+
+    // Members must be listed in declaration order, StructSize is the array stride (rounded up to a vec4)
+    template <size_t N>
+    constexpr bool IsStd140Layout(const std140_member (&Members)[N], size_t StructSize)
+    {
+        size_t Offset = 0;
+        for (size_t i = 0; i < N; ++i)
+        {
+            size_t Alignment = Std140Alignment(Members[i].Type);
+            Offset = (Offset + Alignment - 1) / Alignment * Alignment;
+            if (Members[i].Offset != Offset)
+                return false;
+            Offset += Std140Size(Members[i].Type);
+        }
+        return StructSize == (Offset + 15) / 16 * 16;
+    }
+
+    constexpr std140_member LightLayout[] =
+    {
+        { "enabled",      GL_BOOL,       offsetof(light, Enabled) },
+        { "viewPosition", GL_FLOAT_VEC4, offsetof(light, ViewPosition) },
+        { "ambient",      GL_FLOAT_VEC3, offsetof(light, Ambient) },
+        { "diffuse",      GL_FLOAT_VEC3, offsetof(light, Diffuse) },
+        { "specular",     GL_FLOAT_VEC3, offsetof(light, Specular) },
+        { "attenuation",  GL_FLOAT_VEC3, offsetof(light, Attenuation) },
+    };
+    static_assert(IsStd140Layout(LightLayout, sizeof(light)), "GL::light does not match the std140 layout of 'struct light'");
+
+    constexpr std140_member MaterialLayout[] =
+    {
+        { "ambient",   GL_FLOAT_VEC3, offsetof(material, Ambient) },
+        { "diffuse",   GL_FLOAT_VEC3, offsetof(material, Diffuse) },
+        { "specular",  GL_FLOAT_VEC3, offsetof(material, Specular) },
+        { "emission",  GL_FLOAT_VEC3, offsetof(material, Emission) },
+        { "shininess", GL_FLOAT,      offsetof(material, Shininess) },
+    };
+    static_assert(IsStd140Layout(MaterialLayout, sizeof(material)), "GL::material does not match the std140 layout of 'struct material'");
+
+    // Indexed triangle mesh stored in VRAM
+    struct mesh
+    {
+        GLuint VertexBuffer; // Vertices in Descriptor format
+        GLuint IndexBuffer;
+        GLenum IndexType;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        int VertexCount;
+        int IndexCount;
+        float CacheHitRate;  // Simulated post-transform cache hit rate
+        float SourceACMR;    // Average cache miss ratio before/after optimization
+        float ACMR;
+        float SourceATVR;    // Average transform to vertex ratio before/after optimization
+        float ATVR;
+        float LoadTime;      // Milliseconds spent inside GL::cache::LoadObj or GL::StreamObj
+        bool WarmCache;      // Loaded from the mesh cache file
+        bool Pending;        // Asynchronous load in progress (empty mesh until then)
+        vertex_descriptor Descriptor;
+        int LodCount;
+        mesh_lod Lods[MESH_MAX_LODS]; // Index ranges inside IndexBuffer (Lods[0] is the full mesh, IndexCount indices)
+        v3 BoundsCenter;     // Bounding sphere
+        float BoundsRadius;
+        std::vector<mesh_range> Ranges; // Culling ranges partitioning Lods[0]
+        std::vector<mesh_meshlet> Meshlets; // Partition of Ranges
+    };
+
+    struct cache_resource;
+
+    // Reference counted handle to a resource of GL::cache (must be released before the cache is destroyed).
+    // Resources without handles stay resident until the cache exceeds its VRAM budget, the next Load call reloads evicted ones.
+    class cache_handle
+    {
+    public:
+        cache_handle() = default;
+        explicit cache_handle(cache_resource* Resource);
+        cache_handle(const cache_handle& Other);
+        cache_handle& operator=(const cache_handle& Other);
+        ~cache_handle();
+        void Reset();
+        bool IsValid() const { return Resource != nullptr; }
+        // Up to date data: GL names of asynchronous loads are final, the mesh is complete once not Pending anymore
+        GLuint GetTexture() const;
+        const mesh& GetMesh() const;
+
+    private:
+        cache_resource* Resource = nullptr;
+    };
+
+    struct cache_resource_info
+    {
+        const char* Name;
+        size_t Size;  // Bytes in VRAM
+        int RefCount; // Handles
+        bool IsMesh;
+        bool Pending;
+    };
+
     class cache
     {
     public:
-        cache();
+        cache(size_t BudgetBytes = 256 * 1024 * 1024);
         ~cache();
-        GLuint LoadObj(const char* Filename, float Scale, int* VertexCountOut);
-        GLuint LoadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
+        // Descriptor defaults to vertex_full layout (must be a PackedDescriptor)
+        cache_handle LoadObj(const char* Filename, float Scale, const vertex_descriptor* Descriptor = nullptr);
+        // Textures are block compressed with their mipmaps and cached next to the image ("<filename>.<image flags>.cache")
+        cache_handle LoadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
+        // GL_TEXTURE_CUBE_MAP from 6 images (+X, -X, +Y, -Y, +Z, -Z), each face goes through the texture cache
+        cache_handle LoadCubemap(const char* const Filenames[6], int ImageFlags = 0);
+
+        // Asynchronous versions: return placeholders right away (empty mesh, checkerboard texture) and keep their GL names once loaded.
+        // Parsing and decoding run on the background thread, Update() uploads the results.
+        cache_handle LoadObjAsync(const char* Filename, float Scale, const vertex_descriptor* Descriptor = nullptr);
+        cache_handle LoadTextureAsync(const char* Filename, int ImageFlags = 0);
+        // Upload the loaded resources by slices (through pixel buffers for textures) until BudgetMilliseconds is spent, call once per frame
+        void Update(float BudgetMilliseconds = 2.f);
+        int GetPendingLoadCount() const;
+
+        // Unreferenced resources are evicted (least recently used first) while the resident size exceeds the budget
+        void SetBudget(size_t BudgetBytes);
+        size_t GetBudget() const;
+        size_t GetResidentSize() const;
+        void GetResources(std::vector<cache_resource_info>& Resources) const;
+
     private:
         struct data;
         data* Data = nullptr;
     };
 
+    // Query result of the commands between Begin() and End() (results are read a few frames later to avoid stalls)
+    class gpu_query
+    {
+    public:
+        gpu_query(GLenum Target);
+        ~gpu_query();
+        gpu_query(const gpu_query&) = delete;
+        gpu_query& operator=(const gpu_query&) = delete;
+        void Begin();
+        void End();
+        // Latest available result
+        GLuint64 GetResult() const { return Result; }
+
+    private:
+        static const int QUERY_COUNT = 4;
+        GLenum Target;
+        GLuint Queries[QUERY_COUNT] = {};
+        int Frame = 0;
+        GLuint64 Result = 0;
+    };
+
+    // GPU time
+    class gpu_timer : public gpu_query
+    {
+    public:
+        gpu_timer() : gpu_query(GL_TIME_ELAPSED) {}
+        float GetMilliseconds() const { return GetResult() / 1000000.f; }
+    };
+
+    // Samples that passed the depth test
+    class gpu_sample_counter : public gpu_query
+    {
+    public:
+        gpu_sample_counter() : gpu_query(GL_SAMPLES_PASSED) {}
+    };
+
+    // Frame scoped allocator of uniform data: one buffer split in FRAMES_IN_FLIGHT regions
+    // Each region is mapped unsynchronized once per frame, after waiting for the fence of its previous use
+    class uniform_ring
+    {
+    public:
+        uniform_ring(GLsizeiptr FrameSize);
+        ~uniform_ring();
+        uniform_ring(const uniform_ring&) = delete;
+        uniform_ring& operator=(const uniform_ring&) = delete;
+
+        // Map the next region (the buffer grows here if the previous frame overflowed)
+        void BeginFrame();
+        // Copy to the mapped region, returns the offset in the buffer (-1 if the region is full)
+        GLintptr Push(const void* Data, GLsizeiptr Size);
+        template <typename T> GLintptr Push(const T& Value) { return Push(&Value, sizeof(T)); }
+        // Flush the written range (before the draws reading it)
+        void Unmap();
+        // Fence the region (after the last draw reading it)
+        void EndFrame();
+
+        void Bind(GLuint Binding, GLintptr Offset, GLsizeiptr Size) const { glBindBufferRange(GL_UNIFORM_BUFFER, Binding, Buffer, Offset, Size); }
+
+        GLsizeiptr GetFrameSize() const { return FrameSize; }
+        GLsizeiptr GetUsedSize() const { return LastUsedSize; } // Bytes pushed during the last frame
+        float GetWaitTime() const { return WaitTime; }          // Milliseconds blocked on the fence by the last BeginFrame()
+
+    private:
+        static const int FRAMES_IN_FLIGHT = 3;
+        GLuint Buffer = 0;
+        GLsizeiptr FrameSize;
+        GLint Alignment = 256;
+        GLsync Fences[FRAMES_IN_FLIGHT] = {};
+        int Region = 0;
+        uint8_t* Mapped = nullptr;
+        GLsizeiptr UsedSize = 0;
+        GLsizeiptr LastUsedSize = 0;
+        bool Overflow = false;
+        float WaitTime = 0.f;
+    };
+
     class debug
     {
     public:
         debug();
         ~debug();
-        // Provide wireframe renderer information on how the positions are stored inside the MeshVBO
-        void WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, int VertexCount);
+        // Provide wireframe renderer information on how the positions are stored inside the MeshVBO (and optional MeshIBO)
+        void WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, GLuint MeshIBO = 0);
+        void WireframePrepare(GLuint MeshVBO, const vertex_descriptor& Descriptor, GLuint MeshIBO = 0);
         // Draw previously prepared buffer (must be triangles)
         void WireframeDrawArray(GLint First, GLsizei Count, const mat4& MVP);
+        void WireframeDrawElements(GLsizei Count, GLenum IndexType, const mat4& MVP, GLsizei First = 0);
 
     private:
         struct data;
         data* Data = nullptr;
     };
 
-    void UniformLight(GLuint Program, const char* LightUniformName, const light& Light);
-    void UniformMaterial(GLuint Program, const char* MaterialUniformName, const material& Material);
+    // Active uniforms and uniform blocks of a linked program, enumerated once (no string lookups afterwards)
+    struct program_reflection
+    {
+        struct uniform_info
+        {
+            std::string Name; // Without the "[0]" suffix of arrays
+            GLint Location;
+            GLenum Type;
+            GLint Size;       // Array length
+            GLint BlockIndex; // -1 in the default block
+            GLint Offset;     // Byte offset inside the block (-1 in the default block)
+        };
+        struct block_info
+        {
+            std::string Name;
+            GLuint Index;
+            GLint DataSize;
+        };
+        GLuint Program;
+        std::vector<uniform_info> Uniforms;
+        std::vector<block_info> Blocks;
+    };
+    program_reflection ReflectProgram(GLuint Program);
+
+    // Pre-resolved uniform location, -1 if the uniform is not active (GL ignores the Uniform calls)
+    template <typename T>
+    struct uniform
+    {
+        GLint Location = -1;
+    };
+
+    template <typename T> struct uniform_type;
+    template <> struct uniform_type<int>   { static const GLenum Type = GL_INT; }; // Also bools and samplers
+    template <> struct uniform_type<float> { static const GLenum Type = GL_FLOAT; };
+    template <> struct uniform_type<v2>    { static const GLenum Type = GL_FLOAT_VEC2; };
+    template <> struct uniform_type<v3>    { static const GLenum Type = GL_FLOAT_VEC3; };
+    template <> struct uniform_type<v4>    { static const GLenum Type = GL_FLOAT_VEC4; };
+    template <> struct uniform_type<mat4>  { static const GLenum Type = GL_FLOAT_MAT4; };
+
+    // -1 if not active or of another type (mismatches are reported)
+    GLint FindUniform(const program_reflection& Reflection, const char* Name, GLenum Type);
+    // GL_INVALID_INDEX if not active
+    GLuint FindUniformBlock(const program_reflection& Reflection, const char* Name);
+
+    template <typename T>
+    uniform<T> GetUniform(const program_reflection& Reflection, const char* Name)
+    {
+        uniform<T> Uniform;
+        Uniform.Location = FindUniform(Reflection, Name, uniform_type<T>::Type);
+        return Uniform;
+    }
+
+    // Set uniforms of the bound program
+    inline void Uniform(uniform<int> U, int Value)            { glUniform1i(U.Location, Value); }
+    inline void Uniform(uniform<float> U, float Value)        { glUniform1f(U.Location, Value); }
+    inline void Uniform(uniform<float> U, int Count, const float* Values) { glUniform1fv(U.Location, Count, Values); }
+    inline void Uniform(uniform<v2> U, const v2& Value)       { glUniform2fv(U.Location, 1, Value.e); }
+    inline void Uniform(uniform<v3> U, const v3& Value)       { glUniform3fv(U.Location, 1, Value.e); }
+    inline void Uniform(uniform<v4> U, const v4& Value)       { glUniform4fv(U.Location, 1, Value.e); }
+    inline void Uniform(uniform<mat4> U, const mat4& Value)   { glUniformMatrix4fv(U.Location, 1, GL_FALSE, Value.e); }
+
+    // Compare the offsets reported by the linked program with a std140 table (inactive members are skipped)
+    // MemberPrefix is the glsl path of the struct inside the block (e.g. "uLight[0].")
+    bool CheckUniformBlockLayout(const program_reflection& Reflection, const char* BlockName, const char* MemberPrefix,
+                                 const std140_member* Members, int MemberCount, GLint DataSize);
+    template <size_t N>
+    bool CheckUniformBlockLayout(const program_reflection& Reflection, const char* BlockName, const char* MemberPrefix,
+                                 const std140_member (&Members)[N], GLint DataSize)
+    {
+        return CheckUniformBlockLayout(Reflection, BlockName, MemberPrefix, Members, (int)N, DataSize);
+    }
+
+    // Members of a 'struct light' uniform of the injected light shading (default block)
+    struct light_uniforms
+    {
+        uniform<int> Enabled;
+        uniform<v4> ViewPosition;
+        uniform<v3> Ambient;
+        uniform<v3> Diffuse;
+        uniform<v3> Specular;
+        uniform<v3> Attenuation;
+    };
+    light_uniforms GetLightUniforms(const program_reflection& Reflection, const char* LightUniformName);
+    void UniformLight(const light_uniforms& Uniforms, const light& Light);
+
+    // Programs with injected light shading read 'uMaterial' from this uniform block binding
+    static const GLuint MATERIAL_BLOCK_BINDING = 0;
+
+    // Materials stored in one uniform buffer (each one aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+    struct material_buffer
+    {
+        GLuint Buffer;
+        GLsizeiptr Stride;
+        int Count;
+    };
+    material_buffer CreateMaterialBuffer(const material* Materials, int Count);
+    void DeleteMaterialBuffer(const material_buffer& MaterialBuffer);
+    void UpdateMaterial(const material_buffer& MaterialBuffer, int Index, const material& Material);
+    // Select the material of the next draws (one glBindBufferRange)
+    void BindMaterial(const material_buffer& MaterialBuffer, int Index);
+
+    // Buffer read with texelFetch (samplerBuffer), for arrays too large for uniform blocks
+    struct texture_buffer
+    {
+        GLuint Buffer;
+        GLuint Texture;
+    };
+    texture_buffer CreateTextureBuffer(GLenum InternalFormat);
+    void DeleteTextureBuffer(const texture_buffer& TextureBuffer);
+    // Replace the content (the previous storage is orphaned)
+    void UploadTextureBuffer(const texture_buffer& TextureBuffer, const void* Data, GLsizeiptr Size);
+
+    // Offscreen render target: color textures (GL_COLOR_ATTACHMENT0 + i) and a GL_DEPTH24_STENCIL8 depth stencil
+    struct framebuffer
+    {
+        static const int MAX_COLOR_TEXTURES = 4;
+        GLuint FBO;
+        int ColorTextureCount;
+        GLuint ColorTextures[MAX_COLOR_TEXTURES];
+        GLuint DepthStencilTexture;      // Only if the depth is sampled later
+        GLuint DepthStencilRenderbuffer; // Otherwise
+        int Width;
+        int Height;
+    };
+    // ColorFormats are sized internal formats (GL_RGB8, GL_RGBA16F...), textures are sampled with GL_NEAREST
+    framebuffer CreateFramebuffer(int Width, int Height, int ColorTextureCount, const GLenum* ColorFormats, bool DepthStencilTexture = false);
+    void DeleteFramebuffer(const framebuffer& Framebuffer);
+
+    // Count the calls of some GL functions by wrapping their loaded pointers (uniform lookups by name)
+    struct call_counts
+    {
+        int GetUniformLocation;
+        int GetUniformBlockIndex;
+    };
+    void EnableCallCounts();
+    call_counts GetCallCounts();
+    void ResetCallCounts();
+
     GLuint CompileShader(GLenum ShaderType, const char* ShaderStr, bool InjectLightShading = false);
     GLuint CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading = false);
+    // Linked programs are cached as driver binaries ("media/program_<hash>.cache") when GL_ARB_get_program_binary is available,
+    // the hash covers the sources, the light shading injection and the driver
     GLuint CreateProgram(const char* VSString, const char* FSString, bool InjectLightShading = false);
     GLuint CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringCount, const char** FSString, bool InjectLightShading = false);
+    struct program_cache_stats
+    {
+        int Hits;   // Programs loaded from a binary
+        int Misses; // Programs compiled (then saved if supported)
+    };
+    program_cache_stats GetProgramCacheStats();
+    // Setup attributes of the bound vertex array from the bound GL_ARRAY_BUFFER (-1 locations are ignored)
+    void VertexAttribPointer(GLuint Location, vertex_format Format, int ComponentCount, GLsizei Stride, GLsizei Offset);
+    void SetupVertexAttributes(const vertex_descriptor& Descriptor, GLint PositionLocation, GLint NormalLocation, GLint UVLocation);
     void UploadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
     void UploadCheckerboardTexture(int Width, int Height, int SquareSize);
+    // Stream a .obj to a non-indexed mesh (one vertex per triangle corner) without holding the whole file or vertex buffer in memory
+    // MemoryBudget is shared between the file blocks and the mapped buffer window (attributes needed by the faces are extra)
+    mesh StreamObj(const char* Filename, float Scale, const vertex_descriptor& Descriptor, size_t MemoryBudget, obj_stream_stats* Stats = nullptr);
 }
 
 namespace GLImGui
 {
     void InspectProgram(GLuint program);
+    // Resident bytes per resource and VRAM budget
+    void InspectCache(GL::cache& Cache);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <vector>
 
 #include <imgui.h>
 
@@ -409,4 +410,28 @@ void GLImGui::InspectProgram(GLuint program)
 	}
 
 	glUseProgram(previousProgram);
+}
+
+void GLImGui::InspectCache(GL::cache& Cache)
+{
+	int BudgetMB = (int)(Cache.GetBudget() / (1024 * 1024));
+	if (ImGui::SliderInt("VRAM budget (MB)", &BudgetMB, 0, 1024))
+		Cache.SetBudget((size_t)BudgetMB * 1024 * 1024);
+	ImGui::Text("Resident: %.1f MB", Cache.GetResidentSize() / (1024.f * 1024.f));
+
+	static std::vector<GL::cache_resource_info> Resources;
+	Cache.GetResources(Resources);
+
+	ImGui::Columns(3);
+	ImGui::Text("Resource"); ImGui::NextColumn();
+	ImGui::Text("Resident KB"); ImGui::NextColumn();
+	ImGui::Text("Handles"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (const GL::cache_resource_info& Resource : Resources)
+	{
+		ImGui::Text("%s %s", Resource.IsMesh ? "[mesh]" : "[texture]", Resource.Name); ImGui::NextColumn();
+		ImGui::Text("%.1f%s", Resource.Size / 1024.f, Resource.Pending ? " (loading)" : ""); ImGui::NextColumn();
+		ImGui::Text("%d", Resource.RefCount); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include <cstdio>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "process_info.h"
+
+size_t ProcessInfo::GetResidentMemory()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS Counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+        return 0;
+    return Counters.WorkingSetSize;
+#else
+    // Second field of statm is the resident page count
+    FILE* File = fopen("/proc/self/statm", "r");
+    if (File == nullptr)
+        return 0;
+    unsigned long Size = 0;
+    unsigned long Resident = 0;
+    int Read = fscanf(File, "%lu %lu", &Size, &Resident);
+    fclose(File);
+    return (Read == 2) ? (size_t)Resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+size_t ProcessInfo::GetPeakResidentMemory()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS Counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+        return 0;
+    return Counters.PeakWorkingSetSize;
+#else
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (size_t)Usage.ru_maxrss; // Bytes
+#else
+    return (size_t)Usage.ru_maxrss * 1024; // Kilobytes
+#endif
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Memory usage of the current process
+namespace ProcessInfo
+{
+    // Resident set size (working set on Windows) in bytes, 0 if unknown
+    size_t GetResidentMemory();
+    // Highest resident set size since the process started
+    size_t GetPeakResidentMemory();
+}
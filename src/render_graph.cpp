@@ -0,0 +1,285 @@
+#include <vector>
+
+#include "maths.h"
+#include "render_graph.h"
+
+// Bytes per texel of the formats used by the passes (drivers pad 3 component formats)
+static size_t GetTexelSize(GLenum Format)
+{
+    switch (Format)
+    {
+    case GL_R8:      return 1;
+    case GL_RG8:     return 2;
+    case GL_RGBA16F: return 8;
+    case GL_RGBA32F: return 16;
+    default:         return 4; // GL_RGB8, GL_RGBA8, GL_R11F_G11F_B10F, GL_R32F
+    }
+}
+
+render_graph::render_graph()
+{
+    glGenFramebuffers(1, &FBO);
+}
+
+render_graph::~render_graph()
+{
+    for (const pool_texture& PoolTexture : Pool)
+        glDeleteTextures(1, &PoolTexture.Texture);
+    glDeleteFramebuffers(1, &FBO);
+}
+
+void render_graph::Reset()
+{
+    Textures.clear();
+    Passes.clear();
+}
+
+int render_graph::ImportTexture(const char* Name, GLuint Texture, int Width, int Height)
+{
+    Textures.push_back({ Name, 1.f, GL_NONE, Texture, Width, Height, -1, -1, -1 });
+    return (int)Textures.size() - 1;
+}
+
+int render_graph::CreateTexture(const char* Name, float Scale, GLenum Format)
+{
+    Textures.push_back({ Name, Scale, Format, 0, 0, 0, -1, -1, -1 });
+    return (int)Textures.size() - 1;
+}
+
+int render_graph::AddPass(const char* Name, std::function<void()> Execute)
+{
+    // Pass names are unique within a frame
+    GL::gpu_timer* Timer = nullptr;
+    for (const pass_timer& PassTimer : Timers)
+    {
+        if (PassTimer.Name == Name)
+            Timer = PassTimer.Timer.get();
+    }
+    if (Timer == nullptr)
+    {
+        Timers.push_back({ Name, std::make_unique<GL::gpu_timer>() });
+        Timer = Timers.back().Timer.get();
+    }
+
+    pass Pass = {};
+    Pass.Name = Name;
+    Pass.Execute = std::move(Execute);
+    Pass.Timer = Timer;
+    Passes.push_back(std::move(Pass));
+    return (int)Passes.size() - 1;
+}
+
+void render_graph::Read(int Pass, int Texture)
+{
+    Passes[Pass].Reads.push_back(Texture);
+}
+
+void render_graph::Write(int Pass, int Texture)
+{
+    Passes[Pass].Writes.push_back(Texture);
+}
+
+void render_graph::WriteScreen(int Pass)
+{
+    Passes[Pass].Screen = true;
+}
+
+void render_graph::Compile(int ScreenWidth, int ScreenHeight)
+{
+    this->ScreenWidth = ScreenWidth;
+    this->ScreenHeight = ScreenHeight;
+    for (texture& Texture : Textures)
+    {
+        if (!Texture.Imported)
+        {
+            Texture.Width = Math::Max(1, (int)(ScreenWidth * Texture.Scale + 0.5f));
+            Texture.Height = Math::Max(1, (int)(ScreenHeight * Texture.Scale + 0.5f));
+        }
+        Texture.PoolIndex = -1;
+        Texture.FirstPass = -1;
+        Texture.LastPass = -1;
+    }
+
+    // Cull from the last pass: a pass is alive if it draws to the screen or to an imported texture,
+    // or if it writes a texture read by an alive pass
+    std::vector<bool> Needed(Textures.size(), false);
+    for (int PassIndex = (int)Passes.size() - 1; PassIndex >= 0; --PassIndex)
+    {
+        pass& Pass = Passes[PassIndex];
+        Pass.Culled = !Pass.Screen;
+        for (int Texture : Pass.Writes)
+        {
+            if (Needed[Texture] || Textures[Texture].Imported)
+                Pass.Culled = false;
+        }
+        if (Pass.Culled)
+            continue;
+        for (int Texture : Pass.Reads)
+            Needed[Texture] = true;
+    }
+
+    // Lifetimes of the textures in alive passes
+    for (int PassIndex = 0; PassIndex < (int)Passes.size(); ++PassIndex)
+    {
+        const pass& Pass = Passes[PassIndex];
+        if (Pass.Culled)
+            continue;
+        for (int Texture : Pass.Writes)
+        {
+            if (Textures[Texture].FirstPass < 0)
+                Textures[Texture].FirstPass = PassIndex;
+            Textures[Texture].LastPass = PassIndex;
+        }
+        for (int Texture : Pass.Reads)
+            Textures[Texture].LastPass = PassIndex;
+    }
+
+    // Each transient texture takes a pool texture of its size and format at its first write,
+    // the pool texture is free again after the last read (no texture is written while it is read)
+    for (pool_texture& PoolTexture : Pool)
+    {
+        PoolTexture.LastPass = -1;
+        PoolTexture.Used = false;
+    }
+    for (int PassIndex = 0; PassIndex < (int)Passes.size(); ++PassIndex)
+    {
+        if (Passes[PassIndex].Culled)
+            continue;
+        for (int TextureIndex : Passes[PassIndex].Writes)
+        {
+            texture& Texture = Textures[TextureIndex];
+            if (Texture.Imported || Texture.FirstPass != PassIndex)
+                continue;
+
+            int PoolIndex = -1;
+            for (int i = 0; i < (int)Pool.size() && PoolIndex < 0; ++i)
+            {
+                const pool_texture& PoolTexture = Pool[i];
+                if (PoolTexture.Width == Texture.Width && PoolTexture.Height == Texture.Height && PoolTexture.Format == Texture.Format
+                    && PoolTexture.LastPass < PassIndex)
+                    PoolIndex = i;
+            }
+            if (PoolIndex < 0)
+            {
+                pool_texture PoolTexture = { 0, Texture.Width, Texture.Height, Texture.Format, -1, false };
+                glGenTextures(1, &PoolTexture.Texture);
+                glBindTexture(GL_TEXTURE_2D, PoolTexture.Texture);
+                glObjectLabel(GL_TEXTURE, PoolTexture.Texture, -1, "RenderGraphTexture");
+                glTexImage2D(GL_TEXTURE_2D, 0, Texture.Format, Texture.Width, Texture.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                PoolIndex = (int)Pool.size();
+                Pool.push_back(PoolTexture);
+            }
+            Pool[PoolIndex].LastPass = Texture.LastPass;
+            Pool[PoolIndex].Used = true;
+            Texture.PoolIndex = PoolIndex;
+        }
+    }
+
+    // Release what this frame did not need (other sizes after a resize, culled effects)
+    std::vector<int> Remap(Pool.size(), -1);
+    int UsedCount = 0;
+    for (int i = 0; i < (int)Pool.size(); ++i)
+    {
+        if (Pool[i].Used)
+        {
+            Remap[i] = UsedCount;
+            Pool[UsedCount++] = Pool[i];
+        }
+        else
+        {
+            glDeleteTextures(1, &Pool[i].Texture);
+        }
+    }
+    Pool.resize(UsedCount);
+    for (texture& Texture : Textures)
+    {
+        if (Texture.PoolIndex >= 0)
+            Texture.PoolIndex = Remap[Texture.PoolIndex];
+    }
+}
+
+void render_graph::Execute()
+{
+    GLint PreviousFramebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+
+    int AttachmentCount = 0;
+    for (pass& Pass : Passes)
+    {
+        if (Pass.Culled)
+            continue;
+
+        if (Pass.Screen)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+            glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+        }
+        else
+        {
+            // Outputs replace the attachments of the previous pass
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            GLenum DrawBuffers[GL::framebuffer::MAX_COLOR_TEXTURES];
+            int OutputCount = Math::Min((int)Pass.Writes.size(), (int)GL::framebuffer::MAX_COLOR_TEXTURES);
+            for (int i = 0; i < Math::Max(OutputCount, AttachmentCount); ++i)
+            {
+                GLuint Texture = (i < OutputCount) ? GetTexture(Pass.Writes[i]) : 0;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, Texture, 0);
+                DrawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+            }
+            AttachmentCount = OutputCount;
+            glDrawBuffers(OutputCount, DrawBuffers);
+
+            const texture& Output = Textures[Pass.Writes[0]];
+            glViewport(0, 0, Output.Width, Output.Height);
+        }
+
+        Pass.Timer->Begin();
+        Pass.Execute();
+        Pass.Timer->End();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+    glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+}
+
+GLuint render_graph::GetTexture(int Texture) const
+{
+    const texture& Info = Textures[Texture];
+    if (Info.Imported)
+        return Info.Imported;
+    return (Info.PoolIndex >= 0) ? Pool[Info.PoolIndex].Texture : 0;
+}
+
+void render_graph::GetPasses(std::vector<pass_info>& PassInfos) const
+{
+    PassInfos.clear();
+    for (const pass& Pass : Passes)
+        PassInfos.push_back({ Pass.Name, Pass.Culled, Pass.Timer->GetMilliseconds() });
+}
+
+void render_graph::GetTextures(std::vector<texture_info>& TextureInfos) const
+{
+    TextureInfos.clear();
+    for (const texture& Texture : Textures)
+        TextureInfos.push_back({ Texture.Name, Texture.Width, Texture.Height, Texture.Format, Texture.PoolIndex, Texture.FirstPass, Texture.LastPass });
+}
+
+render_graph::stats render_graph::GetStats() const
+{
+    stats Stats = {};
+    Stats.PoolTextureCount = (int)Pool.size();
+    for (const pool_texture& PoolTexture : Pool)
+        Stats.PoolSize += PoolTexture.Width * PoolTexture.Height * GetTexelSize(PoolTexture.Format);
+    for (const texture& Texture : Textures)
+    {
+        if (Texture.PoolIndex >= 0)
+            Stats.TransientSize += Texture.Width * Texture.Height * GetTexelSize(Texture.Format);
+    }
+    return Stats;
+}
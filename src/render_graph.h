@@ -0,0 +1,123 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opengl_headers.h"
+#include "opengl_helpers.h"
+
+// Passes and textures are declared every frame, in execution order, then Compile() and Execute():
+// - passes whose outputs are never read (directly or not) by a pass drawing to the screen are culled
+// - transient textures come from a pool kept between frames, a pool texture is shared by the transient
+//   textures of the same size and format whose lifetimes (first write to last read) do not overlap
+class render_graph
+{
+public:
+    struct pass_info
+    {
+        const char* Name;
+        bool Culled;
+        float GpuTime; // Milliseconds (last available result)
+    };
+
+    struct texture_info
+    {
+        const char* Name;
+        int Width;
+        int Height;
+        GLenum Format;
+        int PoolIndex;  // -1 if imported or unused
+        int FirstPass;  // Lifetime (pass indices)
+        int LastPass;
+    };
+
+    struct stats
+    {
+        int PoolTextureCount;
+        size_t PoolSize;      // Bytes allocated by the pool
+        size_t TransientSize; // Bytes the transient textures would use without aliasing
+    };
+
+    render_graph();
+    ~render_graph();
+    render_graph(const render_graph&) = delete;
+    render_graph& operator=(const render_graph&) = delete;
+
+    // Start the declaration of a frame (the pool and the pass timers are kept)
+    void Reset();
+
+    // Textures are handles to use in the declarations, Scale is relative to the screen size
+    int ImportTexture(const char* Name, GLuint Texture, int Width, int Height);
+    int CreateTexture(const char* Name, float Scale, GLenum Format);
+
+    // Execute draws the pass with its outputs bound (color attachments in Write order, viewport of their size)
+    // Names are unique within a frame (the GPU timers follow them from one frame to the next)
+    int AddPass(const char* Name, std::function<void()> Execute);
+    void Read(int Pass, int Texture);
+    void Write(int Pass, int Texture);
+    // Draw to the framebuffer bound when Execute() is called (one per frame, it keeps its pass alive)
+    void WriteScreen(int Pass);
+
+    // Cull the passes, then assign the pool textures (allocated or released here)
+    void Compile(int ScreenWidth, int ScreenHeight);
+    void Execute();
+
+    // GL name of a texture, valid inside the Execute function of the passes reading it
+    GLuint GetTexture(int Texture) const;
+
+    void GetPasses(std::vector<pass_info>& Passes) const;
+    void GetTextures(std::vector<texture_info>& Textures) const;
+    stats GetStats() const;
+
+private:
+    struct texture
+    {
+        const char* Name;
+        float Scale;
+        GLenum Format;
+        GLuint Imported; // 0 for transient textures
+        int Width;
+        int Height;
+        int PoolIndex;
+        int FirstPass;
+        int LastPass;
+    };
+
+    struct pass
+    {
+        const char* Name;
+        std::function<void()> Execute;
+        std::vector<int> Reads;
+        std::vector<int> Writes;
+        bool Screen;
+        bool Culled;
+        GL::gpu_timer* Timer;
+    };
+
+    struct pool_texture
+    {
+        GLuint Texture;
+        int Width;
+        int Height;
+        GLenum Format;
+        int LastPass; // Pass of the last read of the current occupant during Compile (-1 if free)
+        bool Used;    // By the last Compile
+    };
+
+    // Timers are matched by pass name from one frame to the next
+    struct pass_timer
+    {
+        std::string Name;
+        std::unique_ptr<GL::gpu_timer> Timer;
+    };
+
+    std::vector<texture> Textures;
+    std::vector<pass> Passes;
+    std::vector<pool_texture> Pool;
+    std::vector<pass_timer> Timers;
+    GLuint FBO = 0;
+    int ScreenWidth = 0;
+    int ScreenHeight = 0;
+};
@@ -0,0 +1,77 @@
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
+
+#include "simd.h"
+
+#if SIMD_X86
+static void CpuId(int Leaf, int SubLeaf, unsigned int Registers[4])
+{
+#if defined(_MSC_VER)
+    int Result[4];
+    __cpuidex(Result, Leaf, SubLeaf);
+    for (int i = 0; i < 4; ++i)
+        Registers[i] = (unsigned int)Result[i];
+#else
+    __cpuid_count(Leaf, SubLeaf, Registers[0], Registers[1], Registers[2], Registers[3]);
+#endif
+}
+
+// XCR0 register (state of the registers saved by the OS on context switches)
+static unsigned long long GetXCR0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int Low, High;
+    __asm__ volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+    return ((unsigned long long)High << 32) | Low;
+#endif
+}
+
+static simd_level DetectLevel()
+{
+    unsigned int Registers[4]; // eax, ebx, ecx, edx
+    CpuId(0, 0, Registers);
+    int MaxLeaf = (int)Registers[0];
+
+    CpuId(1, 0, Registers);
+    bool HasSSE41 = (Registers[2] & (1u << 19)) != 0;
+    bool HasOSXSAVE = (Registers[2] & (1u << 27)) != 0;
+    bool HasAVX = (Registers[2] & (1u << 28)) != 0;
+    if (!HasSSE41)
+        return SIMD_NONE;
+
+    // AVX registers must be enabled by the OS (XMM and YMM state)
+    if (MaxLeaf >= 7 && HasAVX && HasOSXSAVE && (GetXCR0() & 0x6) == 0x6)
+    {
+        CpuId(7, 0, Registers);
+        if (Registers[1] & (1u << 5))
+            return SIMD_AVX2;
+    }
+    return SIMD_SSE41;
+}
+#else
+static simd_level DetectLevel()
+{
+    return SIMD_NONE;
+}
+#endif
+
+simd_level Simd::GetSupportedLevel()
+{
+    static simd_level Level = DetectLevel();
+    return Level;
+}
+
+const char* Simd::GetLevelName(simd_level Level)
+{
+    switch (Level)
+    {
+    case SIMD_SSE41: return "SSE4.1";
+    case SIMD_AVX2:  return "AVX2";
+    default:         return "Scalar";
+    }
+}
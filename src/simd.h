@@ -0,0 +1,32 @@
+#pragma once
+
+// Instruction sets used by the SIMD kernels (selected at runtime)
+enum simd_level
+{
+    SIMD_NONE,  // Scalar code
+    SIMD_SSE41,
+    SIMD_AVX2,
+};
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+// Functions using instructions above the compiler baseline must be tagged (MSVC does not need it)
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#endif
+
+namespace Simd
+{
+    // Highest level supported by the cpu and the OS
+    simd_level GetSupportedLevel();
+    const char* GetLevelName(simd_level Level);
+}
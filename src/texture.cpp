@@ -0,0 +1,960 @@
+#include <cassert>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "maths.h"
+#include "jobs.h"
+#include "lz.h"
+#include "simd.h"
+#include "texture.h"
+
+// ================================================================================================
+// FORMATS
+// ================================================================================================
+const char* Texture::GetFormatName(texture_format Format)
+{
+    switch (Format)
+    {
+    case TEXTURE_FORMAT_RGB8:  return "RGB8";
+    case TEXTURE_FORMAT_RGBA8: return "RGBA8";
+    case TEXTURE_FORMAT_BC1:   return "BC1";
+    case TEXTURE_FORMAT_BC3:   return "BC3";
+    case TEXTURE_FORMAT_BC5:   return "BC5";
+    default:                   return "Unknown";
+    }
+}
+
+bool Texture::IsCompressed(texture_format Format)
+{
+    return Format == TEXTURE_FORMAT_BC1 || Format == TEXTURE_FORMAT_BC3 || Format == TEXTURE_FORMAT_BC5;
+}
+
+size_t Texture::GetLevelSize(texture_format Format, int Width, int Height)
+{
+    size_t BlockCount = (size_t)((Width + 3) / 4) * ((Height + 3) / 4);
+    switch (Format)
+    {
+    case TEXTURE_FORMAT_RGB8:  return (size_t)Width * Height * 3;
+    case TEXTURE_FORMAT_RGBA8: return (size_t)Width * Height * 4;
+    case TEXTURE_FORMAT_BC1:   return BlockCount * 8;
+    case TEXTURE_FORMAT_BC3:   return BlockCount * 16;
+    case TEXTURE_FORMAT_BC5:   return BlockCount * 16;
+    default:                   return 0;
+    }
+}
+
+texture_format Texture::ChooseCompressedFormat(const uint8_t* Pixels, int Width, int Height, int Channels, bool NormalMap)
+{
+    if (NormalMap)
+        return TEXTURE_FORMAT_BC5;
+
+    if (Channels == 4)
+    {
+        size_t PixelCount = (size_t)Width * Height;
+        for (size_t i = 0; i < PixelCount; ++i)
+        {
+            if (Pixels[i * 4 + 3] != 255)
+                return TEXTURE_FORMAT_BC3;
+        }
+    }
+    return TEXTURE_FORMAT_BC1;
+}
+
+// ================================================================================================
+// MIPMAPS
+// ================================================================================================
+// Each level is filtered from the previous one in linear space (sRGB decoded) with a Kaiser windowed sinc,
+// vertically then horizontally, one destination row per job. Alpha is scaled per level so that the
+// fraction of texels passing the alpha test stays the one of level 0 (alpha tested foliage does not fade out).
+
+static const float MIP_FILTER_RADIUS = 3.f; // In destination texels
+static const float MIP_KAISER_BETA = 4.f;
+static const float MIP_ALPHA_CUTOFF = 0.5f; // Alpha test reference of the coverage
+static const int MIP_COVERAGE_ITERATIONS = 10;
+static const int SRGB_ENCODE_TABLE_SIZE = 16 * 1024;
+
+static float SrgbToLinear(float Value)
+{
+    return (Value <= 0.04045f) ? Value / 12.92f : std::pow((Value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float Value)
+{
+    return (Value <= 0.0031308f) ? Value * 12.92f : 1.055f * std::pow(Value, 1.f / 2.4f) - 0.055f;
+}
+
+static const float* GetSrgbDecodeTable()
+{
+    static const std::vector<float> Table = []()
+    {
+        std::vector<float> Values(256);
+        for (int i = 0; i < 256; ++i)
+            Values[i] = SrgbToLinear(i / 255.f);
+        return Values;
+    }();
+    return Table.data();
+}
+
+// Indexed by linear value * (SRGB_ENCODE_TABLE_SIZE - 1), fine enough to round near black like the exact curve
+static const uint8_t* GetSrgbEncodeTable()
+{
+    static const std::vector<uint8_t> Table = []()
+    {
+        std::vector<uint8_t> Values(SRGB_ENCODE_TABLE_SIZE);
+        for (int i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i)
+            Values[i] = (uint8_t)(LinearToSrgb(i / (float)(SRGB_ENCODE_TABLE_SIZE - 1)) * 255.f + 0.5f);
+        return Values;
+    }();
+    return Table.data();
+}
+
+// Modified Bessel function of the first kind (order 0)
+static float BesselI0(float X)
+{
+    float Sum = 1.f;
+    float Term = 1.f;
+    for (int k = 1; k < 32 && Term > Sum * 1e-8f; ++k)
+    {
+        float Factor = X / (2.f * k);
+        Term *= Factor * Factor;
+        Sum += Term;
+    }
+    return Sum;
+}
+
+// X in destination texels
+static float KaiserSinc(float X)
+{
+    float T = X / MIP_FILTER_RADIUS;
+    if (Math::Abs(T) >= 1.f)
+        return 0.f;
+
+    float Window = BesselI0(MIP_KAISER_BETA * Math::Sqrt(1.f - T * T)) / BesselI0(MIP_KAISER_BETA);
+    float Sinc = (Math::Abs(X) < 1e-6f) ? 1.f : Math::Sin(Math::Pi() * X) / (Math::Pi() * X);
+    return Sinc * Window;
+}
+
+// Source texels (edge clamped) and normalized weights of each destination texel along one axis
+struct mip_filter
+{
+    int TapCount; // Per destination texel
+    std::vector<int> Indices;
+    std::vector<float> Weights;
+};
+
+static mip_filter BuildMipFilter(int SourceSize, int DestinationSize)
+{
+    mip_filter Filter;
+    float Scale = (float)SourceSize / DestinationSize;
+    float Support = MIP_FILTER_RADIUS * Scale;
+    Filter.TapCount = (int)std::ceil(2.f * Support) + 1;
+    Filter.Indices.resize((size_t)DestinationSize * Filter.TapCount);
+    Filter.Weights.resize((size_t)DestinationSize * Filter.TapCount);
+
+    for (int x = 0; x < DestinationSize; ++x)
+    {
+        float Center = (x + 0.5f) * Scale - 0.5f;
+        int First = (int)std::floor(Center - Support) + 1;
+        int* Indices = &Filter.Indices[(size_t)x * Filter.TapCount];
+        float* Weights = &Filter.Weights[(size_t)x * Filter.TapCount];
+
+        float Sum = 0.f;
+        for (int i = 0; i < Filter.TapCount; ++i)
+        {
+            Indices[i] = Math::Clamp(First + i, 0, SourceSize - 1);
+            Weights[i] = KaiserSinc((First + i - Center) / Scale);
+            Sum += Weights[i];
+        }
+        for (int i = 0; i < Filter.TapCount; ++i)
+            Weights[i] /= Sum;
+    }
+    return Filter;
+}
+
+// Destination[i] = sum of Weights[t] * Rows[t][i]
+static void FilterRows(float* Destination, const float* const* Rows, const float* Weights, int TapCount, int Count)
+{
+    for (int i = 0; i < Count; ++i)
+    {
+        float Sum = 0.f;
+        for (int t = 0; t < TapCount; ++t)
+            Sum += Weights[t] * Rows[t][i];
+        Destination[i] = Sum;
+    }
+}
+
+// Destination texel x = sum of Weights[t] * Source texel Indices[t] (4 floats per texel)
+static void FilterTexels(float* Destination, const float* Source, const mip_filter& Filter, int DestinationWidth)
+{
+    for (int x = 0; x < DestinationWidth; ++x)
+    {
+        const int* Indices = &Filter.Indices[(size_t)x * Filter.TapCount];
+        const float* Weights = &Filter.Weights[(size_t)x * Filter.TapCount];
+        float Sum[4] = {};
+        for (int t = 0; t < Filter.TapCount; ++t)
+        {
+            for (int c = 0; c < 4; ++c)
+                Sum[c] += Weights[t] * Source[Indices[t] * 4 + c];
+        }
+        memcpy(Destination + x * 4, Sum, sizeof(Sum));
+    }
+}
+
+#if SIMD_X86
+SIMD_TARGET_SSE41
+static void FilterRowsSSE(float* Destination, const float* const* Rows, const float* Weights, int TapCount, int Count)
+{
+    int i = 0;
+    for (; i + 4 <= Count; i += 4)
+    {
+        __m128 Sum = _mm_setzero_ps();
+        for (int t = 0; t < TapCount; ++t)
+            Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(Weights[t]), _mm_loadu_ps(Rows[t] + i)));
+        _mm_storeu_ps(Destination + i, Sum);
+    }
+
+    const float* Tail[64];
+    for (int t = 0; t < TapCount; ++t)
+        Tail[t] = Rows[t] + i;
+    FilterRows(Destination + i, Tail, Weights, TapCount, Count - i);
+}
+
+SIMD_TARGET_AVX2
+static void FilterRowsAVX(float* Destination, const float* const* Rows, const float* Weights, int TapCount, int Count)
+{
+    int i = 0;
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m256 Sum = _mm256_setzero_ps();
+        for (int t = 0; t < TapCount; ++t)
+            Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_set1_ps(Weights[t]), _mm256_loadu_ps(Rows[t] + i)));
+        _mm256_storeu_ps(Destination + i, Sum);
+    }
+
+    const float* Tail[64];
+    for (int t = 0; t < TapCount; ++t)
+        Tail[t] = Rows[t] + i;
+    FilterRowsSSE(Destination + i, Tail, Weights, TapCount, Count - i);
+}
+
+// One texel (4 channels) per register
+SIMD_TARGET_SSE41
+static void FilterTexelsSSE(float* Destination, const float* Source, const mip_filter& Filter, int DestinationWidth)
+{
+    for (int x = 0; x < DestinationWidth; ++x)
+    {
+        const int* Indices = &Filter.Indices[(size_t)x * Filter.TapCount];
+        const float* Weights = &Filter.Weights[(size_t)x * Filter.TapCount];
+        __m128 Sum = _mm_setzero_ps();
+        for (int t = 0; t < Filter.TapCount; ++t)
+            Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(Weights[t]), _mm_loadu_ps(Source + Indices[t] * 4)));
+        _mm_storeu_ps(Destination + x * 4, Sum);
+    }
+}
+#endif
+
+// Source and Destination hold 4 floats per texel
+static void DownsampleLinear(float* Destination, int DestinationWidth, int DestinationHeight, const float* Source, int Width, int Height, simd_level SimdLevel)
+{
+    mip_filter Horizontal = BuildMipFilter(Width, DestinationWidth);
+    mip_filter Vertical = BuildMipFilter(Height, DestinationHeight);
+    assert(Vertical.TapCount <= 64);
+
+#if SIMD_X86
+    simd_level Level = Math::Min(SimdLevel, Simd::GetSupportedLevel());
+#else
+    simd_level Level = SIMD_NONE;
+#endif
+
+    Jobs::ParallelFor(DestinationHeight, [&](int y)
+    {
+        const float* Rows[64];
+        for (int t = 0; t < Vertical.TapCount; ++t)
+            Rows[t] = Source + (size_t)Vertical.Indices[(size_t)y * Vertical.TapCount + t] * Width * 4;
+        const float* Weights = &Vertical.Weights[(size_t)y * Vertical.TapCount];
+
+        std::vector<float> Row((size_t)Width * 4);
+        float* Output = Destination + (size_t)y * DestinationWidth * 4;
+#if SIMD_X86
+        if (Level == SIMD_AVX2)
+            FilterRowsAVX(Row.data(), Rows, Weights, Vertical.TapCount, Width * 4);
+        else if (Level == SIMD_SSE41)
+            FilterRowsSSE(Row.data(), Rows, Weights, Vertical.TapCount, Width * 4);
+        else
+            FilterRows(Row.data(), Rows, Weights, Vertical.TapCount, Width * 4);
+
+        if (Level != SIMD_NONE)
+        {
+            FilterTexelsSSE(Output, Row.data(), Horizontal, DestinationWidth);
+            return;
+        }
+#else
+        FilterRows(Row.data(), Rows, Weights, Vertical.TapCount, Width * 4);
+#endif
+        FilterTexels(Output, Row.data(), Horizontal, DestinationWidth);
+    });
+}
+
+// 8 bits texels to 4 floats (linear color, opaque if no alpha)
+static void DecodeTexels(float* Destination, const uint8_t* Pixels, int Width, int Height, int Channels, bool Srgb)
+{
+    const float* DecodeTable = GetSrgbDecodeTable();
+    Jobs::ParallelFor(Height, [=](int y)
+    {
+        const uint8_t* Input = Pixels + (size_t)y * Width * Channels;
+        float* Output = Destination + (size_t)y * Width * 4;
+        for (int x = 0; x < Width; ++x, Input += Channels, Output += 4)
+        {
+            if (Srgb)
+            {
+                Output[0] = DecodeTable[Input[0]];
+                Output[1] = DecodeTable[Input[1]];
+                Output[2] = DecodeTable[Input[2]];
+            }
+            else
+            {
+                Output[0] = Input[0] / 255.f;
+                Output[1] = Input[1] / 255.f;
+                Output[2] = Input[2] / 255.f;
+            }
+            Output[3] = (Channels == 4) ? Input[3] / 255.f : 1.f;
+        }
+    });
+}
+
+static void EncodeTexels(uint8_t* Destination, const float* Texels, int Width, int Height, int Channels, bool Srgb, float AlphaScale)
+{
+    const uint8_t* EncodeTable = GetSrgbEncodeTable();
+    Jobs::ParallelFor(Height, [=](int y)
+    {
+        const float* Input = Texels + (size_t)y * Width * 4;
+        uint8_t* Output = Destination + (size_t)y * Width * Channels;
+        for (int x = 0; x < Width; ++x)
+        {
+            for (int c = 0; c < Channels; ++c)
+            {
+                float Value = Input[x * 4 + c];
+                if (c == 3)
+                    Output[x * Channels + c] = (uint8_t)(Math::Clamp(Value * AlphaScale, 0.f, 1.f) * 255.f + 0.5f);
+                else if (Srgb)
+                    Output[x * Channels + c] = EncodeTable[(int)(Math::Clamp(Value, 0.f, 1.f) * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)];
+                else
+                    Output[x * Channels + c] = (uint8_t)(Math::Clamp(Value, 0.f, 1.f) * 255.f + 0.5f);
+            }
+        }
+    });
+}
+
+// Fraction of the texels passing the alpha test
+static float ComputeAlphaCoverage(const float* Texels, size_t Count, float AlphaScale)
+{
+    size_t Covered = 0;
+    for (size_t i = 0; i < Count; ++i)
+        Covered += (Texels[i * 4 + 3] * AlphaScale > MIP_ALPHA_CUTOFF);
+    return (float)Covered / Count;
+}
+
+// Coverage increases with the scale: bisection
+static float FindAlphaScale(const float* Texels, size_t Count, float Coverage)
+{
+    float MinScale = 0.f;
+    float MaxScale = 4.f;
+    for (int i = 0; i < MIP_COVERAGE_ITERATIONS; ++i)
+    {
+        float Scale = (MinScale + MaxScale) * 0.5f;
+        if (ComputeAlphaCoverage(Texels, Count, Scale) < Coverage)
+            MinScale = Scale;
+        else
+            MaxScale = Scale;
+    }
+    return (MinScale + MaxScale) * 0.5f;
+}
+
+void Texture::GenerateMipmaps(uint8_t* const* Levels, int LevelCount, const uint8_t* Pixels, int Width, int Height, int Channels, int BuildFlags, simd_level SimdLevel)
+{
+    if (LevelCount <= 1)
+        return;
+
+    bool Srgb = (BuildFlags & TEXTURE_BUILD_LINEAR) == 0;
+    std::vector<float> Level((size_t)Width * Height * 4);
+    std::vector<float> NextLevel;
+    DecodeTexels(Level.data(), Pixels, Width, Height, Channels, Srgb);
+
+    // Only when some texels are cut by the alpha test
+    float Coverage = (Channels == 4) ? ComputeAlphaCoverage(Level.data(), (size_t)Width * Height, 1.f) : 1.f;
+    bool PreserveCoverage = Coverage > 0.f && Coverage < 1.f;
+
+    for (int i = 1; i < LevelCount; ++i)
+    {
+        int LevelWidth = Math::Max(Width / 2, 1);
+        int LevelHeight = Math::Max(Height / 2, 1);
+        size_t TexelCount = (size_t)LevelWidth * LevelHeight;
+        NextLevel.resize(TexelCount * 4);
+        DownsampleLinear(NextLevel.data(), LevelWidth, LevelHeight, Level.data(), Width, Height, SimdLevel);
+
+        // Next levels are filtered from the unscaled alpha
+        float AlphaScale = PreserveCoverage ? FindAlphaScale(NextLevel.data(), TexelCount, Coverage) : 1.f;
+        EncodeTexels(Levels[i], NextLevel.data(), LevelWidth, LevelHeight, Channels, Srgb, AlphaScale);
+
+        Level.swap(NextLevel);
+        Width = LevelWidth;
+        Height = LevelHeight;
+    }
+}
+
+// ================================================================================================
+// BLOCK COMPRESSION
+// ================================================================================================
+// BC1 colors are fitted along the principal axis of the block, then refined by least squares on the indices.
+// Palette of a color block (C0 > C1): C0, C1, (2 * C0 + C1) / 3, (C0 + 2 * C1) / 3.
+
+static const int BC1_REFINE_ITERATIONS = 2;
+
+static uint16_t PackColor565(const float* Color)
+{
+    int R = (int)Math::Clamp(Color[0] * (31.f / 255.f) + 0.5f, 0.f, 31.f);
+    int G = (int)Math::Clamp(Color[1] * (63.f / 255.f) + 0.5f, 0.f, 63.f);
+    int B = (int)Math::Clamp(Color[2] * (31.f / 255.f) + 0.5f, 0.f, 31.f);
+    return (uint16_t)(R << 11 | G << 5 | B);
+}
+
+static void UnpackColor565(uint16_t Color, int* Rgb)
+{
+    int R = (Color >> 11) & 31;
+    int G = (Color >> 5) & 63;
+    int B = Color & 31;
+    Rgb[0] = (R << 3) | (R >> 2);
+    Rgb[1] = (G << 2) | (G >> 4);
+    Rgb[2] = (B << 3) | (B >> 2);
+}
+
+// Index of the closest palette entry for each texel, returns the total squared error
+static float FitIndices(const uint8_t* Texels, const int (*Palette)[3], uint8_t* Indices)
+{
+#if SIMD_X86
+    // 4 texels per iteration, one per lane
+    float TotalError = 0.f;
+    for (int i = 0; i < 16; i += 4)
+    {
+        const uint8_t* T = Texels + i * 4;
+        __m128 R = _mm_setr_ps(T[0], T[4], T[8], T[12]);
+        __m128 G = _mm_setr_ps(T[1], T[5], T[9], T[13]);
+        __m128 B = _mm_setr_ps(T[2], T[6], T[10], T[14]);
+        __m128 BestError = _mm_set1_ps(FLT_MAX);
+        __m128 BestIndex = _mm_setzero_ps();
+        for (int p = 0; p < 4; ++p)
+        {
+            __m128 DR = _mm_sub_ps(R, _mm_set1_ps((float)Palette[p][0]));
+            __m128 DG = _mm_sub_ps(G, _mm_set1_ps((float)Palette[p][1]));
+            __m128 DB = _mm_sub_ps(B, _mm_set1_ps((float)Palette[p][2]));
+            __m128 Error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DR, DR), _mm_mul_ps(DG, DG)), _mm_mul_ps(DB, DB));
+            __m128 Closer = _mm_cmplt_ps(Error, BestError);
+            BestError = _mm_min_ps(Error, BestError);
+            BestIndex = _mm_or_ps(_mm_and_ps(Closer, _mm_set1_ps((float)p)), _mm_andnot_ps(Closer, BestIndex));
+        }
+
+        float Errors[4], BestIndices[4];
+        _mm_storeu_ps(Errors, BestError);
+        _mm_storeu_ps(BestIndices, BestIndex);
+        for (int j = 0; j < 4; ++j)
+        {
+            Indices[i + j] = (uint8_t)BestIndices[j];
+            TotalError += Errors[j];
+        }
+    }
+    return TotalError;
+#else
+    float TotalError = 0.f;
+    for (int i = 0; i < 16; ++i)
+    {
+        const uint8_t* T = Texels + i * 4;
+        int BestError = INT32_MAX;
+        for (int p = 0; p < 4; ++p)
+        {
+            int DR = T[0] - Palette[p][0];
+            int DG = T[1] - Palette[p][1];
+            int DB = T[2] - Palette[p][2];
+            int Error = DR * DR + DG * DG + DB * DB;
+            if (Error < BestError)
+            {
+                BestError = Error;
+                Indices[i] = (uint8_t)p;
+            }
+        }
+        TotalError += (float)BestError;
+    }
+    return TotalError;
+#endif
+}
+
+// Encode the endpoints (ordered for the 4 colors mode) and fit the indices, returns the squared error
+static float EncodeColorBlock(const uint8_t* Texels, const float* Endpoint0, const float* Endpoint1, uint16_t* Color0, uint16_t* Color1, uint8_t* Indices)
+{
+    uint16_t C0 = PackColor565(Endpoint0);
+    uint16_t C1 = PackColor565(Endpoint1);
+    if (C0 < C1)
+        std::swap(C0, C1);
+
+    int Palette[4][3];
+    UnpackColor565(C0, Palette[0]);
+    UnpackColor565(C1, Palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+        Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+    }
+
+    *Color0 = C0;
+    *Color1 = C1;
+    if (C0 == C1)
+    {
+        // 3 colors mode: only the first entry is valid
+        memset(Indices, 0, 16);
+        float Error = 0.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                Error += (float)((Texels[i * 4 + c] - Palette[0][c]) * (Texels[i * 4 + c] - Palette[0][c]));
+        }
+        return Error;
+    }
+    return FitIndices(Texels, Palette, Indices);
+}
+
+// Endpoints minimizing the squared error for the given indices (false if all texels use the same weight)
+static bool RefineEndpoints(const uint8_t* Texels, const uint8_t* Indices, float* Endpoint0, float* Endpoint1)
+{
+    static const float Weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f }; // Of C0
+
+    float AA = 0.f, AB = 0.f, BB = 0.f;
+    float AX[3] = {}, BX[3] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float A = Weights[Indices[i]];
+        float B = 1.f - A;
+        AA += A * A;
+        AB += A * B;
+        BB += B * B;
+        for (int c = 0; c < 3; ++c)
+        {
+            AX[c] += A * Texels[i * 4 + c];
+            BX[c] += B * Texels[i * 4 + c];
+        }
+    }
+
+    float Determinant = AA * BB - AB * AB;
+    if (Math::Abs(Determinant) < 1e-6f)
+        return false;
+
+    float InvDeterminant = 1.f / Determinant;
+    for (int c = 0; c < 3; ++c)
+    {
+        Endpoint0[c] = Math::Clamp((AX[c] * BB - BX[c] * AB) * InvDeterminant, 0.f, 255.f);
+        Endpoint1[c] = Math::Clamp((BX[c] * AA - AX[c] * AB) * InvDeterminant, 0.f, 255.f);
+    }
+    return true;
+}
+
+static void WriteColorBlock(uint8_t* Destination, uint16_t Color0, uint16_t Color1, const uint8_t* Indices)
+{
+    uint32_t Bits = 0;
+    for (int i = 0; i < 16; ++i)
+        Bits |= (uint32_t)Indices[i] << (i * 2);
+    memcpy(Destination, &Color0, 2);
+    memcpy(Destination + 2, &Color1, 2);
+    memcpy(Destination + 4, &Bits, 4);
+}
+
+void Texture::CompressBlockBC1(uint8_t* Destination, const uint8_t* Texels)
+{
+    // Mean and covariance
+    float Mean[3] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+            Mean[c] += Texels[i * 4 + c] / 16.f;
+    }
+
+    float Covariance[6] = {}; // rr rg rb gg gb bb
+    float Min[3] = { 255.f, 255.f, 255.f }, Max[3] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float D[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            D[c] = Texels[i * 4 + c] - Mean[c];
+            Min[c] = Math::Min(Min[c], (float)Texels[i * 4 + c]);
+            Max[c] = Math::Max(Max[c], (float)Texels[i * 4 + c]);
+        }
+        Covariance[0] += D[0] * D[0];
+        Covariance[1] += D[0] * D[1];
+        Covariance[2] += D[0] * D[2];
+        Covariance[3] += D[1] * D[1];
+        Covariance[4] += D[1] * D[2];
+        Covariance[5] += D[2] * D[2];
+    }
+
+    // Principal axis by power iteration (starting from the bounding box diagonal)
+    float Axis[3] = { Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2] };
+    for (int Iteration = 0; Iteration < 4; ++Iteration)
+    {
+        float X = Covariance[0] * Axis[0] + Covariance[1] * Axis[1] + Covariance[2] * Axis[2];
+        float Y = Covariance[1] * Axis[0] + Covariance[3] * Axis[1] + Covariance[4] * Axis[2];
+        float Z = Covariance[2] * Axis[0] + Covariance[4] * Axis[1] + Covariance[5] * Axis[2];
+        float Length = Math::Max(Math::Max(Math::Abs(X), Math::Abs(Y)), Math::Abs(Z));
+        if (Length < 1e-6f)
+            break;
+        Axis[0] = X / Length;
+        Axis[1] = Y / Length;
+        Axis[2] = Z / Length;
+    }
+
+    // Extreme projections, inset to reduce the error of the outliers
+    float MinProjection = FLT_MAX, MaxProjection = -FLT_MAX;
+    float AxisLengthSquared = Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2];
+    for (int i = 0; i < 16; ++i)
+    {
+        float Projection = 0.f;
+        for (int c = 0; c < 3; ++c)
+            Projection += (Texels[i * 4 + c] - Mean[c]) * Axis[c];
+        MinProjection = Math::Min(MinProjection, Projection);
+        MaxProjection = Math::Max(MaxProjection, Projection);
+    }
+    float Inset = (MaxProjection - MinProjection) / 16.f;
+    MinProjection = (MinProjection + Inset) / Math::Max(AxisLengthSquared, 1e-6f);
+    MaxProjection = (MaxProjection - Inset) / Math::Max(AxisLengthSquared, 1e-6f);
+
+    float Endpoint0[3], Endpoint1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        Endpoint0[c] = Math::Clamp(Mean[c] + Axis[c] * MaxProjection, 0.f, 255.f);
+        Endpoint1[c] = Math::Clamp(Mean[c] + Axis[c] * MinProjection, 0.f, 255.f);
+    }
+
+    uint16_t Color0, Color1;
+    uint8_t Indices[16];
+    float Error = EncodeColorBlock(Texels, Endpoint0, Endpoint1, &Color0, &Color1, Indices);
+
+    // Least squares refinement, keep the best candidate
+    for (int Iteration = 0; Iteration < BC1_REFINE_ITERATIONS && Error > 0.f; ++Iteration)
+    {
+        if (!RefineEndpoints(Texels, Indices, Endpoint0, Endpoint1))
+            break;
+
+        uint16_t RefinedColor0, RefinedColor1;
+        uint8_t RefinedIndices[16];
+        float RefinedError = EncodeColorBlock(Texels, Endpoint0, Endpoint1, &RefinedColor0, &RefinedColor1, RefinedIndices);
+        if (RefinedError >= Error)
+            break;
+
+        Error = RefinedError;
+        Color0 = RefinedColor0;
+        Color1 = RefinedColor1;
+        memcpy(Indices, RefinedIndices, 16);
+    }
+
+    WriteColorBlock(Destination, Color0, Color1, Indices);
+}
+
+// Single channel block: 2 endpoints (A0 > A1 selects 6 interpolated values) + 3 bits indices
+void Texture::CompressBlockBC4(uint8_t* Destination, const uint8_t* Texels, int Channel)
+{
+    int Min = 255, Max = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        Min = Math::Min(Min, (int)Texels[i * 4 + Channel]);
+        Max = Math::Max(Max, (int)Texels[i * 4 + Channel]);
+    }
+
+    memset(Destination, 0, 8);
+    Destination[0] = (uint8_t)Max;
+    Destination[1] = (uint8_t)Min;
+    if (Min == Max)
+        return;
+
+    int Palette[8] = { Max, Min };
+    for (int i = 2; i < 8; ++i)
+        Palette[i] = ((8 - i) * Max + (i - 1) * Min) / 7;
+
+    uint64_t Bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int Value = Texels[i * 4 + Channel];
+        int BestIndex = 0;
+        int BestError = INT32_MAX;
+        for (int p = 0; p < 8; ++p)
+        {
+            int Error = (Value - Palette[p]) * (Value - Palette[p]);
+            if (Error < BestError)
+            {
+                BestError = Error;
+                BestIndex = p;
+            }
+        }
+        Bits |= (uint64_t)BestIndex << (i * 3);
+    }
+    for (int i = 0; i < 6; ++i)
+        Destination[2 + i] = (uint8_t)(Bits >> (i * 8));
+}
+
+void Texture::Compress(uint8_t* Destination, texture_format Format, const uint8_t* Pixels, int Width, int Height, int Channels)
+{
+    assert(IsCompressed(Format));
+
+    int BlockCountX = (Width + 3) / 4;
+    int BlockCountY = (Height + 3) / 4;
+    size_t BlockSize = (Format == TEXTURE_FORMAT_BC1) ? 8 : 16;
+
+    Jobs::ParallelFor(BlockCountY, [=](int BlockY)
+    {
+        uint8_t* Output = Destination + (size_t)BlockY * BlockCountX * BlockSize;
+        for (int BlockX = 0; BlockX < BlockCountX; ++BlockX)
+        {
+            // Gather the block as rgba
+            uint8_t Texels[16 * 4];
+            for (int i = 0; i < 16; ++i)
+            {
+                int x = Math::Min(BlockX * 4 + i % 4, Width - 1);
+                int y = Math::Min(BlockY * 4 + i / 4, Height - 1);
+                const uint8_t* Pixel = Pixels + ((size_t)y * Width + x) * Channels;
+                Texels[i * 4 + 0] = Pixel[0];
+                Texels[i * 4 + 1] = Pixel[Math::Min(1, Channels - 1)];
+                Texels[i * 4 + 2] = Pixel[Math::Min(2, Channels - 1)];
+                Texels[i * 4 + 3] = (Channels == 4) ? Pixel[3] : 255;
+            }
+
+            switch (Format)
+            {
+            case TEXTURE_FORMAT_BC1:
+                CompressBlockBC1(Output, Texels);
+                break;
+            case TEXTURE_FORMAT_BC3:
+                CompressBlockBC4(Output, Texels, 3);
+                CompressBlockBC1(Output + 8, Texels);
+                break;
+            case TEXTURE_FORMAT_BC5:
+                CompressBlockBC4(Output, Texels, 0);
+                CompressBlockBC4(Output + 8, Texels, 1);
+                break;
+            default:
+                break;
+            }
+            Output += BlockSize;
+        }
+    });
+}
+
+// ================================================================================================
+// BUILD
+// ================================================================================================
+void Texture::Build(texture_data& Texture, const uint8_t* Pixels, int Width, int Height, int Channels, texture_format Format, int BuildFlags)
+{
+    Texture.Format = Format;
+    Texture.Width = Width;
+    Texture.Height = Height;
+    Texture.Channels = Channels;
+
+    // Level layout
+    Texture.LevelCount = 0;
+    size_t Offset = 0;
+    size_t MipmapSize = 0; // Uncompressed texels of levels 1+
+    for (int LevelWidth = Width, LevelHeight = Height; Texture.LevelCount < TEXTURE_MAX_LEVELS;)
+    {
+        texture_level& Level = Texture.Levels[Texture.LevelCount++];
+        Level.Width = (uint32_t)LevelWidth;
+        Level.Height = (uint32_t)LevelHeight;
+        Level.Offset = Offset;
+        Level.Size = GetLevelSize(Format, LevelWidth, LevelHeight);
+        Offset += Level.Size;
+        if (Texture.LevelCount > 1)
+            MipmapSize += (size_t)LevelWidth * LevelHeight * Channels;
+
+        if (!(BuildFlags & TEXTURE_BUILD_MIPMAPS) || (LevelWidth == 1 && LevelHeight == 1))
+            break;
+        LevelWidth = Math::Max(LevelWidth / 2, 1);
+        LevelHeight = Math::Max(LevelHeight / 2, 1);
+    }
+    Texture.Data.resize(Offset);
+
+    // Uncompressed levels, then encoded in place (or compressed)
+    std::vector<uint8_t> Mipmaps(MipmapSize);
+    uint8_t* LevelPixels[TEXTURE_MAX_LEVELS] = { (uint8_t*)Pixels };
+    size_t MipmapOffset = 0;
+    for (int i = 1; i < Texture.LevelCount; ++i)
+    {
+        LevelPixels[i] = Mipmaps.data() + MipmapOffset;
+        MipmapOffset += (size_t)Texture.Levels[i].Width * Texture.Levels[i].Height * Channels;
+    }
+    GenerateMipmaps(LevelPixels, Texture.LevelCount, Pixels, Width, Height, Channels, BuildFlags);
+
+    for (int i = 0; i < Texture.LevelCount; ++i)
+    {
+        const texture_level& Level = Texture.Levels[i];
+        if (IsCompressed(Format))
+            Compress(Texture.Data.data() + Level.Offset, Format, LevelPixels[i], (int)Level.Width, (int)Level.Height, Channels);
+        else
+            memcpy(Texture.Data.data() + Level.Offset, LevelPixels[i], Level.Size);
+    }
+}
+
+// ================================================================================================
+// TEXTURE CACHE
+// ================================================================================================
+static const uint32_t TEXTURE_CACHE_MAGIC = 0x54524249; // "IBRT"
+static const uint32_t TEXTURE_CACHE_VERSION = 3; // 2: Kaiser filtered mipmaps in linear space, alpha coverage
+                                                 // 3: Chunks compressed with Lz
+
+// Decoding depends on the image flags (flip, channels)
+static std::string GetCacheFilename(const char* Filename, int ImageFlags)
+{
+    char Suffix[32];
+    snprintf(Suffix, sizeof(Suffix), ".%x.cache", ImageFlags);
+    return std::string(Filename) + Suffix;
+}
+
+bool Texture::SaveCache(const texture_data& Texture, const char* Filename, int ImageFlags)
+{
+    texture_cache_header Header = {};
+    Header.Magic = TEXTURE_CACHE_MAGIC;
+    Header.Version = TEXTURE_CACHE_VERSION;
+    Header.Format = (uint32_t)Texture.Format;
+    Header.ImageFlags = (uint32_t)ImageFlags;
+    Header.Width = (uint32_t)Texture.Width;
+    Header.Height = (uint32_t)Texture.Height;
+    Header.Channels = (uint32_t)Texture.Channels;
+    Header.LevelCount = (uint32_t)Texture.LevelCount;
+    Header.DataSize = Texture.Data.size();
+    Header.ChunkSize = TEXTURE_CACHE_CHUNK_SIZE;
+    Header.ChunkCount = (uint32_t)((Texture.Data.size() + TEXTURE_CACHE_CHUNK_SIZE - 1) / TEXTURE_CACHE_CHUNK_SIZE);
+    for (int i = 0; i < Texture.LevelCount; ++i)
+        Header.Levels[i] = Texture.Levels[i];
+
+    file_info SourceInfo = {};
+    File::GetInfo(Filename, &SourceInfo);
+    Header.SourceSize = SourceInfo.Size;
+    Header.SourceModificationTime = SourceInfo.ModificationTime;
+
+    // Compress the chunks in parallel
+    int ChunkCount = (int)Header.ChunkCount;
+    std::vector<texture_cache_chunk> ChunkTable(ChunkCount);
+    std::vector<std::vector<uint8_t>> CompressedChunks(ChunkCount);
+    Jobs::ParallelFor(ChunkCount, [&](int i)
+    {
+        size_t Offset = (size_t)i * TEXTURE_CACHE_CHUNK_SIZE;
+        size_t Size = Math::Min<size_t>(TEXTURE_CACHE_CHUNK_SIZE, Texture.Data.size() - Offset);
+        std::vector<uint8_t>& Compressed = CompressedChunks[i];
+        Compressed.resize(Lz::GetMaxCompressedSize(Size));
+        Compressed.resize(Lz::Compress(Compressed.data(), Texture.Data.data() + Offset, Size));
+        ChunkTable[i].Size = (uint32_t)Size;
+        ChunkTable[i].CompressedSize = (uint32_t)Math::Min(Compressed.size(), Size);
+    });
+
+    std::vector<const void*> Chunks = { &Header, ChunkTable.data() };
+    std::vector<size_t> ChunkSizes = { sizeof(texture_cache_header), ChunkCount * sizeof(texture_cache_chunk) };
+    uint64_t Offset = sizeof(texture_cache_header) + ChunkCount * sizeof(texture_cache_chunk);
+    for (int i = 0; i < ChunkCount; ++i)
+    {
+        bool Raw = ChunkTable[i].CompressedSize == ChunkTable[i].Size;
+        ChunkTable[i].Offset = Offset;
+        Chunks.push_back(Raw ? Texture.Data.data() + (size_t)i * TEXTURE_CACHE_CHUNK_SIZE : CompressedChunks[i].data());
+        ChunkSizes.push_back(ChunkTable[i].CompressedSize);
+        Offset += ChunkTable[i].CompressedSize;
+    }
+    Header.FileSize = Offset;
+
+    std::string CachedFile = GetCacheFilename(Filename, ImageFlags);
+    if (!File::WriteAtomic(CachedFile.c_str(), (int)Chunks.size(), Chunks.data(), ChunkSizes.data()))
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        return false;
+    }
+
+    printf("Saved to cache: %s (%s, %d levels, %.1f KB -> %.1f KB)\n", Filename, GetFormatName(Texture.Format), Texture.LevelCount,
+        Texture.Data.size() / 1024.f, Header.FileSize / 1024.f);
+    return true;
+}
+
+static bool ValidateTextureCache(const file_mapping& Mapping, const char* Filename, int ImageFlags)
+{
+    if (Mapping.Size < sizeof(texture_cache_header))
+        return false;
+
+    const texture_cache_header* Header = (const texture_cache_header*)Mapping.Data;
+    if (Header->Magic != TEXTURE_CACHE_MAGIC
+     || Header->Version != TEXTURE_CACHE_VERSION
+     || Header->Format >= TEXTURE_FORMAT_COUNT
+     || Header->ImageFlags != (uint32_t)ImageFlags
+     || Header->FileSize != Mapping.Size
+     || Header->LevelCount == 0 || Header->LevelCount > TEXTURE_MAX_LEVELS
+     || Header->ChunkSize != TEXTURE_CACHE_CHUNK_SIZE
+     || Header->ChunkCount != (Header->DataSize + TEXTURE_CACHE_CHUNK_SIZE - 1) / TEXTURE_CACHE_CHUNK_SIZE
+     || Header->ChunkCount > (Mapping.Size - sizeof(texture_cache_header)) / sizeof(texture_cache_chunk))
+        return false;
+
+    for (uint32_t i = 0; i < Header->LevelCount; ++i)
+    {
+        const texture_level& Level = Header->Levels[i];
+        if (Level.Offset > Header->DataSize || Level.Size > Header->DataSize - Level.Offset
+         || Level.Size != Texture::GetLevelSize((texture_format)Header->Format, (int)Level.Width, (int)Level.Height))
+            return false;
+    }
+
+    const texture_cache_chunk* Chunks = (const texture_cache_chunk*)(Header + 1);
+    for (uint32_t i = 0; i < Header->ChunkCount; ++i)
+    {
+        const texture_cache_chunk& Chunk = Chunks[i];
+        if (Chunk.Size != Math::Min<uint64_t>(TEXTURE_CACHE_CHUNK_SIZE, Header->DataSize - (uint64_t)i * TEXTURE_CACHE_CHUNK_SIZE)
+         || Chunk.CompressedSize > Chunk.Size
+         || Chunk.Offset > Mapping.Size || Chunk.CompressedSize > Mapping.Size - Chunk.Offset)
+            return false;
+    }
+
+    // Outdated
+    file_info SourceInfo;
+    if (!File::GetInfo(Filename, &SourceInfo)
+     || SourceInfo.Size != Header->SourceSize
+     || SourceInfo.ModificationTime != Header->SourceModificationTime)
+        return false;
+
+    return true;
+}
+
+bool Texture::MapCache(texture_cache& Cache, const char* Filename, int ImageFlags)
+{
+    Cache = {};
+
+    std::string CachedFile = GetCacheFilename(Filename, ImageFlags);
+    if (!File::Map(&Cache.Mapping, CachedFile.c_str()))
+        return false;
+
+    if (!ValidateTextureCache(Cache.Mapping, Filename, ImageFlags))
+    {
+        UnmapCache(Cache);
+        return false;
+    }
+
+    Cache.Header = (const texture_cache_header*)Cache.Mapping.Data;
+    Cache.Chunks = (const texture_cache_chunk*)(Cache.Header + 1);
+    return true;
+}
+
+void Texture::UnmapCache(texture_cache& Cache)
+{
+    File::Unmap(&Cache.Mapping);
+    Cache = {};
+}
+
+bool Texture::ReadCacheChunk(const texture_cache& Cache, int Chunk, uint8_t* Destination)
+{
+    const texture_cache_chunk& Info = Cache.Chunks[Chunk];
+    const uint8_t* Source = (const uint8_t*)Cache.Mapping.Data + Info.Offset;
+    if (Info.CompressedSize == Info.Size)
+    {
+        memcpy(Destination, Source, Info.Size);
+        return true;
+    }
+    return Lz::Decompress(Destination, Info.Size, Source, Info.CompressedSize);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "file.h"
+#include "simd.h"
+
+// Formats of the texture levels (block compressed formats encode 4x4 texel blocks)
+enum texture_format
+{
+    TEXTURE_FORMAT_RGB8,
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1, // 8 bytes per block: 5:6:5 color endpoints + 2 bits indices (opaque)
+    TEXTURE_FORMAT_BC3, // 16 bytes per block: BC4 alpha + BC1 color
+    TEXTURE_FORMAT_BC5, // 16 bytes per block: two BC4 channels (normal map xy)
+    TEXTURE_FORMAT_COUNT
+};
+
+#define TEXTURE_MAX_LEVELS 16
+
+enum texture_build_flags
+{
+    TEXTURE_BUILD_MIPMAPS = 1 << 0,
+    TEXTURE_BUILD_LINEAR  = 1 << 1, // Texels are not sRGB encoded (normal maps)
+};
+
+struct texture_level
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint64_t Offset; // From the start of the texture data
+    uint64_t Size;
+};
+
+// Texture with all its levels in one buffer
+struct texture_data
+{
+    texture_format Format;
+    int Width;
+    int Height;
+    int Channels; // Of the source image (3 or 4)
+    int LevelCount;
+    texture_level Levels[TEXTURE_MAX_LEVELS];
+    std::vector<uint8_t> Data;
+};
+
+// Texture data is cached in chunks compressed separately (slices of the upload), stored raw if they do not compress
+#define TEXTURE_CACHE_CHUNK_SIZE (256 * 1024)
+
+struct texture_cache_chunk
+{
+    uint64_t Offset;         // In the cache file
+    uint32_t Size;
+    uint32_t CompressedSize; // Size if stored raw
+};
+
+// Header of the binary cache written next to the image ("<filename>.<image flags>.cache"), followed by the chunk table
+struct texture_cache_header
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Format;     // texture_format
+    uint32_t ImageFlags; // Flags used to decode the source image
+    uint64_t FileSize;
+    uint64_t SourceSize; // Used to detect outdated cache
+    uint64_t SourceModificationTime;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Channels;
+    uint32_t LevelCount;
+    uint64_t DataSize;   // All levels
+    uint32_t ChunkCount;
+    uint32_t ChunkSize;  // TEXTURE_CACHE_CHUNK_SIZE (last chunk can be smaller)
+    texture_level Levels[TEXTURE_MAX_LEVELS];
+};
+
+// Texture cache mapped in memory
+struct texture_cache
+{
+    file_mapping Mapping;
+    const texture_cache_header* Header;
+    const texture_cache_chunk* Chunks;
+};
+
+namespace Texture
+{
+    const char* GetFormatName(texture_format Format);
+    bool IsCompressed(texture_format Format);
+    // Size in bytes of a level (whole 4x4 blocks for compressed formats)
+    size_t GetLevelSize(texture_format Format, int Width, int Height);
+    // BC5 for normal maps, BC3 if some texels are not opaque, BC1 otherwise (Channels is 3 or 4)
+    texture_format ChooseCompressedFormat(const uint8_t* Pixels, int Width, int Height, int Channels, bool NormalMap);
+
+    // Fill Levels[1..LevelCount) with the mip chain of Pixels (level i is max(Width >> i, 1) x max(Height >> i, 1) texels).
+    // Kaiser filtered in linear space (unless TEXTURE_BUILD_LINEAR), alpha scaled to keep the alpha test coverage of level 0 (Channels is 3 or 4).
+    void GenerateMipmaps(uint8_t* const* Levels, int LevelCount, const uint8_t* Pixels, int Width, int Height, int Channels, int BuildFlags, simd_level SimdLevel = SIMD_AVX2);
+    // Encode a Width x Height image (rows of blocks in parallel, partial blocks repeat the edge texels)
+    void Compress(uint8_t* Destination, texture_format Format, const uint8_t* Pixels, int Width, int Height, int Channels);
+    // Single block encoders (Texels are 16 rgba values in row order)
+    void CompressBlockBC1(uint8_t* Destination, const uint8_t* Texels);
+    void CompressBlockBC4(uint8_t* Destination, const uint8_t* Texels, int Channel);
+    // Fill Texture with Pixels in Format (and its mip chain down to 1x1 with TEXTURE_BUILD_MIPMAPS)
+    void Build(texture_data& Texture, const uint8_t* Pixels, int Width, int Height, int Channels, texture_format Format, int BuildFlags);
+
+    bool SaveCache(const texture_data& Texture, const char* Filename, int ImageFlags);
+    // Map the cache of a previously built image, fails if the cache is missing, invalid or outdated
+    bool MapCache(texture_cache& Cache, const char* Filename, int ImageFlags);
+    void UnmapCache(texture_cache& Cache);
+    // Decompress the texture data of a chunk (Destination holds TEXTURE_CACHE_CHUNK_SIZE bytes), false if corrupted
+    bool ReadCacheChunk(const texture_cache& Cache, int Chunk, uint8_t* Destination);
+}